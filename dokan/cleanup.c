@@ -26,7 +26,7 @@ VOID DispatchCleanup(PDOKAN_IO_EVENT IoEvent) {
   CheckFileName(IoEvent->EventContext->Operation.Cleanup.FileName);
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   IoEvent->EventResult->Status = STATUS_SUCCESS; // return success at any case
 
@@ -47,5 +47,10 @@ VOID DispatchCleanup(PDOKAN_IO_EVENT IoEvent) {
         &IoEvent->DokanFileInfo);
   }
 
+  if (IoEvent->DokanFileInfo.DeletePending) {
+    InvalidateDirectoryCache(IoEvent->DokanInstance,
+                             IoEvent->EventContext->Operation.Cleanup.FileName);
+  }
+
   EventCompletion(IoEvent);
 }
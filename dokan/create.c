@@ -104,6 +104,145 @@ BOOL CreateSuccesStatusCheck(NTSTATUS status, ULONG disposition) {
   return FALSE;
 }
 
+VOID DOKANAPI DokanEndDispatchCreate(PDOKAN_FILE_INFO DokanFileInfo,
+                                     NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  ULONG disposition;
+  DWORD options;
+  DOKAN_IO_SECURITY_CONTEXT ioSecurityContext;
+  WCHAR *fileName;
+
+  fileName = (WCHAR *)((PCHAR)&ioEvent->EventContext->Operation.Create +
+                       ioEvent->EventContext->Operation.Create.FileNameOffset);
+
+  // The high 8 bits of this parameter correspond to the Disposition parameter
+  disposition = (ioEvent->EventContext->Operation.Create.CreateOptions >> 24) &
+                0x000000ff;
+  // The low 24 bits of this member correspond to the CreateOptions parameter
+  options = ioEvent->EventContext->Operation.Create.CreateOptions &
+            FILE_VALID_OPTION_FLAGS;
+  if (ioEvent->EventContext->Flags & SL_OPEN_TARGET_DIRECTORY) {
+    options |= FILE_DIRECTORY_FILE;
+    options &= ~FILE_NON_DIRECTORY_FILE;
+  }
+
+  // save the information about this access in DOKAN_OPEN_INFO
+  ioEvent->DokanOpenInfo->IsDirectory = DokanFileInfo->IsDirectory;
+  ioEvent->DokanOpenInfo->UserContext = DokanFileInfo->Context;
+
+  if (!CreateSuccesStatusCheck(Status, disposition)) {
+    if (ioEvent->EventContext->Flags & SL_OPEN_TARGET_DIRECTORY) {
+      DbgPrint("SL_OPEN_TARGET_DIRECTORY specified\n");
+    }
+    ioEvent->EventResult->Operation.Create.Information = FILE_DOES_NOT_EXIST;
+    ioEvent->EventResult->Status = Status;
+
+    if (Status == STATUS_OBJECT_NAME_COLLISION) {
+      ioEvent->EventResult->Operation.Create.Information = FILE_EXISTS;
+    }
+
+    if (STATUS_ACCESS_DENIED == Status &&
+        ioEvent->DokanInstance->DokanOperations->ZwCreateFile &&
+        (ioEvent->EventContext->Operation.Create.SecurityContext.DesiredAccess &
+         DELETE)) {
+      UCHAR asyncDispatch = DokanFileInfo->AsyncDispatch;
+      DbgPrint("Delete failed, ask parent folder if we have the right\n");
+      // strip the last section of the file path
+      WCHAR *lastP = NULL;
+      for (WCHAR *p = fileName; *p; p++) {
+        if ((*p == L'\\' || *p == L'/') && p[1])
+          lastP = p;
+      }
+      if (lastP) {
+        *lastP = 0;
+      }
+
+      SetIOSecurityContext(ioEvent->EventContext, &ioSecurityContext);
+      ACCESS_MASK newDesiredAccess =
+          (MAXIMUM_ALLOWED & ioSecurityContext.DesiredAccess)
+              ? (FILE_DELETE_CHILD | FILE_LIST_DIRECTORY)
+              : (((DELETE & ioSecurityContext.DesiredAccess) ? FILE_DELETE_CHILD
+                                                             : 0) |
+                 ((FILE_READ_ATTRIBUTES & ioSecurityContext.DesiredAccess)
+                      ? FILE_LIST_DIRECTORY
+                      : 0));
+
+      options |= FILE_OPEN_FOR_BACKUP_INTENT; //Enable open directory
+      options &= ~FILE_NON_DIRECTORY_FILE;    //Remove non dir flag
+
+      // The parent check is part of the pending create and cannot pend itself.
+      DokanFileInfo->AsyncDispatch = FALSE;
+      Status = ioEvent->DokanInstance->DokanOperations->ZwCreateFile(
+          fileName, &ioSecurityContext, newDesiredAccess,
+          ioEvent->EventContext->Operation.Create.FileAttributes,
+          ioEvent->EventContext->Operation.Create.ShareAccess, disposition,
+          options, DokanFileInfo);
+      DokanFileInfo->AsyncDispatch = asyncDispatch;
+
+      if (Status == STATUS_SUCCESS) {
+        DbgPrint("Parent give us the right to delete\n");
+        ioEvent->EventResult->Status = STATUS_SUCCESS;
+        ioEvent->EventResult->Operation.Create.Information = FILE_OPENED;
+      } else {
+        DbgPrint("Parent CreateFile failed status = %lx\n", Status);
+        PushFileOpenInfo(ioEvent->DokanOpenInfo);
+        ioEvent->DokanOpenInfo = NULL;
+      }
+    } else {
+      PushFileOpenInfo(ioEvent->DokanOpenInfo);
+      ioEvent->DokanOpenInfo = NULL;
+    }
+
+  } else {
+
+    ioEvent->EventResult->Status = STATUS_SUCCESS;
+    ioEvent->EventResult->Operation.Create.Information = FILE_OPENED;
+
+    if (disposition == FILE_CREATE || disposition == FILE_OPEN_IF ||
+        disposition == FILE_OVERWRITE_IF || disposition == FILE_SUPERSEDE) {
+      ioEvent->EventResult->Operation.Create.Information = FILE_CREATED;
+
+      if (Status == STATUS_OBJECT_NAME_COLLISION) {
+        if (disposition == FILE_OPEN_IF) {
+          ioEvent->EventResult->Operation.Create.Information = FILE_OPENED;
+        } else if (disposition == FILE_OVERWRITE_IF) {
+          ioEvent->EventResult->Operation.Create.Information =
+              FILE_OVERWRITTEN;
+        } else if (disposition == FILE_SUPERSEDE) {
+          ioEvent->EventResult->Operation.Create.Information = FILE_SUPERSEDED;
+        }
+      }
+    }
+
+    if (disposition == FILE_OVERWRITE)
+      ioEvent->EventResult->Operation.Create.Information = FILE_OVERWRITTEN;
+
+    if (ioEvent->EventResult->Operation.Create.Information != FILE_OPENED)
+      InvalidateDirectoryCache(ioEvent->DokanInstance, fileName);
+
+    if (DokanFileInfo->IsDirectory)
+      ioEvent->EventResult->Operation.Create.Flags |= DOKAN_FILE_DIRECTORY;
+  }
+
+  if (!NT_SUCCESS(ioEvent->EventResult->Status)) {
+    ioEvent->EventResult->Context = 0;
+  } else {
+    TraceEventOpen(ioEvent->DokanInstance,
+                   ioEvent->EventContext->SerialNumber,
+                   ioEvent->EventResult->Context);
+  }
+
+  DbgPrint("Dokan Information: DokanEndDispatchCreate() status = %lx, file "
+           "handle = 0x%p, eventID = %04d, result = 0x%x\n",
+           ioEvent->EventResult->Status, ioEvent->DokanOpenInfo,
+           ioEvent->DokanOpenInfo ? ioEvent->DokanOpenInfo->EventId : -1,
+           ioEvent->EventResult->Operation.Create.Information);
+
+  // The open is kept for the handle, only the pending result is sent.
+  CompletePendingDispatch(ioEvent);
+}
+
 VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
   static volatile LONG globalEventId = 0;
   ULONG currentEventId = InterlockedIncrement(&globalEventId);
@@ -112,7 +251,6 @@ VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
   DWORD options;
   DOKAN_IO_SECURITY_CONTEXT ioSecurityContext;
   WCHAR *fileName;
-  BOOL childExisted = TRUE;
   WCHAR *origFileName = NULL;
   DWORD origOptions;
 
@@ -122,14 +260,13 @@ VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
   CheckFileName(fileName);
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   assert(IoEvent->DokanOpenInfo == NULL);
 
-  IoEvent->DokanOpenInfo = PopFileOpenInfo();
+  IoEvent->DokanOpenInfo = PopFileOpenInfo(IoEvent->DokanInstance);
   IoEvent->DokanOpenInfo->OpenCount = 1;
   IoEvent->DokanOpenInfo->EventContext = IoEvent->EventContext;
-  IoEvent->DokanOpenInfo->DokanInstance = IoEvent->DokanInstance;
   IoEvent->DokanOpenInfo->EventId = currentEventId;
 
   // Pass it to the driver so we can retrieve it on the next call of the same context.
@@ -193,6 +330,9 @@ VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
     if ((IoEvent->EventContext->Flags & SL_OPEN_TARGET_DIRECTORY) &&
         IoEvent->DokanInstance->DokanOperations->Cleanup &&
         IoEvent->DokanInstance->DokanOperations->CloseFile) {
+      // Only the open of the target directory itself can pend.
+      UCHAR asyncDispatch = IoEvent->DokanFileInfo.AsyncDispatch;
+      IoEvent->DokanFileInfo.AsyncDispatch = FALSE;
 
       if (options & FILE_NON_DIRECTORY_FILE && options & FILE_DIRECTORY_FILE)
         status = STATUS_INVALID_PARAMETER;
@@ -209,10 +349,12 @@ VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
             origFileName, &IoEvent->DokanFileInfo);
       } else if (status == STATUS_OBJECT_NAME_NOT_FOUND) {
         DbgPrint("SL_OPEN_TARGET_DIRECTORY file not found\n");
-        childExisted = FALSE;
+        IoEvent->EventResult->Operation.Create.Information =
+            FILE_DOES_NOT_EXIST;
       }
 
       IoEvent->DokanFileInfo.IsDirectory = TRUE;
+      IoEvent->DokanFileInfo.AsyncDispatch = asyncDispatch;
     }
 
     if (options & FILE_NON_DIRECTORY_FILE && options & FILE_DIRECTORY_FILE)
@@ -223,116 +365,15 @@ VOID DispatchCreate(PDOKAN_IO_EVENT IoEvent) {
           IoEvent->EventContext->Operation.Create.FileAttributes,
           IoEvent->EventContext->Operation.Create.ShareAccess, disposition,
           options, &IoEvent->DokanFileInfo);
-
-    if (CreateSuccesStatusCheck(status, disposition)
-      && !childExisted) {
-      IoEvent->EventResult->Operation.Create.Information = FILE_DOES_NOT_EXIST;
-    }
   } else {
     status = STATUS_NOT_IMPLEMENTED;
   }
 
-  // save the information about this access in DOKAN_OPEN_INFO
-  IoEvent->DokanOpenInfo->IsDirectory = IoEvent->DokanFileInfo.IsDirectory;
-  IoEvent->DokanOpenInfo->UserContext = IoEvent->DokanFileInfo.Context;
-
-  if (!CreateSuccesStatusCheck(status, disposition)) {
-    if (IoEvent->EventContext->Flags & SL_OPEN_TARGET_DIRECTORY) {
-      DbgPrint("SL_OPEN_TARGET_DIRECTORY specified\n");
-    }
-    IoEvent->EventResult->Operation.Create.Information = FILE_DOES_NOT_EXIST;
-    IoEvent->EventResult->Status = status;
-
-    if (status == STATUS_OBJECT_NAME_COLLISION) {
-      IoEvent->EventResult->Operation.Create.Information = FILE_EXISTS;
-    }
-
-    if (STATUS_ACCESS_DENIED == status &&
-        IoEvent->DokanInstance->DokanOperations->ZwCreateFile &&
-        (IoEvent->EventContext->Operation.Create.SecurityContext.DesiredAccess &
-         DELETE)) {
-      DbgPrint("Delete failed, ask parent folder if we have the right\n");
-      // strip the last section of the file path
-      WCHAR *lastP = NULL;
-      for (WCHAR *p = fileName; *p; p++) {
-        if ((*p == L'\\' || *p == L'/') && p[1])
-          lastP = p;
-      }
-      if (lastP) {
-        *lastP = 0;
-      }
-
-      SetIOSecurityContext(IoEvent->EventContext, &ioSecurityContext);
-      ACCESS_MASK newDesiredAccess =
-          (MAXIMUM_ALLOWED & ioSecurityContext.DesiredAccess)
-              ? (FILE_DELETE_CHILD | FILE_LIST_DIRECTORY)
-              : (((DELETE & ioSecurityContext.DesiredAccess) ? FILE_DELETE_CHILD
-                                                             : 0) |
-                 ((FILE_READ_ATTRIBUTES & ioSecurityContext.DesiredAccess)
-                      ? FILE_LIST_DIRECTORY
-                      : 0));
-
-      options |= FILE_OPEN_FOR_BACKUP_INTENT; //Enable open directory
-      options &= ~FILE_NON_DIRECTORY_FILE;    //Remove non dir flag
-
-      status = IoEvent->DokanInstance->DokanOperations->ZwCreateFile(
-          fileName, &ioSecurityContext, newDesiredAccess,
-          IoEvent->EventContext->Operation.Create.FileAttributes,
-          IoEvent->EventContext->Operation.Create.ShareAccess, disposition,
-          options, &IoEvent->DokanFileInfo);
-
-      if (status == STATUS_SUCCESS) {
-        DbgPrint("Parent give us the right to delete\n");
-        IoEvent->EventResult->Status = STATUS_SUCCESS;
-        IoEvent->EventResult->Operation.Create.Information = FILE_OPENED;
-      } else {
-        DbgPrint("Parent CreateFile failed status = %lx\n", status);
-        PushFileOpenInfo(IoEvent->DokanOpenInfo);
-        IoEvent->DokanOpenInfo = NULL;
-      }
-    } else {
-      PushFileOpenInfo(IoEvent->DokanOpenInfo);
-      IoEvent->DokanOpenInfo = NULL;
-    }
-
-  } else {
-
-    IoEvent->EventResult->Status = STATUS_SUCCESS;
-    IoEvent->EventResult->Operation.Create.Information = FILE_OPENED;
-
-    if (disposition == FILE_CREATE || disposition == FILE_OPEN_IF ||
-        disposition == FILE_OVERWRITE_IF || disposition == FILE_SUPERSEDE) {
-      IoEvent->EventResult->Operation.Create.Information = FILE_CREATED;
-
-      if (status == STATUS_OBJECT_NAME_COLLISION) {
-        if (disposition == FILE_OPEN_IF) {
-          IoEvent->EventResult->Operation.Create.Information = FILE_OPENED;
-        } else if (disposition == FILE_OVERWRITE_IF) {
-          IoEvent->EventResult->Operation.Create.Information =
-              FILE_OVERWRITTEN;
-        } else if (disposition == FILE_SUPERSEDE) {
-          IoEvent->EventResult->Operation.Create.Information = FILE_SUPERSEDED;
-        }
-      }
-    }
-
-    if (disposition == FILE_OVERWRITE)
-      IoEvent->EventResult->Operation.Create.Information = FILE_OVERWRITTEN;
-
-    if (IoEvent->DokanFileInfo.IsDirectory)
-      IoEvent->EventResult->Operation.Create.Flags |= DOKAN_FILE_DIRECTORY;
-  }
-
   if (origFileName)
     free(origFileName);
 
-  if (!NT_SUCCESS(IoEvent->EventResult->Status)) {
-    IoEvent->EventResult->Context = 0;
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  DbgPrint("Dokan Information: DokanEndDispatchCreate() status = %lx, file "
-           "handle = 0x%p, eventID = %04d, result = 0x%x\n",
-           IoEvent->EventResult->Status, IoEvent->DokanOpenInfo,
-           IoEvent->DokanOpenInfo ? IoEvent->DokanOpenInfo->EventId : -1,
-           IoEvent->EventResult->Operation.Create.Information);
+  DokanEndDispatchCreate(&IoEvent->DokanFileInfo, status);
 }
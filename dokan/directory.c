@@ -27,275 +27,269 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include <assert.h>
 
-/**
-* \struct DOKAN_FIND_DATA
-* \brief Dokan find file list
-*
-* Used by FindFiles
-*/
-typedef struct _DOKAN_FIND_DATA {
-  /**
-  * File data information link
-  */
-  WIN32_FIND_DATAW FindData;
-  /**
-  * Current list entry informations
-  */
-  LIST_ENTRY ListEntry;
-} DOKAN_FIND_DATA, *PDOKAN_FIND_DATA;
-
-VOID DokanFillDirInfo(PFILE_DIRECTORY_INFORMATION Buffer,
-                      PWIN32_FIND_DATAW FindData, ULONG Index,
-                      PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+/////////////////// DOKAN_DIRECTORY_LIST ///////////////////
+PDOKAN_DIRECTORY_LIST CreateDirectoryList() {
+  PDOKAN_DIRECTORY_LIST directoryList =
+      (PDOKAN_DIRECTORY_LIST)malloc(sizeof(DOKAN_DIRECTORY_LIST));
+  if (!directoryList) {
+    return NULL;
+  }
+  RtlZeroMemory(directoryList, sizeof(DOKAN_DIRECTORY_LIST));
+  directoryList->Entries = DokanVector_Alloc(sizeof(DOKAN_DIRECTORY_ENTRY));
+  directoryList->Names = DokanVector_Alloc(sizeof(WCHAR));
+  if (!directoryList->Entries || !directoryList->Names) {
+    DeleteDirectoryList(directoryList);
+    return NULL;
+  }
+  return directoryList;
+}
 
-  Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
-  Buffer->FileNameLength = nameBytes;
+VOID DeleteDirectoryList(PDOKAN_DIRECTORY_LIST DirectoryList) {
+  if (!DirectoryList) {
+    return;
+  }
+  DokanVector_Free(DirectoryList->Entries);
+  DokanVector_Free(DirectoryList->Names);
+  free(DirectoryList);
+}
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
-  ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
+VOID ClearDirectoryList(PDOKAN_DIRECTORY_LIST DirectoryList) {
+  DokanVector_Clear(DirectoryList->Entries);
+  DokanVector_Clear(DirectoryList->Names);
+  DirectoryList->Paged = FALSE;
+  DirectoryList->MoreEntries = FALSE;
+  DirectoryList->Continuation = 0;
+  DirectoryList->HasDotEntries = FALSE;
+}
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
+size_t GetDirectoryEntryCount(PDOKAN_DIRECTORY_LIST DirectoryList) {
+  return DokanVector_GetCount(DirectoryList->Entries);
+}
 
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
+PDOKAN_DIRECTORY_ENTRY GetDirectoryEntry(PDOKAN_DIRECTORY_LIST DirectoryList,
+                                         size_t Index) {
+  return (PDOKAN_DIRECTORY_ENTRY)DokanVector_GetItem(DirectoryList->Entries,
+                                                     Index);
+}
 
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+LPCWSTR GetDirectoryEntryName(PDOKAN_DIRECTORY_LIST DirectoryList,
+                              PDOKAN_DIRECTORY_ENTRY Entry) {
+  return (LPCWSTR)DokanVector_GetItem(DirectoryList->Names,
+                                      Entry->NameOffset);
+}
 
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+LONG64 FileTimeToQuadPart(FILETIME FileTime) {
+  return ((LONG64)FileTime.dwHighDateTime << 32) | FileTime.dwLowDateTime;
+}
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+// Stores the name of FindData in DirectoryList and fills Entry with it. The
+// entry is not added to the list.
+BOOL PrepareDirectoryEntry(PDOKAN_DIRECTORY_LIST DirectoryList,
+                           PWIN32_FIND_DATAW FindData,
+                           PDOKAN_DIRECTORY_ENTRY Entry) {
+  size_t nameLength = wcsnlen(FindData->cFileName, MAX_PATH - 1);
+  WCHAR nul = L'\0';
+
+  Entry->NameOffset = (ULONG)DokanVector_GetCount(DirectoryList->Names);
+  Entry->NameLength = (USHORT)nameLength;
+  // The NUL is pushed apart so that a name filling cFileName is terminated.
+  if (!DokanVector_PushBackArray(DirectoryList->Names, FindData->cFileName,
+                                 nameLength) ||
+      !DokanVector_PushBack(DirectoryList->Names, &nul)) {
+    return FALSE;
+  }
+  Entry->CreationTime = FileTimeToQuadPart(FindData->ftCreationTime);
+  Entry->LastAccessTime = FileTimeToQuadPart(FindData->ftLastAccessTime);
+  Entry->LastWriteTime = FileTimeToQuadPart(FindData->ftLastWriteTime);
+  Entry->FileSize =
+      ((LONG64)FindData->nFileSizeHigh << 32) | FindData->nFileSizeLow;
+  Entry->FileAttributes = FindData->dwFileAttributes;
+  return TRUE;
 }
 
-VOID DokanFillFullDirInfo(PFILE_FULL_DIR_INFORMATION Buffer,
-                          PWIN32_FIND_DATAW FindData, ULONG Index,
-                          PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+VOID DokanFillDirInfo(PFILE_DIRECTORY_INFORMATION Buffer,
+                      PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                      ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
+}
+
+VOID DokanFillFullDirInfo(PFILE_FULL_DIR_INFORMATION Buffer,
+                          PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                          ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->FileIndex = Index;
+  Buffer->FileAttributes = Entry->FileAttributes;
+  Buffer->FileNameLength = nameBytes;
+
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
+  ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillIdFullDirInfo(PFILE_ID_FULL_DIR_INFORMATION Buffer,
-                            PWIN32_FIND_DATAW FindData, ULONG Index,
-                            PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                            PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                            ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
-
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
-
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
-
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
   Buffer->FileId.QuadPart = 0;
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillIdBothDirInfo(PFILE_ID_BOTH_DIR_INFORMATION Buffer,
-                            PWIN32_FIND_DATAW FindData, ULONG Index,
-                            PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                            PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                            ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
   Buffer->ShortNameLength = 0;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
-
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
-
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
-
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
   Buffer->FileId.QuadPart = 0;
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillIdExtdDirInfo(PFILE_ID_EXTD_DIR_INFO Buffer,
-                            PWIN32_FIND_DATAW FindData, ULONG Index,
-                            PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                            PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                            ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
-
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
-
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
-
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
   Buffer->ReparsePointTag = 0;
   RtlFillMemory(&Buffer->FileId.Identifier, sizeof Buffer->FileId.Identifier, 0);
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillIdExtdBothDirInfo(PFILE_ID_EXTD_BOTH_DIR_INFORMATION Buffer,
-                            PWIN32_FIND_DATAW FindData, ULONG Index,
-                            PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                            PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                            ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
   Buffer->ShortNameLength = 0;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
-
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
-
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
-
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
   Buffer->ReparsePointTag = 0;
   RtlFillMemory(&Buffer->FileId.Identifier, sizeof Buffer->FileId.Identifier, 0);
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillBothDirInfo(PFILE_BOTH_DIR_INFORMATION Buffer,
-                          PWIN32_FIND_DATAW FindData, ULONG Index,
-                          PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                          PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                          ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
-  Buffer->FileAttributes = FindData->dwFileAttributes;
+  Buffer->FileAttributes = Entry->FileAttributes;
   Buffer->FileNameLength = nameBytes;
   Buffer->ShortNameLength = 0;
 
-  Buffer->EndOfFile.HighPart = FindData->nFileSizeHigh;
-  Buffer->EndOfFile.LowPart = FindData->nFileSizeLow;
-  Buffer->AllocationSize.HighPart = FindData->nFileSizeHigh;
-  Buffer->AllocationSize.LowPart = FindData->nFileSizeLow;
+  Buffer->EndOfFile.QuadPart = Entry->FileSize;
+  Buffer->AllocationSize.QuadPart = Entry->FileSize;
   ALIGN_ALLOCATION_SIZE(&Buffer->AllocationSize, DokanInstance->DokanOptions);
 
-  Buffer->CreationTime.HighPart = FindData->ftCreationTime.dwHighDateTime;
-  Buffer->CreationTime.LowPart = FindData->ftCreationTime.dwLowDateTime;
-
-  Buffer->LastAccessTime.HighPart = FindData->ftLastAccessTime.dwHighDateTime;
-  Buffer->LastAccessTime.LowPart = FindData->ftLastAccessTime.dwLowDateTime;
-
-  Buffer->LastWriteTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->LastWriteTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
-
-  Buffer->ChangeTime.HighPart = FindData->ftLastWriteTime.dwHighDateTime;
-  Buffer->ChangeTime.LowPart = FindData->ftLastWriteTime.dwLowDateTime;
+  Buffer->CreationTime.QuadPart = Entry->CreationTime;
+  Buffer->LastAccessTime.QuadPart = Entry->LastAccessTime;
+  Buffer->LastWriteTime.QuadPart = Entry->LastWriteTime;
+  Buffer->ChangeTime.QuadPart = Entry->LastWriteTime;
 
   Buffer->EaSize = 0;
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
 VOID DokanFillNamesInfo(PFILE_NAMES_INFORMATION Buffer,
-                        PWIN32_FIND_DATAW FindData, ULONG Index) {
-  ULONG nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
+                        PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                        ULONG Index) {
+  ULONG nameBytes = Entry->NameLength * sizeof(WCHAR);
 
   Buffer->FileIndex = Index;
   Buffer->FileNameLength = nameBytes;
 
-  RtlCopyMemory(Buffer->FileName, FindData->cFileName, nameBytes);
+  RtlCopyMemory(Buffer->FileName, FileName, nameBytes);
 }
 
-ULONG
-DokanFillDirectoryInformation(FILE_INFORMATION_CLASS DirectoryInfo,
-                              PVOID Buffer, PULONG LengthRemaining,
-                              PWIN32_FIND_DATAW FindData, ULONG Index,
-                              PDOKAN_INSTANCE DokanInstance) {
-  ULONG nameBytes;
-  ULONG thisEntrySize;
-
-  nameBytes = (ULONG)wcslen(FindData->cFileName) * sizeof(WCHAR);
-
-  thisEntrySize = nameBytes;
+// Returns the size in the reply of an entry with a name of NameBytes.
+ULONG GetDirectoryInformationSize(FILE_INFORMATION_CLASS DirectoryInfo,
+                                  ULONG NameBytes) {
+  ULONG thisEntrySize = NameBytes;
 
   switch (DirectoryInfo) {
   case FileDirectoryInformation:
@@ -327,7 +321,16 @@ DokanFillDirectoryInformation(FILE_INFORMATION_CLASS DirectoryInfo,
   }
 
   // Must be align on a 8-byte boundary.
-  thisEntrySize = QuadAlign(thisEntrySize);
+  return QuadAlign(thisEntrySize);
+}
+
+ULONG
+DokanFillDirectoryInformation(FILE_INFORMATION_CLASS DirectoryInfo,
+                              PVOID Buffer, PULONG LengthRemaining,
+                              PDOKAN_DIRECTORY_ENTRY Entry, LPCWSTR FileName,
+                              ULONG Index, PDOKAN_INSTANCE DokanInstance) {
+  ULONG thisEntrySize = GetDirectoryInformationSize(
+      DirectoryInfo, Entry->NameLength * sizeof(WCHAR));
 
   // no more memory, don't fill any more
   if (*LengthRemaining < thisEntrySize) {
@@ -339,28 +342,28 @@ DokanFillDirectoryInformation(FILE_INFORMATION_CLASS DirectoryInfo,
 
   switch (DirectoryInfo) {
   case FileDirectoryInformation:
-    DokanFillDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileFullDirectoryInformation:
-    DokanFillFullDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillFullDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileIdFullDirectoryInformation:
-    DokanFillIdFullDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillIdFullDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileNamesInformation:
-    DokanFillNamesInfo(Buffer, FindData, Index);
+    DokanFillNamesInfo(Buffer, Entry, FileName, Index);
     break;
   case FileBothDirectoryInformation:
-    DokanFillBothDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillBothDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileIdBothDirectoryInformation:
-    DokanFillIdBothDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillIdBothDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileIdExtdDirectoryInformation:
-    DokanFillIdExtdDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillIdExtdDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;
   case FileIdExtdBothDirectoryInformation:
-    DokanFillIdExtdBothDirInfo(Buffer, FindData, Index, DokanInstance);
+    DokanFillIdExtdBothDirInfo(Buffer, Entry, FileName, Index, DokanInstance);
     break;    
   default:
     break;
@@ -374,25 +377,41 @@ DokanFillDirectoryInformation(FILE_INFORMATION_CLASS DirectoryInfo,
 int WINAPI DokanFillFileData(PWIN32_FIND_DATAW FindData,
                              PDOKAN_FILE_INFO FileInfo) {
   assert(FileInfo->ProcessingContext);
-  PDOKAN_VECTOR dirList = (PDOKAN_VECTOR )FileInfo->ProcessingContext;
-  DokanVector_PushBack(dirList, FindData);
+  PDOKAN_DIRECTORY_LIST dirList =
+      (PDOKAN_DIRECTORY_LIST)FileInfo->ProcessingContext;
+  DOKAN_DIRECTORY_ENTRY entry;
+  // Already added in front of the first page.
+  if (dirList->HasDotEntries && (wcscmp(FindData->cFileName, L".") == 0 ||
+                                 wcscmp(FindData->cFileName, L"..") == 0)) {
+    return 0;
+  }
+  if (PrepareDirectoryEntry(dirList, FindData, &entry)) {
+    DokanVector_PushBack(dirList->Entries, &entry);
+  }
   return 0;
 }
 
 // add entry which matches the pattern specifed in EventContext
 // to the buffer specifed in EventInfo
 //
-LONG MatchFiles(PDOKAN_IO_EVENT IoEvent, PDOKAN_VECTOR DirList) {
+// The search starts from Cursor when it is not past the requested index, and
+// Cursor is moved to where it stopped. The entries a list matches never change
+// since the list is rescanned when the pattern changes.
+//
+LONG MatchFiles(PDOKAN_IO_EVENT IoEvent, PDOKAN_DIRECTORY_LIST DirList,
+                PDOKAN_DIR_LIST_CURSOR Cursor) {
   ULONG lengthRemaining =
       IoEvent->EventContext->Operation.Directory.BufferLength;
   PVOID currentBuffer = IoEvent->EventResult->Buffer;
   PVOID lastBuffer = currentBuffer;
   ULONG index = 0;
+  size_t i = 0;
   BOOL patternCheck = FALSE;
   PWCHAR pattern = NULL;
   BOOL bufferOverFlow = FALSE;
   BOOL caseSensitive = IoEvent->DokanInstance->DokanOptions->Options &
                        DOKAN_OPTION_CASE_SENSITIVE;
+  PDOKAN_NAME_MATCHER matcher = NULL;
 
   if (IoEvent->EventContext->Operation.Directory.SearchPatternLength > 0) {
     pattern = (PWCHAR)((SIZE_T)&IoEvent->EventContext->Operation.Directory
@@ -402,26 +421,37 @@ LONG MatchFiles(PDOKAN_IO_EVENT IoEvent, PDOKAN_VECTOR DirList) {
   }
 
   if (pattern && wcscmp(pattern, L"*") != 0 &&
-      (!IoEvent->DokanInstance->DokanOperations->FindFilesWithPattern ||
+      (DirList->Paged ||
+       !IoEvent->DokanInstance->DokanOperations->FindFilesWithPattern ||
        IoEvent->DokanOpenInfo->UnimplementedFindFilesWithPattern)) {
     patternCheck = TRUE;
+    matcher = CreateNameMatcher(pattern, !caseSensitive);
   }
 
-  for (size_t i = 0; i < DokanVector_GetCount(DirList); ++i) {
-    PDOKAN_FIND_DATA find = (PDOKAN_FIND_DATA)DokanVector_GetItem(DirList, i);
-    DbgPrintW(L"FileMatch? : %s (%s,%d,%d)\n", find->FindData.cFileName,
+  if (Cursor->MatchIndex <=
+          IoEvent->EventContext->Operation.Directory.FileIndex &&
+      Cursor->Position <= GetDirectoryEntryCount(DirList)) {
+    index = Cursor->MatchIndex;
+    i = Cursor->Position;
+  }
+
+  for (; i < GetDirectoryEntryCount(DirList); ++i) {
+    PDOKAN_DIRECTORY_ENTRY entry = GetDirectoryEntry(DirList, i);
+    LPCWSTR fileName = GetDirectoryEntryName(DirList, entry);
+    DbgPrintW(L"FileMatch? : %s (%s,%d,%d)\n", fileName,
               (pattern ? pattern : L"null"),
               IoEvent->EventContext->Operation.Directory.FileIndex, index);
 
     // pattern is not specified or pattern match is ignore cases
     if (!patternCheck ||
-        DokanIsNameInExpression(pattern, find->FindData.cFileName,
-                                !caseSensitive)) {
+        (matcher ? MatchName(matcher, fileName)
+                 : DokanIsNameInExpression(pattern, fileName,
+                                           !caseSensitive))) {
       if (IoEvent->EventContext->Operation.Directory.FileIndex <= index) {
         // index+1 is very important, should use next entry index
         ULONG entrySize = DokanFillDirectoryInformation(
             IoEvent->EventContext->Operation.Directory.FileInformationClass,
-            currentBuffer, &lengthRemaining, &find->FindData, index + 1,
+            currentBuffer, &lengthRemaining, entry, fileName, index + 1,
             IoEvent->DokanInstance);
         // buffer is full
         if (entrySize == 0) {
@@ -435,6 +465,7 @@ LONG MatchFiles(PDOKAN_IO_EVENT IoEvent, PDOKAN_VECTOR DirList) {
 
           DbgPrint("  =>return single entry\n");
           index++;
+          i++;
           break;
         }
         DbgPrint("  =>return\n");
@@ -447,6 +478,9 @@ LONG MatchFiles(PDOKAN_IO_EVENT IoEvent, PDOKAN_VECTOR DirList) {
       index++;
     }
   }
+  Cursor->MatchIndex = index;
+  Cursor->Position = i;
+  DeleteNameMatcher(matcher);
 
   // Since next of the last entry doesn't exist, clear next offset
   ((PFILE_BOTH_DIR_INFORMATION)lastBuffer)->NextEntryOffset = 0;
@@ -467,7 +501,8 @@ VOID AddMissingCurrentAndParentFolder(PDOKAN_IO_EVENT IoEvent) {
   BOOLEAN currentFolder = FALSE, parentFolder = FALSE;
   WIN32_FIND_DATAW findData;
   FILETIME systime;
-  PDOKAN_VECTOR dirList = (PDOKAN_VECTOR)IoEvent->DokanFileInfo.ProcessingContext;
+  PDOKAN_DIRECTORY_LIST dirList =
+      (PDOKAN_DIRECTORY_LIST)IoEvent->DokanFileInfo.ProcessingContext;
 
   assert(dirList);
   if (IoEvent->EventContext->Operation.Directory.SearchPatternLength != 0) {
@@ -484,20 +519,21 @@ VOID AddMissingCurrentAndParentFolder(PDOKAN_IO_EVENT IoEvent) {
   }
 
   for (size_t i = 0;
-       (!currentFolder || !parentFolder) && i < DokanVector_GetCount(dirList);
+       (!currentFolder || !parentFolder) && i < GetDirectoryEntryCount(dirList);
        ++i) {
-    PDOKAN_FIND_DATA find = (PDOKAN_FIND_DATA)DokanVector_GetItem(dirList, i);
-    if (wcscmp(find->FindData.cFileName, L".") == 0) {
+    LPCWSTR fileName =
+        GetDirectoryEntryName(dirList, GetDirectoryEntry(dirList, i));
+    if (wcscmp(fileName, L".") == 0) {
       currentFolder = TRUE;
     }
 
-    if (wcscmp(find->FindData.cFileName, L"..") == 0) {
+    if (wcscmp(fileName, L"..") == 0) {
       parentFolder = TRUE;
     }
   }
 
   if (!currentFolder || !parentFolder) {
-    WIN32_FIND_DATAW missingItems[2];
+    DOKAN_DIRECTORY_ENTRY missingItems[2];
     ULONG missingCount = 0;
 
     ZeroMemory(&findData, sizeof(WIN32_FIND_DATAW));
@@ -510,27 +546,35 @@ VOID AddMissingCurrentAndParentFolder(PDOKAN_IO_EVENT IoEvent) {
     if (!currentFolder) {
       findData.cFileName[0] = '.';
       findData.cFileName[1] = '\0';
-      missingItems[missingCount++] = findData;
+      if (PrepareDirectoryEntry(dirList, &findData,
+                                &missingItems[missingCount])) {
+        ++missingCount;
+      }
     }
     if (!parentFolder) {
       findData.cFileName[0] = '.';
       findData.cFileName[1] = '.';
       findData.cFileName[2] = '\0';
       // NULL written during ZeroMemory()
-      missingItems[missingCount++] = findData;
+      if (PrepareDirectoryEntry(dirList, &findData,
+                                &missingItems[missingCount])) {
+        ++missingCount;
+      }
     }
     if (missingCount > 0) {
-      DokanVector_PushFrontArray(dirList, missingItems, missingCount);
+      DokanVector_PushFrontArray(dirList->Entries, missingItems, missingCount);
+      dirList->HasDotEntries = TRUE;
     }
   }
 }
 
 NTSTATUS WriteDirectoryResults(PDOKAN_IO_EVENT EventInfo,
-                               PDOKAN_VECTOR dirList) {
+                               PDOKAN_DIRECTORY_LIST dirList,
+                               PDOKAN_DIR_LIST_CURSOR Cursor) {
   // If this function is called then so far everything should be good
   assert(EventInfo->EventResult->Status == STATUS_SUCCESS);
   // Write the file info to the output buffer
-  int index = MatchFiles(EventInfo, dirList);
+  int index = MatchFiles(EventInfo, dirList, Cursor);
   DbgPrint("WriteDirectoryResults() New directory index is %d.\n", index);
   // there is no matched file
   if (index < 0) {
@@ -556,10 +600,107 @@ NTSTATUS WriteDirectoryResults(PDOKAN_IO_EVENT EventInfo,
   return EventInfo->EventResult->Status;
 }
 
+// Adds the next page of a DOKAN_OPERATIONS.FindFilesPage listing to DirList.
+NTSTATUS FetchDirectoryPage(PDOKAN_IO_EVENT IoEvent,
+                            PDOKAN_DIRECTORY_LIST DirList) {
+  PWCHAR searchPattern = NULL;
+  PVOID processingContext = IoEvent->DokanFileInfo.ProcessingContext;
+  UCHAR asyncDispatch = IoEvent->DokanFileInfo.AsyncDispatch;
+  size_t entryCount = GetDirectoryEntryCount(DirList);
+  NTSTATUS status;
+
+  if (IoEvent->EventContext->Operation.Directory.SearchPatternLength > 0) {
+    searchPattern = (PWCHAR)((SIZE_T)&IoEvent->EventContext->Operation.Directory
+                                 .SearchPatternBase[0] +
+                             (SIZE_T)IoEvent->EventContext->Operation.Directory
+                                 .SearchPatternOffset);
+  }
+
+  IoEvent->DokanFileInfo.ProcessingContext = DirList;
+  IoEvent->DokanFileInfo.AsyncDispatch = FALSE;
+  status = IoEvent->DokanInstance->DokanOperations->FindFilesPage(
+      IoEvent->EventContext->Operation.Directory.DirectoryName,
+      searchPattern ? searchPattern : L"*", &DirList->Continuation,
+      DokanFillFileData, &IoEvent->DokanFileInfo);
+  IoEvent->DokanFileInfo.AsyncDispatch = asyncDispatch;
+  IoEvent->DokanFileInfo.ProcessingContext = processingContext;
+  if (status == STATUS_PENDING) {
+    DbgPrint("Dokan Error: FindFilesPage cannot return STATUS_PENDING.\n");
+    status = STATUS_INTERNAL_ERROR;
+  }
+  if (status != STATUS_SUCCESS) {
+    return status;
+  }
+  DirList->Paged = TRUE;
+  DirList->MoreEntries = DirList->Continuation != 0;
+  if (DirList->MoreEntries && GetDirectoryEntryCount(DirList) == entryCount) {
+    DbgPrint("Dokan Warning: FindFilesPage returned an empty page, ending "
+             "the listing.\n");
+    DirList->MoreEntries = FALSE;
+  }
+  return STATUS_SUCCESS;
+}
+
+// Returns whether the entries of DirList after Cursor can fill the reply
+// buffer, not counting the ones the search pattern may skip.
+BOOL HasEnoughDirectoryEntries(PDOKAN_IO_EVENT IoEvent,
+                               PDOKAN_DIRECTORY_LIST DirList,
+                               PDOKAN_DIR_LIST_CURSOR Cursor) {
+  ULONG bufferLength = IoEvent->EventContext->Operation.Directory.BufferLength;
+  size_t count = GetDirectoryEntryCount(DirList);
+  size_t i = 0;
+  ULONG64 size = 0;
+
+  if (Cursor->MatchIndex <=
+      IoEvent->EventContext->Operation.Directory.FileIndex) {
+    i = Cursor->Position;
+  }
+  if (IoEvent->EventContext->Flags & SL_RETURN_SINGLE_ENTRY) {
+    return i < count;
+  }
+  for (; i < count && size < bufferLength; ++i) {
+    size += GetDirectoryInformationSize(
+        IoEvent->EventContext->Operation.Directory.FileInformationClass,
+        GetDirectoryEntry(DirList, i)->NameLength * sizeof(WCHAR));
+  }
+  return size >= bufferLength;
+}
+
+// Writes the results from DirList. The next pages of a FindFilesPage listing
+// are added first, until the entries not returned yet can fill the reply
+// buffer, and while none of the entries matches.
+NTSTATUS FillDirectoryResults(PDOKAN_IO_EVENT IoEvent,
+                              PDOKAN_DIRECTORY_LIST DirList,
+                              PDOKAN_DIR_LIST_CURSOR Cursor) {
+  NTSTATUS status;
+
+  for (;;) {
+    while (DirList->MoreEntries &&
+           !HasEnoughDirectoryEntries(IoEvent, DirList, Cursor)) {
+      status = FetchDirectoryPage(IoEvent, DirList);
+      if (status != STATUS_SUCCESS) {
+        return status;
+      }
+    }
+    status = WriteDirectoryResults(IoEvent, DirList, Cursor);
+    if ((status != STATUS_NO_SUCH_FILE && status != STATUS_NO_MORE_FILES) ||
+        !DirList->MoreEntries) {
+      return status;
+    }
+    IoEvent->EventResult->Status = STATUS_SUCCESS;
+    status = FetchDirectoryPage(IoEvent, DirList);
+    if (status != STATUS_SUCCESS) {
+      return status;
+    }
+  }
+}
+
 VOID EndFindFilesCommon(PDOKAN_IO_EVENT IoEvent, NTSTATUS Status) {
-  PDOKAN_VECTOR dirList =
-      (PDOKAN_VECTOR)IoEvent->DokanFileInfo.ProcessingContext;
-  PDOKAN_VECTOR oldDirList = NULL;
+  PDOKAN_DIRECTORY_LIST dirList =
+      (PDOKAN_DIRECTORY_LIST)IoEvent->DokanFileInfo.ProcessingContext;
+  PDOKAN_DIRECTORY_LIST oldDirList = NULL;
+  DOKAN_DIR_LIST_CURSOR cursor = {0};
+  PWCHAR searchPattern = NULL;
 
   assert(IoEvent->EventResult->BufferLength == 0);
   assert(IoEvent->DokanFileInfo.ProcessingContext);
@@ -571,14 +712,28 @@ VOID EndFindFilesCommon(PDOKAN_IO_EVENT IoEvent, NTSTATUS Status) {
     Status = STATUS_INTERNAL_ERROR;
   }
 
+  if (IoEvent->EventContext->Operation.Directory.SearchPatternLength > 0) {
+    searchPattern = (PWCHAR)((SIZE_T)&IoEvent->EventContext->Operation.Directory
+                                 .SearchPatternBase[0] +
+                             (SIZE_T)IoEvent->EventContext->Operation.Directory
+                                 .SearchPatternOffset);
+  }
+
   if (Status == STATUS_SUCCESS) {
     AddMissingCurrentAndParentFolder(IoEvent);
-    Status = WriteDirectoryResults(IoEvent, dirList);
+    // Only complete listings are shared with the other opens.
+    if (!searchPattern || wcscmp(searchPattern, L"*") == 0) {
+      InsertDirectoryCache(
+          IoEvent->DokanInstance,
+          IoEvent->EventContext->Operation.Directory.DirectoryName, dirList);
+    }
+    Status = FillDirectoryResults(IoEvent, dirList, &cursor);
     EnterCriticalSection(&IoEvent->DokanOpenInfo->CriticalSection);
     {
       if (IoEvent->DokanOpenInfo->DirList != dirList) {
         oldDirList = IoEvent->DokanOpenInfo->DirList;
         IoEvent->DokanOpenInfo->DirList = dirList;
+        IoEvent->DokanOpenInfo->DirListCursor = cursor;
       } else {
         // They should never point to the same object
         DbgPrint("Dokan Warning: EndFindFilesCommon() "
@@ -589,27 +744,28 @@ VOID EndFindFilesCommon(PDOKAN_IO_EVENT IoEvent, NTSTATUS Status) {
         free(IoEvent->DokanOpenInfo->DirListSearchPattern);
         IoEvent->DokanOpenInfo->DirListSearchPattern = NULL;
       }
-      if (IoEvent->EventContext->Operation.Directory
-              .SearchPatternLength > 0) {
-        IoEvent->DokanOpenInfo->DirListSearchPattern =
-            _wcsdup((PWCHAR)((SIZE_T)&IoEvent->EventContext->Operation.Directory
-                                 .SearchPatternBase[0] +
-                             (SIZE_T)IoEvent->EventContext->Operation.Directory
-                                 .SearchPatternOffset));
+      if (searchPattern) {
+        IoEvent->DokanOpenInfo->DirListSearchPattern = _wcsdup(searchPattern);
       }
     }
     LeaveCriticalSection(&IoEvent->DokanOpenInfo->CriticalSection);
     if (oldDirList) {
-      PushDirectoryList(oldDirList);
+      PushDirectoryList(IoEvent->DokanInstance, oldDirList);
     }
   } else {
-    PushDirectoryList(dirList);
+    PushDirectoryList(IoEvent->DokanInstance, dirList);
   }
   IoEvent->DokanFileInfo.ProcessingContext = NULL;
   IoEvent->EventResult->Status = Status;
   EventCompletion(IoEvent);
 }
 
+VOID DOKANAPI DokanEndDispatchFindFiles(PDOKAN_FILE_INFO DokanFileInfo,
+                                        NTSTATUS Status) {
+  EndFindFilesCommon((PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext,
+                     Status);
+}
+
 VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
   PWCHAR searchPattern = NULL;
   NTSTATUS status = STATUS_SUCCESS;
@@ -630,7 +786,7 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
   CreateDispatchCommon(IoEvent,
                        IoEvent->EventContext->Operation.Directory.BufferLength,
                        /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   // check whether this is handled FileInfoClass
   if (fileInfoClass != FileDirectoryInformation &&
@@ -661,8 +817,10 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
   }
 
   if (!openInfo) {
-    openInfo = PopFileOpenInfo();
+    openInfo = PopFileOpenInfo(IoEvent->DokanInstance);
     allocatedOpenInfo = TRUE;
+    // The temporary open does not outlive the dispatch.
+    IoEvent->DokanFileInfo.AsyncDispatch = FALSE;
   }
 
   EnterCriticalSection(&openInfo->CriticalSection);
@@ -686,7 +844,8 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
             ? TRUE
             : FALSE;
     if (!forceScan) {
-      status = WriteDirectoryResults(IoEvent, openInfo->DirList);
+      status = FillDirectoryResults(IoEvent, openInfo->DirList,
+                                    &openInfo->DirListCursor);
     }
   }
   LeaveCriticalSection(&openInfo->CriticalSection);
@@ -700,7 +859,43 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
     return;
   }
 
-  IoEvent->DokanFileInfo.ProcessingContext = PopDirectoryList();
+  // Another open may have listed the directory already.
+  if (!searchPattern || wcscmp(searchPattern, L"*") == 0) {
+    PDOKAN_DIRECTORY_LIST cachedDirList = LookupDirectoryCache(
+        IoEvent->DokanInstance,
+        IoEvent->EventContext->Operation.Directory.DirectoryName);
+    if (cachedDirList) {
+      PDOKAN_DIRECTORY_LIST oldDirList;
+      EnterCriticalSection(&openInfo->CriticalSection);
+      {
+        oldDirList = openInfo->DirList;
+        openInfo->DirList = cachedDirList;
+        RtlZeroMemory(&openInfo->DirListCursor, sizeof(DOKAN_DIR_LIST_CURSOR));
+        if (openInfo->DirListSearchPattern) {
+          free(openInfo->DirListSearchPattern);
+          openInfo->DirListSearchPattern = NULL;
+        }
+        if (searchPattern) {
+          openInfo->DirListSearchPattern = _wcsdup(searchPattern);
+        }
+        status = FillDirectoryResults(IoEvent, cachedDirList,
+                                      &openInfo->DirListCursor);
+      }
+      LeaveCriticalSection(&openInfo->CriticalSection);
+      if (oldDirList) {
+        PushDirectoryList(IoEvent->DokanInstance, oldDirList);
+      }
+      IoEvent->EventResult->Status = status;
+      EventCompletion(IoEvent);
+      if (allocatedOpenInfo) {
+        PushFileOpenInfo(openInfo);
+      }
+      return;
+    }
+  }
+
+  IoEvent->DokanFileInfo.ProcessingContext =
+      PopDirectoryList(IoEvent->DokanInstance);
   if (!IoEvent->DokanFileInfo.ProcessingContext) {
     DbgPrint(
         "Dokan Error: Failed to allocate memory for a new directory list.\n");
@@ -711,11 +906,25 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
     }
     return;
   }
+  // Changes invalidated from here on keep the listing out of the cache.
+  ((PDOKAN_DIRECTORY_LIST)IoEvent->DokanFileInfo.ProcessingContext)
+      ->CacheGeneration = GetDirectoryCacheGeneration(IoEvent->DokanInstance);
 
   status = STATUS_NOT_IMPLEMENTED;
 
+  // A paged listing only asks for its first page here. Older
+  // DOKAN_OPERATIONS end before FindFilesPage.
+  if ((IoEvent->DokanInstance->DokanOptions->Options &
+       DOKAN_OPTION_FIND_FILES_PAGE) &&
+      IoEvent->DokanInstance->DokanOperations->FindFilesPage) {
+    status = FetchDirectoryPage(
+        IoEvent,
+        (PDOKAN_DIRECTORY_LIST)IoEvent->DokanFileInfo.ProcessingContext);
+  }
+
   // Reminder: FindFilesWithPattern may not be implemented by returning STATUS_NOT_IMPLEMENTED.
-  if (IoEvent->DokanInstance->DokanOperations->FindFilesWithPattern) {
+  if (status == STATUS_NOT_IMPLEMENTED &&
+      IoEvent->DokanInstance->DokanOperations->FindFilesWithPattern) {
     status = IoEvent->DokanInstance->DokanOperations->FindFilesWithPattern(
         IoEvent->EventContext->Operation.Directory.DirectoryName,
         searchPattern ? searchPattern : L"*", DokanFillFileData,
@@ -735,12 +944,10 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
         DokanFillFileData, &IoEvent->DokanFileInfo);
   }
 
-  if (status != STATUS_NOT_IMPLEMENTED) {
+  // None of FindFilesPage, FindFilesWithPattern or FindFiles being
+  // implemented also ends here, which releases the directory list.
+  if (!IsDispatchPending(IoEvent, status)) {
     EndFindFilesCommon(IoEvent, status);
-  } else {
-    // Neither FindFilesWithPattern nor FindFiles are implemented.
-    IoEvent->EventResult->Status = STATUS_NOT_IMPLEMENTED;
-    EventCompletion(IoEvent);
   }
 
   if (allocatedOpenInfo) {
@@ -748,96 +955,8 @@ VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent) {
   }
 }
 
-#define DOS_STAR (L'<')
-#define DOS_QM (L'>')
-#define DOS_DOT (L'"')
-
 BOOL DOKANAPI DokanIsNameInExpression(LPCWSTR Expression, // matching pattern
                                       LPCWSTR Name,       // file name
                                       BOOL IgnoreCase) {
-  ULONG ei = 0;
-  ULONG ni = 0;
-
-  while (Expression[ei] != '\0') {
-
-    if (Expression[ei] == L'*') {
-      ei++;
-      if (Expression[ei] == '\0')
-        return TRUE;
-
-      while (Name[ni] != '\0') {
-        if (DokanIsNameInExpression(&Expression[ei], &Name[ni], IgnoreCase))
-          return TRUE;
-        ni++;
-      }
-
-    } else if (Expression[ei] == DOS_STAR) {
-
-      ULONG p = ni;
-      ULONG lastDot = 0;
-      ei++;
-
-      while (Name[p] != '\0') {
-        if (Name[p] == L'.')
-          lastDot = p;
-        p++;
-      }
-
-      BOOL endReached = FALSE;
-      while (!endReached) {
-
-        endReached = (Name[ni] == '\0' || ni == lastDot);
-
-        if (!endReached) {
-          if (DokanIsNameInExpression(&Expression[ei], &Name[ni], IgnoreCase))
-            return TRUE;
-
-          ni++;
-        }
-      }
-
-    } else if (Expression[ei] == DOS_QM) {
-
-      ei++;
-      if (Name[ni] != L'.') {
-        ni++;
-      } else {
-
-        ULONG p = ni + 1;
-        while (Name[p] != '\0') {
-          if (Name[p] == L'.')
-            break;
-          p++;
-        }
-
-        if (Name[p] == L'.')
-          ni++;
-      }
-
-    } else if (Expression[ei] == DOS_DOT) {
-      ei++;
-
-      if (Name[ni] == L'.')
-        ni++;
-
-    } else {
-      if (Expression[ei] == L'?') {
-        ei++;
-        ni++;
-      } else if (IgnoreCase && towupper(Expression[ei]) == towupper(Name[ni])) {
-        ei++;
-        ni++;
-      } else if (!IgnoreCase && Expression[ei] == Name[ni]) {
-        ei++;
-        ni++;
-      } else {
-        return FALSE;
-      }
-    }
-  }
-
-  if (ei == wcslen(Expression) && ni == wcslen(Name))
-    return TRUE;
-
-  return FALSE;
+  return IsNameInExpression(Expression, Name, IgnoreCase);
 }
@@ -0,0 +1,259 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+// Interval at which the controller adjusts the thread limits.
+#define DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS 1000
+
+#define DOKAN_DEFAULT_MIN_PULL_THREADS 1
+#define DOKAN_DEFAULT_MAX_PULL_THREADS 16
+#define DOKAN_DEFAULT_MIN_WORKER_THREADS 2
+#define DOKAN_DEFAULT_MAX_WORKER_THREADS 128
+
+// Pulls returning at least this many events on average mean the kernel queue
+// fills faster than it is drained.
+#define DOKAN_DISPATCH_CONTROLLER_BUSY_BATCH_SIZE 2
+
+ULONG ReserveQueuedIoWork(DOKAN_DISPATCH_QUEUE *Queue) {
+  ULONG count = 0;
+  while (Queue->PendingSubmits < Queue->QueuedEvents &&
+         Queue->PendingSubmits + Queue->ActiveWorkers < Queue->WorkerLimit) {
+    ++Queue->PendingSubmits;
+    ++count;
+  }
+  return count;
+}
+
+VOID SubmitQueuedIoWork(DOKAN_DISPATCH_QUEUE *Queue, ULONG Count) {
+  while (Count--) {
+    SubmitThreadpoolWork(Queue->Work);
+  }
+}
+
+BOOL BeginPoolPull(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_DISPATCH_CONTROLLER *controller =
+      &DokanInstance->ThreadInfo.DispatchController;
+  if (InterlockedIncrement(&controller->ActivePullers) >
+      controller->PullerLimit) {
+    InterlockedDecrement(&controller->ActivePullers);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+VOID EndPoolPull(PDOKAN_INSTANCE DokanInstance) {
+  InterlockedDecrement(
+      &DokanInstance->ThreadInfo.DispatchController.ActivePullers);
+}
+
+VOID RecordPull(PDOKAN_INSTANCE DokanInstance, ULONG EventCount) {
+  DOKAN_DISPATCH_CONTROLLER *controller =
+      &DokanInstance->ThreadInfo.DispatchController;
+  InterlockedIncrement64(&controller->Pulls);
+  if (EventCount) {
+    InterlockedAdd64(&controller->PulledEvents, EventCount);
+  } else {
+    InterlockedIncrement64(&controller->EmptyPulls);
+  }
+}
+
+VOID RecordDispatch(PDOKAN_INSTANCE DokanInstance, LONG64 DispatchTicks) {
+  DOKAN_DISPATCH_CONTROLLER *controller =
+      &DokanInstance->ThreadInfo.DispatchController;
+  InterlockedIncrement64(&controller->DispatchedEvents);
+  InterlockedAdd64(&controller->DispatchTicks, DispatchTicks);
+}
+
+// Pool pullers are added while pulls return several events and removed while
+// most of them time out without any.
+LONG GetNextPullerLimit(DOKAN_DISPATCH_CONTROLLER *Controller, LONG64 Pulls,
+                        LONG64 EmptyPulls, LONG64 PulledEvents) {
+  LONG pullerLimit = Controller->PullerLimit;
+  if (!Pulls || EmptyPulls * 2 > Pulls) {
+    --pullerLimit;
+  } else if (PulledEvents >=
+             Pulls * DOKAN_DISPATCH_CONTROLLER_BUSY_BATCH_SIZE) {
+    ++pullerLimit;
+  }
+  return max(Controller->MinPullers, min(Controller->MaxPullers, pullerLimit));
+}
+
+// The workers needed are the average number of events dispatched at the same
+// time during the interval with some headroom. The limit grows right away but
+// shrinks by a quarter per interval at most, and grows by a quarter at least
+// when events had to wait for a worker.
+ULONG GetNextWorkerLimit(DOKAN_DISPATCH_CONTROLLER *Controller,
+                         ULONG WorkerLimit, LONG64 DispatchTicks,
+                         LONG64 WaitingEvents) {
+  ULONG64 busyWorkers =
+      (ULONG64)DispatchTicks * 1000 /
+      ((ULONG64)Controller->TicksPerSecond *
+       DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS);
+  ULONG64 target = busyWorkers + busyWorkers / 4 + 1;
+  if (WaitingEvents) {
+    target = max(target, (ULONG64)WorkerLimit + WorkerLimit / 4 + 1);
+  } else {
+    target = max(target, (ULONG64)WorkerLimit - (WorkerLimit + 3) / 4);
+  }
+  return (ULONG)max(Controller->MinWorkers,
+                    min((ULONG64)Controller->MaxWorkers, target));
+}
+
+VOID CALLBACK DispatchControllerTimerCallback(PTP_CALLBACK_INSTANCE Instance,
+                                              PVOID Context, PTP_TIMER Timer) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Timer);
+
+  PDOKAN_INSTANCE dokanInstance = (PDOKAN_INSTANCE)Context;
+  DOKAN_DISPATCH_CONTROLLER *controller =
+      &dokanInstance->ThreadInfo.DispatchController;
+  DOKAN_DISPATCH_QUEUE *queue = &dokanInstance->ThreadInfo.DispatchQueue;
+  LONG64 pulls = InterlockedExchange64(&controller->Pulls, 0);
+  LONG64 emptyPulls = InterlockedExchange64(&controller->EmptyPulls, 0);
+  LONG64 pulledEvents = InterlockedExchange64(&controller->PulledEvents, 0);
+  LONG64 dispatchedEvents =
+      InterlockedExchange64(&controller->DispatchedEvents, 0);
+  LONG64 dispatchTicks = InterlockedExchange64(&controller->DispatchTicks, 0);
+  LONG64 waitingEvents = InterlockedExchange64(&controller->WaitingEvents, 0);
+  LONG previousPullerLimit = controller->PullerLimit;
+  LONG pullerLimit =
+      GetNextPullerLimit(controller, pulls, emptyPulls, pulledEvents);
+  ULONG previousWorkerLimit;
+  ULONG workerLimit;
+  ULONG submitCount;
+
+  InterlockedExchange(&controller->PullerLimit, pullerLimit);
+
+  AcquireSRWLockExclusive(&queue->Lock);
+  previousWorkerLimit = queue->WorkerLimit;
+  workerLimit = GetNextWorkerLimit(controller, previousWorkerLimit,
+                                   dispatchTicks, waitingEvents);
+  queue->WorkerLimit = workerLimit;
+  submitCount = ReserveQueuedIoWork(queue);
+  ReleaseSRWLockExclusive(&queue->Lock);
+  SubmitQueuedIoWork(queue, submitCount);
+
+  if (pullerLimit != previousPullerLimit ||
+      workerLimit != previousWorkerLimit) {
+    DbgPrint("Dokan Information: Dispatch limits changed to %d pullers and "
+             "%lu workers.\n",
+             pullerLimit, workerLimit);
+  }
+
+  AcquireSRWLockExclusive(&controller->StatisticsLock);
+  controller->Statistics.Pulls = pulls;
+  controller->Statistics.EmptyPulls = emptyPulls;
+  controller->Statistics.PulledEvents = pulledEvents;
+  controller->Statistics.AverageDispatchTimeUs =
+      dispatchedEvents ? (ULONG64)dispatchTicks * 1000000 /
+                             ((ULONG64)controller->TicksPerSecond *
+                              dispatchedEvents)
+                       : 0;
+  if (pullerLimit > previousPullerLimit) {
+    ++controller->Statistics.PullerLimitIncreases;
+  } else if (pullerLimit < previousPullerLimit) {
+    ++controller->Statistics.PullerLimitDecreases;
+  }
+  if (workerLimit > previousWorkerLimit) {
+    ++controller->Statistics.WorkerLimitIncreases;
+  } else if (workerLimit < previousWorkerLimit) {
+    ++controller->Statistics.WorkerLimitDecreases;
+  }
+  ReleaseSRWLockExclusive(&controller->StatisticsLock);
+}
+
+BOOL StartDispatchController(PDOKAN_INSTANCE DokanInstance,
+                             ULONG MainPullThreadCount) {
+  DOKAN_DISPATCH_CONTROLLER *controller =
+      &DokanInstance->ThreadInfo.DispatchController;
+  PDOKAN_OPTIONS options = DokanInstance->DokanOptions;
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER relativeDueTime;
+  FILETIME dueTime;
+
+  controller->MinPullers = DOKAN_DEFAULT_MIN_PULL_THREADS;
+  controller->MaxPullers = DOKAN_DEFAULT_MAX_PULL_THREADS;
+  controller->MinWorkers =
+      max(DOKAN_DEFAULT_MIN_WORKER_THREADS, MainPullThreadCount);
+  controller->MaxWorkers = DOKAN_DEFAULT_MAX_WORKER_THREADS;
+  if (options->Options & DOKAN_OPTION_DISPATCH_THREAD_BOUNDS) {
+    if (options->MaxPullThreads) {
+      controller->MaxPullers = options->MaxPullThreads;
+    }
+    controller->MinPullers =
+        min((LONG)options->MinPullThreads, controller->MaxPullers);
+    if (options->MaxWorkerThreads) {
+      controller->MaxWorkers = options->MaxWorkerThreads;
+    }
+    controller->MinWorkers =
+        max(1, min(options->MinWorkerThreads, controller->MaxWorkers));
+  }
+  // Start with the highest limits, the controller lowers them if the mount
+  // is idle.
+  controller->PullerLimit = controller->MaxPullers;
+  DokanInstance->ThreadInfo.DispatchQueue.WorkerLimit = controller->MaxWorkers;
+  QueryPerformanceFrequency(&frequency);
+  controller->TicksPerSecond = frequency.QuadPart;
+  InitializeSRWLock(&controller->StatisticsLock);
+
+  controller->Timer = CreateThreadpoolTimer(
+      DispatchControllerTimerCallback, DokanInstance,
+      &DokanInstance->ThreadInfo.CallbackEnvironment);
+  if (!controller->Timer) {
+    DokanDbgPrintW(L"Dokan Error: CreateThreadpoolTimer() has returned "
+                   L"error code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  relativeDueTime.QuadPart =
+      -(LONGLONG)DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS * 10000;
+  dueTime.dwLowDateTime = relativeDueTime.LowPart;
+  dueTime.dwHighDateTime = relativeDueTime.HighPart;
+  SetThreadpoolTimer(controller->Timer, &dueTime,
+                     DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS,
+                     DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS / 10);
+  return TRUE;
+}
+
+BOOL DOKANAPI DokanGetDispatchStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _Out_ PDOKAN_DISPATCH_STATISTICS Statistics) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_DISPATCH_CONTROLLER *controller;
+  DOKAN_DISPATCH_QUEUE *queue;
+
+  if (!instance || !Statistics || !instance->ThreadInfo.DispatchQueue.Work) {
+    return FALSE;
+  }
+  controller = &instance->ThreadInfo.DispatchController;
+  queue = &instance->ThreadInfo.DispatchQueue;
+  AcquireSRWLockShared(&controller->StatisticsLock);
+  *Statistics = controller->Statistics;
+  ReleaseSRWLockShared(&controller->StatisticsLock);
+  Statistics->PullerLimit = controller->PullerLimit;
+  Statistics->ActivePullers = max(0, controller->ActivePullers);
+  AcquireSRWLockShared(&queue->Lock);
+  Statistics->WorkerLimit = queue->WorkerLimit;
+  Statistics->ActiveWorkers = queue->ActiveWorkers;
+  Statistics->QueuedEvents = queue->QueuedEvents;
+  ReleaseSRWLockShared(&queue->Lock);
+  return TRUE;
+}
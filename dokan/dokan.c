@@ -84,6 +84,8 @@ NewDokanInstance() {
 
   dokanInstance->GlobalDevice = INVALID_HANDLE_VALUE;
   dokanInstance->Device = INVALID_HANDLE_VALUE;
+  dokanInstance->Transport = &g_DeviceTransport;
+  dokanInstance->PullDevice = INVALID_HANDLE_VALUE;
   dokanInstance->NotifyHandle = INVALID_HANDLE_VALUE;
   dokanInstance->KeepaliveHandle = INVALID_HANDLE_VALUE;
 
@@ -91,6 +93,17 @@ NewDokanInstance() {
                                               0x80000400);
 
   InitializeListHead(&dokanInstance->ListEntry);
+  InitializeSRWLock(&dokanInstance->EventTrace.Lock);
+  {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    dokanInstance->TicksPerSecond = frequency.QuadPart;
+  }
+  InitializeSRWLock(&dokanInstance->ThreadInfo.DispatchQueue.Lock);
+  InitializeSRWLock(&dokanInstance->ThreadInfo.ReplyBatch.Lock);
+  for (ULONG i = 0; i < DOKAN_DISPATCH_LANE_COUNT; ++i) {
+    InitializeListHead(&dokanInstance->ThreadInfo.DispatchQueue.Lanes[i]);
+  }
 
   dokanInstance->DeviceClosedWaitHandle = CreateEvent(NULL, TRUE, FALSE, NULL);
   if (!dokanInstance->DeviceClosedWaitHandle) {
@@ -140,6 +153,7 @@ NewDokanInstance() {
 
 VOID DeleteDokanInstance(PDOKAN_INSTANCE DokanInstance) {
   SetEvent(DokanInstance->DeviceClosedWaitHandle);
+  StopOverlappedPulls(DokanInstance);
   if (DokanInstance->ThreadInfo.CleanupGroup) {
     CloseThreadpoolCleanupGroupMembers(DokanInstance->ThreadInfo.CleanupGroup,
                                        FALSE, DokanInstance);
@@ -148,6 +162,12 @@ VOID DeleteDokanInstance(PDOKAN_INSTANCE DokanInstance) {
     DestroyThreadpoolEnvironment(
         &DokanInstance->ThreadInfo.CallbackEnvironment);
   }
+  DiscardQueuedReplies(DokanInstance);
+  FreeProcessAdmission(DokanInstance);
+  DokanInstance->Transport->Delete(DokanInstance);
+  StopEventTrace(DokanInstance);
+  FreeOperationCounters(DokanInstance);
+  DeleteInstancePools(DokanInstance);
   if (DokanInstance->NotifyHandle &&
       DokanInstance->NotifyHandle != INVALID_HANDLE_VALUE) {
     CloseHandle(DokanInstance->NotifyHandle);
@@ -159,6 +179,13 @@ VOID DeleteDokanInstance(PDOKAN_INSTANCE DokanInstance) {
   if (DokanInstance->Device && DokanInstance->Device != INVALID_HANDLE_VALUE) {
     CloseHandle(DokanInstance->Device);
   }
+  if (DokanInstance->PullDevice &&
+      DokanInstance->PullDevice != INVALID_HANDLE_VALUE) {
+    CloseHandle(DokanInstance->PullDevice);
+  }
+  if (DokanInstance->ThreadInfo.PullsDrainedEvent) {
+    CloseHandle(DokanInstance->ThreadInfo.PullsDrainedEvent);
+  }
   if (DokanInstance->GlobalDevice &&
       DokanInstance->GlobalDevice != INVALID_HANDLE_VALUE) {
     CloseHandle(DokanInstance->GlobalDevice);
@@ -268,6 +295,13 @@ VOID SetupIOEventForProcessing(PDOKAN_IO_EVENT IoEvent) {
   IoEvent->DokanFileInfo.DokanContext = (ULONG64)IoEvent;
   IoEvent->DokanFileInfo.ProcessId = IoEvent->EventContext->ProcessId;
   IoEvent->DokanFileInfo.DokanOptions = IoEvent->DokanInstance->DokanOptions;
+  // Cleanup and CloseFile do not return a status and cannot pend.
+  if ((IoEvent->DokanInstance->DokanOptions->Options &
+       DOKAN_OPTION_ASYNC_DISPATCH) &&
+      IoEvent->EventContext->MajorFunction != IRP_MJ_CLEANUP &&
+      IoEvent->EventContext->MajorFunction != IRP_MJ_CLOSE) {
+    IoEvent->DokanFileInfo.AsyncDispatch = 1;
+  }
 
   if (!IoEvent->DokanOpenInfo) {
     return;
@@ -297,23 +331,37 @@ VOID HandleUnknownEvent(PDOKAN_IO_EVENT IoEvent) {
   DokanDbgPrintW(L"Dokan Warning: Unsupported IRP 0x%x, event Info = 0x%p.\n",
                  IoEvent->EventContext->MajorFunction, IoEvent->EventContext);
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
   IoEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
   EventCompletion(IoEvent);
 }
 
 VOID DispatchEvent(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_INSTANCE dokanInstance = IoEvent->DokanInstance;
+  UCHAR majorFunction = IoEvent->EventContext->MajorFunction;
+
+  IoEvent->OperationSlot = GetOperationSlot(IoEvent->EventContext);
+  IoEvent->DispatchTime = GetPerformanceCounter();
+  RecordOperationStage(dokanInstance, IoEvent->OperationSlot,
+                       DOKAN_OPERATION_STAGE_QUEUE_WAIT,
+                       IoEvent->DispatchTime - IoEvent->IoBatch->PullTime);
   SetupIOEventForProcessing(IoEvent);
-  switch (IoEvent->EventContext->MajorFunction) {
+  switch (majorFunction) {
   case IRP_MJ_CREATE:
     DispatchCreate(IoEvent);
     break;
   case IRP_MJ_CLEANUP:
     DispatchCleanup(IoEvent);
     break;
-  case IRP_MJ_CLOSE:
+  case IRP_MJ_CLOSE: {
+    // Close has no result and releases the event.
+    ULONG operationSlot = IoEvent->OperationSlot;
+    LONG64 dispatchTime = IoEvent->DispatchTime;
     DispatchClose(IoEvent);
-    break;
+    RecordOperationStage(dokanInstance, operationSlot,
+                         DOKAN_OPERATION_STAGE_CALLBACK,
+                         GetPerformanceCounter() - dispatchTime);
+  } break;
   case IRP_MJ_DIRECTORY_CONTROL:
     DispatchDirectoryInformation(IoEvent);
     break;
@@ -377,25 +425,16 @@ VOID HandleProcessIoFatalError(PDOKAN_INSTANCE DokanInstance,
   OnDeviceIoCtlFailed(DokanInstance, Result);
 }
 
-VOID FreeIoEventResult(PEVENT_INFORMATION EventResult, ULONG EventResultSize,
+VOID FreeIoEventResult(PDOKAN_INSTANCE DokanInstance,
+                       PEVENT_INFORMATION EventResult, ULONG EventResultSize,
                        BOOL PoolAllocated) {
   if (!EventResult) {
     return;
   }
   if (!PoolAllocated) {
     FreeEventResult(EventResult);
-  } else if (EventResultSize <= DOKAN_EVENT_INFO_DEFAULT_SIZE) {
-    PushEventResult(EventResult);
-  } else if (EventResultSize <= DOKAN_EVENT_INFO_16K_SIZE) {
-    Push16KEventResult(EventResult);
-  } else if (EventResultSize <= DOKAN_EVENT_INFO_32K_SIZE) {
-    Push32KEventResult(EventResult);
-  } else if (EventResultSize <= DOKAN_EVENT_INFO_64K_SIZE) {
-    Push64KEventResult(EventResult);
-  } else if (EventResultSize <= DOKAN_EVENT_INFO_128K_SIZE) {
-    Push128KEventResult(EventResult);
   } else {
-    assert(FALSE);
+    PushEventResult(DokanInstance, EventResult, EventResultSize);
   }
 }
 
@@ -414,6 +453,188 @@ VOID QueueIoEvent(PDOKAN_IO_EVENT IoEvent, PTP_WORK_CALLBACK Callback) {
   SubmitThreadpoolWork(work);
 }
 
+ULONG GetDispatchLane(UCHAR MajorFunction) {
+  switch (MajorFunction) {
+  case IRP_MJ_READ:
+  case IRP_MJ_WRITE:
+  case IRP_MJ_FLUSH_BUFFERS:
+  case IRP_MJ_LOCK_CONTROL:
+    return DOKAN_DISPATCH_LANE_DATA;
+  default:
+    return DOKAN_DISPATCH_LANE_METADATA;
+  }
+}
+
+VOID InitializeDispatchQueueWeights(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_DISPATCH_QUEUE *queue = &DokanInstance->ThreadInfo.DispatchQueue;
+  PDOKAN_OPTIONS options = DokanInstance->DokanOptions;
+
+  queue->Weights[DOKAN_DISPATCH_LANE_METADATA] =
+      DOKAN_DEFAULT_METADATA_LANE_WEIGHT;
+  queue->Weights[DOKAN_DISPATCH_LANE_DATA] = DOKAN_DEFAULT_DATA_LANE_WEIGHT;
+  if (options->Options & DOKAN_OPTION_DISPATCH_LANE_WEIGHTS) {
+    for (ULONG i = 0; i < DOKAN_DISPATCH_LANE_COUNT; ++i) {
+      if (options->DispatchLaneWeights[i]) {
+        queue->Weights[i] = options->DispatchLaneWeights[i];
+      }
+    }
+  }
+  for (ULONG i = 0; i < DOKAN_DISPATCH_LANE_COUNT; ++i) {
+    queue->Credits[i] = queue->Weights[i];
+  }
+}
+
+// Appends the events to the lanes of the instance dispatch queue and submits
+// its work object once per event the worker limit allows. Events is emptied.
+VOID QueueIoEventList(PDOKAN_INSTANCE DokanInstance, PLIST_ENTRY Events) {
+  DOKAN_DISPATCH_QUEUE *queue = &DokanInstance->ThreadInfo.DispatchQueue;
+  ULONG submitCount;
+  ULONG waitingEvents;
+
+  if (IsListEmpty(Events)) {
+    return;
+  }
+  AcquireSRWLockExclusive(&queue->Lock);
+  while (!IsListEmpty(Events)) {
+    PDOKAN_IO_EVENT ioEvent = CONTAINING_RECORD(
+        RemoveHeadList(Events), DOKAN_IO_EVENT, DispatchListEntry);
+    RecordTimeline(DokanInstance, DOKAN_TIMELINE_QUEUED,
+                   ioEvent->EventContext->MajorFunction,
+                   ioEvent->EventContext->SerialNumber);
+    InsertTailList(
+        &queue->Lanes[GetDispatchLane(ioEvent->EventContext->MajorFunction)],
+        &ioEvent->DispatchListEntry);
+    ++queue->QueuedEvents;
+  }
+  submitCount = ReserveQueuedIoWork(queue);
+  waitingEvents = queue->QueuedEvents - queue->PendingSubmits;
+  ReleaseSRWLockExclusive(&queue->Lock);
+  if (waitingEvents) {
+    InterlockedAdd64(
+        &DokanInstance->ThreadInfo.DispatchController.WaitingEvents,
+        waitingEvents);
+  }
+  SubmitQueuedIoWork(queue, submitCount);
+}
+
+// Removes the next event to dispatch in weighted round robin between the
+// lanes. Queue lock must be held exclusively.
+PDOKAN_IO_EVENT RemoveNextQueuedIoEvent(DOKAN_DISPATCH_QUEUE *Queue) {
+  for (ULONG round = 0; round < 2; ++round) {
+    for (ULONG i = 0; i < DOKAN_DISPATCH_LANE_COUNT; ++i) {
+      if (Queue->Credits[i] && !IsListEmpty(&Queue->Lanes[i])) {
+        --Queue->Credits[i];
+        return CONTAINING_RECORD(RemoveHeadList(&Queue->Lanes[i]),
+                                 DOKAN_IO_EVENT, DispatchListEntry);
+      }
+    }
+    // Every lane with events has used its credits, start a new round.
+    for (ULONG i = 0; i < DOKAN_DISPATCH_LANE_COUNT; ++i) {
+      Queue->Credits[i] = Queue->Weights[i];
+    }
+  }
+  return NULL;
+}
+
+VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance,
+                                      PVOID Parameter, PTP_WORK Work);
+
+// Takes the ordered dispatch of the open of the event. Returns FALSE if
+// another event of the open is being dispatched, the event is then queued
+// and dispatched later by EndOrderedDispatch.
+BOOL BeginOrderedDispatch(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_OPEN_INFO openInfo =
+      (PDOKAN_OPEN_INFO)(UINT_PTR)IoEvent->EventContext->Context;
+  BOOL dispatchNow = TRUE;
+
+  if (!(IoEvent->DokanInstance->DokanOptions->Options &
+        DOKAN_OPTION_ORDERED_FILE_DISPATCH) ||
+      !openInfo || IoEvent->OrderedDispatch) {
+    return TRUE;
+  }
+  EnterCriticalSection(&openInfo->CriticalSection);
+  if (openInfo->OrderedDispatchBusy) {
+    InsertTailList(&openInfo->OrderedEvents, &IoEvent->DispatchListEntry);
+    dispatchNow = FALSE;
+  } else {
+    openInfo->OrderedDispatchBusy = TRUE;
+    IoEvent->OrderedDispatch = TRUE;
+  }
+  LeaveCriticalSection(&openInfo->CriticalSection);
+  return dispatchNow;
+}
+
+// Gives the ordered dispatch of the open to its next queued event, if any,
+// and queues it for dispatch. Must be called before the open can be released.
+VOID EndOrderedDispatch(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_OPEN_INFO openInfo;
+  LIST_ENTRY nextEvents;
+
+  if (!IoEvent->OrderedDispatch) {
+    return;
+  }
+  IoEvent->OrderedDispatch = FALSE;
+  openInfo = (PDOKAN_OPEN_INFO)(UINT_PTR)IoEvent->EventContext->Context;
+  InitializeListHead(&nextEvents);
+  EnterCriticalSection(&openInfo->CriticalSection);
+  if (IsListEmpty(&openInfo->OrderedEvents)) {
+    openInfo->OrderedDispatchBusy = FALSE;
+  } else {
+    PDOKAN_IO_EVENT nextEvent =
+        CONTAINING_RECORD(RemoveHeadList(&openInfo->OrderedEvents),
+                          DOKAN_IO_EVENT, DispatchListEntry);
+    nextEvent->OrderedDispatch = TRUE;
+    InsertTailList(&nextEvents, &nextEvent->DispatchListEntry);
+  }
+  LeaveCriticalSection(&openInfo->CriticalSection);
+  QueueIoEventList(IoEvent->DokanInstance, &nextEvents);
+}
+
+VOID CALLBACK DispatchQueuedIoCallback(PTP_CALLBACK_INSTANCE Instance,
+                                       PVOID Parameter, PTP_WORK Work) {
+  PDOKAN_INSTANCE dokanInstance = (PDOKAN_INSTANCE)Parameter;
+  DOKAN_DISPATCH_QUEUE *queue = &dokanInstance->ThreadInfo.DispatchQueue;
+  PDOKAN_IO_EVENT ioEvent = NULL;
+
+  ULONG submitCount;
+
+  AcquireSRWLockExclusive(&queue->Lock);
+  --queue->PendingSubmits;
+  ioEvent = RemoveNextQueuedIoEvent(queue);
+  if (ioEvent) {
+    --queue->QueuedEvents;
+    ++queue->ActiveWorkers;
+  }
+  ReleaseSRWLockExclusive(&queue->Lock);
+  // Each submission matches one queued event.
+  assert(ioEvent);
+  if (!ioEvent) {
+    return;
+  }
+  DispatchBatchIoCallback(Instance, ioEvent, Work);
+
+  // Let the events that waited for a free worker run.
+  AcquireSRWLockExclusive(&queue->Lock);
+  --queue->ActiveWorkers;
+  submitCount = ReserveQueuedIoWork(queue);
+  ReleaseSRWLockExclusive(&queue->Lock);
+  SubmitQueuedIoWork(queue, submitCount);
+}
+
+// Dispatches the event between the timeline entries of its dispatch.
+VOID DispatchTimedEvent(PDOKAN_IO_EVENT IoEvent) {
+  // The event can be released by its dispatch.
+  PDOKAN_INSTANCE dokanInstance = IoEvent->DokanInstance;
+  UCHAR majorFunction = IoEvent->EventContext->MajorFunction;
+  ULONG serialNumber = IoEvent->EventContext->SerialNumber;
+
+  RecordTimeline(dokanInstance, DOKAN_TIMELINE_DISPATCH_BEGIN, majorFunction,
+                 serialNumber);
+  DispatchEvent(IoEvent);
+  RecordTimeline(dokanInstance, DOKAN_TIMELINE_DISPATCH_END, majorFunction,
+                 serialNumber);
+}
+
 DWORD
 GetEventInfoSize(__in ULONG MajorFunction, __in PEVENT_INFORMATION EventInfo) {
   if (MajorFunction == IRP_MJ_WRITE) {
@@ -426,25 +647,327 @@ GetEventInfoSize(__in ULONG MajorFunction, __in PEVENT_INFORMATION EventInfo) {
                         EventInfo->BufferLength);
 }
 
+// Describes the result of IoEvent for sending and counts the time taken to
+// make it. Must be called before the event is released.
+VOID InitQueuedReply(PDOKAN_IO_EVENT IoEvent, DOKAN_QUEUED_REPLY *Reply) {
+  ULONG majorFunction = IoEvent->EventContext->MajorFunction;
+
+  Reply->EventResult = IoEvent->EventResult;
+  Reply->EventResultSize = IoEvent->EventResultSize;
+  Reply->EventInfoSize = GetEventInfoSize(majorFunction, IoEvent->EventResult);
+  Reply->BatchFlags = DOKAN_EVENT_INFO_BATCHED;
+  if (majorFunction == IRP_MJ_WRITE) {
+    Reply->BatchFlags |= DOKAN_EVENT_INFO_FIXED_SIZE;
+  }
+  Reply->PoolAllocated = IoEvent->PoolAllocated;
+  Reply->OperationSlot = IoEvent->OperationSlot;
+  Reply->ReadyTime = GetPerformanceCounter();
+  RecordOperationStage(IoEvent->DokanInstance, IoEvent->OperationSlot,
+                       DOKAN_OPERATION_STAGE_CALLBACK,
+                       Reply->ReadyTime - IoEvent->DispatchTime);
+}
+
+// Returns TRUE if the reply can be sent in the same buffer as other replies.
+BOOL CanBatchReply(PDOKAN_INSTANCE DokanInstance, DOKAN_QUEUED_REPLY *Reply) {
+  // The driver stops reading the buffer after a buffer overflow reply.
+  return DokanInstance->ThreadInfo.ReplyBatch.Timer &&
+         Reply->EventResult->Status != STATUS_BUFFER_OVERFLOW &&
+         Reply->EventInfoSize <= DOKAN_REPLY_BATCH_MAX_REPLY_SIZE;
+}
+
+VOID FreeQueuedReplies(PDOKAN_INSTANCE DokanInstance,
+                       DOKAN_QUEUED_REPLY *Replies, ULONG Count) {
+  for (ULONG i = 0; i < Count; ++i) {
+    FreeIoEventResult(DokanInstance, Replies[i].EventResult,
+                      Replies[i].EventResultSize, Replies[i].PoolAllocated);
+  }
+}
+
+// Copies the replies, sorted by serial number as the driver expects them, in
+// one buffer to release with FreeIoEventResult. Returns NULL if the buffer
+// cannot be allocated, Replies is then left untouched.
+PEVENT_INFORMATION BuildReplyBatchBuffer(PDOKAN_INSTANCE DokanInstance,
+                                         DOKAN_QUEUED_REPLY *Replies,
+                                         ULONG Count, PDWORD BufferSize,
+                                         PULONG EventResultSize) {
+  PCHAR buffer;
+  DWORD size = 0;
+
+  for (ULONG i = 0; i < Count; ++i) {
+    size += Replies[i].EventInfoSize;
+  }
+  buffer = (PCHAR)PopEventResult(
+      DokanInstance, size - FIELD_OFFSET(EVENT_INFORMATION, Buffer),
+      EventResultSize);
+  if (!buffer) {
+    return NULL;
+  }
+  // Batches are small enough for an insertion sort.
+  for (ULONG i = 1; i < Count; ++i) {
+    DOKAN_QUEUED_REPLY reply = Replies[i];
+    ULONG j = i;
+    while (j > 0 && Replies[j - 1].EventResult->SerialNumber >
+                        reply.EventResult->SerialNumber) {
+      Replies[j] = Replies[j - 1];
+      --j;
+    }
+    Replies[j] = reply;
+  }
+  size = 0;
+  for (ULONG i = 0; i < Count; ++i) {
+    PEVENT_INFORMATION eventInfo = (PEVENT_INFORMATION)(buffer + size);
+    CopyMemory(eventInfo, Replies[i].EventResult, Replies[i].EventInfoSize);
+    eventInfo->Flags |= Replies[i].BatchFlags;
+    size += Replies[i].EventInfoSize;
+  }
+  *BufferSize = size;
+  return (PEVENT_INFORMATION)buffer;
+}
+
+// Sends replies without pulling new events.
+DWORD SendReplyBuffer(PDOKAN_INSTANCE DokanInstance, PVOID Buffer,
+                      DWORD BufferSize) {
+  DWORD lastError;
+  DWORD returnedLength = 0;
+
+  // Without output buffer the driver only completes the events.
+  lastError = DokanInstance->Transport->ProcessAndPull(
+      DokanInstance, Buffer, BufferSize, NULL, 0, &returnedLength);
+  if (lastError) {
+    if (!DokanInstance->FileSystemStopped) {
+      DokanDbgPrintW(L"Dokan Error: Dokan device result ioctl failed with "
+                     L"code %d.\n",
+                     lastError);
+    }
+  }
+  return lastError;
+}
+
+// Sends the replies in one device call when possible and releases them.
+DWORD SendQueuedReplies(PDOKAN_INSTANCE DokanInstance,
+                        DOKAN_QUEUED_REPLY *Replies, ULONG Count) {
+  PEVENT_INFORMATION buffer = NULL;
+  DWORD bufferSize = 0;
+  ULONG eventResultSize = 0;
+  DWORD lastError = 0;
+
+  if (Count > 1) {
+    buffer = BuildReplyBatchBuffer(DokanInstance, Replies, Count, &bufferSize,
+                                   &eventResultSize);
+  }
+  if (buffer) {
+    lastError = SendReplyBuffer(DokanInstance, buffer, bufferSize);
+    RecordReplies(DokanInstance, Replies, Count);
+    FreeIoEventResult(DokanInstance, buffer, eventResultSize,
+                      /*PoolAllocated=*/TRUE);
+  } else {
+    for (ULONG i = 0; i < Count; ++i) {
+      DWORD error = SendReplyBuffer(DokanInstance, Replies[i].EventResult,
+                                    Replies[i].EventInfoSize);
+      RecordReplies(DokanInstance, &Replies[i], 1);
+      if (error) {
+        lastError = error;
+      }
+    }
+  }
+  FreeQueuedReplies(DokanInstance, Replies, Count);
+  return lastError;
+}
+
+// Moves the queued replies to Replies, that must hold
+// DOKAN_REPLY_BATCH_MAX_COUNT of them. Returns their number.
+ULONG TakeQueuedReplies(PDOKAN_INSTANCE DokanInstance,
+                        DOKAN_QUEUED_REPLY *Replies) {
+  DOKAN_REPLY_BATCH *batch = &DokanInstance->ThreadInfo.ReplyBatch;
+  ULONG count;
+
+  // Unlocked check to keep pulls cheap when nothing is queued. A reply queued
+  // meanwhile is sent by the next pull or the timer.
+  if (!batch->Count) {
+    return 0;
+  }
+  AcquireSRWLockExclusive(&batch->Lock);
+  count = batch->Count;
+  CopyMemory(Replies, batch->Replies, count * sizeof(DOKAN_QUEUED_REPLY));
+  batch->Count = 0;
+  batch->Size = 0;
+  ReleaseSRWLockExclusive(&batch->Lock);
+  return count;
+}
+
+// Sends the queued replies on their own.
+VOID FlushQueuedReplies(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_QUEUED_REPLY replies[DOKAN_REPLY_BATCH_MAX_COUNT];
+  ULONG count = TakeQueuedReplies(DokanInstance, replies);
+  if (count) {
+    DWORD error = SendQueuedReplies(DokanInstance, replies, count);
+    if (error) {
+      OnDeviceIoCtlFailed(DokanInstance, error);
+    }
+  }
+}
+
+// Sends the queued replies if no thread dispatching an event is left to
+// carry them. Called by the dispatching threads that stop without sending a
+// result, after they left ReplyBatch.Dispatchers.
+VOID FlushOrphanedReplies(PDOKAN_INSTANCE DokanInstance) {
+  if (!InterlockedAdd(&DokanInstance->ThreadInfo.ReplyBatch.Dispatchers, 0)) {
+    FlushQueuedReplies(DokanInstance);
+  }
+}
+
+// Queues the reply in the reply batch, that is sent once it is full. Returns
+// the error of the device call if it failed.
+DWORD QueueReply(PDOKAN_INSTANCE DokanInstance, DOKAN_QUEUED_REPLY *Reply) {
+  DOKAN_REPLY_BATCH *batch = &DokanInstance->ThreadInfo.ReplyBatch;
+  DOKAN_QUEUED_REPLY replies[DOKAN_REPLY_BATCH_MAX_COUNT];
+  ULONG count = 0;
+  BOOL startTimer = FALSE;
+
+  AcquireSRWLockExclusive(&batch->Lock);
+  batch->Replies[batch->Count++] = *Reply;
+  batch->Size += Reply->EventInfoSize;
+  if (batch->Count == DOKAN_REPLY_BATCH_MAX_COUNT ||
+      batch->Size >= DOKAN_REPLY_BATCH_MAX_SIZE) {
+    count = batch->Count;
+    CopyMemory(replies, batch->Replies, count * sizeof(DOKAN_QUEUED_REPLY));
+    batch->Count = 0;
+    batch->Size = 0;
+  } else if (batch->Count == 1) {
+    startTimer = TRUE;
+  }
+  ReleaseSRWLockExclusive(&batch->Lock);
+
+  if (startTimer) {
+    // An expiration for replies already sent only finds an empty batch.
+    LARGE_INTEGER relativeDueTime;
+    FILETIME dueTime;
+    relativeDueTime.QuadPart = -(LONGLONG)DOKAN_REPLY_BATCH_TIMEOUT_MS * 10000;
+    dueTime.dwLowDateTime = relativeDueTime.LowPart;
+    dueTime.dwHighDateTime = relativeDueTime.HighPart;
+    SetThreadpoolTimer(batch->Timer, &dueTime, 0, 0);
+  }
+  if (!count) {
+    // The last dispatcher may have taken the batch before the reply was
+    // queued.
+    FlushOrphanedReplies(DokanInstance);
+    return 0;
+  }
+  return SendQueuedReplies(DokanInstance, replies, count);
+}
+
+VOID CALLBACK ReplyBatchTimerCallback(PTP_CALLBACK_INSTANCE Instance,
+                                      PVOID Context, PTP_TIMER Timer) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Timer);
+
+  FlushQueuedReplies((PDOKAN_INSTANCE)Context);
+}
+
+BOOL StartReplyBatch(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_REPLY_BATCH *batch = &DokanInstance->ThreadInfo.ReplyBatch;
+
+  batch->Timer =
+      CreateThreadpoolTimer(ReplyBatchTimerCallback, DokanInstance,
+                            &DokanInstance->ThreadInfo.CallbackEnvironment);
+  if (!batch->Timer) {
+    DokanDbgPrintW(L"Dokan Error: CreateThreadpoolTimer() has returned "
+                   L"error code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+VOID DiscardQueuedReplies(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_REPLY_BATCH *batch = &DokanInstance->ThreadInfo.ReplyBatch;
+  FreeQueuedReplies(DokanInstance, batch->Replies, batch->Count);
+  batch->Count = 0;
+  batch->Size = 0;
+}
+
+// Returns TRUE if Reply is better queued than sent now: it joins replies
+// already waiting, or a thread dispatching an event sends it with its own
+// result soon. Otherwise nothing but the timer would send it.
+BOOL ShouldQueueReply(PDOKAN_INSTANCE DokanInstance,
+                      DOKAN_QUEUED_REPLY *Reply) {
+  DOKAN_REPLY_BATCH *batch = &DokanInstance->ThreadInfo.ReplyBatch;
+  return CanBatchReply(DokanInstance, Reply) &&
+         (batch->Count || batch->Dispatchers);
+}
+
+// Sends the event result without pulling new events and releases the event.
+// With IPC batching, small results are queued in the reply batch while a
+// dispatching thread can carry them, else sent with the queued ones.
+DWORD SendEventInformation(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_INSTANCE dokanInstance = IoEvent->DokanInstance;
+  DOKAN_QUEUED_REPLY replies[DOKAN_REPLY_BATCH_MAX_COUNT + 1];
+  DOKAN_QUEUED_REPLY reply;
+  ULONG count = 0;
+
+  InitQueuedReply(IoEvent, &reply);
+  PushIoBatchBuffer(IoEvent->IoBatch);
+  PushIoEventBuffer(IoEvent);
+  if (ShouldQueueReply(dokanInstance, &reply)) {
+    return QueueReply(dokanInstance, &reply);
+  }
+  if (CanBatchReply(dokanInstance, &reply)) {
+    count = TakeQueuedReplies(dokanInstance, replies);
+  }
+  replies[count++] = reply;
+  return SendQueuedReplies(dokanInstance, replies, count);
+}
+
+BOOL IsDispatchPending(PDOKAN_IO_EVENT IoEvent, NTSTATUS Status) {
+  if (Status != STATUS_PENDING) {
+    return FALSE;
+  }
+  if (!IoEvent->DokanFileInfo.AsyncDispatch) {
+    DbgPrint("Dokan Error: STATUS_PENDING returned by a callback that cannot "
+             "complete asynchronously.\n");
+    return FALSE;
+  }
+  IoEvent->CallbackPending = TRUE;
+  return TRUE;
+}
+
+BOOL HandOffPendingIoEvent(PDOKAN_IO_EVENT IoEvent) {
+  return InterlockedCompareExchange(&IoEvent->CompletionState,
+                                    DOKAN_IO_EVENT_PENDING,
+                                    DOKAN_IO_EVENT_DISPATCHING) ==
+         DOKAN_IO_EVENT_DISPATCHING;
+}
+
+VOID CompletePendingDispatch(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_INSTANCE dokanInstance = IoEvent->DokanInstance;
+  DWORD error;
+
+  if (InterlockedExchange(&IoEvent->CompletionState,
+                          DOKAN_IO_EVENT_COMPLETED) != DOKAN_IO_EVENT_PENDING) {
+    // Completed before its dispatching thread gave it up, which sends it.
+    return;
+  }
+  EndAdmittedDispatch(IoEvent);
+  error = SendEventInformation(IoEvent);
+  if (error) {
+    OnDeviceIoCtlFailed(dokanInstance, error);
+  }
+}
+
 DWORD SendAndPullEventInformation(PDOKAN_IO_EVENT IoEvent,
                                   PDOKAN_IO_BATCH IoBatch,
                                   BOOL ReleaseBatchBuffers) {
+  PDOKAN_INSTANCE dokanInstance = IoBatch->DokanInstance;
   DWORD lastError = 0;
   PCHAR inputBuffer = NULL;
-  DWORD eventInfoSize = 0;
-  ULONG eventResultSize = 0;
-  PEVENT_INFORMATION eventInfo = NULL;
-  BOOL eventInfoPollAllocated = FALSE;
+  DWORD inputBufferSize = 0;
+  DOKAN_QUEUED_REPLY reply = {0};
+  DOKAN_QUEUED_REPLY replies[DOKAN_REPLY_BATCH_MAX_COUNT + 1];
+  PEVENT_INFORMATION batchBuffer = NULL;
+  ULONG batchResultSize = 0;
 
   if (IoEvent && IoEvent->EventResult) {
-    eventInfo = IoEvent->EventResult;
-    eventResultSize = IoEvent->EventResultSize;
-    eventInfoPollAllocated = IoEvent->PoolAllocated;
-    inputBuffer = (PCHAR)eventInfo;
-    eventInfoSize =
-        GetEventInfoSize(IoEvent->EventContext->MajorFunction, eventInfo);
-    eventInfo->PullEventTimeoutMs =
-        IoBatch->MainPullThread ? /*infinite*/ 0 : DOKAN_PULL_EVENT_TIMEOUT_MS;
+    InitQueuedReply(IoEvent, &reply);
     if (ReleaseBatchBuffers) {
       PushIoBatchBuffer(IoEvent->IoBatch);
       PushIoEventBuffer(IoEvent);
@@ -452,38 +975,112 @@ DWORD SendAndPullEventInformation(PDOKAN_IO_EVENT IoEvent,
     DbgPrint(
         "Dokan Information: SendAndPullEventInformation() with NTSTATUS 0x%x, "
         "context 0x%lx, and result object 0x%p with size %d\n",
-        eventInfo->Status, eventInfo->Context, eventInfo, eventInfoSize);
+        reply.EventResult->Status, reply.EventResult->Context,
+        reply.EventResult, reply.EventInfoSize);
   } else {
     // Main pull thread is allowed to pull events without having event results to send
     assert(IoBatch->MainPullThread);
   }
 
-  if (!DeviceIoControl(
-          IoBatch->DokanInstance->Device, // Handle to device
-          FSCTL_EVENT_PROCESS_N_PULL,     // IO Control code
-          inputBuffer,                    // Input Buffer to driver.
-          eventInfoSize,                  // Length of input buffer in bytes.
-          &IoBatch->EventContext[0],      // Output Buffer from driver.
-          BATCH_EVENT_CONTEXT_SIZE,       // Length of output buffer in bytes.
-          &IoBatch->NumberOfBytesTransferred, // Bytes placed in buffer.
-          NULL                                // asynchronous call
-          )) {
-    lastError = GetLastError();
-    if (eventInfo) {
-      FreeIoEventResult(eventInfo, eventResultSize, eventInfoPollAllocated);
+  // Queued replies are sent with the result of the pull.
+  if (!reply.EventResult || CanBatchReply(dokanInstance, &reply)) {
+    ULONG queuedCount = TakeQueuedReplies(dokanInstance, replies);
+    if (queuedCount) {
+      ULONG replyCount = queuedCount;
+      if (reply.EventResult) {
+        replies[replyCount++] = reply;
+      }
+      batchBuffer = BuildReplyBatchBuffer(dokanInstance, replies, replyCount,
+                                          &inputBufferSize, &batchResultSize);
+      if (batchBuffer) {
+        RecordReplies(dokanInstance, replies, replyCount);
+        FreeQueuedReplies(dokanInstance, replies, replyCount);
+        reply.EventResult = NULL;
+        inputBuffer = (PCHAR)batchBuffer;
+      } else {
+        // A device error is also returned by the pull below.
+        SendQueuedReplies(dokanInstance, replies, queuedCount);
+      }
     }
-    if (!IoBatch->DokanInstance->FileSystemStopped) {
+  }
+  if (reply.EventResult) {
+    inputBuffer = (PCHAR)reply.EventResult;
+    inputBufferSize = reply.EventInfoSize;
+    RecordReplies(dokanInstance, &reply, 1);
+  }
+  if (inputBuffer) {
+    ((PEVENT_INFORMATION)inputBuffer)->PullEventTimeoutMs =
+        IoBatch->MainPullThread ? /*infinite*/ 0 : DOKAN_PULL_EVENT_TIMEOUT_MS;
+  }
+
+  RecordTimeline(dokanInstance, DOKAN_TIMELINE_PULL_BEGIN, 0, 0);
+  lastError = dokanInstance->Transport->ProcessAndPull(
+      dokanInstance, inputBuffer, inputBufferSize, &IoBatch->EventContext[0],
+      BATCH_EVENT_CONTEXT_SIZE, &IoBatch->NumberOfBytesTransferred);
+  RecordTimeline(dokanInstance, DOKAN_TIMELINE_PULL_END, 0, 0);
+  if (lastError) {
+    if (!dokanInstance->FileSystemStopped) {
       DokanDbgPrintW(
           L"Dokan Error: Dokan device result ioctl failed for wait with "
           L"code %d.\n",
           lastError);
     }
-    return lastError;
   }
-  if (eventInfo) {
-    FreeIoEventResult(eventInfo, eventResultSize, eventInfoPollAllocated);
+  if (batchBuffer) {
+    FreeIoEventResult(dokanInstance, batchBuffer, batchResultSize,
+                      /*PoolAllocated=*/TRUE);
   }
-  return 0;
+  if (reply.EventResult) {
+    FreeQueuedReplies(dokanInstance, &reply, 1);
+  }
+  return lastError;
+}
+
+// Counts the events pulled in IoBatch and queues all of them to the thread
+// pool except the last one, that is returned to be executed on the current
+// thread. Returns NULL if the events could not be allocated.
+PDOKAN_IO_EVENT SplitIoBatch(PDOKAN_INSTANCE DokanInstance,
+                             PDOKAN_IO_BATCH IoBatch) {
+  PDOKAN_IO_EVENT ioEvent = NULL;
+  PEVENT_CONTEXT context = IoBatch->EventContext;
+  ULONG_PTR currentNumberOfBytesTransferred =
+      IoBatch->NumberOfBytesTransferred;
+  IoBatch->PullTime = GetPerformanceCounter();
+  TraceEventBatch(DokanInstance, IoBatch->EventContext,
+                  IoBatch->NumberOfBytesTransferred);
+  while (currentNumberOfBytesTransferred) {
+    ++IoBatch->EventContextBatchCount;
+    currentNumberOfBytesTransferred -= context->Length;
+    context = (PEVENT_CONTEXT)((PCHAR)(context) + context->Length);
+  }
+  RecordPull(DokanInstance, IoBatch->EventContextBatchCount);
+  RecordTimeline(DokanInstance, DOKAN_TIMELINE_PULLED, 0,
+                 IoBatch->EventContextBatchCount);
+  context = IoBatch->EventContext;
+  LONG eventContextBatchCount = IoBatch->EventContextBatchCount;
+  LIST_ENTRY queuedEvents;
+  InitializeListHead(&queuedEvents);
+  while (eventContextBatchCount) {
+    ioEvent = PopIoEventBuffer(DokanInstance);
+    if (!ioEvent) {
+      DbgPrintW(L"Dokan Error: IoEvent allocation failed.\n");
+      QueueIoEventList(DokanInstance, &queuedEvents);
+      OnDeviceIoCtlFailed(DokanInstance, ERROR_OUTOFMEMORY);
+      return NULL;
+    }
+    ioEvent->EventContext = context;
+    ioEvent->IoBatch = IoBatch;
+    --eventContextBatchCount;
+    context = (PEVENT_CONTEXT)((PCHAR)(context) + context->Length);
+    // All batched events are dispatched to the thread pool except the last event that is executed on the current thread.
+    // Note: Single thread mode has batching disabled and therefore only has one event which is executed on the main thread.
+    if (eventContextBatchCount) {
+      InsertTailList(&queuedEvents, &ioEvent->DispatchListEntry);
+    }
+  }
+  // It is unsafe to access the batch from here after queuing the events.
+  QueueIoEventList(DokanInstance, &queuedEvents);
+  return ioEvent;
 }
 
 VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Parameter,
@@ -503,7 +1100,36 @@ VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Para
     // - New pool thread that just started with a dispatched event.
     // Note: Main pull thread does not have an EventContext when started.
     if (ioEvent && ioEvent->EventContext) {
-      DispatchEvent(ioEvent);
+      if (!BeginAdmittedDispatch(ioEvent) || !BeginOrderedDispatch(ioEvent)) {
+        // Dispatched once its process is admitted and the previous events of
+        // its open are completed.
+        if (mainPullThread) {
+          ioEvent = NULL;
+          continue;
+        }
+        return;
+      }
+      LARGE_INTEGER dispatchStart;
+      LARGE_INTEGER dispatchEnd;
+      QueryPerformanceCounter(&dispatchStart);
+      InterlockedIncrement(&dokanInstance->ThreadInfo.ReplyBatch.Dispatchers);
+      DispatchTimedEvent(ioEvent);
+      InterlockedDecrement(&dokanInstance->ThreadInfo.ReplyBatch.Dispatchers);
+      QueryPerformanceCounter(&dispatchEnd);
+      RecordDispatch(dokanInstance,
+                     dispatchEnd.QuadPart - dispatchStart.QuadPart);
+      if (ioEvent->CallbackPending && HandOffPendingIoEvent(ioEvent)) {
+        // The DokanEndDispatch call sends the result and releases the event.
+        if (mainPullThread) {
+          ioEvent = NULL;
+          continue;
+        }
+        FlushOrphanedReplies(dokanInstance);
+        return;
+      }
+      // Dispatchers failing before completing the event keep their open.
+      EndOrderedDispatch(ioEvent);
+      EndAdmittedDispatch(ioEvent);
       if (!ioEvent->EventResult) {
         // Some events like Close() do not have event results.
         // Release the resource and terminate here unless we are the main pulling thread.
@@ -513,16 +1139,31 @@ VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Para
           ioEvent = NULL;
           continue;
         }
+        FlushOrphanedReplies(dokanInstance);
         return;
       }
     }
 
-    ioBatch = PopIoBatchBuffer();
+    // Pool threads only pull again while the dispatch controller allows it.
+    // With overlapped pulls, the posted pulls are the only ones.
+    if (!mainPullThread &&
+        ((dokanInstance->DokanOptions->Options &
+          DOKAN_OPTION_OVERLAPPED_PULL) ||
+         !BeginPoolPull(dokanInstance))) {
+      DWORD error = SendEventInformation(ioEvent);
+      if (error) {
+        OnDeviceIoCtlFailed(dokanInstance, error);
+      }
+      return;
+    }
+    ioBatch = PopIoBatchBuffer(dokanInstance);
     ioBatch->MainPullThread = mainPullThread;
-    ioBatch->DokanInstance = dokanInstance;
 
     // 1 - Send event result and pull new events.
     DWORD error = SendAndPullEventInformation(ioEvent, ioBatch, /*ReleaseBatchBuffers=*/TRUE);
+    if (!mainPullThread) {
+      EndPoolPull(dokanInstance);
+    }
     if (error) {
       HandleProcessIoFatalError(dokanInstance, ioBatch, error);
       return;
@@ -530,6 +1171,7 @@ VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Para
 
     // 2 - Terminate thread as nothing needs to be proceed unless we are the mainPullThread.
     if (!ioBatch->NumberOfBytesTransferred) {
+      RecordPull(dokanInstance, 0);
       PushIoBatchBuffer(ioBatch);
       if (mainPullThread) {
         ioEvent = NULL;
@@ -538,39 +1180,141 @@ VOID CALLBACK DispatchBatchIoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Para
       return;
     }
 
-    PEVENT_CONTEXT context = ioBatch->EventContext;
-    ULONG_PTR currentNumberOfBytesTransferred =
-        ioBatch->NumberOfBytesTransferred;
-    while (currentNumberOfBytesTransferred) {
-      ++ioBatch->EventContextBatchCount;
-      currentNumberOfBytesTransferred -= context->Length;
-      context = (PEVENT_CONTEXT)((PCHAR)(context) + context->Length);
-    }
     // 3 - Dispatch Events
-    context = ioBatch->EventContext;
-    LONG eventContextBatchCount = ioBatch->EventContextBatchCount;
-    while (eventContextBatchCount) {
-      ioEvent = PopIoEventBuffer();
-      if (!ioEvent) {
-        DbgPrintW(L"Dokan Error: IoEvent allocation failed.\n");
-        OnDeviceIoCtlFailed(ioBatch->DokanInstance, ERROR_OUTOFMEMORY);
-        return;
-      }
-      ioEvent->DokanInstance = ioBatch->DokanInstance;
-      ioEvent->EventContext = context;
-      ioEvent->IoBatch = ioBatch;
-      --eventContextBatchCount;
-      // It is unsafe to access the context from here after Queuing the event.
-      context = (PEVENT_CONTEXT)((PCHAR)(context) + context->Length);
-      // 4 - All batched events are dispatched to the thread pool except the last event that is executed on the current thread.
-      // Note: Single thread mode has batching disabled and therefore only has one event which is executed on the main thread.
-      if (eventContextBatchCount) {
-        QueueIoEvent(ioEvent, DispatchBatchIoCallback);
-      }
+    ioEvent = SplitIoBatch(dokanInstance, ioBatch);
+    if (!ioEvent) {
+      return;
     }
   }
 }
 
+DWORD PostOverlappedPull(PDOKAN_INSTANCE DokanInstance);
+
+VOID CompleteOverlappedPull(PDOKAN_INSTANCE DokanInstance,
+                            PDOKAN_IO_BATCH IoBatch, DWORD IoResult,
+                            DWORD NumberOfBytesTransferred) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+  PDOKAN_IO_EVENT ioEvent = NULL;
+  DWORD error = 0;
+
+  // 1 - Replace the harvested pull before dispatching its events.
+  if (!IoResult) {
+    error = PostOverlappedPull(DokanInstance);
+  }
+  if (InterlockedDecrement(&threadInfo->PostedPulls) == 0 &&
+      threadInfo->PullsStopped) {
+    SetEvent(threadInfo->PullsDrainedEvent);
+  }
+  if (IoResult) {
+    // Cancelled by StopOverlappedPulls or failed because of the unmount.
+    PushIoBatchBuffer(IoBatch);
+    if (!threadInfo->PullsStopped) {
+      OnDeviceIoCtlFailed(DokanInstance, IoResult);
+    }
+    return;
+  }
+  if (error) {
+    // The events already pulled are still dispatched.
+    OnDeviceIoCtlFailed(DokanInstance, error);
+  }
+
+  IoBatch->NumberOfBytesTransferred = NumberOfBytesTransferred;
+  if (!IoBatch->NumberOfBytesTransferred) {
+    RecordPull(DokanInstance, 0);
+    PushIoBatchBuffer(IoBatch);
+    return;
+  }
+  // 2 - Dispatch the events. The last one runs on this thread, that sends its
+  // result without pulling since the posted pulls already wait for events.
+  ioEvent = SplitIoBatch(DokanInstance, IoBatch);
+  if (ioEvent) {
+    DispatchBatchIoCallback(NULL, ioEvent, NULL);
+  }
+}
+
+// Posts one overlapped pull completed by CompleteOverlappedPull. The queued
+// replies are sent along, the transport copies them before the call returns.
+DWORD PostOverlappedPull(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+  DOKAN_QUEUED_REPLY replies[DOKAN_REPLY_BATCH_MAX_COUNT];
+  PEVENT_INFORMATION batchBuffer = NULL;
+  DWORD inputBufferSize = 0;
+  ULONG batchResultSize = 0;
+  DWORD lastError = 0;
+
+  if (threadInfo->PullsStopped) {
+    return 0;
+  }
+  PDOKAN_IO_BATCH ioBatch = PopIoBatchBuffer(DokanInstance);
+  if (!ioBatch) {
+    DbgPrintW(L"Dokan Error: IoBatch allocation failed.\n");
+    return ERROR_OUTOFMEMORY;
+  }
+  ULONG queuedCount = TakeQueuedReplies(DokanInstance, replies);
+  if (queuedCount) {
+    batchBuffer = BuildReplyBatchBuffer(DokanInstance, replies, queuedCount,
+                                        &inputBufferSize, &batchResultSize);
+    if (batchBuffer) {
+      FreeQueuedReplies(DokanInstance, replies, queuedCount);
+    } else {
+      // A device error is also returned by the pull below.
+      SendQueuedReplies(DokanInstance, replies, queuedCount);
+    }
+  }
+
+  InterlockedIncrement(&threadInfo->PostedPulls);
+  lastError = DokanInstance->Transport->PostPull(DokanInstance, batchBuffer,
+                                                 inputBufferSize, ioBatch);
+  if (lastError) {
+    InterlockedDecrement(&threadInfo->PostedPulls);
+    PushIoBatchBuffer(ioBatch);
+    if (!DokanInstance->FileSystemStopped) {
+      DokanDbgPrintW(L"Dokan Error: Dokan device overlapped pull failed with "
+                     L"code %d.\n",
+                     lastError);
+    }
+  }
+  if (batchBuffer) {
+    FreeIoEventResult(DokanInstance, batchBuffer, batchResultSize,
+                      /*PoolAllocated=*/TRUE);
+  }
+  return lastError;
+}
+
+BOOL StartOverlappedPulls(PDOKAN_INSTANCE DokanInstance, ULONG PullCount) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+
+  threadInfo->PullsDrainedEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (!threadInfo->PullsDrainedEvent) {
+    DokanDbgPrintW(L"Dokan Error: CreateEvent() has returned error code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  if (!DokanInstance->Transport->StartPulls(DokanInstance)) {
+    return FALSE;
+  }
+  for (ULONG i = 0; i < PullCount; ++i) {
+    if (PostOverlappedPull(DokanInstance)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+VOID StopOverlappedPulls(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+
+  if (!threadInfo->PullsDrainedEvent) {
+    return;
+  }
+  InterlockedExchange(&threadInfo->PullsStopped, TRUE);
+  if (threadInfo->PostedPulls) {
+    DokanInstance->Transport->CancelPulls(DokanInstance);
+    WaitForSingleObject(threadInfo->PullsDrainedEvent, INFINITE);
+  }
+  DokanInstance->Transport->WaitForPulls(DokanInstance);
+}
+
 VOID CALLBACK DispatchDedicatedIoCallback(PTP_CALLBACK_INSTANCE Instance,
                                           PVOID Parameter, PTP_WORK Work) {
   UNREFERENCED_PARAMETER(Instance);
@@ -578,9 +1322,8 @@ VOID CALLBACK DispatchDedicatedIoCallback(PTP_CALLBACK_INSTANCE Instance,
 
   PDOKAN_IO_EVENT ioEvent = (PDOKAN_IO_EVENT)Parameter;
   assert(ioEvent);
-  PDOKAN_IO_BATCH ioBatch = PopIoBatchBuffer();
+  PDOKAN_IO_BATCH ioBatch = PopIoBatchBuffer(ioEvent->DokanInstance);
   ioBatch->MainPullThread = TRUE;
-  ioBatch->DokanInstance = ioEvent->DokanInstance;
   ioEvent->EventContext = ioBatch->EventContext;
   ioEvent->IoBatch = ioBatch;
 
@@ -593,7 +1336,7 @@ VOID CALLBACK DispatchDedicatedIoCallback(PTP_CALLBACK_INSTANCE Instance,
       HandleProcessIoFatalError(ioBatch->DokanInstance, ioBatch, error);
       return;
     }
-    RtlZeroMemory(ioEvent, sizeof(DOKAN_IO_EVENT));
+    RtlZeroMemory(ioEvent, DOKAN_IO_EVENT_RESET_SIZE);
     ioEvent->DokanInstance = ioBatch->DokanInstance;
     ioEvent->EventContext = ioBatch->EventContext;
     ioEvent->IoBatch = ioBatch;
@@ -601,8 +1344,29 @@ VOID CALLBACK DispatchDedicatedIoCallback(PTP_CALLBACK_INSTANCE Instance,
     if (!ioBatch->NumberOfBytesTransferred) {
       continue;
     }
+    ioBatch->PullTime = GetPerformanceCounter();
+    TraceEventBatch(ioBatch->DokanInstance, ioBatch->EventContext,
+                    ioBatch->NumberOfBytesTransferred);
+    RecordTimeline(ioBatch->DokanInstance, DOKAN_TIMELINE_PULLED, 0, 1);
     // 3 - Process event
-    DispatchEvent(ioEvent);
+    DispatchTimedEvent(ioEvent);
+    if (ioEvent->CallbackPending) {
+      // The batch holding the event context is released with the event.
+      ioBatch->EventContextBatchCount = 1;
+      if (HandOffPendingIoEvent(ioEvent)) {
+        PDOKAN_INSTANCE dokanInstance = ioBatch->DokanInstance;
+        ioEvent = PopIoEventBuffer(dokanInstance);
+        if (!ioEvent) {
+          DbgPrintW(L"Dokan Error: IoEvent allocation failed.\n");
+          OnDeviceIoCtlFailed(dokanInstance, ERROR_OUTOFMEMORY);
+          return;
+        }
+        ioBatch = PopIoBatchBuffer(dokanInstance);
+        ioBatch->MainPullThread = TRUE;
+        ioEvent->EventContext = ioBatch->EventContext;
+        ioEvent->IoBatch = ioBatch;
+      }
+    }
   }
 }
 
@@ -650,7 +1414,7 @@ VOID DOKANAPI DokanCloseHandle(_In_ DOKAN_HANDLE DokanInstance) {
   }
   // make sure the driver is unmounted
   instance->FileSystemStopped = TRUE;
-  DokanRemoveMountPoint(instance->MountPoint);
+  instance->Transport->Release(instance);
   DokanWaitForFileSystemClosed((DOKAN_HANDLE)instance, INFINITE);
   EnterCriticalSection(&g_InstanceCriticalSection);
   DeleteDokanInstance(instance);
@@ -671,6 +1435,88 @@ int DOKANAPI DokanMain(PDOKAN_OPTIONS DokanOptions,
   return returnCode;
 }
 
+// Starts the threads pulling the events of the instance from its transport and
+// dispatching them.
+int StartEventDispatch(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_OPTIONS dokanOptions = DokanInstance->DokanOptions;
+  DWORD_PTR processAffinityMask;
+  DWORD_PTR systemAffinityMask;
+  DWORD mainPullThreadCount = 0;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask,
+                             &systemAffinityMask)) {
+    while (processAffinityMask) {
+      mainPullThreadCount += 1;
+      processAffinityMask >>= 1;
+    }
+  } else {
+    DbgPrintW(L"Dokan Error: GetProcessAffinityMask failed with Error %d\n",
+              GetLastError());
+  }
+  if (dokanOptions->SingleThread) {
+    mainPullThreadCount = 1; // Really not recommanded
+    dokanOptions->Options &= ~(DOKAN_OPTION_ALLOW_IPC_BATCHING |
+                               DOKAN_OPTION_ORDERED_FILE_DISPATCH |
+                               DOKAN_OPTION_OVERLAPPED_PULL |
+                               DOKAN_OPTION_PROCESS_ADMISSION);
+  } else if (mainPullThreadCount < DOKAN_MAIN_PULL_THREAD_COUNT_MIN) {
+    mainPullThreadCount = DOKAN_MAIN_PULL_THREAD_COUNT_MIN;
+  } else if (mainPullThreadCount > DOKAN_MAIN_PULL_THREAD_COUNT_MAX) {
+    // Thread pool will allocate more threads when pulling batched events
+    dokanOptions->Options |= DOKAN_OPTION_ALLOW_IPC_BATCHING;
+    mainPullThreadCount = DOKAN_MAIN_PULL_THREAD_COUNT_MAX;
+  }
+  if (dokanOptions->Options & (DOKAN_OPTION_ORDERED_FILE_DISPATCH |
+                               DOKAN_OPTION_OVERLAPPED_PULL |
+                               DOKAN_OPTION_PROCESS_ADMISSION)) {
+    // Events waiting for their open or their process admission and the events
+    // harvested by overlapped pulls are dispatched from the batch queue.
+    dokanOptions->Options |= DOKAN_OPTION_ALLOW_IPC_BATCHING;
+  }
+  // Not cast: the option bit does not fit in a BOOLEAN.
+  BOOLEAN allowIpcBatching =
+      (dokanOptions->Options & DOKAN_OPTION_ALLOW_IPC_BATCHING) != 0;
+  DbgPrintW(L"Dokan: Using %d main pull threads with ipc batching: %d\n",
+            mainPullThreadCount, allowIpcBatching);
+  if (allowIpcBatching) {
+    InitializeDispatchQueueWeights(DokanInstance);
+    if (!StartDispatchController(DokanInstance, mainPullThreadCount) ||
+        !StartReplyBatch(DokanInstance)) {
+      return DOKAN_MOUNT_ERROR;
+    }
+    if ((dokanOptions->Options & DOKAN_OPTION_PROCESS_ADMISSION) &&
+        !StartProcessAdmission(DokanInstance)) {
+      return DOKAN_MOUNT_ERROR;
+    }
+    DokanInstance->ThreadInfo.DispatchQueue.Work = CreateThreadpoolWork(
+        DispatchQueuedIoCallback, DokanInstance,
+        &DokanInstance->ThreadInfo.CallbackEnvironment);
+    if (!DokanInstance->ThreadInfo.DispatchQueue.Work) {
+      DokanDbgPrintW(L"Dokan Error: CreateThreadpoolWork() has returned "
+                     L"error code %u.\n",
+                     GetLastError());
+      return DOKAN_MOUNT_ERROR;
+    }
+  }
+  if (dokanOptions->Options & DOKAN_OPTION_OVERLAPPED_PULL) {
+    // As many pulls as main pull threads are kept posted, without threads.
+    if (!StartOverlappedPulls(DokanInstance, mainPullThreadCount)) {
+      return DOKAN_MOUNT_ERROR;
+    }
+    mainPullThreadCount = 0;
+  }
+  for (DWORD x = 0; x < mainPullThreadCount; ++x) {
+    PDOKAN_IO_EVENT ioEvent = PopIoEventBuffer(DokanInstance);
+    if (!ioEvent) {
+      DokanDbgPrintW(L"Dokan Error: IoEvent allocation failed.");
+      return DOKAN_MOUNT_ERROR;
+    }
+    QueueIoEvent(ioEvent, allowIpcBatching
+                              ? DispatchBatchIoCallback
+                              : DispatchDedicatedIoCallback);
+  }
+  return DOKAN_SUCCESS;
+}
+
 int DOKANAPI DokanCreateFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
                                    _In_ PDOKAN_OPERATIONS DokanOperations,
                                    _Out_ DOKAN_HANDLE *DokanInstance) {
@@ -729,6 +1575,12 @@ int DOKANAPI DokanCreateFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
 
   dokanInstance->DokanOptions = DokanOptions;
   dokanInstance->DokanOperations = DokanOperations;
+  if (!CreateInstancePools(dokanInstance,
+                           DokanOptions->Options & DOKAN_OPTION_NUMA_POOLS)) {
+    DokanDbgPrint("Dokan Error: Failed to create the mount memory pools.\n");
+    DeleteDokanInstance(dokanInstance);
+    return DOKAN_DRIVER_INSTALL_ERROR;
+  }
   dokanInstance->GlobalDevice =
       CreateFile(DOKAN_GLOBAL_DEVICE_NAME,           // lpFileName
                  0,                                  // dwDesiredAccess
@@ -790,44 +1642,11 @@ int DOKANAPI DokanCreateFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
     return DOKAN_DRIVER_INSTALL_ERROR;
   }
 
-  DWORD_PTR processAffinityMask;
-  DWORD_PTR systemAffinityMask;
-  DWORD mainPullThreadCount = 0;
-  if (GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask,
-                             &systemAffinityMask)) {
-    while (processAffinityMask) {
-      mainPullThreadCount += 1;
-      processAffinityMask >>= 1;
-    }
-  } else {
-    DbgPrintW(L"Dokan Error: GetProcessAffinityMask failed with Error %d\n",
-              GetLastError());
-  }
-  if (DokanOptions->SingleThread) {
-    mainPullThreadCount = 1; // Really not recommanded
-    DokanOptions->Options &= ~DOKAN_OPTION_ALLOW_IPC_BATCHING;
-  } else if (mainPullThreadCount < DOKAN_MAIN_PULL_THREAD_COUNT_MIN) {
-    mainPullThreadCount = DOKAN_MAIN_PULL_THREAD_COUNT_MIN;
-  } else if (mainPullThreadCount > DOKAN_MAIN_PULL_THREAD_COUNT_MAX) {
-    // Thread pool will allocate more threads when pulling batched events
-    DokanOptions->Options |= DOKAN_OPTION_ALLOW_IPC_BATCHING;
-    mainPullThreadCount = DOKAN_MAIN_PULL_THREAD_COUNT_MAX;
-  }
-  BOOLEAN allowIpcBatching =
-      (BOOLEAN)(DokanOptions->Options & DOKAN_OPTION_ALLOW_IPC_BATCHING);
-  DbgPrintW(L"Dokan: Using %d main pull threads with ipc batching: %d\n",
-            mainPullThreadCount, allowIpcBatching);
-  for (DWORD x = 0; x < mainPullThreadCount; ++x) {
-    PDOKAN_IO_EVENT ioEvent = PopIoEventBuffer();
-    if (!ioEvent) {
-      DokanDbgPrintW(L"Dokan Error: IoEvent allocation failed.");
-      DeleteDokanInstance(dokanInstance);
-      return DOKAN_MOUNT_ERROR;
-    }
-    ioEvent->DokanInstance = dokanInstance;
-    QueueIoEvent(ioEvent, allowIpcBatching
-                              ? DispatchBatchIoCallback
-                              : DispatchDedicatedIoCallback);
+  result = StartEventDispatch(dokanInstance);
+  if (result != DOKAN_SUCCESS) {
+    SendReleaseIRP(dokanInstance->DeviceName);
+    DeleteDokanInstance(dokanInstance);
+    return result;
   }
 
   if (!DokanMount(dokanInstance, DokanOptions)) {
@@ -883,6 +1702,74 @@ int DOKANAPI DokanCreateFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
   return DOKAN_SUCCESS;
 }
 
+int DOKANAPI DokanCreateMemoryFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
+                                         _In_ PDOKAN_OPERATIONS DokanOperations,
+                                         _Out_ DOKAN_HANDLE *DokanInstance) {
+  PDOKAN_INSTANCE dokanInstance;
+
+  if (DokanInstance) {
+    *DokanInstance = NULL;
+  }
+
+  if (InterlockedAdd(&g_DokanInitialized, 0) <= 0) {
+    RaiseException(DOKAN_EXCEPTION_NOT_INITIALIZED, 0, 0, NULL);
+  }
+
+  g_DebugMode = DokanOptions->Options & DOKAN_OPTION_DEBUG;
+  g_UseStdErr = DokanOptions->Options & DOKAN_OPTION_STDERR;
+  if (g_UseStdErr) {
+    g_DebugMode = TRUE;
+  }
+
+  if (DokanOptions->Version < DOKAN_MINIMUM_COMPATIBLE_VERSION) {
+    DokanDbgPrintW(
+        L"Dokan Error: Incompatible version (%d), minimum is (%d) \n",
+        DokanOptions->Version, DOKAN_MINIMUM_COMPATIBLE_VERSION);
+    return DOKAN_VERSION_ERROR;
+  }
+
+  CheckAllocationUnitSectorSize(DokanOptions);
+  dokanInstance = NewDokanInstance();
+  if (!dokanInstance) {
+    return DOKAN_MOUNT_ERROR;
+  }
+
+  dokanInstance->DokanOptions = DokanOptions;
+  dokanInstance->DokanOperations = DokanOperations;
+  if (!CreateInstancePools(dokanInstance,
+                           DokanOptions->Options & DOKAN_OPTION_NUMA_POOLS) ||
+      !CreateMemoryTransport(dokanInstance)) {
+    DokanDbgPrint("Dokan Error: Failed to create the memory transport.\n");
+    DeleteDokanInstance(dokanInstance);
+    return DOKAN_MOUNT_ERROR;
+  }
+  if (DokanOptions->MountPoint != NULL) {
+    wcscpy_s(dokanInstance->MountPoint,
+             sizeof(dokanInstance->MountPoint) / sizeof(WCHAR),
+             DokanOptions->MountPoint);
+  }
+
+  int result = StartEventDispatch(dokanInstance);
+  if (result != DOKAN_SUCCESS) {
+    dokanInstance->Transport->Release(dokanInstance);
+    DeleteDokanInstance(dokanInstance);
+    return result;
+  }
+
+  if (DokanOperations->Mounted) {
+    DOKAN_FILE_INFO fileInfo;
+    RtlZeroMemory(&fileInfo, sizeof(DOKAN_FILE_INFO));
+    fileInfo.DokanOptions = DokanOptions;
+    // Ignore return value
+    DokanOperations->Mounted(dokanInstance->MountPoint, &fileInfo);
+  }
+
+  if (DokanInstance) {
+    *DokanInstance = dokanInstance;
+  }
+  return DOKAN_SUCCESS;
+}
+
 VOID GetRawDeviceName(LPCWSTR DeviceName, LPWSTR DestinationBuffer,
                       rsize_t DestinationBufferSizeInElements) {
   if (DeviceName && DestinationBuffer && DestinationBufferSizeInElements > 0) {
@@ -900,6 +1787,7 @@ VOID ALIGN_ALLOCATION_SIZE(PLARGE_INTEGER size, PDOKAN_OPTIONS DokanOptions) {
 VOID EventCompletion(PDOKAN_IO_EVENT IoEvent) {
   assert(IoEvent->EventResult);
   ReleaseDokanOpenInfo(IoEvent);
+  CompletePendingDispatch(IoEvent);
 }
 
 VOID CheckFileName(LPWSTR FileName) {
@@ -928,51 +1816,42 @@ ULONG DispatchGetEventInformationLength(ULONG bufferSize) {
              FIELD_OFFSET(EVENT_INFORMATION, Buffer[0]) + bufferSize);
 }
 
-VOID CreateDispatchCommon(PDOKAN_IO_EVENT IoEvent, ULONG SizeOfEventInfo, BOOL UseExtraMemoryPool, BOOL ClearNonPoolBuffer) {
+VOID CreateDispatchCommon(PDOKAN_IO_EVENT IoEvent, ULONG SizeOfEventInfo, BOOL UseExtraMemoryPool, BOOL ClearBuffer) {
   assert(IoEvent != NULL);
   assert(IoEvent->EventResult == NULL && IoEvent->EventResultSize == 0);
 
-  if (SizeOfEventInfo <= DOKAN_EVENT_INFO_DEFAULT_BUFFER_SIZE) {
-    IoEvent->EventResult = PopEventResult();
-    IoEvent->EventResultSize = DOKAN_EVENT_INFO_DEFAULT_SIZE;
-    IoEvent->PoolAllocated = TRUE;
-  } else {
-    if (UseExtraMemoryPool) {
-      if (SizeOfEventInfo <= (16 * 1024)) {
-        IoEvent->EventResult = Pop16KEventResult();
-        IoEvent->EventResultSize = DOKAN_EVENT_INFO_16K_SIZE;
-        IoEvent->PoolAllocated = TRUE;
-      } else if (SizeOfEventInfo <= (32 * 1024)) {
-        IoEvent->EventResult = Pop32KEventResult();
-        IoEvent->EventResultSize = DOKAN_EVENT_INFO_32K_SIZE;
-        IoEvent->PoolAllocated = TRUE;
-      } else if (SizeOfEventInfo <= (64 * 1024)) {
-        IoEvent->EventResult = Pop64KEventResult();
-        IoEvent->EventResultSize = DOKAN_EVENT_INFO_64K_SIZE;
-        IoEvent->PoolAllocated = TRUE;
-      } else if (SizeOfEventInfo <= (128 * 1024)) {
-        IoEvent->EventResult = Pop128KEventResult();
-        IoEvent->EventResultSize = DOKAN_EVENT_INFO_128K_SIZE;
-        IoEvent->PoolAllocated = TRUE;
-      }
-    }
-    if (IoEvent->EventResult == NULL) {
-      IoEvent->EventResultSize =
-          DispatchGetEventInformationLength(SizeOfEventInfo);
-      IoEvent->EventResult =
-          (PEVENT_INFORMATION)malloc(IoEvent->EventResultSize);
-      if (!IoEvent->EventResult) {
-        return;
-      }
-      ZeroMemory(IoEvent->EventResult,
-                 ClearNonPoolBuffer
-                     ? IoEvent->EventResultSize
-                     : FIELD_OFFSET(EVENT_INFORMATION, Buffer[0]));
+  // Results above DOKAN_EVENT_RESULT_MAX_POOLED_BUFFER_SIZE can only come
+  // from the large buffer pool, or from the heap when it is full.
+  if (SizeOfEventInfo <= DOKAN_EVENT_INFO_DEFAULT_BUFFER_SIZE ||
+      (UseExtraMemoryPool &&
+       (SizeOfEventInfo <= DOKAN_EVENT_RESULT_MAX_POOLED_BUFFER_SIZE ||
+        IoEvent->DokanInstance->LargeBufferPool))) {
+    IoEvent->EventResult =
+        PopEventResult(IoEvent->DokanInstance, SizeOfEventInfo,
+                       &IoEvent->EventResultSize);
+    IoEvent->PoolAllocated = IoEvent->EventResult != NULL;
+  }
+  if (IoEvent->EventResult == NULL) {
+    IoEvent->EventResultSize =
+        DispatchGetEventInformationLength(SizeOfEventInfo);
+    IoEvent->EventResult =
+        (PEVENT_INFORMATION)malloc(IoEvent->EventResultSize);
+    if (!IoEvent->EventResult) {
+      return;
     }
+    ZeroMemory(IoEvent->EventResult,
+               FIELD_OFFSET(EVENT_INFORMATION, Buffer[0]));
+    POOL_POISON_BUFFER(IoEvent->EventResult->Buffer,
+                       IOEVENT_RESULT_BUFFER_SIZE(IoEvent));
   }
   assert(IoEvent->EventResult &&
          IoEvent->EventResultSize >=
              DispatchGetEventInformationLength(SizeOfEventInfo));
+  // Only the requested part of the buffer is cleared, most replies only use
+  // the header.
+  if (ClearBuffer && SizeOfEventInfo) {
+    ZeroMemory(IoEvent->EventResult->Buffer, SizeOfEventInfo);
+  }
 
   IoEvent->EventResult->SerialNumber = IoEvent->EventContext->SerialNumber;
   IoEvent->EventResult->Context = IoEvent->EventContext->Context;
@@ -982,6 +1861,7 @@ VOID ReleaseDokanOpenInfo(PDOKAN_IO_EVENT IoEvent) {
   if (!IoEvent->DokanOpenInfo) {
     return;
   }
+  EndOrderedDispatch(IoEvent);
   EnterCriticalSection(&IoEvent->DokanOpenInfo->CriticalSection);
   IoEvent->DokanOpenInfo->UserContext = IoEvent->DokanFileInfo.Context;
   IoEvent->DokanOpenInfo->OpenCount--;
@@ -1134,6 +2014,12 @@ int DokanStart(_In_ PDOKAN_INSTANCE DokanInstance) {
   if (DokanInstance->DokanOptions->Options & DOKAN_OPTION_ALLOW_IPC_BATCHING) {
     eventStart->Flags |= DOKAN_EVENT_ALLOW_IPC_BATCHING;
   }
+  // DokanMain only pulls synchronously in single thread mode.
+  if ((DokanInstance->DokanOptions->Options & DOKAN_OPTION_OVERLAPPED_PULL) &&
+      !DokanInstance->DokanOptions->SingleThread) {
+    eventStart->Flags |=
+        DOKAN_EVENT_OVERLAPPED_PULL | DOKAN_EVENT_ALLOW_IPC_BATCHING;
+  }
   if (driverLetter && mountManager &&
       !CheckDriveLetterAvailability(DokanInstance->MountPoint[0])) {
     eventStart->Flags |= DOKAN_EVENT_DRIVE_LETTER_IN_USE;
@@ -1323,6 +2209,9 @@ BOOL WINAPI DllMain(HINSTANCE Instance, DWORD Reason, LPVOID Reserved) {
   } break;
   case DLL_PROCESS_DETACH: {
 
+  } break;
+  case DLL_THREAD_DETACH: {
+    ReleaseTimelineRing();
   } break;
   default:
     break;
@@ -1442,6 +2331,7 @@ VOID DOKANAPI DokanInit() {
                                               0x80000400);
 
   InitializeListHead(&g_InstanceList);
+  InitializeTimeline();
   EnterCriticalSection(&g_InstanceCriticalSection);
   { InitializePool(); }
   LeaveCriticalSection(&g_InstanceCriticalSection);
@@ -1470,13 +2360,14 @@ VOID DOKANAPI DokanShutdown() {
   }
   LeaveCriticalSection(&g_InstanceCriticalSection);
   DeleteCriticalSection(&g_InstanceCriticalSection);
+  CleanupTimeline();
 }
 
 BOOL DOKANAPI DokanNotifyPath(_In_ DOKAN_HANDLE DokanInstance,
                               _In_ LPCWSTR FilePath,
                               _In_ ULONG CompletionFilter, _In_ ULONG Action) {
   DOKAN_INSTANCE *instance = (DOKAN_INSTANCE *)DokanInstance;
-  if (FilePath == NULL || !instance || !instance->NotifyHandle) {
+  if (FilePath == NULL || !instance) {
     return FALSE;
   }
   size_t length = wcslen(FilePath);
@@ -1484,9 +2375,13 @@ BOOL DOKANAPI DokanNotifyPath(_In_ DOKAN_HANDLE DokanInstance,
   if (length <= prefixSize) {
     return FALSE;
   }
+  // The shared listings are dropped even if the driver cannot be notified.
+  InvalidateDirectoryCache(instance, FilePath + prefixSize);
+  if (!instance->NotifyHandle) {
+    return FALSE;
+  }
   // remove the mount letter and colon from length, for example: "G:"
   length -= prefixSize;
-  ULONG returnedLength;
   ULONG inputLength = (ULONG)(sizeof(DOKAN_NOTIFY_PATH_INTERMEDIATE) +
                               (length * sizeof(WCHAR)));
   PDOKAN_NOTIFY_PATH_INTERMEDIATE pNotifyPath = malloc(inputLength);
@@ -1499,8 +2394,7 @@ BOOL DOKANAPI DokanNotifyPath(_In_ DOKAN_HANDLE DokanInstance,
   pNotifyPath->Action = Action;
   pNotifyPath->Length = (USHORT)(length * sizeof(WCHAR));
   CopyMemory(pNotifyPath->Buffer, FilePath + prefixSize, pNotifyPath->Length);
-  if (!DeviceIoControl(instance->NotifyHandle, FSCTL_NOTIFY_PATH, pNotifyPath,
-                       inputLength, NULL, 0, &returnedLength, NULL)) {
+  if (instance->Transport->NotifyPath(instance, pNotifyPath, inputLength)) {
     DbgPrint("Failed to send notify path command:%ws\n", FilePath);
     free(pNotifyPath);
     return FALSE;
@@ -127,10 +127,125 @@ extern "C" {
 #define DOKAN_OPTION_DISPATCH_DRIVER_LOGS (1 << 11)
 /**
  * Pull batches of events from the driver instead of a single one and execute them parallelly.
+ * Small results of events completed without pulling again are also gathered and sent together.
  * This option should only be used on computers with low cpu count
  * and userland filesystem taking time to process requests (like remote storage).
  */
 #define DOKAN_OPTION_ALLOW_IPC_BATCHING (1 << 12)
+/**
+ * Keep one set of memory pools per NUMA node for the mount and allocate large
+ * buffers on the node of the thread using them.
+ * Only useful on multi-socket computers running a busy filesystem.
+ */
+#define DOKAN_OPTION_NUMA_POOLS (1 << 13)
+/**
+ * Use \ref DOKAN_OPTIONS.DispatchLaneWeights instead of the default weights
+ * to share the threads between the dispatch lanes.
+ * Only used with \ref DOKAN_OPTION_ALLOW_IPC_BATCHING.
+ */
+#define DOKAN_OPTION_DISPATCH_LANE_WEIGHTS (1 << 14)
+/**
+ * Dispatch the events of a same opened handle one at a time, in the order they
+ * are received, while events of different handles are still processed in parallel.
+ * This removes the need for the filesystem to lock its file context in every callback
+ * without serializing the whole volume like \ref DOKAN_OPTIONS.SingleThread.
+ * ZwCreateFile is not ordered as the handle does not exist yet.
+ * Enables \ref DOKAN_OPTION_ALLOW_IPC_BATCHING. Ignored in single thread mode where all events are already ordered.
+ */
+#define DOKAN_OPTION_ORDERED_FILE_DISPATCH (1 << 15)
+/**
+ * Use the thread bounds of \ref DOKAN_OPTIONS instead of the defaults for the
+ * adaptive number of pulling and dispatching threads.
+ * Only used with \ref DOKAN_OPTION_ALLOW_IPC_BATCHING.
+ * \see DokanGetDispatchStatistics
+ */
+#define DOKAN_OPTION_DISPATCH_THREAD_BOUNDS (1 << 16)
+/**
+ * Allow the \ref DOKAN_OPERATIONS callbacks returning a \c NTSTATUS to return \c STATUS_PENDING
+ * and complete the operation later, from any thread, with the matching DokanEndDispatch function.
+ * \ref DOKAN_FILE_INFO.AsyncDispatch tells whether the current call can be completed this way.
+ * Cleanup and CloseFile are always synchronous.
+ * \see DokanEndDispatch
+ */
+#define DOKAN_OPTION_ASYNC_DISPATCH (1 << 17)
+/**
+ * Keep overlapped event pulls posted on the device and dispatch the events from the thread pool I/O completion
+ * callbacks, instead of parking pulling threads in the driver. The number of outstanding pulls no longer depends
+ * on the number of threads. Enables \ref DOKAN_OPTION_ALLOW_IPC_BATCHING. Ignored with \ref DOKAN_OPTIONS.SingleThread.
+ */
+#define DOKAN_OPTION_OVERLAPPED_PULL (1 << 18)
+/**
+ * Record when each event is pulled, queued, dispatched and replied in per-thread ring buffers, to be
+ * written as a Chrome trace with \ref DokanWriteEventTimeline.
+ */
+#define DOKAN_OPTION_EVENT_TIMELINE (1 << 19)
+/**
+ * Limit the events of each requesting process dispatched at once and per second with
+ * \ref DOKAN_OPTIONS.ProcessMaxInFlight and \ref DOKAN_OPTIONS.ProcessEventRate so that a process
+ * flooding the volume does not starve the others. Events over the limits wait in a queue per process
+ * and the waiting processes are served in round robin. Close events are never delayed.
+ * Enables \ref DOKAN_OPTION_ALLOW_IPC_BATCHING. Ignored in single thread mode.
+ * \see DokanGetProcessAdmissionStatistics
+ */
+#define DOKAN_OPTION_PROCESS_ADMISSION (1 << 20)
+/**
+ * Back the large buffer pool of \ref DOKAN_OPTION_LARGE_BUFFER_POOL with large pages, committed at once
+ * when the mount is created. The account running the file system needs the "Lock pages in memory"
+ * privilege, regular pages are used otherwise. Ignored without \ref DOKAN_OPTION_LARGE_BUFFER_POOL.
+ * \see DOKAN_OPTIONS.LargeBufferPoolSize
+ */
+#define DOKAN_OPTION_LARGE_PAGE_BUFFERS (1 << 21)
+/**
+ * Share the complete listing of a directory between all its opens for \ref DOKAN_OPTIONS.DirectoryCacheTimeout,
+ * instead of calling FindFiles for each open. A listing is dropped when a create, delete or rename is dispatched
+ * in the directory or notified with \ref DokanNotifyCreate, \ref DokanNotifyDelete, \ref DokanNotifyRename or
+ * \ref DokanNotifyUpdate. Other changes, like writes, show once the listing expires. Listings of
+ * \ref DOKAN_OPERATIONS.FindFilesPage and searches with a pattern are not shared.
+ */
+#define DOKAN_OPTION_DIRECTORY_CACHE (1 << 22)
+/**
+ * Call \ref DOKAN_OPERATIONS.ReadFileBuffer. The callback is only read with this flag, since the
+ * \ref DOKAN_OPERATIONS of a FileSystem built against older headers ends before it.
+ */
+#define DOKAN_OPTION_READ_FILE_BUFFER (1 << 23)
+/**
+ * Carve the buffers of the reads and writes above 128 KiB from a region of
+ * \ref DOKAN_OPTIONS.LargeBufferPoolSize bytes reserved for the mount, instead of the pools of the
+ * buffers up to 1 MiB and the heap. The region is committed and its pages faulted in when the mount is created.
+ * \see DokanGetLargeBufferPoolStatistics
+ */
+#define DOKAN_OPTION_LARGE_BUFFER_POOL (1 << 24)
+/**
+ * Call \ref DOKAN_OPERATIONS.FindFilesPage. The callback is only read with this flag, since the
+ * \ref DOKAN_OPERATIONS of a FileSystem built against older headers ends before it.
+ */
+#define DOKAN_OPTION_FIND_FILES_PAGE (1 << 25)
+
+/** @} */
+
+/**
+ * \defgroup DOKAN_DISPATCH_LANE DOKAN_DISPATCH_LANE
+ * \brief Dispatch lanes of the batched events.
+ *
+ * With \ref DOKAN_OPTION_ALLOW_IPC_BATCHING, the events waiting for a thread
+ * are queued in a lane depending on their type. Threads pick the lanes in
+ * weighted round robin so that metadata operations are not stuck behind large
+ * reads and writes.
+ * \see DOKAN_OPTIONS.DispatchLaneWeights
+ */
+/** @{ */
+
+/** Create, Cleanup, Close, information, directory, volume and security events */
+#define DOKAN_DISPATCH_LANE_METADATA 0
+/** Read, Write, FlushBuffers and LockControl events */
+#define DOKAN_DISPATCH_LANE_DATA 1
+/** Number of dispatch lanes */
+#define DOKAN_DISPATCH_LANE_COUNT 2
+
+/** Default weight of \ref DOKAN_DISPATCH_LANE_METADATA */
+#define DOKAN_DEFAULT_METADATA_LANE_WEIGHT 4
+/** Default weight of \ref DOKAN_DISPATCH_LANE_DATA */
+#define DOKAN_DEFAULT_DATA_LANE_WEIGHT 1
 
 /** @} */
 
@@ -172,6 +287,51 @@ typedef struct _DOKAN_OPTIONS {
   ULONG VolumeSecurityDescriptorLength;
   /** Optional Volume Security descriptor. See <a href="https://docs.microsoft.com/en-us/windows/win32/api/securitybaseapi/nf-securitybaseapi-initializesecuritydescriptor">InitializeSecurityDescriptor</a> */
   CHAR VolumeSecurityDescriptor[VOLUME_SECURITY_DESCRIPTOR_MAX_SIZE];
+  /**
+   * Number of events each \ref DOKAN_DISPATCH_LANE dispatches per scheduling round when other lanes have events waiting.
+   * Only read with \ref DOKAN_OPTION_DISPATCH_LANE_WEIGHTS. A weight of 0 is replaced by the lane default weight.
+   */
+  ULONG DispatchLaneWeights[DOKAN_DISPATCH_LANE_COUNT];
+  /**
+   * Bounds of the number of pool threads allowed to pull new events at once, in addition to the main pull threads.
+   * Only read with \ref DOKAN_OPTION_DISPATCH_THREAD_BOUNDS. A maximum of 0 is replaced by the default bound.
+   */
+  ULONG MinPullThreads;
+  ULONG MaxPullThreads;
+  /**
+   * Bounds of the number of batched events dispatched at once.
+   * Only read with \ref DOKAN_OPTION_DISPATCH_THREAD_BOUNDS. A maximum of 0 is replaced by the default bound.
+   */
+  ULONG MinWorkerThreads;
+  ULONG MaxWorkerThreads;
+  /**
+   * Number of events of a same process dispatched at once.
+   * Only read with \ref DOKAN_OPTION_PROCESS_ADMISSION. A limit of 0 disables it.
+   */
+  ULONG ProcessMaxInFlight;
+  /**
+   * Number of events of a same process admitted per second, and at once after an idle period.
+   * Only read with \ref DOKAN_OPTION_PROCESS_ADMISSION. A rate of 0 disables it, a burst of 0 is the rate.
+   */
+  ULONG ProcessEventRate;
+  ULONG ProcessEventBurst;
+  /**
+   * Size in bytes of the memory reserved at mount for the buffers of the reads and writes above
+   * 128 KiB. Buffers not fitting in it come from the pools of the buffers up to 1 MiB or from the heap.
+   * 0 uses the default of 16 MiB. Only read with \ref DOKAN_OPTION_LARGE_BUFFER_POOL.
+   * \see DokanGetLargeBufferPoolStatistics
+   */
+  ULONG LargeBufferPoolSize;
+  /**
+   * Time in milliseconds a directory listing is shared. 0 uses the default of 2 seconds.
+   * Only read with \ref DOKAN_OPTION_DIRECTORY_CACHE.
+   */
+  ULONG DirectoryCacheTimeout;
+  /**
+   * Size in bytes of the memory the shared directory listings can use, the least recently used being dropped
+   * first. 0 uses the default of 8 MiB. Only read with \ref DOKAN_OPTION_DIRECTORY_CACHE.
+   */
+  ULONG DirectoryCacheSize;
 } DOKAN_OPTIONS, *PDOKAN_OPTIONS;
 
 /**
@@ -220,6 +380,12 @@ typedef struct _DOKAN_FILE_INFO {
   UCHAR Nocache;
   /**  If \c TRUE, write to the current end of file instead of using the Offset parameter. */
   UCHAR WriteToEndOfFile;
+  /**
+   * If \c TRUE, the callback can return \c STATUS_PENDING and later complete the operation
+   * with its DokanEndDispatch function. Only set with \ref DOKAN_OPTION_ASYNC_DISPATCH.
+   * \see DokanEndDispatch
+   */
+  UCHAR AsyncDispatch;
 } DOKAN_FILE_INFO, *PDOKAN_FILE_INFO;
 
 #define DOKAN_EXCEPTION_NOT_INITIALIZED 0x0f0ff0ff
@@ -238,6 +404,21 @@ typedef int(WINAPI *PFillFindData)(PWIN32_FIND_DATAW, PDOKAN_FILE_INFO);
  */
 typedef BOOL(WINAPI *PFillFindStreamData)(PWIN32_FIND_STREAM_DATA, PVOID);
 
+/**
+ * \struct DOKAN_READ_BUFFER
+ * \brief Data of a read lent by the FileSystem
+ * \see DOKAN_OPERATIONS.ReadFileBuffer
+ */
+typedef struct _DOKAN_READ_BUFFER {
+  /** Data read. It must stay valid until Release is called. */
+  LPCVOID Buffer;
+  /** Number of bytes of Buffer read. 0 at the end of the file. */
+  DWORD Length;
+  /** Optional callback called with ReleaseContext once Buffer is no longer used. */
+  VOID(WINAPI *Release)(PVOID ReleaseContext);
+  PVOID ReleaseContext;
+} DOKAN_READ_BUFFER, *PDOKAN_READ_BUFFER;
+
 // clang-format off
 
 /**
@@ -411,8 +592,8 @@ typedef struct _DOKAN_OPERATIONS {
   * \brief FindFiles Dokan API callback
   *
   * List all files in the requested path.
-  * \ref DOKAN_OPERATIONS.FindFilesWithPattern is checked first. If it is not implemented or
-  * returns \c STATUS_NOT_IMPLEMENTED, then FindFiles is called, if assigned.
+  * \ref DOKAN_OPERATIONS.FindFilesPage and then \ref DOKAN_OPERATIONS.FindFilesWithPattern are checked first.
+  * If they are not implemented or return \c STATUS_NOT_IMPLEMENTED, then FindFiles is called, if assigned.
   * It is recommended to have this implemented for performance reason.
   *
   * \param FileName File path requested by the Kernel on the FileSystem.
@@ -777,10 +958,252 @@ typedef struct _DOKAN_OPERATIONS {
     PVOID FindStreamContext,
     PDOKAN_FILE_INFO DokanFileInfo);
 
+  /**
+  * \brief ReadFileBuffer Dokan API callback
+  *
+  * Same as DOKAN_OPERATIONS.ReadFile for a FileSystem already holding the data in memory, like a cache
+  * block or a mapped view. Instead of filling a buffer, the callback lends its memory in \c ReadBuffer and
+  * the library copies it once, straight into a reply sized to the data read, before releasing it.
+  * When set, it is called instead of DOKAN_OPERATIONS.ReadFile, which is still called if it returns
+  * \c STATUS_NOT_IMPLEMENTED, for example on a cache miss.
+  * Only read with \ref DOKAN_OPTION_READ_FILE_BUFFER.
+  *
+  * \param FileName File path requested by the Kernel on the FileSystem.
+  * \param BufferLength Read size requested. \ref DOKAN_READ_BUFFER.Length must not be larger.
+  * \param Offset Offset from where the read has to be continued.
+  * \param ReadBuffer Receives the data read. Its release callback is called even if the read fails, unless \c STATUS_NOT_IMPLEMENTED is returned.
+  * \param DokanFileInfo Information about the file or directory.
+  * \return \c STATUS_SUCCESS on success or NTSTATUS appropriate to the request result.
+  * \see DokanEndDispatchReadBuffer
+  */
+  NTSTATUS(DOKAN_CALLBACK *ReadFileBuffer)(LPCWSTR FileName,
+    DWORD BufferLength,
+    LONGLONG Offset,
+    PDOKAN_READ_BUFFER ReadBuffer,
+    PDOKAN_FILE_INFO DokanFileInfo);
+
+  /**
+  * \brief FindFilesPage Dokan API callback
+  *
+  * Same as \ref DOKAN_OPERATIONS.FindFiles for a FileSystem that lists a directory in pages, like a remote
+  * store. Each call adds the next entries with \c FillFindData and sets \c Continuation to where the
+  * listing goes on. The library replies to the Kernel as soon as it holds enough entries and only asks for
+  * the next page when a later request reaches the end of the ones listed so far.
+  * When set, it is called before DOKAN_OPERATIONS.FindFilesWithPattern and DOKAN_OPERATIONS.FindFiles,
+  * which are still called if the first page returns \c STATUS_NOT_IMPLEMENTED.
+  * Only read with \ref DOKAN_OPTION_FIND_FILES_PAGE.
+  *
+  * The entries are always filtered with the search pattern by the library. A page must add at least one
+  * entry unless it ends the listing. State kept for the listing, like a backend cursor, can be referenced by
+  * \c Continuation and released in \ref DOKAN_OPERATIONS.Cleanup, since a listing may not be read to its end.
+  * Pages are requested synchronously: \ref DOKAN_FILE_INFO.AsyncDispatch is not set.
+  *
+  * \param PathName Path requested by the Kernel on the FileSystem.
+  * \param SearchPattern Search pattern, that can be used to skip the entries that cannot match.
+  * \param Continuation 0 for the first page of a listing. Receives a nonzero value to be called again for the next page, or 0 once all the entries were added.
+  * \param FillFindData Callback that has to be called with PWIN32_FIND_DATAW that contains file information.
+  * \param DokanFileInfo Information about the file or directory.
+  * \return \c STATUS_SUCCESS on success or NTSTATUS appropriate to the request result.
+  * \see FindFiles
+  */
+  NTSTATUS(DOKAN_CALLBACK *FindFilesPage)(LPCWSTR PathName,
+    LPCWSTR SearchPattern,
+    PULONG64 Continuation,
+    PFillFindData FillFindData,
+    PDOKAN_FILE_INFO DokanFileInfo);
+
 } DOKAN_OPERATIONS, *PDOKAN_OPERATIONS;
 
 // clang-format on
 
+/**
+ * \struct DOKAN_POOL_STATISTICS
+ * \brief Usage counters of one of the Dokan library internal memory pools.
+ * \see DokanGetPoolStatistics
+ */
+typedef struct _DOKAN_POOL_STATISTICS {
+  /** Name of the pool. Static string owned by the library. */
+  LPCWSTR Name;
+  /** Size in bytes of the objects of the pool. */
+  ULONG64 ObjectSize;
+  /** Number of allocations served from the pool. */
+  ULONG64 Hits;
+  /** Number of allocations that fell back to the heap. */
+  ULONG64 Misses;
+  /** Number of released objects freed because the pool was full. */
+  ULONG64 DroppedPushes;
+  /** Highest number of objects allocated at once, cached or in use. */
+  ULONG64 HighWaterObjects;
+  /** Number of objects currently in use. */
+  ULONG64 ObjectsOutstanding;
+  /** Number of bytes currently in use. */
+  ULONG64 BytesOutstanding;
+} DOKAN_POOL_STATISTICS, *PDOKAN_POOL_STATISTICS;
+
+/**
+ * \struct DOKAN_DISPATCH_STATISTICS
+ * \brief State and last decisions of the controller adapting the number of
+ * threads of a mount to its load.
+ * \see DokanGetDispatchStatistics
+ */
+typedef struct _DOKAN_DISPATCH_STATISTICS {
+  /** Number of pool threads allowed to pull new events at once. */
+  ULONG PullerLimit;
+  /** Number of pool threads pulling new events, main pull threads excluded. */
+  ULONG ActivePullers;
+  /** Number of batched events allowed to be dispatched at once. */
+  ULONG WorkerLimit;
+  /** Number of batched events being dispatched. */
+  ULONG ActiveWorkers;
+  /** Number of batched events waiting for a thread. */
+  ULONG QueuedEvents;
+  /** Number of pulls completed during the last interval. */
+  ULONG64 Pulls;
+  /** Number of pulls of the last interval that returned no event. */
+  ULONG64 EmptyPulls;
+  /** Number of events pulled during the last interval. */
+  ULONG64 PulledEvents;
+  /** Average time spent dispatching an event during the last interval, in microseconds. */
+  ULONG64 AverageDispatchTimeUs;
+  /** Number of times PullerLimit was raised since the mount. */
+  ULONG PullerLimitIncreases;
+  /** Number of times PullerLimit was lowered since the mount. */
+  ULONG PullerLimitDecreases;
+  /** Number of times WorkerLimit was raised since the mount. */
+  ULONG WorkerLimitIncreases;
+  /** Number of times WorkerLimit was lowered since the mount. */
+  ULONG WorkerLimitDecreases;
+} DOKAN_DISPATCH_STATISTICS, *PDOKAN_DISPATCH_STATISTICS;
+
+/**
+ * \struct DOKAN_PROCESS_ADMISSION_STATISTICS
+ * \brief Admission counters of the events of a requesting process.
+ * \see DokanGetProcessAdmissionStatistics
+ */
+typedef struct _DOKAN_PROCESS_ADMISSION_STATISTICS {
+  /** Id of the process that sent the events. */
+  ULONG ProcessId;
+  /** Number of admitted events not completed yet. */
+  ULONG InFlightEvents;
+  /** Number of events waiting to be admitted. */
+  ULONG WaitingEvents;
+  /** Number of events admitted. */
+  ULONG64 AdmittedEvents;
+  /** Number of admitted events that had to wait for the limits of the process. */
+  ULONG64 DelayedEvents;
+} DOKAN_PROCESS_ADMISSION_STATISTICS, *PDOKAN_PROCESS_ADMISSION_STATISTICS;
+
+/**
+ * \struct DOKAN_LARGE_BUFFER_POOL_STATISTICS
+ * \brief Usage of the buffers of the reads and writes above 128 KiB.
+ * \see DokanGetLargeBufferPoolStatistics
+ */
+typedef struct _DOKAN_LARGE_BUFFER_POOL_STATISTICS {
+  /** Size in bytes of the memory reserved for the pool. */
+  ULONG64 PoolSize;
+  /** Size in bytes of the committed part of the pool, all of it since the pool is committed at mount. */
+  ULONG64 CommittedBytes;
+  /** Whether the pool is backed by large pages. */
+  BOOL LargePages;
+  /** Number of buffers taken from the pool. */
+  ULONG64 Allocations;
+  /** Number of buffers taken from the smaller pools or the heap because the pool had no room for them. */
+  ULONG64 Fallbacks;
+  /** Number of bytes of the pool currently lent to buffers. */
+  ULONG64 BytesInUse;
+  /** Highest number of bytes of the pool lent at once. */
+  ULONG64 HighWaterBytes;
+} DOKAN_LARGE_BUFFER_POOL_STATISTICS, *PDOKAN_LARGE_BUFFER_POOL_STATISTICS;
+
+/** Number of IRP major functions, the size of the per major function arrays. */
+#define DOKAN_MAJOR_FUNCTION_COUNT 0x1c
+
+/**
+ * \struct DOKAN_LATENCY_STATISTICS
+ * \brief Time taken by the events of a major function.
+ */
+typedef struct _DOKAN_LATENCY_STATISTICS {
+  /** Number of events measured. */
+  ULONG64 Count;
+  /** Sum of the times of the events, in microseconds. */
+  ULONG64 TotalUs;
+  /** Longest time of an event, in microseconds. */
+  ULONG64 MaxUs;
+} DOKAN_LATENCY_STATISTICS, *PDOKAN_LATENCY_STATISTICS;
+
+/**
+ * \struct DOKAN_MEMORY_TRANSPORT_STATISTICS
+ * \brief Counters of a file system created by \ref DokanCreateMemoryFileSystem.
+ * \see DokanGetMemoryTransportStatistics
+ */
+typedef struct _DOKAN_MEMORY_TRANSPORT_STATISTICS {
+  /** Number of events given to \ref DokanMemoryTransportSubmit. */
+  ULONG64 SubmittedEvents;
+  /** Number of events pulled by the library. */
+  ULONG64 PulledEvents;
+  /** Number of events whose result was received, or pulled for events without result. */
+  ULONG64 CompletedEvents;
+  /** Number of event results received, including the ones of unknown events. */
+  ULONG64 Results;
+  /** Number of pulls asking for new events. */
+  ULONG64 Pulls;
+  /** Number of writes larger than EVENT_CONTEXT_MAX_SIZE fetched apart. */
+  ULONG64 LargeWrites;
+  /** Number of file change notifications sent by the file system. */
+  ULONG64 Notifications;
+  /**
+   * Time from the submission of the events to their completion, indexed by
+   * their IRP major function.
+   */
+  DOKAN_LATENCY_STATISTICS Latency[DOKAN_MAJOR_FUNCTION_COUNT];
+} DOKAN_MEMORY_TRANSPORT_STATISTICS, *PDOKAN_MEMORY_TRANSPORT_STATISTICS;
+
+/** Number of FILE_INFORMATION_CLASS values measured apart by \ref DokanGetOperationStatistics. */
+#define DOKAN_FILE_INFORMATION_CLASS_COUNT 80
+
+/**
+ * Number of buckets of a \ref DOKAN_LATENCY_HISTOGRAM. The first 8 buckets count the times of 0 to 7
+ * microseconds, then each power of two is split in 8 buckets of equal width up to 2^32 microseconds.
+ * \see DokanGetLatencyBucketStart
+ */
+#define DOKAN_LATENCY_HISTOGRAM_BUCKET_COUNT 240
+
+/**
+ * \struct DOKAN_LATENCY_HISTOGRAM
+ * \brief Distribution of the time taken by a stage of the events of an operation.
+ */
+typedef struct _DOKAN_LATENCY_HISTOGRAM {
+  /** Number of events measured. */
+  ULONG64 Count;
+  /** Sum of the times of the events, in microseconds. */
+  ULONG64 TotalUs;
+  /** Longest time of an event, in microseconds. */
+  ULONG64 MaxUs;
+  /** Number of events per range of time, see \ref DokanGetLatencyBucketStart. */
+  ULONG64 Buckets[DOKAN_LATENCY_HISTOGRAM_BUCKET_COUNT];
+} DOKAN_LATENCY_HISTOGRAM, *PDOKAN_LATENCY_HISTOGRAM;
+
+/**
+ * \struct DOKAN_OPERATION_STATISTICS
+ * \brief Time spent by the events of an operation in each stage of their processing.
+ * \see DokanGetOperationStatistics
+ */
+typedef struct _DOKAN_OPERATION_STATISTICS {
+  /** IRP major function of the events. */
+  ULONG MajorFunction;
+  /** FILE_INFORMATION_CLASS of the events for IRP_MJ_QUERY_INFORMATION and IRP_MJ_SET_INFORMATION, 0 otherwise. */
+  ULONG FileInformationClass;
+  /** Time from the pull of the events until their dispatch started. */
+  DOKAN_LATENCY_HISTOGRAM QueueWait;
+  /** Time from the start of the dispatch until the result was ready, the operation callback included. */
+  DOKAN_LATENCY_HISTOGRAM Callback;
+  /**
+   * Time from the result being ready until it was given to the driver. Results sent with a pull
+   * are counted when the pull starts since it only returns with new events.
+   */
+  DOKAN_LATENCY_HISTOGRAM Reply;
+} DOKAN_OPERATION_STATISTICS, *PDOKAN_OPERATION_STATISTICS;
+
 /**
  * \defgroup DokanMainResult DokanMainResult
  * \brief \ref DokanMain \ref DokanCreateFileSystem returns error codes
@@ -1038,6 +1461,184 @@ VOID DOKANAPI DokanMapKernelToUserCreateFileFlags(
     ULONG CreateDisposition, ACCESS_MASK *outDesiredAccess,
     DWORD *outFileAttributesAndFlags, DWORD *outCreationDisposition);
 
+/**
+ * \defgroup DokanEndDispatch Dokan End Dispatch
+ * \brief Dokan asynchronous completion of the filesystem operations
+ *
+ * With \ref DOKAN_OPTION_ASYNC_DISPATCH, a \ref DOKAN_OPERATIONS callback called with
+ * \ref DOKAN_FILE_INFO.AsyncDispatch set can return \c STATUS_PENDING instead of waiting for its backend.
+ * The operation must then be completed exactly once, from any thread, by the DokanEndDispatch
+ * function of the callback with the same \ref DOKAN_FILE_INFO pointer and the final status.
+ * The DOKAN_FILE_INFO can be modified, for example to set \ref DOKAN_FILE_INFO.Context, until then.
+ *
+ * The file names, the ReadFile and GetFileSecurity buffers to fill, the WriteFile buffer and the
+ * FillFindData and FillFindStreamData callbacks with their context stay valid until the operation
+ * is completed. The other pointer parameters, like the output values, are only valid during the
+ * callback call: their values are given to the DokanEndDispatch function instead.
+ * DOKAN_FILE_INFO must not be used after the DokanEndDispatch call.
+ * @{
+ */
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.ZwCreateFile.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback, with \ref DOKAN_FILE_INFO.Context and
+ * \ref DOKAN_FILE_INFO.IsDirectory set like a synchronous call would.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchCreate(PDOKAN_FILE_INFO DokanFileInfo,
+                                     NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.ReadFile.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param ReadLength Number of bytes written to the callback Buffer.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchRead(PDOKAN_FILE_INFO DokanFileInfo,
+                                   DWORD ReadLength, NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.ReadFileBuffer.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param ReadBuffer Data read, released before the function returns. Can be a different
+ * \ref DOKAN_READ_BUFFER than the one given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchReadBuffer(PDOKAN_FILE_INFO DokanFileInfo,
+                                         PDOKAN_READ_BUFFER ReadBuffer,
+                                         NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.WriteFile.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param NumberOfBytesWritten Number of bytes written to the file.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchWrite(PDOKAN_FILE_INFO DokanFileInfo,
+                                    DWORD NumberOfBytesWritten,
+                                    NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.FlushFileBuffers.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchFlush(PDOKAN_FILE_INFO DokanFileInfo,
+                                    NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.GetFileInformation.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param ByHandleFileInfo Information of the file. Only read during the call.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchGetFileInformation(
+    PDOKAN_FILE_INFO DokanFileInfo,
+    PBY_HANDLE_FILE_INFORMATION ByHandleFileInfo, NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.FindFiles or \ref DOKAN_OPERATIONS.FindFilesWithPattern.
+ *
+ * The entries must have been added with the FillFindData callback before this call.
+ * A pending FindFilesWithPattern is not retried with FindFiles when completed with \c STATUS_NOT_IMPLEMENTED.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchFindFiles(PDOKAN_FILE_INFO DokanFileInfo,
+                                        NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.FindStreams.
+ *
+ * The streams must have been added with the FillFindStreamData callback before this call.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchFindStreams(PDOKAN_FILE_INFO DokanFileInfo,
+                                          NTSTATUS Status);
+
+/**
+ * \brief Complete a pending SetFileAttributes, SetFileTime, DeleteFile, DeleteDirectory, MoveFile,
+ * SetEndOfFile or SetAllocationSize of \ref DOKAN_OPERATIONS.
+ *
+ * SetFileAttributes is always called synchronously before SetFileTime, as is GetFileInformation
+ * before DeleteFile and DeleteDirectory.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchSetInformation(PDOKAN_FILE_INFO DokanFileInfo,
+                                             NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.LockFile or \ref DOKAN_OPERATIONS.UnlockFile.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchLock(PDOKAN_FILE_INFO DokanFileInfo,
+                                   NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.GetDiskFreeSpace.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param FreeBytesAvailable Amount of available space.
+ * \param TotalNumberOfBytes Total size of storage space.
+ * \param TotalNumberOfFreeBytes Amount of free space.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchGetDiskFreeSpace(
+    PDOKAN_FILE_INFO DokanFileInfo, ULONGLONG FreeBytesAvailable,
+    ULONGLONG TotalNumberOfBytes, ULONGLONG TotalNumberOfFreeBytes,
+    NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.GetVolumeInformation.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param VolumeName Name of the volume. Only read during the call.
+ * \param VolumeSerialNumber Serial number of the volume.
+ * \param MaximumComponentLength Maximum length of a file name component.
+ * \param FileSystemFlags Flags of the file system.
+ * \param FileSystemName Name of the file system. Only read during the call.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchGetVolumeInformation(
+    PDOKAN_FILE_INFO DokanFileInfo, LPCWSTR VolumeName,
+    DWORD VolumeSerialNumber, DWORD MaximumComponentLength,
+    DWORD FileSystemFlags, LPCWSTR FileSystemName, NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.GetFileSecurity.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param LengthNeeded Length of the security descriptor.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchGetFileSecurity(PDOKAN_FILE_INFO DokanFileInfo,
+                                              ULONG LengthNeeded,
+                                              NTSTATUS Status);
+
+/**
+ * \brief Complete a pending \ref DOKAN_OPERATIONS.SetFileSecurity.
+ *
+ * \param DokanFileInfo \ref DOKAN_FILE_INFO given to the callback.
+ * \param Status Result of the operation.
+ */
+VOID DOKANAPI DokanEndDispatchSetFileSecurity(PDOKAN_FILE_INFO DokanFileInfo,
+                                              NTSTATUS Status);
+
+/**@}*/
+
 /**
  * \defgroup DokanNotify Dokan Notify
  * \brief Dokan User FS file-change notification
@@ -1128,6 +1729,265 @@ BOOL DOKANAPI DokanNotifyRename(_In_ DOKAN_HANDLE DokanInstance,
  */
 NTSTATUS DOKANAPI DokanNtStatusFromWin32(DWORD Error);
 
+/**
+ * \brief Get the usage counters of the Dokan library internal memory pools.
+ *
+ * Each mount owns its pools. The counters returned are the sum of all the
+ * mounts of the process, including the ones already unmounted. The counters
+ * are maintained per thread and summed on read, so they are cheap enough to
+ * be left enabled but values read while operations are processed are
+ * approximate.
+ *
+ * \param Statistics Array of \ref DOKAN_POOL_STATISTICS receiving one entry per pool.
+ * \param Count Number of entries of \c Statistics.
+ * \return The number of pools, which can be greater than \c Count. Only the
+ * first \c Count entries are filled. Returns 0 if no filesystem was mounted since \ref DokanInit.
+ * \see DokanGetInstancePoolStatistics
+ */
+ULONG DOKANAPI DokanGetPoolStatistics(PDOKAN_POOL_STATISTICS Statistics,
+                                      ULONG Count);
+
+/**
+ * \brief Get the usage counters of the memory pools of a single mount.
+ *
+ * Same as \ref DokanGetPoolStatistics but limited to the pools of \c DokanInstance.
+ * With \ref DOKAN_OPTION_NUMA_POOLS the counters of every NUMA node are summed.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param Statistics Array of \ref DOKAN_POOL_STATISTICS receiving one entry per pool.
+ * \param Count Number of entries of \c Statistics.
+ * \return The number of pools, which can be greater than \c Count. Only the
+ * first \c Count entries are filled.
+ */
+ULONG DOKANAPI DokanGetInstancePoolStatistics(_In_ DOKAN_HANDLE DokanInstance,
+                                              PDOKAN_POOL_STATISTICS Statistics,
+                                              ULONG Count);
+
+/**
+ * \brief Get the state of the controller adapting the number of threads of a mount.
+ *
+ * With \ref DOKAN_OPTION_ALLOW_IPC_BATCHING, the number of pool threads pulling new
+ * events and of batched events dispatched at once are adjusted every second
+ * from the number of events pulled and the time spent in the filesystem callbacks.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param Statistics Receives the controller state.
+ * \return \c TRUE on success, \c FALSE if the mount does not use IPC batching.
+ */
+BOOL DOKANAPI DokanGetDispatchStatistics(_In_ DOKAN_HANDLE DokanInstance,
+                                         _Out_ PDOKAN_DISPATCH_STATISTICS Statistics);
+
+/**
+ * \brief Get the admission counters of the processes sending events to a mount.
+ *
+ * Only available with \ref DOKAN_OPTION_PROCESS_ADMISSION. A process is tracked from its first
+ * event. Processes without events in flight or waiting are forgotten, with their counters, once
+ * more than 64 processes are tracked.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param Statistics Array of \ref DOKAN_PROCESS_ADMISSION_STATISTICS receiving one entry per process.
+ * \param Count Number of entries of \c Statistics.
+ * \return The number of processes tracked, which can be greater than \c Count. Only the first
+ * \c Count entries are filled.
+ */
+ULONG DOKANAPI DokanGetProcessAdmissionStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    PDOKAN_PROCESS_ADMISSION_STATISTICS Statistics, ULONG Count);
+
+/**
+ * \brief Get the usage of the pool of buffers of the reads and writes above 128 KiB of a mount.
+ *
+ * A high \ref DOKAN_LARGE_BUFFER_POOL_STATISTICS.Fallbacks count means \ref
+ * DOKAN_OPTIONS.LargeBufferPoolSize is too small for the I/O concurrency of the mount.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param Statistics Receives the usage of the pool.
+ * \return \c TRUE if the statistics were retrieved, \c FALSE if the mount has no large buffer pool
+ * because \ref DOKAN_OPTION_LARGE_BUFFER_POOL is not set.
+ */
+BOOL DOKANAPI DokanGetLargeBufferPoolStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _Out_ PDOKAN_LARGE_BUFFER_POOL_STATISTICS Statistics);
+
+/**
+ * \brief Get the latency histograms of the operations of a mount.
+ *
+ * The histograms are always kept: each event updates them with a few interlocked operations and
+ * without lock. Operations without any event since the mount or the last reset are left out.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param Statistics Array of \ref DOKAN_OPERATION_STATISTICS receiving one entry per operation.
+ * \param Count Number of entries of \c Statistics.
+ * \param Reset Whether to reset the histograms returned. Each counter is reset atomically but the
+ * events completing meanwhile can be counted in either snapshot.
+ * \return The number of operations, which can be greater than \c Count. Only the first \c Count
+ * entries are filled and reset.
+ */
+ULONG DOKANAPI DokanGetOperationStatistics(_In_ DOKAN_HANDLE DokanInstance,
+                                           PDOKAN_OPERATION_STATISTICS Statistics,
+                                           ULONG Count, BOOL Reset);
+
+/**
+ * \brief Get the shortest time counted by a bucket of a \ref DOKAN_LATENCY_HISTOGRAM.
+ *
+ * \param Bucket Index of the bucket, lower than \ref DOKAN_LATENCY_HISTOGRAM_BUCKET_COUNT.
+ * \return The time in microseconds. The bucket counts the times up to the start of the next one.
+ */
+ULONG64 DOKANAPI DokanGetLatencyBucketStart(ULONG Bucket);
+
+/**
+ * \brief Write the last events of a mount as a Chrome trace, to be opened in chrome://tracing or Perfetto.
+ *
+ * Only available with \ref DOKAN_OPTION_EVENT_TIMELINE. Each thread shows its pulls, the events it
+ * dispatched as spans named after their major function and the replies it sent, with arrows from
+ * the thread that queued an event to the one that dispatched it. The last 4096 entries of each
+ * thread are kept.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param FileName Path of the JSON file to write, replaced if it exists.
+ * \return \c TRUE if the file was written.
+ */
+BOOL DOKANAPI DokanWriteEventTimeline(_In_ DOKAN_HANDLE DokanInstance,
+                                      _In_ LPCWSTR FileName);
+
+/**
+ * \brief Create a file system whose events come from the process itself instead of the driver.
+ *
+ * Nothing is mounted and the driver is not needed: the events given to \ref DokanMemoryTransportSubmit
+ * go through the same pools, batching and dispatching as the events of a mounted file system and their
+ * results are counted. This is meant to benchmark the library and the operations, and to run them in
+ * regression tests. Calls made by the operations that need the driver, like \ref DokanOpenRequestorToken,
+ * fail. With \ref DOKAN_OPTION_OVERLAPPED_PULL, the pulls are posted on the memory transport and
+ * completed on the thread pool like the ones posted on the driver.
+ *
+ * The file system is stopped and released with \ref DokanCloseHandle.
+ *
+ * \param DokanOptions a \ref DOKAN_OPTIONS that describe the file system. Only its dispatching options are used.
+ * \param DokanOperations Instance of \ref DOKAN_OPERATIONS that will be called for each event.
+ * \param DokanInstance Dokan file system instance handle.
+ * \return \ref DokanMainResult status.
+ * \see DokanMemoryTransportSubmit
+ */
+int DOKANAPI DokanCreateMemoryFileSystem(_In_ PDOKAN_OPTIONS DokanOptions,
+                                         _In_ PDOKAN_OPERATIONS DokanOperations,
+                                         _Out_ DOKAN_HANDLE *DokanInstance);
+
+/**
+ * \brief Give an event to a file system created by \ref DokanCreateMemoryFileSystem.
+ *
+ * The event is copied and pulled by the library as if the driver had sent it. Its \c SerialNumber
+ * and \c MountId are set by the transport, \c Length must be the size of the whole event. Writes larger
+ * than EVENT_CONTEXT_MAX_SIZE are fetched apart like the driver does.
+ *
+ * Like the driver does for a file object, the transport keeps the open made by a create: a non zero
+ * \c Context identifies the open of the event. The later events with the same \c Context are given the
+ * open once the create succeeded and wait for it until then, and a Close waits for the other events
+ * of its open. Events whose \c Context was not given to a create are dispatched without open.
+ *
+ * \param DokanInstance The file system created by \ref DokanCreateMemoryFileSystem.
+ * \param EventContext The event to dispatch.
+ * \return \c TRUE if the event was queued.
+ */
+BOOL DOKANAPI DokanMemoryTransportSubmit(_In_ DOKAN_HANDLE DokanInstance,
+                                         _In_ PEVENT_CONTEXT EventContext);
+
+/**
+ * \brief Submit events to a memory file system at once.
+ *
+ * Like IRPs arriving together at the driver, the events are queued as one and a pull takes all of them
+ * that fit in its buffer when \ref DOKAN_OPTION_ALLOW_IPC_BATCHING is set. Otherwise the same as
+ * \ref DokanMemoryTransportSubmit for each event, in order.
+ *
+ * \param DokanInstance The file system created by \ref DokanCreateMemoryFileSystem.
+ * \param EventContexts The events to dispatch.
+ * \param Count Number of events in \c EventContexts.
+ * \return \c TRUE if the events were queued, \c FALSE if none was.
+ */
+BOOL DOKANAPI DokanMemoryTransportSubmitBatch(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _In_reads_(Count) PEVENT_CONTEXT *EventContexts, _In_ ULONG Count);
+
+/**
+ * \brief Wait until every event submitted to a memory file system is completed.
+ *
+ * \param DokanInstance The file system created by \ref DokanCreateMemoryFileSystem.
+ * \param Milliseconds Longest time to wait, or \c INFINITE.
+ * \return \c TRUE if no submitted event is waiting to be completed.
+ */
+BOOL DOKANAPI DokanWaitForMemoryTransportIdle(_In_ DOKAN_HANDLE DokanInstance,
+                                              _In_ DWORD Milliseconds);
+
+/**
+ * \brief Get the counters of a file system created by \ref DokanCreateMemoryFileSystem.
+ *
+ * \param DokanInstance The file system created by \ref DokanCreateMemoryFileSystem.
+ * \param Statistics Receives the counters.
+ * \return \c TRUE on success, \c FALSE if the file system was not created in memory.
+ */
+BOOL DOKANAPI DokanGetMemoryTransportStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _Out_ PDOKAN_MEMORY_TRANSPORT_STATISTICS Statistics);
+
+/**
+ * \brief Start recording the events received by a mount in a trace file.
+ *
+ * Every batch of events pulled from the driver is written as is with the time it was received,
+ * followed by the opens made by the successful creates. The data of writes larger than
+ * EVENT_CONTEXT_MAX_SIZE is not recorded. The trace can be replayed with \ref DokanReplayEventTrace.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ * \param FileName Path of the trace file, replaced if it exists.
+ * \return \c TRUE if the trace started, \c FALSE if the file could not be created or a trace is
+ * already recorded.
+ * \see DokanStopEventTrace
+ */
+BOOL DOKANAPI DokanStartEventTrace(_In_ DOKAN_HANDLE DokanInstance,
+                                   _In_ LPCWSTR FileName);
+
+/**
+ * \brief Stop recording the trace started by \ref DokanStartEventTrace and close its file.
+ *
+ * The trace is also stopped when the mount is released.
+ *
+ * \param DokanInstance The dokan mount context created by \ref DokanCreateFileSystem.
+ */
+VOID DOKANAPI DokanStopEventTrace(_In_ DOKAN_HANDLE DokanInstance);
+
+/**
+ * \struct DOKAN_REPLAY_STATISTICS
+ * \brief Result of \ref DokanReplayEventTrace.
+ */
+typedef struct _DOKAN_REPLAY_STATISTICS {
+  /** Number of events submitted. */
+  ULONG64 Events;
+  /** Number of events left out because their open was made before the trace started. */
+  ULONG64 SkippedEvents;
+  /** Time from the first submitted event until every event completed, in microseconds. */
+  ULONG64 ElapsedUs;
+  /** Number of events completed per second. */
+  ULONG64 EventsPerSecond;
+} DOKAN_REPLAY_STATISTICS, *PDOKAN_REPLAY_STATISTICS;
+
+/**
+ * \brief Replay a trace recorded by \ref DokanStartEventTrace on a file system created in memory.
+ *
+ * The events are submitted with \ref DokanMemoryTransportSubmit, either when they were received
+ * during the recording or all at once, and the call returns once all of them completed. Writes
+ * whose data was not recorded are replayed with zeroed data. The time taken by each major function
+ * is then available with \ref DokanGetMemoryTransportStatistics.
+ *
+ * \param DokanInstance The file system created by \ref DokanCreateMemoryFileSystem.
+ * \param FileName Path of the trace file.
+ * \param OriginalSpeed Whether to submit the events at the pace they were recorded instead of as fast
+ * as possible.
+ * \param Statistics Optionally receives the throughput of the replay.
+ * \return \c TRUE if the whole trace was replayed.
+ */
+BOOL DOKANAPI DokanReplayEventTrace(_In_ DOKAN_HANDLE DokanInstance,
+                                    _In_ LPCWSTR FileName,
+                                    _In_ BOOL OriginalSpeed,
+                                    _Out_opt_ PDOKAN_REPLAY_STATISTICS Statistics);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,344 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+#include <stdlib.h>
+
+PLIST_ENTRY GetProcessAdmissionBucket(DOKAN_ADMISSION *Admission,
+                                      ULONG ProcessId) {
+  // Process ids are multiples of 4.
+  return &Admission->Processes[(ProcessId >> 2) % DOKAN_ADMISSION_BUCKET_COUNT];
+}
+
+VOID RefillTokens(DOKAN_ADMISSION *Admission,
+                  DOKAN_PROCESS_ADMISSION *Process, LONG64 Now) {
+  LONG64 capacity = (LONG64)Admission->Burst * Admission->TicksPerSecond;
+  LONG64 elapsed = Now - Process->RefillTime;
+
+  Process->RefillTime = Now;
+  if (!Admission->Rate || elapsed <= 0) {
+    return;
+  }
+  if (elapsed > (capacity - Process->Tokens) / Admission->Rate) {
+    Process->Tokens = capacity;
+  } else {
+    Process->Tokens += elapsed * Admission->Rate;
+  }
+}
+
+BOOL CanAdmitEvent(DOKAN_ADMISSION *Admission,
+                   DOKAN_PROCESS_ADMISSION *Process) {
+  return (!Admission->MaxInFlight ||
+          Process->InFlightEvents < Admission->MaxInFlight) &&
+         (!Admission->Rate || Process->Tokens >= Admission->TicksPerSecond);
+}
+
+VOID AdmitEvent(DOKAN_ADMISSION *Admission, DOKAN_PROCESS_ADMISSION *Process,
+                PDOKAN_IO_EVENT IoEvent) {
+  ++Process->InFlightEvents;
+  if (Admission->Rate) {
+    Process->Tokens -= Admission->TicksPerSecond;
+  }
+  ++Process->AdmittedEvents;
+  IoEvent->ProcessAdmission = Process;
+}
+
+// Returns the ticks until the process has a token, or 0 if it is not waiting
+// for tokens. A process at its in flight limit is admitted again on the
+// completion of one of its events instead.
+LONG64 GetTokenWait(DOKAN_ADMISSION *Admission,
+                    DOKAN_PROCESS_ADMISSION *Process) {
+  if (!Admission->Rate || Process->Tokens >= Admission->TicksPerSecond ||
+      (Admission->MaxInFlight &&
+       Process->InFlightEvents >= Admission->MaxInFlight)) {
+    return 0;
+  }
+  return (Admission->TicksPerSecond - Process->Tokens + Admission->Rate - 1) /
+         Admission->Rate;
+}
+
+// Sets the timer to run Wait ticks from Now unless it already runs earlier.
+VOID ScheduleAdmissionTimer(DOKAN_ADMISSION *Admission, LONG64 Now,
+                            LONG64 Wait) {
+  LONG64 dueTime = Now + Wait;
+  LARGE_INTEGER relativeDueTime;
+  FILETIME fileTime;
+
+  if (Admission->TimerDueTime && Admission->TimerDueTime <= dueTime) {
+    return;
+  }
+  Admission->TimerDueTime = dueTime;
+  // Wait is at most a second, the conversion to 100ns units cannot overflow.
+  relativeDueTime.QuadPart =
+      -max(1, Wait * 10000000 / Admission->TicksPerSecond);
+  fileTime.dwLowDateTime = relativeDueTime.LowPart;
+  fileTime.dwHighDateTime = relativeDueTime.HighPart;
+  SetThreadpoolTimer(Admission->Timer, &fileTime, 0, 0);
+}
+
+// Admits the waiting events the limits allow, one event per process in round
+// robin, and appends them to Events. Admission lock must be held exclusively.
+VOID AdmitWaitingEvents(DOKAN_ADMISSION *Admission, PLIST_ENTRY Events) {
+  LONG64 now = GetPerformanceCounter();
+  LONG64 tokenWait = 0;
+  ULONG blockedProcesses = 0;
+
+  // Stops after a whole round of processes without any event admitted.
+  while (blockedProcesses < Admission->WaitingProcessCount) {
+    DOKAN_PROCESS_ADMISSION *process =
+        CONTAINING_RECORD(RemoveHeadList(&Admission->WaitingProcesses),
+                          DOKAN_PROCESS_ADMISSION, WaitingListEntry);
+    PDOKAN_IO_EVENT ioEvent;
+
+    RefillTokens(Admission, process, now);
+    if (!CanAdmitEvent(Admission, process)) {
+      LONG64 wait = GetTokenWait(Admission, process);
+      if (wait && (!tokenWait || wait < tokenWait)) {
+        tokenWait = wait;
+      }
+      InsertTailList(&Admission->WaitingProcesses, &process->WaitingListEntry);
+      ++blockedProcesses;
+      continue;
+    }
+    ioEvent = CONTAINING_RECORD(RemoveHeadList(&process->WaitingEvents),
+                                DOKAN_IO_EVENT, DispatchListEntry);
+    AdmitEvent(Admission, process, ioEvent);
+    ++process->DelayedEvents;
+    InsertTailList(Events, &ioEvent->DispatchListEntry);
+    blockedProcesses = 0;
+    if (--process->WaitingEventCount) {
+      InsertTailList(&Admission->WaitingProcesses, &process->WaitingListEntry);
+    } else {
+      --Admission->WaitingProcessCount;
+    }
+  }
+  if (tokenWait) {
+    ScheduleAdmissionTimer(Admission, now, tokenWait);
+  }
+}
+
+VOID CALLBACK AdmissionTimerCallback(PTP_CALLBACK_INSTANCE Instance,
+                                     PVOID Context, PTP_TIMER Timer) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Timer);
+
+  PDOKAN_INSTANCE dokanInstance = (PDOKAN_INSTANCE)Context;
+  DOKAN_ADMISSION *admission = &dokanInstance->ThreadInfo.Admission;
+  LIST_ENTRY events;
+
+  InitializeListHead(&events);
+  AcquireSRWLockExclusive(&admission->Lock);
+  admission->TimerDueTime = 0;
+  AdmitWaitingEvents(admission, &events);
+  ReleaseSRWLockExclusive(&admission->Lock);
+  QueueIoEventList(dokanInstance, &events);
+}
+
+// Forgets the processes without events in flight or waiting and with a full
+// token bucket, so that they come back in the same state.
+VOID ForgetIdleProcesses(DOKAN_ADMISSION *Admission, LONG64 Now) {
+  LONG64 capacity = (LONG64)Admission->Burst * Admission->TicksPerSecond;
+
+  for (ULONG i = 0; i < DOKAN_ADMISSION_BUCKET_COUNT; ++i) {
+    PLIST_ENTRY entry = Admission->Processes[i].Flink;
+    while (entry != &Admission->Processes[i]) {
+      DOKAN_PROCESS_ADMISSION *process =
+          CONTAINING_RECORD(entry, DOKAN_PROCESS_ADMISSION, ListEntry);
+      entry = entry->Flink;
+      RefillTokens(Admission, process, Now);
+      if (process->InFlightEvents || process->WaitingEventCount ||
+          process->Tokens < capacity) {
+        continue;
+      }
+      RemoveEntryList(&process->ListEntry);
+      free(process);
+      --Admission->ProcessCount;
+    }
+  }
+}
+
+// Returns the admission of the process, created if needed, or NULL if it
+// could not be allocated. Admission lock must be held exclusively.
+DOKAN_PROCESS_ADMISSION *GetProcessAdmission(DOKAN_ADMISSION *Admission,
+                                             ULONG ProcessId, LONG64 Now) {
+  PLIST_ENTRY bucket = GetProcessAdmissionBucket(Admission, ProcessId);
+  DOKAN_PROCESS_ADMISSION *process;
+
+  for (PLIST_ENTRY entry = bucket->Flink; entry != bucket;
+       entry = entry->Flink) {
+    process = CONTAINING_RECORD(entry, DOKAN_PROCESS_ADMISSION, ListEntry);
+    if (process->ProcessId == ProcessId) {
+      return process;
+    }
+  }
+  if (Admission->ProcessCount >= DOKAN_ADMISSION_MAX_IDLE_PROCESSES) {
+    ForgetIdleProcesses(Admission, Now);
+  }
+  process = (DOKAN_PROCESS_ADMISSION *)calloc(1, sizeof(*process));
+  if (!process) {
+    return NULL;
+  }
+  process->ProcessId = ProcessId;
+  InitializeListHead(&process->WaitingEvents);
+  process->Tokens = (LONG64)Admission->Burst * Admission->TicksPerSecond;
+  process->RefillTime = Now;
+  InsertTailList(bucket, &process->ListEntry);
+  ++Admission->ProcessCount;
+  return process;
+}
+
+BOOL StartProcessAdmission(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_ADMISSION *admission = &DokanInstance->ThreadInfo.Admission;
+  PDOKAN_OPTIONS options = DokanInstance->DokanOptions;
+
+  InitializeSRWLock(&admission->Lock);
+  for (ULONG i = 0; i < DOKAN_ADMISSION_BUCKET_COUNT; ++i) {
+    InitializeListHead(&admission->Processes[i]);
+  }
+  InitializeListHead(&admission->WaitingProcesses);
+  admission->MaxInFlight = options->ProcessMaxInFlight;
+  admission->Rate = options->ProcessEventRate;
+  if (admission->Rate) {
+    admission->Burst = options->ProcessEventBurst ? options->ProcessEventBurst
+                                                  : admission->Rate;
+  }
+  admission->TicksPerSecond = DokanInstance->TicksPerSecond;
+  admission->Timer = CreateThreadpoolTimer(
+      AdmissionTimerCallback, DokanInstance,
+      &DokanInstance->ThreadInfo.CallbackEnvironment);
+  if (!admission->Timer) {
+    DokanDbgPrintW(L"Dokan Error: CreateThreadpoolTimer() has returned "
+                   L"error code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+VOID FreeProcessAdmission(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_ADMISSION *admission = &DokanInstance->ThreadInfo.Admission;
+
+  if (!admission->Timer) {
+    return;
+  }
+  // Waiting events are released with the instance pools.
+  for (ULONG i = 0; i < DOKAN_ADMISSION_BUCKET_COUNT; ++i) {
+    while (!IsListEmpty(&admission->Processes[i])) {
+      free(CONTAINING_RECORD(RemoveHeadList(&admission->Processes[i]),
+                             DOKAN_PROCESS_ADMISSION, ListEntry));
+    }
+  }
+  admission->ProcessCount = 0;
+}
+
+BOOL BeginAdmittedDispatch(PDOKAN_IO_EVENT IoEvent) {
+  PDOKAN_INSTANCE dokanInstance = IoEvent->DokanInstance;
+  DOKAN_ADMISSION *admission = &dokanInstance->ThreadInfo.Admission;
+  DOKAN_PROCESS_ADMISSION *process;
+  BOOL dispatchNow = TRUE;
+  LONG64 now;
+
+  // Close releases the open and never waits behind the other events.
+  if (!(dokanInstance->DokanOptions->Options &
+        DOKAN_OPTION_PROCESS_ADMISSION) ||
+      IoEvent->ProcessAdmission ||
+      IoEvent->EventContext->MajorFunction == IRP_MJ_CLOSE) {
+    return TRUE;
+  }
+  now = GetPerformanceCounter();
+  AcquireSRWLockExclusive(&admission->Lock);
+  process =
+      GetProcessAdmission(admission, IoEvent->EventContext->ProcessId, now);
+  if (process) {
+    RefillTokens(admission, process, now);
+    // Events only pass the ones of their process already waiting.
+    if (!process->WaitingEventCount && CanAdmitEvent(admission, process)) {
+      AdmitEvent(admission, process, IoEvent);
+    } else {
+      LONG64 tokenWait = GetTokenWait(admission, process);
+      InsertTailList(&process->WaitingEvents, &IoEvent->DispatchListEntry);
+      if (!process->WaitingEventCount++) {
+        InsertTailList(&admission->WaitingProcesses,
+                       &process->WaitingListEntry);
+        ++admission->WaitingProcessCount;
+      }
+      if (tokenWait) {
+        ScheduleAdmissionTimer(admission, now, tokenWait);
+      }
+      dispatchNow = FALSE;
+    }
+  }
+  ReleaseSRWLockExclusive(&admission->Lock);
+  return dispatchNow;
+}
+
+VOID EndAdmittedDispatch(PDOKAN_IO_EVENT IoEvent) {
+  DOKAN_PROCESS_ADMISSION *process = IoEvent->ProcessAdmission;
+  DOKAN_ADMISSION *admission;
+  LIST_ENTRY events;
+
+  if (!process) {
+    return;
+  }
+  IoEvent->ProcessAdmission = NULL;
+  admission = &IoEvent->DokanInstance->ThreadInfo.Admission;
+  InitializeListHead(&events);
+  AcquireSRWLockExclusive(&admission->Lock);
+  --process->InFlightEvents;
+  if (admission->WaitingProcessCount) {
+    AdmitWaitingEvents(admission, &events);
+  }
+  ReleaseSRWLockExclusive(&admission->Lock);
+  QueueIoEventList(IoEvent->DokanInstance, &events);
+}
+
+ULONG DOKANAPI DokanGetProcessAdmissionStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    PDOKAN_PROCESS_ADMISSION_STATISTICS Statistics, ULONG Count) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_ADMISSION *admission;
+  ULONG processCount = 0;
+
+  if (!instance || !instance->ThreadInfo.Admission.Timer) {
+    return 0;
+  }
+  admission = &instance->ThreadInfo.Admission;
+  AcquireSRWLockShared(&admission->Lock);
+  for (ULONG i = 0; i < DOKAN_ADMISSION_BUCKET_COUNT; ++i) {
+    for (PLIST_ENTRY entry = admission->Processes[i].Flink;
+         entry != &admission->Processes[i]; entry = entry->Flink) {
+      DOKAN_PROCESS_ADMISSION *process =
+          CONTAINING_RECORD(entry, DOKAN_PROCESS_ADMISSION, ListEntry);
+      if (Statistics && processCount < Count) {
+        PDOKAN_PROCESS_ADMISSION_STATISTICS statistics =
+            &Statistics[processCount];
+        statistics->ProcessId = process->ProcessId;
+        statistics->InFlightEvents = process->InFlightEvents;
+        statistics->WaitingEvents = process->WaitingEventCount;
+        statistics->AdmittedEvents = process->AdmittedEvents;
+        statistics->DelayedEvents = process->DelayedEvents;
+      }
+      ++processCount;
+    }
+  }
+  ReleaseSRWLockShared(&admission->Lock);
+  return processCount;
+}
@@ -0,0 +1,917 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOKAN_CORO_H_
+#define DOKAN_CORO_H_
+
+/** @file */
+
+/**
+ * \defgroup DokanCoro Dokan Coroutines
+ * \brief Header only C++20 coroutine layer over \ref DOKAN_OPERATIONS
+ *
+ * A filesystem class implements the operations as coroutines returning a
+ * dokan::coro::task, like:
+ *
+ * \code
+ * dokan::coro::task<dokan::coro::io_result> read(LPCWSTR FileName,
+ *     LPVOID Buffer, DWORD BufferLength, LONGLONG Offset,
+ *     PDOKAN_FILE_INFO DokanFileInfo) {
+ *   DWORD read = co_await backend_.read(Buffer, BufferLength, Offset);
+ *   co_return dokan::coro::io_result{STATUS_SUCCESS, read};
+ * }
+ * \endcode
+ *
+ * dokan::coro::make_operations builds the \ref DOKAN_OPERATIONS calling the
+ * members the class has, with the class instance given in
+ * \ref DOKAN_OPTIONS.GlobalContext. An operation that completes without
+ * suspending is returned synchronously. One that suspends returns
+ * \c STATUS_PENDING when \ref DOKAN_FILE_INFO.AsyncDispatch is set and is
+ * completed later with its DokanEndDispatch function, otherwise the dispatch
+ * thread waits for it. \ref DOKAN_OPTION_ASYNC_DISPATCH is therefore needed
+ * for suspended operations to release the dispatch threads.
+ *
+ * The backends resume the coroutines with dokan::coro::completion, on the
+ * completing thread or through a dokan::coro::executor.
+ * @{
+ */
+
+#if defined(__cplusplus) && __cplusplus >= 202002L && \
+    defined(__cpp_impl_coroutine)
+
+#include "dokan.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+
+namespace dokan {
+namespace coro {
+
+/** Result of the read and write operations. */
+struct io_result {
+  NTSTATUS status = STATUS_SUCCESS;
+  /** Number of bytes read or written. */
+  DWORD length = 0;
+};
+
+/** Result of the get_file_information operation. */
+struct file_information_result {
+  NTSTATUS status = STATUS_SUCCESS;
+  BY_HANDLE_FILE_INFORMATION information = {};
+};
+
+/** Result of the get_disk_free_space operation. */
+struct disk_free_space_result {
+  NTSTATUS status = STATUS_SUCCESS;
+  ULONGLONG free_bytes_available = 0;
+  ULONGLONG total_number_of_bytes = 0;
+  ULONGLONG total_number_of_free_bytes = 0;
+};
+
+/** Result of the get_volume_information operation. */
+struct volume_information_result {
+  NTSTATUS status = STATUS_SUCCESS;
+  std::wstring volume_name;
+  DWORD volume_serial_number = 0;
+  DWORD maximum_component_length = 0;
+  DWORD file_system_flags = 0;
+  std::wstring file_system_name;
+};
+
+/** Result of the get_file_security operation. */
+struct security_result {
+  NTSTATUS status = STATUS_SUCCESS;
+  /** Length of the security descriptor. */
+  ULONG length_needed = 0;
+};
+
+/**
+ * \brief Runs resumed coroutines.
+ *
+ * Implementations must resume every posted handle exactly once.
+ */
+class executor {
+ public:
+  virtual ~executor() = default;
+
+  /** Queues the resumption of Handle. */
+  virtual void post(std::coroutine_handle<> Handle) = 0;
+
+  /** Returns an awaitable that resumes the awaiting coroutine on the
+   * executor. */
+  auto schedule() noexcept {
+    struct awaiter {
+      executor *Executor;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> Handle) {
+        Executor->post(Handle);
+      }
+      void await_resume() const noexcept {}
+    };
+    return awaiter{this};
+  }
+};
+
+/**
+ * \brief Executor resuming the coroutines on the Windows thread pool.
+ *
+ * The default process thread pool is used when no callback environment is
+ * given.
+ */
+class thread_pool_executor final : public executor {
+ public:
+  explicit thread_pool_executor(PTP_CALLBACK_ENVIRON CallbackEnviron = nullptr)
+      : callback_environ_(CallbackEnviron) {}
+
+  void post(std::coroutine_handle<> Handle) override {
+    if (!TrySubmitThreadpoolCallback(&thread_pool_executor::run,
+                                     Handle.address(), callback_environ_)) {
+      // The coroutine must not be lost, resume it on the posting thread.
+      Handle.resume();
+    }
+  }
+
+ private:
+  static VOID CALLBACK run(PTP_CALLBACK_INSTANCE, PVOID Context) {
+    std::coroutine_handle<>::from_address(Context).resume();
+  }
+
+  PTP_CALLBACK_ENVIRON callback_environ_;
+};
+
+/**
+ * \brief Executor queuing the coroutines until its owner runs them.
+ *
+ * Does not depend on any system facility so that an event loop, like the one
+ * of a test or a benchmark, can drive the operations from a single thread.
+ */
+class manual_executor final : public executor {
+ public:
+  void post(std::coroutine_handle<> Handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(Handle);
+  }
+
+  /** Resumes the oldest queued coroutine. Returns false when none was
+   * queued. */
+  bool run_one() {
+    std::coroutine_handle<> handle;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty())
+        return false;
+      handle = queue_.front();
+      queue_.pop_front();
+    }
+    handle.resume();
+    return true;
+  }
+
+  /** Resumes queued coroutines, including the ones they post, until the
+   * queue is empty. Returns the number of resumed coroutines. */
+  std::size_t run() {
+    std::size_t count = 0;
+    while (run_one())
+      ++count;
+    return count;
+  }
+
+  bool empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.empty();
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::deque<std::coroutine_handle<>> queue_;
+};
+
+template <typename T = void> class task;
+
+namespace detail {
+
+template <typename T> class task_promise_base {
+ public:
+  struct final_awaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> Handle) noexcept {
+      // Transfer to the awaiting coroutine without growing the stack.
+      std::coroutine_handle<> continuation = Handle.promise().continuation_;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  final_awaiter final_suspend() const noexcept { return {}; }
+
+  void unhandled_exception() noexcept {
+    result_.template emplace<2>(std::current_exception());
+  }
+
+  void set_continuation(std::coroutine_handle<> Continuation) noexcept {
+    continuation_ = Continuation;
+  }
+
+ protected:
+  std::coroutine_handle<> continuation_;
+  // T is replaced by std::monostate for task<void>.
+  std::variant<std::monostate, T, std::exception_ptr> result_;
+
+  void rethrow_if_exception() {
+    if (result_.index() == 2)
+      std::rethrow_exception(std::get<2>(result_));
+  }
+};
+
+template <typename T> class task_promise : public task_promise_base<T> {
+ public:
+  task<T> get_return_object() noexcept;
+
+  template <typename U> void return_value(U &&Value) {
+    this->result_.template emplace<1>(std::forward<U>(Value));
+  }
+
+  T result() {
+    this->rethrow_if_exception();
+    return std::move(std::get<1>(this->result_));
+  }
+};
+
+template <>
+class task_promise<void> : public task_promise_base<std::monostate> {
+ public:
+  task<void> get_return_object() noexcept;
+
+  void return_void() noexcept {}
+
+  void result() { rethrow_if_exception(); }
+};
+
+} // namespace detail
+
+/**
+ * \brief Lazily started coroutine producing a T.
+ *
+ * The coroutine starts when awaited and resumes its awaiter when it completes.
+ * Exceptions are rethrown to the awaiter.
+ */
+template <typename T> class task {
+ public:
+  using promise_type = detail::task_promise<T>;
+
+  task() noexcept = default;
+  explicit task(std::coroutine_handle<promise_type> Handle) noexcept
+      : handle_(Handle) {}
+  task(task &&Other) noexcept : handle_(std::exchange(Other.handle_, {})) {}
+  task &operator=(task &&Other) noexcept {
+    if (this != &Other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(Other.handle_, {});
+    }
+    return *this;
+  }
+  task(const task &) = delete;
+  task &operator=(const task &) = delete;
+  ~task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  auto operator co_await() && noexcept {
+    struct awaiter {
+      std::coroutine_handle<promise_type> Handle;
+      bool await_ready() const noexcept { return !Handle || Handle.done(); }
+      std::coroutine_handle<>
+      await_suspend(std::coroutine_handle<> Continuation) noexcept {
+        Handle.promise().set_continuation(Continuation);
+        return Handle;
+      }
+      T await_resume() { return Handle.promise().result(); }
+    };
+    return awaiter{handle_};
+  }
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+namespace detail {
+
+template <typename T> task<T> task_promise<T>::get_return_object() noexcept {
+  return task<T>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept {
+  return task<void>(std::coroutine_handle<task_promise>::from_promise(*this));
+}
+
+} // namespace detail
+
+/**
+ * \brief One shot result set by a backend and awaited by a coroutine.
+ *
+ * The backend keeps a copy of the completion and calls complete once, from
+ * any thread. The awaiting coroutine is resumed on the given executor, or on
+ * the completing thread without one. Awaiting an already completed
+ * completion does not suspend.
+ */
+template <typename T> class completion {
+ public:
+  explicit completion(executor *Executor = nullptr)
+      : state_(std::make_shared<state>()) {
+    state_->Executor = Executor;
+  }
+
+  template <typename U> void complete(U &&Value) {
+    state_->Value.emplace(std::forward<U>(Value));
+    void *waiter = state_->Waiter.exchange(ready(), std::memory_order_acq_rel);
+    if (!waiter)
+      return;
+    std::coroutine_handle<> handle =
+        std::coroutine_handle<>::from_address(waiter);
+    if (state_->Executor)
+      state_->Executor->post(handle);
+    else
+      handle.resume();
+  }
+
+  auto operator co_await() const noexcept {
+    struct awaiter {
+      std::shared_ptr<state> State;
+      bool await_ready() const noexcept {
+        return State->Waiter.load(std::memory_order_acquire) == ready();
+      }
+      bool await_suspend(std::coroutine_handle<> Handle) noexcept {
+        void *expected = nullptr;
+        // Fails when complete ran since await_ready, continue inline then.
+        return State->Waiter.compare_exchange_strong(
+            expected, Handle.address(), std::memory_order_acq_rel);
+      }
+      T await_resume() { return std::move(*State->Value); }
+    };
+    return awaiter{state_};
+  }
+
+ private:
+  struct state {
+    std::atomic<void *> Waiter{nullptr};
+    std::optional<T> Value;
+    executor *Executor = nullptr;
+  };
+
+  static void *ready() noexcept {
+    static char marker;
+    return &marker;
+  }
+
+  std::shared_ptr<state> state_;
+};
+
+namespace detail {
+
+inline NTSTATUS &status_of(NTSTATUS &Result) noexcept { return Result; }
+template <typename R> NTSTATUS &status_of(R &Result) noexcept {
+  return Result.status;
+}
+
+// Whoever of the callback and the completed coroutine is last does the
+// completion: the callback returns the result synchronously, the coroutine
+// calls the DokanEndDispatch function. The state is changed under the mutex
+// of the promise, so that the callback destroys the coroutine only once the
+// coroutine has released it.
+enum : int {
+  kOperationRunning = 0,
+  kOperationPending = 1,
+  kOperationCompleted = 2,
+};
+
+template <typename R> class root_operation {
+ public:
+  struct promise_type {
+    std::mutex Mutex;
+    std::condition_variable Completed;
+    int State = kOperationRunning;
+    R Result{};
+    PDOKAN_FILE_INFO DokanFileInfo = nullptr;
+    void (*EndDispatch)(PDOKAN_FILE_INFO, R &) = nullptr;
+
+    struct final_awaiter {
+      bool await_ready() const noexcept { return false; }
+      bool await_suspend(
+          std::coroutine_handle<promise_type> Handle) noexcept {
+        promise_type &promise = Handle.promise();
+        {
+          std::lock_guard<std::mutex> lock(promise.Mutex);
+          if (promise.State == kOperationRunning) {
+            // The callback has not returned, it takes the result and destroys
+            // the coroutine once the lock is released. Nothing of the frame
+            // may be touched after that.
+            promise.State = kOperationCompleted;
+            promise.Completed.notify_one();
+            return true;
+          }
+        }
+        promise.EndDispatch(promise.DokanFileInfo, promise.Result);
+        return false;
+      }
+      void await_resume() const noexcept {}
+    };
+
+    root_operation get_return_object() noexcept {
+      return root_operation{
+          std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void return_value(R Value) { Result = std::move(Value); }
+    void unhandled_exception() noexcept {
+      status_of(Result) = STATUS_INTERNAL_ERROR;
+    }
+  };
+
+  std::coroutine_handle<promise_type> Handle;
+};
+
+template <typename R> root_operation<R> run_operation(task<R> Body) {
+  co_return co_await std::move(Body);
+}
+
+// Starts Body on the calling thread. Returns STATUS_PENDING when it suspends
+// and the operation can complete asynchronously, EndDispatch is then called
+// with its result. Otherwise waits for it and gives its result to Fill.
+template <typename R, typename F>
+NTSTATUS dispatch(PDOKAN_FILE_INFO DokanFileInfo, task<R> Body,
+                  void (*EndDispatch)(PDOKAN_FILE_INFO, R &), F &&Fill) {
+  std::coroutine_handle<typename root_operation<R>::promise_type> handle =
+      run_operation<R>(std::move(Body)).Handle;
+  auto &promise = handle.promise();
+  promise.DokanFileInfo = DokanFileInfo;
+  promise.EndDispatch = EndDispatch;
+  handle.resume();
+
+  {
+    std::unique_lock<std::mutex> lock(promise.Mutex);
+    if (DokanFileInfo->AsyncDispatch) {
+      if (promise.State == kOperationRunning) {
+        promise.State = kOperationPending;
+        return STATUS_PENDING;
+      }
+    } else {
+      promise.Completed.wait(
+          lock, [&promise] { return promise.State == kOperationCompleted; });
+    }
+  }
+
+  R result = std::move(promise.Result);
+  handle.destroy();
+  Fill(result);
+  return status_of(result);
+}
+
+template <typename R>
+NTSTATUS dispatch(PDOKAN_FILE_INFO DokanFileInfo, task<R> Body,
+                  void (*EndDispatch)(PDOKAN_FILE_INFO, R &)) {
+  return dispatch(DokanFileInfo, std::move(Body), EndDispatch, [](R &) {});
+}
+
+inline void end_create(PDOKAN_FILE_INFO DokanFileInfo, NTSTATUS &Status) {
+  DokanEndDispatchCreate(DokanFileInfo, Status);
+}
+inline void end_read(PDOKAN_FILE_INFO DokanFileInfo, io_result &Result) {
+  DokanEndDispatchRead(DokanFileInfo, Result.length, Result.status);
+}
+inline void end_write(PDOKAN_FILE_INFO DokanFileInfo, io_result &Result) {
+  DokanEndDispatchWrite(DokanFileInfo, Result.length, Result.status);
+}
+inline void end_flush(PDOKAN_FILE_INFO DokanFileInfo, NTSTATUS &Status) {
+  DokanEndDispatchFlush(DokanFileInfo, Status);
+}
+inline void end_get_file_information(PDOKAN_FILE_INFO DokanFileInfo,
+                                     file_information_result &Result) {
+  DokanEndDispatchGetFileInformation(DokanFileInfo, &Result.information,
+                                     Result.status);
+}
+inline void end_find_files(PDOKAN_FILE_INFO DokanFileInfo, NTSTATUS &Status) {
+  DokanEndDispatchFindFiles(DokanFileInfo, Status);
+}
+inline void end_find_streams(PDOKAN_FILE_INFO DokanFileInfo,
+                             NTSTATUS &Status) {
+  DokanEndDispatchFindStreams(DokanFileInfo, Status);
+}
+inline void end_set_information(PDOKAN_FILE_INFO DokanFileInfo,
+                                NTSTATUS &Status) {
+  DokanEndDispatchSetInformation(DokanFileInfo, Status);
+}
+inline void end_lock(PDOKAN_FILE_INFO DokanFileInfo, NTSTATUS &Status) {
+  DokanEndDispatchLock(DokanFileInfo, Status);
+}
+inline void end_get_disk_free_space(PDOKAN_FILE_INFO DokanFileInfo,
+                                    disk_free_space_result &Result) {
+  DokanEndDispatchGetDiskFreeSpace(
+      DokanFileInfo, Result.free_bytes_available, Result.total_number_of_bytes,
+      Result.total_number_of_free_bytes, Result.status);
+}
+inline void end_get_volume_information(PDOKAN_FILE_INFO DokanFileInfo,
+                                       volume_information_result &Result) {
+  DokanEndDispatchGetVolumeInformation(
+      DokanFileInfo, Result.volume_name.c_str(), Result.volume_serial_number,
+      Result.maximum_component_length, Result.file_system_flags,
+      Result.file_system_name.c_str(), Result.status);
+}
+inline void end_get_file_security(PDOKAN_FILE_INFO DokanFileInfo,
+                                  security_result &Result) {
+  DokanEndDispatchGetFileSecurity(DokanFileInfo, Result.length_needed,
+                                  Result.status);
+}
+inline void end_set_file_security(PDOKAN_FILE_INFO DokanFileInfo,
+                                  NTSTATUS &Status) {
+  DokanEndDispatchSetFileSecurity(DokanFileInfo, Status);
+}
+
+inline std::optional<FILETIME> optional_file_time(CONST FILETIME *Time) {
+  return Time ? std::optional<FILETIME>(*Time) : std::nullopt;
+}
+
+// Adapts the DOKAN_OPERATIONS callbacks to the members of Filesystem.
+template <typename Filesystem> struct operation_thunks {
+  static Filesystem &filesystem(PDOKAN_FILE_INFO DokanFileInfo) {
+    return *reinterpret_cast<Filesystem *>(
+        static_cast<ULONG_PTR>(DokanFileInfo->DokanOptions->GlobalContext));
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  create(LPCWSTR FileName, PDOKAN_IO_SECURITY_CONTEXT SecurityContext,
+         ACCESS_MASK DesiredAccess, ULONG FileAttributes, ULONG ShareAccess,
+         ULONG CreateDisposition, ULONG CreateOptions,
+         PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .create(FileName, *SecurityContext, DesiredAccess, FileAttributes,
+                    ShareAccess, CreateDisposition, CreateOptions,
+                    DokanFileInfo),
+        &end_create);
+  }
+
+  static void DOKAN_CALLBACK cleanup(LPCWSTR FileName,
+                                     PDOKAN_FILE_INFO DokanFileInfo) {
+    filesystem(DokanFileInfo).cleanup(FileName, DokanFileInfo);
+  }
+
+  static void DOKAN_CALLBACK close_file(LPCWSTR FileName,
+                                        PDOKAN_FILE_INFO DokanFileInfo) {
+    filesystem(DokanFileInfo).close_file(FileName, DokanFileInfo);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK read(LPCWSTR FileName, LPVOID Buffer,
+                                      DWORD BufferLength, LPDWORD ReadLength,
+                                      LONGLONG Offset,
+                                      PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<io_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .read(FileName, Buffer, BufferLength, Offset, DokanFileInfo),
+        &end_read, [ReadLength](io_result &Result) {
+          *ReadLength = Result.length;
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  write(LPCWSTR FileName, LPCVOID Buffer, DWORD NumberOfBytesToWrite,
+        LPDWORD NumberOfBytesWritten, LONGLONG Offset,
+        PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<io_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .write(FileName, Buffer, NumberOfBytesToWrite, Offset,
+                   DokanFileInfo),
+        &end_write, [NumberOfBytesWritten](io_result &Result) {
+          *NumberOfBytesWritten = Result.length;
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK flush(LPCWSTR FileName,
+                                       PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo, filesystem(DokanFileInfo).flush(FileName, DokanFileInfo),
+        &end_flush);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  get_file_information(LPCWSTR FileName,
+                       LPBY_HANDLE_FILE_INFORMATION Buffer,
+                       PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<file_information_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo).get_file_information(FileName, DokanFileInfo),
+        &end_get_file_information,
+        [Buffer](file_information_result &Result) {
+          *Buffer = Result.information;
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK find_files(LPCWSTR FileName,
+                                            PFillFindData FillFindData,
+                                            PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .find_files(FileName, FillFindData, DokanFileInfo),
+        &end_find_files);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  find_files_with_pattern(LPCWSTR PathName, LPCWSTR SearchPattern,
+                          PFillFindData FillFindData,
+                          PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .find_files_with_pattern(PathName, SearchPattern, FillFindData,
+                                     DokanFileInfo),
+        &end_find_files);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  set_file_attributes(LPCWSTR FileName, DWORD FileAttributes,
+                      PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(DokanFileInfo,
+                              filesystem(DokanFileInfo)
+                                  .set_file_attributes(
+                                      FileName, FileAttributes, DokanFileInfo),
+                              &end_set_information);
+  }
+
+  // The times are copied, their pointers are only valid during the callback.
+  static NTSTATUS DOKAN_CALLBACK
+  set_file_time(LPCWSTR FileName, CONST FILETIME *CreationTime,
+                CONST FILETIME *LastAccessTime, CONST FILETIME *LastWriteTime,
+                PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .set_file_time(FileName, optional_file_time(CreationTime),
+                           optional_file_time(LastAccessTime),
+                           optional_file_time(LastWriteTime), DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK delete_file(LPCWSTR FileName,
+                                             PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo).delete_file(FileName, DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  delete_directory(LPCWSTR FileName, PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo).delete_directory(FileName, DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK move_file(LPCWSTR FileName,
+                                           LPCWSTR NewFileName,
+                                           BOOL ReplaceIfExisting,
+                                           PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .move_file(FileName, NewFileName, ReplaceIfExisting,
+                       DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  set_end_of_file(LPCWSTR FileName, LONGLONG ByteOffset,
+                  PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .set_end_of_file(FileName, ByteOffset, DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  set_allocation_size(LPCWSTR FileName, LONGLONG AllocSize,
+                      PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .set_allocation_size(FileName, AllocSize, DokanFileInfo),
+        &end_set_information);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK lock_file(LPCWSTR FileName,
+                                           LONGLONG ByteOffset,
+                                           LONGLONG Length,
+                                           PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .lock_file(FileName, ByteOffset, Length, DokanFileInfo),
+        &end_lock);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK unlock_file(LPCWSTR FileName,
+                                             LONGLONG ByteOffset,
+                                             LONGLONG Length,
+                                             PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .unlock_file(FileName, ByteOffset, Length, DokanFileInfo),
+        &end_lock);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  get_disk_free_space(PULONGLONG FreeBytesAvailable,
+                      PULONGLONG TotalNumberOfBytes,
+                      PULONGLONG TotalNumberOfFreeBytes,
+                      PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<disk_free_space_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo).get_disk_free_space(DokanFileInfo),
+        &end_get_disk_free_space, [=](disk_free_space_result &Result) {
+          *FreeBytesAvailable = Result.free_bytes_available;
+          *TotalNumberOfBytes = Result.total_number_of_bytes;
+          *TotalNumberOfFreeBytes = Result.total_number_of_free_bytes;
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK get_volume_information(
+      LPWSTR VolumeNameBuffer, DWORD VolumeNameSize,
+      LPDWORD VolumeSerialNumber, LPDWORD MaximumComponentLength,
+      LPDWORD FileSystemFlags, LPWSTR FileSystemNameBuffer,
+      DWORD FileSystemNameSize, PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<volume_information_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo).get_volume_information(DokanFileInfo),
+        &end_get_volume_information, [=](volume_information_result &Result) {
+          wcsncpy_s(VolumeNameBuffer, VolumeNameSize,
+                    Result.volume_name.c_str(), _TRUNCATE);
+          *VolumeSerialNumber = Result.volume_serial_number;
+          *MaximumComponentLength = Result.maximum_component_length;
+          *FileSystemFlags = Result.file_system_flags;
+          wcsncpy_s(FileSystemNameBuffer, FileSystemNameSize,
+                    Result.file_system_name.c_str(), _TRUNCATE);
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK get_file_security(
+      LPCWSTR FileName, PSECURITY_INFORMATION SecurityInformation,
+      PSECURITY_DESCRIPTOR SecurityDescriptor, ULONG BufferLength,
+      PULONG LengthNeeded, PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<security_result>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .get_file_security(FileName, *SecurityInformation,
+                               SecurityDescriptor, BufferLength,
+                               DokanFileInfo),
+        &end_get_file_security, [LengthNeeded](security_result &Result) {
+          *LengthNeeded = Result.length_needed;
+        });
+  }
+
+  static NTSTATUS DOKAN_CALLBACK set_file_security(
+      LPCWSTR FileName, PSECURITY_INFORMATION SecurityInformation,
+      PSECURITY_DESCRIPTOR SecurityDescriptor, ULONG BufferLength,
+      PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .set_file_security(FileName, *SecurityInformation,
+                               SecurityDescriptor, BufferLength,
+                               DokanFileInfo),
+        &end_set_file_security);
+  }
+
+  static NTSTATUS DOKAN_CALLBACK
+  find_streams(LPCWSTR FileName, PFillFindStreamData FillFindStreamData,
+               PVOID FindStreamContext, PDOKAN_FILE_INFO DokanFileInfo) {
+    return dispatch<NTSTATUS>(
+        DokanFileInfo,
+        filesystem(DokanFileInfo)
+            .find_streams(FileName, FillFindStreamData, FindStreamContext,
+                          DokanFileInfo),
+        &end_find_streams);
+  }
+};
+
+} // namespace detail
+
+/**
+ * \brief Builds the \ref DOKAN_OPERATIONS calling the members of Filesystem.
+ *
+ * Only the callbacks of the members Filesystem declares are set, the others
+ * stay \c NULL. The members take the parameters of their callback except the
+ * output ones, that are returned in the task result instead:
+ *
+ * - create: \ref DOKAN_IO_SECURITY_CONTEXT is given by value.
+ * - read, write: return an io_result.
+ * - get_file_information: returns a file_information_result.
+ * - set_file_time: the times are given as std::optional<FILETIME>.
+ * - get_disk_free_space: returns a disk_free_space_result.
+ * - get_volume_information: returns a volume_information_result.
+ * - get_file_security: the SECURITY_INFORMATION is given by value and it
+ *   returns a security_result.
+ * - set_file_security: the SECURITY_INFORMATION is given by value.
+ * - cleanup, close_file: called synchronously, they return void.
+ *
+ * The other members return a task<NTSTATUS>. The Filesystem instance must be
+ * given in \ref DOKAN_OPTIONS.GlobalContext and outlive the mount. Mounted and
+ * Unmounted can be set on the returned operations by the caller.
+ */
+template <typename Filesystem> DOKAN_OPERATIONS make_operations() {
+  using thunks = detail::operation_thunks<Filesystem>;
+  DOKAN_OPERATIONS operations = {};
+  if constexpr (requires { &Filesystem::create; })
+    operations.ZwCreateFile = &thunks::create;
+  if constexpr (requires { &Filesystem::cleanup; })
+    operations.Cleanup = &thunks::cleanup;
+  if constexpr (requires { &Filesystem::close_file; })
+    operations.CloseFile = &thunks::close_file;
+  if constexpr (requires { &Filesystem::read; })
+    operations.ReadFile = &thunks::read;
+  if constexpr (requires { &Filesystem::write; })
+    operations.WriteFile = &thunks::write;
+  if constexpr (requires { &Filesystem::flush; })
+    operations.FlushFileBuffers = &thunks::flush;
+  if constexpr (requires { &Filesystem::get_file_information; })
+    operations.GetFileInformation = &thunks::get_file_information;
+  if constexpr (requires { &Filesystem::find_files; })
+    operations.FindFiles = &thunks::find_files;
+  if constexpr (requires { &Filesystem::find_files_with_pattern; })
+    operations.FindFilesWithPattern = &thunks::find_files_with_pattern;
+  if constexpr (requires { &Filesystem::set_file_attributes; })
+    operations.SetFileAttributes = &thunks::set_file_attributes;
+  if constexpr (requires { &Filesystem::set_file_time; })
+    operations.SetFileTime = &thunks::set_file_time;
+  if constexpr (requires { &Filesystem::delete_file; })
+    operations.DeleteFile = &thunks::delete_file;
+  if constexpr (requires { &Filesystem::delete_directory; })
+    operations.DeleteDirectory = &thunks::delete_directory;
+  if constexpr (requires { &Filesystem::move_file; })
+    operations.MoveFile = &thunks::move_file;
+  if constexpr (requires { &Filesystem::set_end_of_file; })
+    operations.SetEndOfFile = &thunks::set_end_of_file;
+  if constexpr (requires { &Filesystem::set_allocation_size; })
+    operations.SetAllocationSize = &thunks::set_allocation_size;
+  if constexpr (requires { &Filesystem::lock_file; })
+    operations.LockFile = &thunks::lock_file;
+  if constexpr (requires { &Filesystem::unlock_file; })
+    operations.UnlockFile = &thunks::unlock_file;
+  if constexpr (requires { &Filesystem::get_disk_free_space; })
+    operations.GetDiskFreeSpace = &thunks::get_disk_free_space;
+  if constexpr (requires { &Filesystem::get_volume_information; })
+    operations.GetVolumeInformation = &thunks::get_volume_information;
+  if constexpr (requires { &Filesystem::get_file_security; })
+    operations.GetFileSecurity = &thunks::get_file_security;
+  if constexpr (requires { &Filesystem::set_file_security; })
+    operations.SetFileSecurity = &thunks::set_file_security;
+  if constexpr (requires { &Filesystem::find_streams; })
+    operations.FindStreams = &thunks::find_streams;
+  return operations;
+}
+
+} // namespace coro
+} // namespace dokan
+
+#endif // C++20 coroutines
+
+/** @} */
+
+#endif // DOKAN_CORO_H_
@@ -0,0 +1,334 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+#include "dokan_pool.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define DOKAN_DIRECTORY_CACHE_BUCKET_COUNT 64
+#define DOKAN_DEFAULT_DIRECTORY_CACHE_TIMEOUT 2000
+#define DOKAN_DEFAULT_DIRECTORY_CACHE_SIZE (8 * 1024 * 1024)
+
+/**
+ * \struct DOKAN_DIRECTORY_CACHE_ENTRY
+ * \brief Listing of a directory shared by the opens of the directory
+ */
+typedef struct _DOKAN_DIRECTORY_CACHE_ENTRY {
+  /** Entry in DOKAN_DIRECTORY_CACHE.Buckets */
+  LIST_ENTRY BucketEntry;
+  /** Entry in DOKAN_DIRECTORY_CACHE.RecentEntries */
+  LIST_ENTRY RecentEntry;
+  /** The listing, with a reference held by the cache */
+  PDOKAN_DIRECTORY_LIST DirList;
+  /** GetTickCount64 time after which the listing is no longer used */
+  ULONGLONG ExpireTime;
+  /** Bytes counted in DOKAN_DIRECTORY_CACHE.Bytes */
+  SIZE_T Size;
+  ULONG Hash;
+  /** Number of characters of Path */
+  ULONG PathLength;
+  /** Normalized directory path, see NormalizePathChar */
+  WCHAR Path[1];
+} DOKAN_DIRECTORY_CACHE_ENTRY;
+
+/**
+ * \struct DOKAN_DIRECTORY_CACHE
+ * \brief Complete directory listings of a mount, by directory path
+ *
+ * Entries expire after Timeout and the least recently used ones are dropped
+ * to stay under Budget. Generation changes with each invalidation so that a
+ * listing started before it is not cached.
+ */
+struct _DOKAN_DIRECTORY_CACHE {
+  SRWLOCK Lock;
+  BOOL CaseSensitive;
+  /** Lifetime of the entries in milliseconds */
+  ULONG Timeout;
+  SIZE_T Budget;
+  SIZE_T Bytes;
+  ULONG64 Generation;
+  LIST_ENTRY Buckets[DOKAN_DIRECTORY_CACHE_BUCKET_COUNT];
+  /** Entries from the most to the least recently used */
+  LIST_ENTRY RecentEntries;
+};
+
+BOOL CreateDirectoryCache(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_OPTIONS options = DokanInstance->DokanOptions;
+  PDOKAN_DIRECTORY_CACHE cache;
+
+  assert(!DokanInstance->DirectoryCache);
+  if (!(options->Options & DOKAN_OPTION_DIRECTORY_CACHE)) {
+    return TRUE;
+  }
+  cache = (PDOKAN_DIRECTORY_CACHE)calloc(1, sizeof(DOKAN_DIRECTORY_CACHE));
+  if (!cache) {
+    return FALSE;
+  }
+  InitializeSRWLock(&cache->Lock);
+  cache->CaseSensitive = options->Options & DOKAN_OPTION_CASE_SENSITIVE;
+  cache->Timeout = options->DirectoryCacheTimeout
+                       ? options->DirectoryCacheTimeout
+                       : DOKAN_DEFAULT_DIRECTORY_CACHE_TIMEOUT;
+  cache->Budget = options->DirectoryCacheSize
+                      ? options->DirectoryCacheSize
+                      : DOKAN_DEFAULT_DIRECTORY_CACHE_SIZE;
+  for (ULONG i = 0; i < DOKAN_DIRECTORY_CACHE_BUCKET_COUNT; ++i) {
+    InitializeListHead(&cache->Buckets[i]);
+  }
+  InitializeListHead(&cache->RecentEntries);
+  DokanInstance->DirectoryCache = cache;
+  return TRUE;
+}
+
+VOID RemoveDirectoryCacheEntry(PDOKAN_INSTANCE DokanInstance,
+                               DOKAN_DIRECTORY_CACHE_ENTRY *Entry) {
+  RemoveEntryList(&Entry->BucketEntry);
+  RemoveEntryList(&Entry->RecentEntry);
+  DokanInstance->DirectoryCache->Bytes -= Entry->Size;
+  PushDirectoryList(DokanInstance, Entry->DirList);
+  free(Entry);
+}
+
+VOID DeleteDirectoryCache(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_DIRECTORY_CACHE cache = DokanInstance->DirectoryCache;
+
+  if (!cache) {
+    return;
+  }
+  while (!IsListEmpty(&cache->RecentEntries)) {
+    RemoveDirectoryCacheEntry(
+        DokanInstance,
+        CONTAINING_RECORD(cache->RecentEntries.Flink,
+                          DOKAN_DIRECTORY_CACHE_ENTRY, RecentEntry));
+  }
+  free(cache);
+  DokanInstance->DirectoryCache = NULL;
+}
+
+// Paths are compared with '/' read as '\' and, unless the mount is case
+// sensitive, upper cased.
+WCHAR NormalizePathChar(PDOKAN_DIRECTORY_CACHE Cache, WCHAR Char) {
+  if (Char == L'/') {
+    return L'\\';
+  }
+  return Cache->CaseSensitive ? Char : FoldNameChar(Char);
+}
+
+// Returns the length of Path without its trailing separators, keeping the
+// root.
+ULONG GetNormalizedPathLength(LPCWSTR Path) {
+  ULONG length = (ULONG)wcslen(Path);
+  while (length > 1 &&
+         (Path[length - 1] == L'\\' || Path[length - 1] == L'/')) {
+    --length;
+  }
+  return length;
+}
+
+ULONG HashPath(PDOKAN_DIRECTORY_CACHE Cache, LPCWSTR Path, ULONG Length) {
+  // FNV-1a
+  ULONG hash = 2166136261;
+  for (ULONG i = 0; i < Length; ++i) {
+    hash = (hash ^ NormalizePathChar(Cache, Path[i])) * 16777619;
+  }
+  return hash;
+}
+
+// Returns whether the first Length characters of the entry path are Path.
+BOOL IsDirectoryCachePathPrefix(PDOKAN_DIRECTORY_CACHE Cache,
+                                DOKAN_DIRECTORY_CACHE_ENTRY *Entry,
+                                LPCWSTR Path, ULONG Length) {
+  if (Entry->PathLength < Length) {
+    return FALSE;
+  }
+  for (ULONG i = 0; i < Length; ++i) {
+    if (Entry->Path[i] != NormalizePathChar(Cache, Path[i])) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+DOKAN_DIRECTORY_CACHE_ENTRY *FindDirectoryCacheEntry(
+    PDOKAN_DIRECTORY_CACHE Cache, LPCWSTR Path, ULONG Length, ULONG Hash) {
+  PLIST_ENTRY bucket =
+      &Cache->Buckets[Hash % DOKAN_DIRECTORY_CACHE_BUCKET_COUNT];
+  for (PLIST_ENTRY listEntry = bucket->Flink; listEntry != bucket;
+       listEntry = listEntry->Flink) {
+    DOKAN_DIRECTORY_CACHE_ENTRY *entry = CONTAINING_RECORD(
+        listEntry, DOKAN_DIRECTORY_CACHE_ENTRY, BucketEntry);
+    if (entry->Hash == Hash && entry->PathLength == Length &&
+        IsDirectoryCachePathPrefix(Cache, entry, Path, Length)) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+ULONG64 GetDirectoryCacheGeneration(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_DIRECTORY_CACHE cache = DokanInstance->DirectoryCache;
+  ULONG64 generation;
+
+  if (!cache) {
+    return 0;
+  }
+  AcquireSRWLockShared(&cache->Lock);
+  generation = cache->Generation;
+  ReleaseSRWLockShared(&cache->Lock);
+  return generation;
+}
+
+// Returns the cached listing of the directory Path with a reference for the
+// caller, or NULL when it is not cached or has expired.
+PDOKAN_DIRECTORY_LIST LookupDirectoryCache(PDOKAN_INSTANCE DokanInstance,
+                                           LPCWSTR Path) {
+  PDOKAN_DIRECTORY_CACHE cache = DokanInstance->DirectoryCache;
+  PDOKAN_DIRECTORY_LIST dirList = NULL;
+  DOKAN_DIRECTORY_CACHE_ENTRY *entry;
+  ULONG length;
+  ULONG hash;
+
+  if (!cache) {
+    return NULL;
+  }
+  length = GetNormalizedPathLength(Path);
+  hash = HashPath(cache, Path, length);
+  AcquireSRWLockExclusive(&cache->Lock);
+  entry = FindDirectoryCacheEntry(cache, Path, length, hash);
+  if (entry) {
+    if (GetTickCount64() >= entry->ExpireTime) {
+      RemoveDirectoryCacheEntry(DokanInstance, entry);
+    } else {
+      RemoveEntryList(&entry->RecentEntry);
+      InsertHeadList(&cache->RecentEntries, &entry->RecentEntry);
+      InterlockedIncrement(&entry->DirList->ReferenceCount);
+      dirList = entry->DirList;
+    }
+  }
+  ReleaseSRWLockExclusive(&cache->Lock);
+  return dirList;
+}
+
+SIZE_T GetDirectoryListSize(PDOKAN_DIRECTORY_LIST DirList) {
+  return sizeof(DOKAN_DIRECTORY_LIST) +
+         DokanVector_GetCapacity(DirList->Entries) *
+             DokanVector_GetItemSize(DirList->Entries) +
+         DokanVector_GetCapacity(DirList->Names) *
+             DokanVector_GetItemSize(DirList->Names);
+}
+
+// Shares the complete listing DirList of the directory Path with the next
+// opens. It is skipped when the directory was invalidated since
+// DirList->CacheGeneration was read, before the listing started.
+VOID InsertDirectoryCache(PDOKAN_INSTANCE DokanInstance, LPCWSTR Path,
+                          PDOKAN_DIRECTORY_LIST DirList) {
+  PDOKAN_DIRECTORY_CACHE cache = DokanInstance->DirectoryCache;
+  DOKAN_DIRECTORY_CACHE_ENTRY *entry;
+  DOKAN_DIRECTORY_CACHE_ENTRY *oldEntry;
+  ULONG length;
+  SIZE_T size;
+
+  if (!cache || DirList->Paged) {
+    return;
+  }
+  length = GetNormalizedPathLength(Path);
+  size = sizeof(DOKAN_DIRECTORY_CACHE_ENTRY) + length * sizeof(WCHAR) +
+         GetDirectoryListSize(DirList);
+  if (size > cache->Budget) {
+    return;
+  }
+  entry = (DOKAN_DIRECTORY_CACHE_ENTRY *)malloc(
+      sizeof(DOKAN_DIRECTORY_CACHE_ENTRY) + length * sizeof(WCHAR));
+  if (!entry) {
+    return;
+  }
+  for (ULONG i = 0; i < length; ++i) {
+    entry->Path[i] = NormalizePathChar(cache, Path[i]);
+  }
+  entry->Path[length] = L'\0';
+  entry->PathLength = length;
+  entry->Hash = HashPath(cache, Path, length);
+  entry->Size = size;
+  entry->DirList = DirList;
+  entry->ExpireTime = GetTickCount64() + cache->Timeout;
+
+  AcquireSRWLockExclusive(&cache->Lock);
+  if (DirList->CacheGeneration != cache->Generation) {
+    ReleaseSRWLockExclusive(&cache->Lock);
+    free(entry);
+    return;
+  }
+  oldEntry = FindDirectoryCacheEntry(cache, Path, length, entry->Hash);
+  if (oldEntry) {
+    RemoveDirectoryCacheEntry(DokanInstance, oldEntry);
+  }
+  while (cache->Bytes + size > cache->Budget) {
+    RemoveDirectoryCacheEntry(
+        DokanInstance,
+        CONTAINING_RECORD(cache->RecentEntries.Blink,
+                          DOKAN_DIRECTORY_CACHE_ENTRY, RecentEntry));
+  }
+  InterlockedIncrement(&DirList->ReferenceCount);
+  InsertHeadList(&cache->Buckets[entry->Hash %
+                                 DOKAN_DIRECTORY_CACHE_BUCKET_COUNT],
+                 &entry->BucketEntry);
+  InsertHeadList(&cache->RecentEntries, &entry->RecentEntry);
+  cache->Bytes += size;
+  ReleaseSRWLockExclusive(&cache->Lock);
+}
+
+// Drops the listings made stale by a change of Path: the one of its parent
+// directory, its own and the ones of the directories below it.
+VOID InvalidateDirectoryCache(PDOKAN_INSTANCE DokanInstance, LPCWSTR Path) {
+  PDOKAN_DIRECTORY_CACHE cache = DokanInstance->DirectoryCache;
+  ULONG length;
+  ULONG parentLength = 0;
+  PLIST_ENTRY listEntry;
+
+  if (!cache || !Path) {
+    return;
+  }
+  length = GetNormalizedPathLength(Path);
+  for (ULONG i = length; i > 0; --i) {
+    if (Path[i - 1] == L'\\' || Path[i - 1] == L'/') {
+      parentLength = i > 1 ? i - 1 : 1;
+      break;
+    }
+  }
+
+  AcquireSRWLockExclusive(&cache->Lock);
+  ++cache->Generation;
+  listEntry = cache->RecentEntries.Flink;
+  while (listEntry != &cache->RecentEntries) {
+    DOKAN_DIRECTORY_CACHE_ENTRY *entry = CONTAINING_RECORD(
+        listEntry, DOKAN_DIRECTORY_CACHE_ENTRY, RecentEntry);
+    listEntry = listEntry->Flink;
+    if ((parentLength > 0 && entry->PathLength == parentLength &&
+         IsDirectoryCachePathPrefix(cache, entry, Path, parentLength)) ||
+        (IsDirectoryCachePathPrefix(cache, entry, Path, length) &&
+         (entry->PathLength == length || length == 1 ||
+          entry->Path[length] == L'\\'))) {
+      RemoveDirectoryCacheEntry(DokanInstance, entry);
+    }
+  }
+  ReleaseSRWLockExclusive(&cache->Lock);
+}
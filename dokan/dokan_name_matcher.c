@@ -0,0 +1,291 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+#include <stdlib.h>
+
+#define DOS_STAR (L'<')
+#define DOS_QM (L'>')
+#define DOS_DOT (L'"')
+
+/**
+ * \struct DOKAN_NAME_MATCHER
+ * \brief Expression of DokanIsNameInExpression prepared for many names
+ *
+ * Each character of the expression is a state of an automaton. A name is
+ * matched by moving the set of active states over its characters once, so
+ * the time is linear in the name length whatever the wildcards are.
+ * The names must still start with the literal characters before the first
+ * wildcard and end with the ones after the last wildcard, which is checked
+ * first.
+ */
+struct _DOKAN_NAME_MATCHER {
+  BOOL IgnoreCase;
+  /** Number of characters of Expression */
+  ULONG Length;
+  /** Number of literal characters before the first wildcard */
+  ULONG PrefixLength;
+  /** Number of literal characters after the last wildcard */
+  ULONG SuffixLength;
+  /** The expression, upper cased when IgnoreCase is set */
+  PWCHAR Expression;
+  /** Active states, Length + 1 entries for the current and next character */
+  PUCHAR CurrentStates;
+  PUCHAR NextStates;
+};
+
+static BOOL IsNameWildcard(WCHAR Char) {
+  return Char == L'*' || Char == L'?' || Char == DOS_STAR || Char == DOS_QM ||
+         Char == DOS_DOT;
+}
+
+WCHAR FoldNameChar(WCHAR Char) {
+  if (Char < 0x80) {
+    return Char >= L'a' && Char <= L'z' ? Char - (L'a' - L'A') : Char;
+  }
+  return towupper(Char);
+}
+
+static SIZE_T GetNameMatcherSize(LPCWSTR Expression) {
+  SIZE_T length = wcslen(Expression);
+  return sizeof(DOKAN_NAME_MATCHER) + (length + 1) * sizeof(WCHAR) +
+         (length + 1) * 2;
+}
+
+// Prepares Expression in Buffer, of GetNameMatcherSize bytes.
+static PDOKAN_NAME_MATCHER InitializeNameMatcher(PVOID Buffer,
+                                                 LPCWSTR Expression,
+                                                 BOOL IgnoreCase) {
+  PDOKAN_NAME_MATCHER matcher = (PDOKAN_NAME_MATCHER)Buffer;
+  ULONG length = (ULONG)wcslen(Expression);
+
+  matcher->IgnoreCase = IgnoreCase;
+  matcher->Length = length;
+  matcher->Expression = (PWCHAR)(matcher + 1);
+  matcher->CurrentStates = (PUCHAR)(matcher->Expression + length + 1);
+  matcher->NextStates = matcher->CurrentStates + length + 1;
+  for (ULONG i = 0; i <= length; ++i) {
+    matcher->Expression[i] =
+        IgnoreCase ? FoldNameChar(Expression[i]) : Expression[i];
+  }
+  matcher->PrefixLength = 0;
+  while (matcher->PrefixLength < length &&
+         !IsNameWildcard(Expression[matcher->PrefixLength])) {
+    ++matcher->PrefixLength;
+  }
+  matcher->SuffixLength = 0;
+  if (matcher->PrefixLength < length) {
+    while (!IsNameWildcard(Expression[length - matcher->SuffixLength - 1])) {
+      ++matcher->SuffixLength;
+    }
+  }
+  return matcher;
+}
+
+PDOKAN_NAME_MATCHER CreateNameMatcher(LPCWSTR Expression, BOOL IgnoreCase) {
+  PVOID buffer = malloc(GetNameMatcherSize(Expression));
+  if (!buffer) {
+    return NULL;
+  }
+  return InitializeNameMatcher(buffer, Expression, IgnoreCase);
+}
+
+VOID DeleteNameMatcher(PDOKAN_NAME_MATCHER Matcher) { free(Matcher); }
+
+static BOOL MatchNameLiterals(PDOKAN_NAME_MATCHER Matcher,
+                              ULONG ExpressionIndex, LPCWSTR Name,
+                              ULONG Count) {
+  for (ULONG i = 0; i < Count; ++i) {
+    WCHAR c = Matcher->IgnoreCase ? FoldNameChar(Name[i]) : Name[i];
+    if (c != Matcher->Expression[ExpressionIndex + i]) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// The states follow the historical recursive matcher exactly, including
+// where it differs from FsRtlIsNameInExpression: DOS_STAR at the start of a
+// name without dot matches nothing, and DOS_QM or '?' at the end of the name
+// move past it, where the name reads as NUL characters.
+BOOL MatchName(PDOKAN_NAME_MATCHER Matcher, LPCWSTR Name) {
+  ULONG length = Matcher->Length;
+  PWCHAR expression = Matcher->Expression;
+  PUCHAR current = Matcher->CurrentStates;
+  PUCHAR next = Matcher->NextStates;
+  PUCHAR swap;
+  SIZE_T nameLength = wcslen(Name);
+  SIZE_T lastDot = 0;
+  BOOL hasDot = FALSE;
+  SIZE_T k;
+
+  if (Matcher->PrefixLength == length) {
+    return nameLength == length &&
+           MatchNameLiterals(Matcher, 0, Name, length);
+  }
+  if (nameLength < Matcher->PrefixLength + Matcher->SuffixLength ||
+      !MatchNameLiterals(Matcher, 0, Name, Matcher->PrefixLength) ||
+      !MatchNameLiterals(Matcher, length - Matcher->SuffixLength,
+                         Name + nameLength - Matcher->SuffixLength,
+                         Matcher->SuffixLength)) {
+    return FALSE;
+  }
+  // A single '*' between the literals matches anything.
+  if (Matcher->PrefixLength + Matcher->SuffixLength + 1 == length &&
+      expression[Matcher->PrefixLength] == L'*') {
+    return TRUE;
+  }
+
+  for (k = 0; k < nameLength; ++k) {
+    if (Name[k] == L'.') {
+      lastDot = k;
+      hasDot = TRUE;
+    }
+  }
+
+  RtlZeroMemory(current, length + 1);
+  current[Matcher->PrefixLength] = 1;
+  for (k = Matcher->PrefixLength;; ++k) {
+    BOOL isDot = k < nameLength && Name[k] == L'.';
+    BOOL dotFollows = hasDot && lastDot > k;
+    BOOL active = FALSE;
+    WCHAR c;
+
+    // States reached without consuming the character, in expression order
+    // since they only move forward.
+    for (ULONG e = 0; e < length; ++e) {
+      if (!current[e]) {
+        continue;
+      }
+      switch (expression[e]) {
+      case L'*':
+        if (e + 1 == length) {
+          return TRUE;
+        }
+        current[e + 1] = 1;
+        break;
+      case DOS_STAR:
+        current[e + 1] = 1;
+        break;
+      case DOS_QM:
+        if (isDot && !dotFollows) {
+          current[e + 1] = 1;
+        }
+        break;
+      case DOS_DOT:
+        if (!isDot) {
+          current[e + 1] = 1;
+        }
+        break;
+      }
+    }
+    if (k == nameLength) {
+      break;
+    }
+
+    c = Matcher->IgnoreCase ? FoldNameChar(Name[k]) : Name[k];
+    RtlZeroMemory(next, length + 1);
+    for (ULONG e = 0; e < length; ++e) {
+      if (!current[e]) {
+        continue;
+      }
+      switch (expression[e]) {
+      case L'*':
+        next[e] = 1;
+        break;
+      case DOS_STAR:
+        // Stops before the last dot, or at the end of the name when there is
+        // no dot left, but never moves from the start of a dotless name.
+        if ((hasDot && k < lastDot) || ((!hasDot || k > lastDot) && k > 0)) {
+          next[e] = 1;
+        }
+        break;
+      case DOS_QM:
+        if (!isDot || dotFollows) {
+          next[e + 1] = 1;
+        }
+        break;
+      case DOS_DOT:
+        if (isDot) {
+          next[e + 1] = 1;
+        }
+        break;
+      case L'?':
+        next[e + 1] = 1;
+        break;
+      default:
+        if (expression[e] == c) {
+          next[e + 1] = 1;
+        }
+        break;
+      }
+      active = active || next[e] || next[e + 1];
+    }
+    if (!active) {
+      return FALSE;
+    }
+    swap = current;
+    current = next;
+    next = swap;
+  }
+  if (current[length]) {
+    return TRUE;
+  }
+
+  // Past the end of the name only literals fail, and only a final '*'
+  // matches since the name is then too short.
+  RtlZeroMemory(next, length + 1);
+  for (ULONG e = 0; e < length; ++e) {
+    if (current[e] && (expression[e] == L'?' || expression[e] == DOS_QM)) {
+      next[e + 1] = 1;
+    }
+  }
+  for (ULONG e = 0; e < length; ++e) {
+    if (!next[e] || !IsNameWildcard(expression[e])) {
+      continue;
+    }
+    if (expression[e] == L'*' && e + 1 == length) {
+      return TRUE;
+    }
+    next[e + 1] = 1;
+  }
+  return FALSE;
+}
+
+BOOL IsNameInExpression(LPCWSTR Expression, LPCWSTR Name, BOOL IgnoreCase) {
+  ULONG64 stackBuffer[DOKAN_NAME_MATCHER_STACK_SIZE / sizeof(ULONG64)];
+  SIZE_T size = GetNameMatcherSize(Expression);
+  PVOID buffer = stackBuffer;
+  BOOL match;
+
+  if (size > sizeof(stackBuffer)) {
+    buffer = malloc(size);
+    if (!buffer) {
+      return FALSE;
+    }
+  }
+  match = MatchName(InitializeNameMatcher(buffer, Expression, IgnoreCase),
+                    Name);
+  if (buffer != stackBuffer) {
+    free(buffer);
+  }
+  return match;
+}
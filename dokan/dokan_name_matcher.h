@@ -0,0 +1,46 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOKAN_NAME_MATCHER_H_
+#define DOKAN_NAME_MATCHER_H_
+
+// Expressions of DokanIsNameInExpression prepared once to match many names in
+// a time linear in their length.
+typedef struct _DOKAN_NAME_MATCHER DOKAN_NAME_MATCHER, *PDOKAN_NAME_MATCHER;
+
+// Matchers of up to this many bytes are prepared on the stack by
+// IsNameInExpression, larger ones on the heap.
+#define DOKAN_NAME_MATCHER_STACK_SIZE 512
+
+// Returns NULL when the matcher cannot be allocated.
+PDOKAN_NAME_MATCHER CreateNameMatcher(LPCWSTR Expression, BOOL IgnoreCase);
+VOID DeleteNameMatcher(PDOKAN_NAME_MATCHER Matcher);
+BOOL MatchName(PDOKAN_NAME_MATCHER Matcher, LPCWSTR Name);
+
+// Matches a single name without keeping the matcher. Returns FALSE when the
+// matcher of a long expression cannot be allocated.
+BOOL IsNameInExpression(LPCWSTR Expression, LPCWSTR Name, BOOL IgnoreCase);
+
+// Upper case of Char as compared by the matchers when ignoring the case. Also
+// folds the paths of the directory cache, so that a listing is shared by the
+// names the matchers consider equal.
+WCHAR FoldNameChar(WCHAR Char);
+
+#endif // DOKAN_NAME_MATCHER_H_
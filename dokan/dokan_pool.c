@@ -23,6 +23,7 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 #include "dokan_vector.h"
 
 #include <assert.h>
+#include <malloc.h>
 #include <threadpoolapiset.h>
 
 #define DOKAN_IO_BATCH_POOL_SIZE 1024
@@ -30,540 +31,1282 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 #define DOKAN_IO_EXTRA_EVENT_POOL_SIZE 128
 #define DOKAN_DIRECTORY_LIST_POOL_SIZE 128
 
-// Global thread pool
-PTP_POOL g_ThreadPool = NULL;
+// Maximum bytes the pools of the larger EVENT_INFORMATION size classes keep.
+#define DOKAN_EVENT_RESULT_CLASS_BUDGET (32 * 1024 * 1024)
+
+// Maximum number of objects a thread can keep in one magazine.
+#define DOKAN_POOL_MAGAZINE_SIZE 32
+// Magazines of large objects are shortened so that a thread does not hold
+// more than about this many bytes per magazine.
+#define DOKAN_POOL_MAGAZINE_BYTES (256 * 1024)
+
+// Interval at which the pools adapt their depot size to the observed demand.
+#define DOKAN_POOL_TRIM_INTERVAL_MS 10000
+
+// Objects of at least this size are allocated with VirtualAllocExNuma by the
+// pools bound to a NUMA node. Smaller objects come from the process heap.
+#define DOKAN_POOL_NUMA_OBJECT_SIZE (64 * 1024)
+
+// Room in front of the pooled EVENT_INFORMATION for their pool set, keeping
+// their alignment.
+#define DOKAN_EVENT_RESULT_HEADER_SIZE MEMORY_ALLOCATION_ALIGNMENT
+
+// Default size of the large buffer pool of a mount.
+#define DOKAN_DEFAULT_LARGE_BUFFER_POOL_SIZE (16 * 1024 * 1024)
+// Granularity of the buffers carved from the large buffer pool.
+#define DOKAN_LARGE_BUFFER_CHUNK_SIZE (64 * 1024)
+// Stride touching the regular pages of the large buffer pool at mount, the
+// smallest page size of Windows.
+#define DOKAN_LARGE_BUFFER_TOUCH_STRIDE 4096
+
+// Serializes the enabling of SeLockMemoryPrivilege around the large page
+// allocations, so that the mounts restoring its previous state do not
+// disable it under each other.
+SRWLOCK g_LockMemoryPrivilegeLock = SRWLOCK_INIT;
+
+/**
+ * \struct DOKAN_POOL_MAGAZINE
+ * \brief Fixed size stack of pooled objects
+ *
+ * Magazines are owned by a single thread while loaded in its
+ * DOKAN_POOL_THREAD_CACHE and are exchanged in bulk with the pool depot.
+ * Only a whole magazine crosses threads, never a single object.
+ */
+typedef struct _DOKAN_POOL_MAGAZINE {
+  /** Depot list entry. Must be first for the SLIST alignment requirement. */
+  SLIST_ENTRY ListEntry;
+  /** Number of objects currently stored in Objects */
+  ULONG Count;
+  PVOID Objects[DOKAN_POOL_MAGAZINE_SIZE];
+} DOKAN_POOL_MAGAZINE, *PDOKAN_POOL_MAGAZINE;
+
+/**
+ * \struct DOKAN_POOL_COUNTERS
+ * \brief Usage counters of an object pool
+ *
+ * Each thread updates its own copy in its DOKAN_POOL_THREAD_CACHE without
+ * interlocked operations. DokanGetPoolStatistics sums them on read.
+ */
+typedef struct _DOKAN_POOL_COUNTERS {
+  /** Pops served from a magazine */
+  LONG64 Hits;
+  /** Pops that had to allocate from the heap */
+  LONG64 Misses;
+  /** Objects given back to the pool */
+  LONG64 Pushes;
+  /** Pushes freed to the heap because the pool was full */
+  LONG64 DroppedPushes;
+} DOKAN_POOL_COUNTERS, *PDOKAN_POOL_COUNTERS;
 
-// Global vector of event buffers
-PDOKAN_VECTOR g_IoBatchBufferPool = NULL;
-CRITICAL_SECTION g_IoBatchBufferCriticalSection;
+typedef struct _DOKAN_OBJECT_POOL DOKAN_OBJECT_POOL, *PDOKAN_OBJECT_POOL;
 
-PDOKAN_VECTOR g_IoEventBufferPool = NULL;
-CRITICAL_SECTION g_IoEventBufferCriticalSection;
+typedef PVOID (*PDOKAN_POOL_ALLOCATE_ROUTINE)(PDOKAN_OBJECT_POOL Pool);
+typedef VOID (*PDOKAN_POOL_FREE_ROUTINE)(PDOKAN_OBJECT_POOL Pool,
+                                         PVOID Object);
 
-PDOKAN_VECTOR g_EventResultPool = NULL;
-CRITICAL_SECTION g_EventResultCriticalSection;
+/**
+ * \struct DOKAN_OBJECT_POOL
+ * \brief Pool of identical objects with a lock-free depot
+ *
+ * Full magazines are kept in FullMagazines and recycled magazine shells in
+ * EmptyMagazines. Both are interlocked SLists so the depot is never locked.
+ *
+ * The number of full magazines the depot keeps adapts to the demand: every
+ * DOKAN_POOL_TRIM_INTERVAL_MS, TrimObjectPool grows it by the magazines that
+ * were missing during the interval or releases the magazines that stayed in
+ * the depot the whole interval.
+ */
+struct _DOKAN_OBJECT_POOL {
+  SLIST_HEADER FullMagazines;
+  SLIST_HEADER EmptyMagazines;
+  /** Pool set owning the pool */
+  PDOKAN_POOL_SET PoolSet;
+  /** Index of this pool in DOKAN_POOL_THREAD_CACHE.Magazines */
+  ULONG CacheIndex;
+  /** Name reported by DokanGetPoolStatistics */
+  LPCWSTR Name;
+  /** Size of the objects allocated by the default allocator */
+  SIZE_T ObjectSize;
+  /**
+   * NUMA node the objects are allocated on with VirtualAllocExNuma or
+   * NUMA_NO_PREFERRED_NODE to allocate them from the process heap.
+   */
+  DWORD NumaNode;
+  /** Number of objects stored in a magazine of this pool */
+  ULONG MagazineSize;
+  /** Current number of full magazines the depot keeps before freeing */
+  volatile LONG MaxFullMagazines;
+  /** Upper bound of MaxFullMagazines */
+  LONG FullMagazinesLimit;
+  /** Lowest depot depth seen since the last trim */
+  volatile LONG MinFullMagazines;
+  /** Objects allocated from the heap since the last trim */
+  volatile LONG Misses;
+  /**
+   * Counters of the exited threads and of the operations done without a
+   * thread cache. Updated with interlocked operations.
+   */
+  DOKAN_POOL_COUNTERS RetiredCounters;
+  /** Objects currently allocated from the heap, cached or handed out */
+  volatile LONG64 LiveObjects;
+  /** Highest value reached by LiveObjects */
+  volatile LONG64 PeakLiveObjects;
+  PDOKAN_POOL_ALLOCATE_ROUTINE Allocate;
+  PDOKAN_POOL_FREE_ROUTINE Free;
+};
 
-PDOKAN_VECTOR g_16KEventResultPool = NULL;
-CRITICAL_SECTION g_16KEventResultCriticalSection;
+typedef enum _DOKAN_POOL_INDEX {
+  DokanPoolIoBatch = 0,
+  DokanPoolIoEvent,
+  DokanPoolFileOpenInfo,
+  DokanPoolDirectoryList,
+  // One pool per EVENT_INFORMATION size class, smallest first.
+  DokanPoolEventResult,
+  DokanPoolCount = DokanPoolEventResult + DOKAN_EVENT_RESULT_CLASS_COUNT
+} DOKAN_POOL_INDEX;
 
-PDOKAN_VECTOR g_32KEventResultPool = NULL;
-CRITICAL_SECTION g_32KEventResultCriticalSection;
+/**
+ * \struct DOKAN_POOL_THREAD_CACHE
+ * \brief Per thread magazines of every object pool
+ *
+ * Each pool has a loaded and a previous magazine. Pop and Push only touch the
+ * loaded one, the previous one avoids going to the depot when a thread
+ * oscillates around a magazine boundary.
+ * Stored in the fiber local storage slot of its DOKAN_POOL_SET so it is
+ * flushed on thread exit, and linked in the set ThreadCaches so its counters
+ * can be read.
+ */
+typedef struct _DOKAN_POOL_THREAD_CACHE {
+  LIST_ENTRY ListEntry;
+  /** Pool set owning the magazines */
+  PDOKAN_POOL_SET PoolSet;
+  struct {
+    PDOKAN_POOL_MAGAZINE Loaded;
+    PDOKAN_POOL_MAGAZINE Previous;
+  } Magazines[DokanPoolCount];
+  DOKAN_POOL_COUNTERS Counters[DokanPoolCount];
+} DOKAN_POOL_THREAD_CACHE, *PDOKAN_POOL_THREAD_CACHE;
 
-PDOKAN_VECTOR g_64KEventResultPool = NULL;
-CRITICAL_SECTION g_64KEventResultCriticalSection;
+/**
+ * \struct DOKAN_POOL_SET
+ * \brief Object pools of a mount
+ *
+ * Each DOKAN_INSTANCE owns one set, or one per NUMA node, so that mounts do
+ * not evict each other buffers or share depots. A set has its own fiber local
+ * storage slot: freeing it when the instance is deleted flushes the
+ * magazines every thread holds for the set.
+ */
+struct _DOKAN_POOL_SET {
+  /** Entry in g_PoolSets */
+  LIST_ENTRY ListEntry;
+  /** Fiber local storage slot holding the DOKAN_POOL_THREAD_CACHE */
+  DWORD CacheFlsIndex;
+  /** Every live DOKAN_POOL_THREAD_CACHE, protected by ThreadCachesLock */
+  LIST_ENTRY ThreadCaches;
+  SRWLOCK ThreadCachesLock;
+  DOKAN_OBJECT_POOL Pools[DokanPoolCount];
+};
 
-PDOKAN_VECTOR g_128KEventResultPool = NULL;
-CRITICAL_SECTION g_128KEventResultCriticalSection;
+/**
+ * \struct DOKAN_LARGE_BUFFER_POOL
+ * \brief Memory the buffers above DOKAN_LARGE_BUFFER_MIN_SIZE are carved from
+ *
+ * The region is committed and its pages touched when the mount is created, so
+ * that large reads and writes neither churn the heap nor fault their pages in,
+ * and no buffer pays the commit under the pool lock. A buffer is a run
+ * of consecutive DOKAN_LARGE_BUFFER_CHUNK_SIZE chunks found first fit in
+ * ChunkBitmap. Buffers not fitting in the free chunks fall back to the size
+ * class pools or the heap.
+ */
+struct _DOKAN_LARGE_BUFFER_POOL {
+  /** Protects ChunkBitmap and the chunk counters */
+  SRWLOCK Lock;
+  PCHAR Region;
+  SIZE_T RegionSize;
+  BOOL LargePages;
+  ULONG ChunkCount;
+  /** One bit per chunk, set while the chunk is in use */
+  ULONG64 *ChunkBitmap;
+  ULONG UsedChunks;
+  ULONG PeakUsedChunks;
+  ULONG64 Allocations;
+  volatile LONG64 Fallbacks;
+};
 
-PDOKAN_VECTOR g_FileInfoPool = NULL;
-CRITICAL_SECTION g_FileInfoCriticalSection;
+// Global thread pool
+PTP_POOL g_ThreadPool = NULL;
+
+// Periodic timer adapting the pools to the demand
+PTP_TIMER g_PoolTrimTimer = NULL;
+
+// Every live DOKAN_POOL_SET, protected by g_PoolSetsLock
+LIST_ENTRY g_PoolSets = {&g_PoolSets, &g_PoolSets};
+SRWLOCK g_PoolSetsLock = SRWLOCK_INIT;
+
+// Counters of the deleted pool sets, protected by g_PoolSetsLock
+DOKAN_POOL_COUNTERS g_DeletedPoolSetsCounters[DokanPoolCount];
+// Name and object size of each pool, the same in every pool set. Kept after
+// the pool sets are deleted to report their counters. Protected by
+// g_PoolSetsLock, NULL names until a pool set is created.
+LPCWSTR g_PoolNames[DokanPoolCount];
+SIZE_T g_PoolObjectSizes[DokanPoolCount];
 
-PDOKAN_VECTOR g_DirectoryListPool = NULL;
-CRITICAL_SECTION g_DirectoryListCriticalSection;
+static const LPCWSTR
+    g_EventResultPoolNames[DOKAN_EVENT_RESULT_CLASS_COUNT] = {
+    L"EventResult4K",   L"EventResult8K",   L"EventResult16K",
+    L"EventResult32K",  L"EventResult64K",  L"EventResult128K",
+    L"EventResult256K", L"EventResult512K", L"EventResult1M"};
 
 PTP_POOL GetThreadPool() { return g_ThreadPool; }
 
-VOID FreeIoEventBuffer(PDOKAN_IO_EVENT IoEvent) {
-  if (IoEvent) {
-    free(IoEvent);
+/////////////////// Heap objects ///////////////////
+PVOID AllocateHeapObject(PDOKAN_OBJECT_POOL Pool) {
+  PVOID object = Pool->Allocate(Pool);
+  if (object) {
+    LONG64 liveObjects = InterlockedIncrement64(&Pool->LiveObjects);
+    LONG64 peakLiveObjects = Pool->PeakLiveObjects;
+    while (liveObjects > peakLiveObjects) {
+      LONG64 previousPeak = InterlockedCompareExchange64(
+          &Pool->PeakLiveObjects, liveObjects, peakLiveObjects);
+      if (previousPeak == peakLiveObjects) {
+        break;
+      }
+      peakLiveObjects = previousPeak;
+    }
   }
+  return object;
 }
 
-int InitializePool() {
-  (void)InitializeCriticalSectionAndSpinCount(&g_IoBatchBufferCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_IoEventBufferCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_EventResultCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_16KEventResultCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_32KEventResultCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_64KEventResultCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_128KEventResultCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_FileInfoCriticalSection,
-                                              0x80000400);
-  (void)InitializeCriticalSectionAndSpinCount(&g_DirectoryListCriticalSection,
-                                              0x80000400);
+VOID FreeHeapObject(PDOKAN_OBJECT_POOL Pool, PVOID Object) {
+  InterlockedDecrement64(&Pool->LiveObjects);
+  Pool->Free(Pool, Object);
+}
 
-  if (g_ThreadPool) {
-    DokanDbgPrint("Dokan Error: Thread pool has already been created.\n");
-    return DOKAN_DRIVER_INSTALL_ERROR;
+VOID AddPoolCounters(PDOKAN_POOL_COUNTERS Total,
+                     const DOKAN_POOL_COUNTERS *Counters) {
+  Total->Hits += Counters->Hits;
+  Total->Misses += Counters->Misses;
+  Total->Pushes += Counters->Pushes;
+  Total->DroppedPushes += Counters->DroppedPushes;
+}
+
+/////////////////// Magazine depot ///////////////////
+PDOKAN_POOL_MAGAZINE AcquireEmptyMagazine(PDOKAN_OBJECT_POOL Pool) {
+  PDOKAN_POOL_MAGAZINE magazine =
+      (PDOKAN_POOL_MAGAZINE)InterlockedPopEntrySList(&Pool->EmptyMagazines);
+  if (!magazine) {
+    magazine = (PDOKAN_POOL_MAGAZINE)_aligned_malloc(
+        sizeof(DOKAN_POOL_MAGAZINE), MEMORY_ALLOCATION_ALIGNMENT);
+    if (!magazine) {
+      return NULL;
+    }
   }
+  magazine->Count = 0;
+  return magazine;
+}
 
-  // It seems this is only needed if LoadLibrary() and FreeLibrary() are used and it should be called by the exe
-  // SetThreadpoolCallbackLibrary(&g_ThreadPoolCallbackEnvironment, hModule);
-  g_ThreadPool = CreateThreadpool(NULL);
-  if (!g_ThreadPool) {
-    DokanDbgPrint("Dokan Error: Failed to create thread pool.\n");
-    return DOKAN_DRIVER_INSTALL_ERROR;
+VOID ReleaseEmptyMagazine(PDOKAN_OBJECT_POOL Pool,
+                          PDOKAN_POOL_MAGAZINE Magazine) {
+  assert(Magazine->Count == 0);
+  if (QueryDepthSList(&Pool->EmptyMagazines) < Pool->MaxFullMagazines) {
+    InterlockedPushEntrySList(&Pool->EmptyMagazines, &Magazine->ListEntry);
+    return;
   }
+  _aligned_free(Magazine);
+}
 
-  g_IoBatchBufferPool =
-      DokanVector_AllocWithCapacity(sizeof(PVOID), DOKAN_IO_BATCH_POOL_SIZE);
-  g_IoEventBufferPool =
-      DokanVector_AllocWithCapacity(sizeof(PVOID), DOKAN_IO_EVENT_POOL_SIZE);
-  g_EventResultPool =
-      DokanVector_AllocWithCapacity(sizeof(PVOID), DOKAN_IO_EVENT_POOL_SIZE);
-  g_16KEventResultPool = DokanVector_AllocWithCapacity(
-      sizeof(PVOID), DOKAN_IO_EXTRA_EVENT_POOL_SIZE);
-  g_32KEventResultPool = DokanVector_AllocWithCapacity(
-      sizeof(PVOID), DOKAN_IO_EXTRA_EVENT_POOL_SIZE);
-  g_64KEventResultPool = DokanVector_AllocWithCapacity(
-      sizeof(PVOID), DOKAN_IO_EXTRA_EVENT_POOL_SIZE);
-  g_128KEventResultPool = DokanVector_AllocWithCapacity(
-      sizeof(PVOID), DOKAN_IO_EXTRA_EVENT_POOL_SIZE);
-  g_FileInfoPool =
-      DokanVector_AllocWithCapacity(sizeof(PVOID), DOKAN_IO_EVENT_POOL_SIZE);
-  g_DirectoryListPool = DokanVector_AllocWithCapacity(
-      sizeof(PVOID), DOKAN_DIRECTORY_LIST_POOL_SIZE);
-  return DOKAN_SUCCESS;
+VOID FreeMagazineObjects(PDOKAN_OBJECT_POOL Pool,
+                         PDOKAN_POOL_MAGAZINE Magazine) {
+  while (Magazine->Count > 0) {
+    FreeHeapObject(Pool, Magazine->Objects[--Magazine->Count]);
+  }
 }
 
-VOID CleanupPool() {
-  if (g_ThreadPool) {
-    CloseThreadpool(g_ThreadPool);
-    g_ThreadPool = NULL;
+VOID ReleaseFullMagazine(PDOKAN_OBJECT_POOL Pool,
+                         PDOKAN_POOL_MAGAZINE Magazine) {
+  if (Magazine->Count == 0) {
+    ReleaseEmptyMagazine(Pool, Magazine);
+    return;
   }
-  //////////////////// IO batch buffer object pool ////////////////////
-  {
-    EnterCriticalSection(&g_IoBatchBufferCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_IoBatchBufferPool); ++i) {
-        FreeIoBatchBuffer(
-            *(PDOKAN_IO_BATCH *)DokanVector_GetItem(g_IoBatchBufferPool, i));
-      }
-      DokanVector_Free(g_IoBatchBufferPool);
-      g_IoBatchBufferPool = NULL;
-    }
-    LeaveCriticalSection(&g_IoBatchBufferCriticalSection);
-    DeleteCriticalSection(&g_IoBatchBufferCriticalSection);
+  if (QueryDepthSList(&Pool->FullMagazines) < Pool->MaxFullMagazines) {
+    InterlockedPushEntrySList(&Pool->FullMagazines, &Magazine->ListEntry);
+    return;
   }
+  // Depot is full, release the objects to the heap.
+  InterlockedExchangeAdd64(&Pool->RetiredCounters.DroppedPushes,
+                           Magazine->Count);
+  FreeMagazineObjects(Pool, Magazine);
+  ReleaseEmptyMagazine(Pool, Magazine);
+}
 
-  //////////////////// IO event buffer object pool ////////////////////
-  {
-    EnterCriticalSection(&g_IoEventBufferCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_IoEventBufferPool); ++i) {
-        FreeIoEventBuffer(
-            *(PDOKAN_IO_EVENT *)DokanVector_GetItem(g_IoEventBufferPool, i));
-      }
-      DokanVector_Free(g_IoEventBufferPool);
-      g_IoEventBufferPool = NULL;
+PDOKAN_POOL_MAGAZINE AcquireFullMagazine(PDOKAN_OBJECT_POOL Pool) {
+  PDOKAN_POOL_MAGAZINE magazine =
+      (PDOKAN_POOL_MAGAZINE)InterlockedPopEntrySList(&Pool->FullMagazines);
+  if (magazine) {
+    // Racy on purpose, the trim only needs an approximation.
+    LONG depth = QueryDepthSList(&Pool->FullMagazines);
+    if (depth < Pool->MinFullMagazines) {
+      Pool->MinFullMagazines = depth;
     }
-    LeaveCriticalSection(&g_IoEventBufferCriticalSection);
-    DeleteCriticalSection(&g_IoEventBufferCriticalSection);
   }
+  return magazine;
+}
 
-  //////////////////// Event result object pool ////////////////////
-  {
-    EnterCriticalSection(&g_EventResultCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_EventResultPool); ++i) {
-        FreeEventResult(
-            *(PEVENT_INFORMATION *)DokanVector_GetItem(g_EventResultPool, i));
-      }
-      DokanVector_Free(g_EventResultPool);
-      g_EventResultPool = NULL;
+VOID DrainMagazineList(PDOKAN_OBJECT_POOL Pool, PSLIST_HEADER List) {
+  PDOKAN_POOL_MAGAZINE magazine;
+  while ((magazine = (PDOKAN_POOL_MAGAZINE)InterlockedPopEntrySList(List)) !=
+         NULL) {
+    FreeMagazineObjects(Pool, magazine);
+    _aligned_free(magazine);
+  }
+}
+
+/////////////////// Thread cache ///////////////////
+VOID WINAPI FlushPoolThreadCache(PVOID FlsData) {
+  PDOKAN_POOL_THREAD_CACHE cache = (PDOKAN_POOL_THREAD_CACHE)FlsData;
+  PDOKAN_POOL_SET poolSet;
+  if (!cache) {
+    return;
+  }
+  poolSet = cache->PoolSet;
+  AcquireSRWLockExclusive(&poolSet->ThreadCachesLock);
+  RemoveEntryList(&cache->ListEntry);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    PDOKAN_POOL_COUNTERS retired = &poolSet->Pools[i].RetiredCounters;
+    InterlockedExchangeAdd64(&retired->Hits, cache->Counters[i].Hits);
+    InterlockedExchangeAdd64(&retired->Misses, cache->Counters[i].Misses);
+    InterlockedExchangeAdd64(&retired->Pushes, cache->Counters[i].Pushes);
+    InterlockedExchangeAdd64(&retired->DroppedPushes,
+                             cache->Counters[i].DroppedPushes);
+  }
+  ReleaseSRWLockExclusive(&poolSet->ThreadCachesLock);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    if (cache->Magazines[i].Loaded) {
+      ReleaseFullMagazine(&poolSet->Pools[i], cache->Magazines[i].Loaded);
+    }
+    if (cache->Magazines[i].Previous) {
+      ReleaseFullMagazine(&poolSet->Pools[i], cache->Magazines[i].Previous);
     }
-    LeaveCriticalSection(&g_EventResultCriticalSection);
-    DeleteCriticalSection(&g_EventResultCriticalSection);
   }
+  free(cache);
+}
 
-  {
-    EnterCriticalSection(&g_16KEventResultCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_16KEventResultPool); ++i) {
-        FreeEventResult(*(PEVENT_INFORMATION *)DokanVector_GetItem(
-            g_16KEventResultPool, i));
-      }
-      DokanVector_Free(g_16KEventResultPool);
-      g_16KEventResultPool = NULL;
+// Returns the calling thread magazines of the pool or NULL if they cannot be
+// allocated, in which case the caller goes straight to the heap.
+PDOKAN_POOL_THREAD_CACHE GetPoolThreadCache(PDOKAN_POOL_SET PoolSet,
+                                            PDOKAN_OBJECT_POOL Pool) {
+  PDOKAN_POOL_THREAD_CACHE cache = NULL;
+  if (PoolSet->CacheFlsIndex == FLS_OUT_OF_INDEXES) {
+    return NULL;
+  }
+  cache = (PDOKAN_POOL_THREAD_CACHE)FlsGetValue(PoolSet->CacheFlsIndex);
+  if (!cache) {
+    cache =
+        (PDOKAN_POOL_THREAD_CACHE)calloc(1, sizeof(DOKAN_POOL_THREAD_CACHE));
+    if (!cache) {
+      return NULL;
+    }
+    cache->PoolSet = PoolSet;
+    if (!FlsSetValue(PoolSet->CacheFlsIndex, cache)) {
+      free(cache);
+      return NULL;
     }
-    LeaveCriticalSection(&g_16KEventResultCriticalSection);
-    DeleteCriticalSection(&g_16KEventResultCriticalSection);
+    AcquireSRWLockExclusive(&PoolSet->ThreadCachesLock);
+    InsertTailList(&PoolSet->ThreadCaches, &cache->ListEntry);
+    ReleaseSRWLockExclusive(&PoolSet->ThreadCachesLock);
   }
+  if (!cache->Magazines[Pool->CacheIndex].Loaded) {
+    cache->Magazines[Pool->CacheIndex].Loaded = AcquireEmptyMagazine(Pool);
+    if (!cache->Magazines[Pool->CacheIndex].Loaded) {
+      return NULL;
+    }
+  }
+  if (!cache->Magazines[Pool->CacheIndex].Previous) {
+    cache->Magazines[Pool->CacheIndex].Previous = AcquireEmptyMagazine(Pool);
+    if (!cache->Magazines[Pool->CacheIndex].Previous) {
+      return NULL;
+    }
+  }
+  return cache;
+}
 
-  {
-    EnterCriticalSection(&g_32KEventResultCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_32KEventResultPool); ++i) {
-        FreeEventResult(*(PEVENT_INFORMATION *)DokanVector_GetItem(
-            g_32KEventResultPool, i));
-      }
-      DokanVector_Free(g_32KEventResultPool);
-      g_32KEventResultPool = NULL;
+/////////////////// Object pool ///////////////////
+VOID InitializeObjectPool(PDOKAN_POOL_SET PoolSet, DOKAN_POOL_INDEX Index,
+                          LPCWSTR Name, SIZE_T ObjectSize, SIZE_T MaxObjects,
+                          DWORD NumaNode,
+                          PDOKAN_POOL_ALLOCATE_ROUTINE Allocate,
+                          PDOKAN_POOL_FREE_ROUTINE Free) {
+  PDOKAN_OBJECT_POOL pool = &PoolSet->Pools[Index];
+  InitializeSListHead(&pool->FullMagazines);
+  InitializeSListHead(&pool->EmptyMagazines);
+  pool->PoolSet = PoolSet;
+  pool->CacheIndex = Index;
+  pool->Name = Name;
+  pool->ObjectSize = ObjectSize;
+  pool->NumaNode = NumaNode;
+  pool->MagazineSize = DOKAN_POOL_MAGAZINE_SIZE;
+  if (ObjectSize * DOKAN_POOL_MAGAZINE_SIZE > DOKAN_POOL_MAGAZINE_BYTES) {
+    pool->MagazineSize = (ULONG)(DOKAN_POOL_MAGAZINE_BYTES / ObjectSize);
+    if (pool->MagazineSize == 0) {
+      pool->MagazineSize = 1;
     }
-    LeaveCriticalSection(&g_32KEventResultCriticalSection);
-    DeleteCriticalSection(&g_32KEventResultCriticalSection);
   }
+  pool->FullMagazinesLimit = (LONG)(MaxObjects / pool->MagazineSize);
+  if (pool->FullMagazinesLimit == 0) {
+    pool->FullMagazinesLimit = 1;
+  }
+  pool->MaxFullMagazines = pool->FullMagazinesLimit;
+  pool->MinFullMagazines = 0;
+  pool->Misses = 0;
+  RtlZeroMemory(&pool->RetiredCounters, sizeof(DOKAN_POOL_COUNTERS));
+  pool->LiveObjects = 0;
+  pool->PeakLiveObjects = 0;
+  pool->Allocate = Allocate;
+  pool->Free = Free;
+}
 
-  {
-    EnterCriticalSection(&g_64KEventResultCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_64KEventResultPool); ++i) {
-        FreeEventResult(*(PEVENT_INFORMATION *)DokanVector_GetItem(
-            g_64KEventResultPool, i));
-      }
-      DokanVector_Free(g_64KEventResultPool);
-      g_64KEventResultPool = NULL;
+VOID CleanupObjectPool(PDOKAN_OBJECT_POOL pool) {
+  DrainMagazineList(pool, &pool->FullMagazines);
+  DrainMagazineList(pool, &pool->EmptyMagazines);
+}
+
+// Adapts the depot size of the pool to the demand seen since the last call.
+VOID TrimObjectPool(PDOKAN_OBJECT_POOL Pool) {
+  LONG misses = InterlockedExchange(&Pool->Misses, 0);
+  LONG idleMagazines =
+      InterlockedExchange(&Pool->MinFullMagazines,
+                          QueryDepthSList(&Pool->FullMagazines));
+  LONG maxFullMagazines = Pool->MaxFullMagazines;
+  PDOKAN_POOL_MAGAZINE magazine;
+
+  if (misses > 0) {
+    // The depot ran dry, keep enough magazines to have served the misses.
+    maxFullMagazines += (misses + Pool->MagazineSize - 1) / Pool->MagazineSize;
+    if (maxFullMagazines > Pool->FullMagazinesLimit) {
+      maxFullMagazines = Pool->FullMagazinesLimit;
     }
-    LeaveCriticalSection(&g_64KEventResultCriticalSection);
-    DeleteCriticalSection(&g_64KEventResultCriticalSection);
+    InterlockedExchange(&Pool->MaxFullMagazines, maxFullMagazines);
+    return;
+  }
+  if (idleMagazines <= 0) {
+    return;
   }
+  // These magazines were never needed during the interval, release them.
+  maxFullMagazines -= idleMagazines;
+  if (maxFullMagazines < 0) {
+    maxFullMagazines = 0;
+  }
+  InterlockedExchange(&Pool->MaxFullMagazines, maxFullMagazines);
+  while (idleMagazines-- > 0 &&
+         (magazine = (PDOKAN_POOL_MAGAZINE)InterlockedPopEntrySList(
+              &Pool->FullMagazines)) != NULL) {
+    FreeMagazineObjects(Pool, magazine);
+    ReleaseEmptyMagazine(Pool, magazine);
+  }
+  while (QueryDepthSList(&Pool->EmptyMagazines) > maxFullMagazines &&
+         (magazine = (PDOKAN_POOL_MAGAZINE)InterlockedPopEntrySList(
+              &Pool->EmptyMagazines)) != NULL) {
+    _aligned_free(magazine);
+  }
+}
 
-  {
-    EnterCriticalSection(&g_128KEventResultCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_128KEventResultPool); ++i) {
-        FreeEventResult(*(PEVENT_INFORMATION *)DokanVector_GetItem(
-            g_128KEventResultPool, i));
-      }
-      DokanVector_Free(g_128KEventResultPool);
-      g_128KEventResultPool = NULL;
+VOID CALLBACK TrimPoolsCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context,
+                                PTP_TIMER Timer) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Context);
+  UNREFERENCED_PARAMETER(Timer);
+  AcquireSRWLockShared(&g_PoolSetsLock);
+  for (PLIST_ENTRY entry = g_PoolSets.Flink; entry != &g_PoolSets;
+       entry = entry->Flink) {
+    PDOKAN_POOL_SET poolSet =
+        CONTAINING_RECORD(entry, DOKAN_POOL_SET, ListEntry);
+    for (ULONG i = 0; i < DokanPoolCount; ++i) {
+      TrimObjectPool(&poolSet->Pools[i]);
     }
-    LeaveCriticalSection(&g_128KEventResultCriticalSection);
-    DeleteCriticalSection(&g_128KEventResultCriticalSection);
   }
+  ReleaseSRWLockShared(&g_PoolSetsLock);
+}
 
-  //////////////////// File info object pool ////////////////////
-  {
-    EnterCriticalSection(&g_FileInfoCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_FileInfoPool); ++i) {
-        FreeFileOpenInfo(
-            *(PDOKAN_OPEN_INFO *)DokanVector_GetItem(g_FileInfoPool, i));
+PVOID PopObject(PDOKAN_POOL_SET PoolSet, DOKAN_POOL_INDEX Index) {
+  PDOKAN_OBJECT_POOL pool = &PoolSet->Pools[Index];
+  PDOKAN_POOL_THREAD_CACHE cache = GetPoolThreadCache(PoolSet, pool);
+  if (cache) {
+    PDOKAN_POOL_MAGAZINE loaded = cache->Magazines[Index].Loaded;
+    PDOKAN_POOL_MAGAZINE previous = cache->Magazines[Index].Previous;
+    if (loaded->Count == 0) {
+      if (previous->Count > 0) {
+        cache->Magazines[Index].Loaded = previous;
+        cache->Magazines[Index].Previous = loaded;
+      } else {
+        PDOKAN_POOL_MAGAZINE full = AcquireFullMagazine(pool);
+        if (full) {
+          ReleaseEmptyMagazine(pool, previous);
+          cache->Magazines[Index].Previous = loaded;
+          cache->Magazines[Index].Loaded = full;
+        }
       }
-      DokanVector_Free(g_FileInfoPool);
-      g_FileInfoPool = NULL;
+      loaded = cache->Magazines[Index].Loaded;
     }
-    LeaveCriticalSection(&g_FileInfoCriticalSection);
-    DeleteCriticalSection(&g_FileInfoCriticalSection);
+    if (loaded->Count > 0) {
+      ++cache->Counters[Index].Hits;
+      return loaded->Objects[--loaded->Count];
+    }
+    ++cache->Counters[Index].Misses;
+  } else {
+    InterlockedIncrement64(&pool->RetiredCounters.Misses);
   }
+  InterlockedIncrement(&pool->Misses);
+  return AllocateHeapObject(pool);
+}
 
-  //////////////////// Directory list pool ////////////////////
-  {
-    EnterCriticalSection(&g_DirectoryListCriticalSection);
-    {
-      for (size_t i = 0; i < DokanVector_GetCount(g_DirectoryListPool); ++i) {
-        DokanVector_Free(
-            *(PDOKAN_VECTOR *)DokanVector_GetItem(g_DirectoryListPool, i));
+VOID PushObject(PDOKAN_POOL_SET PoolSet, DOKAN_POOL_INDEX Index,
+                PVOID Object) {
+  PDOKAN_OBJECT_POOL pool = &PoolSet->Pools[Index];
+  PDOKAN_POOL_THREAD_CACHE cache = GetPoolThreadCache(PoolSet, pool);
+  if (cache) {
+    PDOKAN_POOL_MAGAZINE loaded = cache->Magazines[Index].Loaded;
+    PDOKAN_POOL_MAGAZINE previous = cache->Magazines[Index].Previous;
+    if (loaded->Count == pool->MagazineSize) {
+      if (previous->Count == 0) {
+        cache->Magazines[Index].Loaded = previous;
+        cache->Magazines[Index].Previous = loaded;
+      } else {
+        PDOKAN_POOL_MAGAZINE empty = AcquireEmptyMagazine(pool);
+        if (empty) {
+          ReleaseFullMagazine(pool, previous);
+          cache->Magazines[Index].Previous = loaded;
+          cache->Magazines[Index].Loaded = empty;
+        }
       }
-      DokanVector_Free(g_DirectoryListPool);
-      g_DirectoryListPool = NULL;
+      loaded = cache->Magazines[Index].Loaded;
+    }
+    ++cache->Counters[Index].Pushes;
+    if (loaded->Count < pool->MagazineSize) {
+      loaded->Objects[loaded->Count++] = Object;
+      return;
     }
-    LeaveCriticalSection(&g_DirectoryListCriticalSection);
-    DeleteCriticalSection(&g_DirectoryListCriticalSection);
+    ++cache->Counters[Index].DroppedPushes;
+  } else {
+    InterlockedIncrement64(&pool->RetiredCounters.Pushes);
+    InterlockedIncrement64(&pool->RetiredCounters.DroppedPushes);
   }
+  FreeHeapObject(pool, Object);
+}
 
-  //////////////////// Object pool cleanup finished ////////////////////
+/////////////////// Pool allocators ///////////////////
+PVOID AllocatePoolObject(PDOKAN_OBJECT_POOL Pool) {
+  if (Pool->NumaNode != NUMA_NO_PREFERRED_NODE) {
+    return VirtualAllocExNuma(GetCurrentProcess(), NULL, Pool->ObjectSize,
+                              MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE,
+                              Pool->NumaNode);
+  }
+  return malloc(Pool->ObjectSize);
 }
 
-/////////////////// DOKAN_IO_BATCH ///////////////////
-PDOKAN_IO_BATCH PopIoBatchBuffer() {
-  PDOKAN_IO_BATCH ioBatch = NULL;
-  EnterCriticalSection(&g_IoBatchBufferCriticalSection);
-  {
-    if (DokanVector_GetCount(g_IoBatchBufferPool) > 0) {
-      ioBatch =
-          *(PDOKAN_IO_BATCH *)DokanVector_GetLastItem(g_IoBatchBufferPool);
-      DokanVector_PopBack(g_IoBatchBufferPool);
-    }
-  }
-  LeaveCriticalSection(&g_IoBatchBufferCriticalSection);
-  if (!ioBatch) {
-    ioBatch = (PDOKAN_IO_BATCH)malloc(DOKAN_IO_BATCH_SIZE);
-  }
-  if (ioBatch) {
-    RtlZeroMemory(ioBatch, FIELD_OFFSET(DOKAN_IO_BATCH, EventContext));
-    ioBatch->PoolAllocated = TRUE;
+VOID FreePoolObject(PDOKAN_OBJECT_POOL Pool, PVOID Object) {
+  if (Pool->NumaNode != NUMA_NO_PREFERRED_NODE) {
+    VirtualFree(Object, 0, MEM_RELEASE);
+    return;
   }
-  return ioBatch;
+  free(Object);
 }
 
-VOID FreeIoBatchBuffer(PDOKAN_IO_BATCH IoBatch) {
-  if (IoBatch) {
-    free(IoBatch);
+// Pooled EVENT_INFORMATION are handed around without the event they were
+// popped for, so they are preceded by the pool set they are pushed back to.
+PVOID AllocateEventResultObject(PDOKAN_OBJECT_POOL Pool) {
+  PCHAR object = (PCHAR)AllocatePoolObject(Pool);
+  if (!object) {
+    return NULL;
+  }
+  *(PDOKAN_POOL_SET *)object = Pool->PoolSet;
+  return object + DOKAN_EVENT_RESULT_HEADER_SIZE;
+}
+
+VOID FreeEventResultObject(PDOKAN_OBJECT_POOL Pool, PVOID Object) {
+  FreePoolObject(Pool, (PCHAR)Object - DOKAN_EVENT_RESULT_HEADER_SIZE);
+}
+
+PDOKAN_POOL_SET GetEventResultPoolSet(PEVENT_INFORMATION EventResult) {
+  return *(PDOKAN_POOL_SET *)((PCHAR)EventResult -
+                              DOKAN_EVENT_RESULT_HEADER_SIZE);
+}
+
+PVOID AllocateFileOpenInfo(PDOKAN_OBJECT_POOL Pool) {
+  UNREFERENCED_PARAMETER(Pool);
+  PDOKAN_OPEN_INFO fileInfo =
+      (PDOKAN_OPEN_INFO)malloc(sizeof(DOKAN_OPEN_INFO));
+  if (!fileInfo) {
+    DokanDbgPrint("Dokan Error: Failed to allocate DOKAN_OPEN_INFO.\n");
+    return NULL;
   }
+  RtlZeroMemory(fileInfo, sizeof(DOKAN_OPEN_INFO));
+  InitializeCriticalSection(&fileInfo->CriticalSection);
+  return fileInfo;
 }
 
-VOID PushIoBatchBuffer(PDOKAN_IO_BATCH IoBatch) {
-  assert(IoBatch);
-  LONG currentEventContextBatchCount =
-      InterlockedDecrement(&IoBatch->EventContextBatchCount);
-  if (currentEventContextBatchCount > 0) {
-    return;
+VOID FreeFileOpenInfoObject(PDOKAN_OBJECT_POOL Pool, PVOID Object) {
+  UNREFERENCED_PARAMETER(Pool);
+  FreeFileOpenInfo((PDOKAN_OPEN_INFO)Object);
+}
+
+PVOID AllocateDirectoryList(PDOKAN_OBJECT_POOL Pool) {
+  UNREFERENCED_PARAMETER(Pool);
+  return CreateDirectoryList();
+}
+
+VOID FreeDirectoryListObject(PDOKAN_OBJECT_POOL Pool, PVOID Object) {
+  UNREFERENCED_PARAMETER(Pool);
+  DeleteDirectoryList((PDOKAN_DIRECTORY_LIST)Object);
+}
+
+/////////////////// Pool sets ///////////////////
+PDOKAN_POOL_SET CreatePoolSet(DWORD NumaNode) {
+  PDOKAN_POOL_SET poolSet =
+      (PDOKAN_POOL_SET)_aligned_malloc(sizeof(DOKAN_POOL_SET),
+                                       MEMORY_ALLOCATION_ALIGNMENT);
+  if (!poolSet) {
+    return NULL;
+  }
+  RtlZeroMemory(poolSet, sizeof(DOKAN_POOL_SET));
+  InitializeListHead(&poolSet->ThreadCaches);
+  InitializeSRWLock(&poolSet->ThreadCachesLock);
+
+  InitializeObjectPool(poolSet, DokanPoolIoBatch, L"IoBatch",
+                       DOKAN_IO_BATCH_SIZE, DOKAN_IO_BATCH_POOL_SIZE, NumaNode,
+                       AllocatePoolObject, FreePoolObject);
+  InitializeObjectPool(poolSet, DokanPoolIoEvent, L"IoEvent",
+                       sizeof(DOKAN_IO_EVENT), DOKAN_IO_EVENT_POOL_SIZE,
+                       NUMA_NO_PREFERRED_NODE, AllocatePoolObject,
+                       FreePoolObject);
+  InitializeObjectPool(poolSet, DokanPoolFileOpenInfo, L"FileOpenInfo",
+                       sizeof(DOKAN_OPEN_INFO), DOKAN_IO_EVENT_POOL_SIZE,
+                       NUMA_NO_PREFERRED_NODE, AllocateFileOpenInfo,
+                       FreeFileOpenInfoObject);
+  InitializeObjectPool(poolSet, DokanPoolDirectoryList, L"DirectoryList",
+                       sizeof(DOKAN_DIRECTORY_LIST),
+                       DOKAN_DIRECTORY_LIST_POOL_SIZE,
+                       NUMA_NO_PREFERRED_NODE, AllocateDirectoryList,
+                       FreeDirectoryListObject);
+  for (ULONG sizeClass = 0; sizeClass < DOKAN_EVENT_RESULT_CLASS_COUNT;
+       ++sizeClass) {
+    ULONG bufferSize = DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(sizeClass);
+    SIZE_T objectSize = DOKAN_EVENT_RESULT_HEADER_SIZE +
+                        FIELD_OFFSET(EVENT_INFORMATION, Buffer) + bufferSize;
+    SIZE_T maxObjects = DOKAN_IO_EVENT_POOL_SIZE;
+    if (sizeClass > 0) {
+      maxObjects = DOKAN_EVENT_RESULT_CLASS_BUDGET / bufferSize;
+      if (maxObjects > DOKAN_IO_EXTRA_EVENT_POOL_SIZE) {
+        maxObjects = DOKAN_IO_EXTRA_EVENT_POOL_SIZE;
+      }
+    }
+    InitializeObjectPool(
+        poolSet, (DOKAN_POOL_INDEX)(DokanPoolEventResult + sizeClass),
+        g_EventResultPoolNames[sizeClass], objectSize, maxObjects,
+        objectSize >= DOKAN_POOL_NUMA_OBJECT_SIZE ? NumaNode
+                                                  : NUMA_NO_PREFERRED_NODE,
+        AllocateEventResultObject, FreeEventResultObject);
+  }
+  // The IO batches are only smaller than a page granularity allocation when
+  // EVENT_CONTEXT_MAX_SIZE is reduced.
+  if (DOKAN_IO_BATCH_SIZE < DOKAN_POOL_NUMA_OBJECT_SIZE) {
+    poolSet->Pools[DokanPoolIoBatch].NumaNode = NUMA_NO_PREFERRED_NODE;
   }
-  if (!IoBatch->PoolAllocated) {
-    FreeIoBatchBuffer(IoBatch);
-    return;
+
+  poolSet->CacheFlsIndex = FlsAlloc(FlushPoolThreadCache);
+  if (poolSet->CacheFlsIndex == FLS_OUT_OF_INDEXES) {
+    // Pools still work but every Pop and Push goes to the heap.
+    DokanDbgPrint(
+        "Dokan Warning: Failed to allocate pool thread cache slot.\n");
   }
-  EnterCriticalSection(&g_IoBatchBufferCriticalSection);
-  {
-    if (DokanVector_GetCount(g_IoBatchBufferPool) < DOKAN_IO_BATCH_POOL_SIZE) {
-      DokanVector_PushBack(g_IoBatchBufferPool, &IoBatch);
-      IoBatch = NULL;
+
+  AcquireSRWLockExclusive(&g_PoolSetsLock);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    g_PoolNames[i] = poolSet->Pools[i].Name;
+    g_PoolObjectSizes[i] = poolSet->Pools[i].ObjectSize;
+  }
+  InsertTailList(&g_PoolSets, &poolSet->ListEntry);
+  ReleaseSRWLockExclusive(&g_PoolSetsLock);
+  return poolSet;
+}
+
+// The pool set must no longer be used by any thread.
+VOID DeletePoolSet(PDOKAN_POOL_SET PoolSet) {
+  AcquireSRWLockExclusive(&g_PoolSetsLock);
+  RemoveEntryList(&PoolSet->ListEntry);
+  ReleaseSRWLockExclusive(&g_PoolSetsLock);
+
+  // Flush the magazines of every thread back to the depots.
+  if (PoolSet->CacheFlsIndex != FLS_OUT_OF_INDEXES) {
+    FlsFree(PoolSet->CacheFlsIndex);
+    PoolSet->CacheFlsIndex = FLS_OUT_OF_INDEXES;
+  }
+  AcquireSRWLockExclusive(&g_PoolSetsLock);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    AddPoolCounters(&g_DeletedPoolSetsCounters[i],
+                    &PoolSet->Pools[i].RetiredCounters);
+  }
+  ReleaseSRWLockExclusive(&g_PoolSetsLock);
+  // File infos can hold a directory list, release them first.
+  CleanupObjectPool(&PoolSet->Pools[DokanPoolFileOpenInfo]);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    if (i != DokanPoolFileOpenInfo) {
+      CleanupObjectPool(&PoolSet->Pools[i]);
     }
   }
-  LeaveCriticalSection(&g_IoBatchBufferCriticalSection);
-  if (IoBatch) {
-    FreeIoBatchBuffer(IoBatch);
-  }
+  _aligned_free(PoolSet);
 }
 
-/////////////////// DOKAN_IO_EVENT ///////////////////
-PDOKAN_IO_EVENT PopIoEventBuffer() {
-  PDOKAN_IO_EVENT ioEvent = NULL;
-  EnterCriticalSection(&g_IoEventBufferCriticalSection);
-  {
-    if (DokanVector_GetCount(g_IoEventBufferPool) > 0) {
-      ioEvent =
-          *(PDOKAN_IO_EVENT *)DokanVector_GetLastItem(g_IoEventBufferPool);
-      DokanVector_PopBack(g_IoEventBufferPool);
+/////////////////// Large buffers ///////////////////
+PDOKAN_LARGE_BUFFER_POOL CreateLargeBufferPool(SIZE_T Size,
+                                               BOOL UseLargePages) {
+  PDOKAN_LARGE_BUFFER_POOL pool =
+      (PDOKAN_LARGE_BUFFER_POOL)calloc(1, sizeof(DOKAN_LARGE_BUFFER_POOL));
+  SIZE_T largePageSize = GetLargePageMinimum();
+
+  if (!pool) {
+    return NULL;
+  }
+  InitializeSRWLock(&pool->Lock);
+  pool->RegionSize = (Size + DOKAN_LARGE_BUFFER_CHUNK_SIZE - 1) &
+                     ~((SIZE_T)DOKAN_LARGE_BUFFER_CHUNK_SIZE - 1);
+  // Large pages need SeLockMemoryPrivilege, that is granted to the account
+  // but not enabled in the process token by default. It is only enabled for
+  // the allocation, the pages stay locked once allocated.
+  if (UseLargePages && largePageSize) {
+    BOOL wasEnabled = FALSE;
+    AcquireSRWLockExclusive(&g_LockMemoryPrivilegeLock);
+    if (EnableTokenPrivilegeEx(SE_LOCK_MEMORY_NAME, TRUE, &wasEnabled)) {
+      SIZE_T regionSize =
+          (pool->RegionSize + largePageSize - 1) & ~(largePageSize - 1);
+      pool->Region = (PCHAR)VirtualAlloc(
+          NULL, regionSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+          PAGE_READWRITE);
+      if (pool->Region) {
+        pool->RegionSize = regionSize;
+        pool->LargePages = TRUE;
+      }
+      if (!wasEnabled) {
+        EnableTokenPrivilege(SE_LOCK_MEMORY_NAME, FALSE);
+      }
+    }
+    ReleaseSRWLockExclusive(&g_LockMemoryPrivilegeLock);
+  }
+  if (UseLargePages && !pool->LargePages) {
+    DokanDbgPrint("Dokan Warning: Large pages are not available for the "
+                  "large buffer pool, using regular pages.\n");
+  }
+  if (!pool->Region) {
+    pool->Region = (PCHAR)VirtualAlloc(NULL, pool->RegionSize,
+                                       MEM_RESERVE | MEM_COMMIT,
+                                       PAGE_READWRITE);
+    if (!pool->Region) {
+      free(pool);
+      return NULL;
+    }
+    // Fault the demand zero pages in now rather than on the first I/O.
+    for (SIZE_T offset = 0; offset < pool->RegionSize;
+         offset += DOKAN_LARGE_BUFFER_TOUCH_STRIDE) {
+      ((volatile CHAR *)pool->Region)[offset] = 0;
     }
   }
-  LeaveCriticalSection(&g_IoEventBufferCriticalSection);
-  if (!ioEvent) {
-    ioEvent = (PDOKAN_IO_EVENT)malloc(sizeof(DOKAN_IO_EVENT));
+  pool->ChunkCount = (ULONG)(pool->RegionSize / DOKAN_LARGE_BUFFER_CHUNK_SIZE);
+  pool->ChunkBitmap =
+      (ULONG64 *)calloc((pool->ChunkCount + 63) / 64, sizeof(ULONG64));
+  if (!pool->ChunkBitmap) {
+    VirtualFree(pool->Region, 0, MEM_RELEASE);
+    free(pool);
+    return NULL;
   }
-  if (ioEvent) {
-    RtlZeroMemory(ioEvent, sizeof(DOKAN_IO_EVENT));
+  return pool;
+}
+
+VOID DeleteLargeBufferPool(PDOKAN_LARGE_BUFFER_POOL Pool) {
+  if (!Pool) {
+    return;
   }
-  return ioEvent;
+  VirtualFree(Pool->Region, 0, MEM_RELEASE);
+  free(Pool->ChunkBitmap);
+  free(Pool);
 }
 
-VOID PushIoEventBuffer(PDOKAN_IO_EVENT IoEvent) {
-  assert(IoEvent);
-  EnterCriticalSection(&g_IoEventBufferCriticalSection);
-  {
-    if (DokanVector_GetCount(g_IoEventBufferPool) < DOKAN_IO_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_IoEventBufferPool, &IoEvent);
-      IoEvent = NULL;
+BOOL IsLargeBufferChunkUsed(PDOKAN_LARGE_BUFFER_POOL Pool, ULONG Chunk) {
+  return (Pool->ChunkBitmap[Chunk / 64] >> (Chunk % 64)) & 1;
+}
+
+VOID SetLargeBufferChunks(PDOKAN_LARGE_BUFFER_POOL Pool, ULONG FirstChunk,
+                          ULONG ChunkCount, BOOL Used) {
+  for (ULONG chunk = FirstChunk; chunk < FirstChunk + ChunkCount; ++chunk) {
+    if (Used) {
+      Pool->ChunkBitmap[chunk / 64] |= 1ULL << (chunk % 64);
+    } else {
+      Pool->ChunkBitmap[chunk / 64] &= ~(1ULL << (chunk % 64));
     }
   }
-  LeaveCriticalSection(&g_IoEventBufferCriticalSection);
-  if (IoEvent) {
-    FreeIoEventBuffer(IoEvent);
-  }
 }
 
-/////////////////// EVENT_INFORMATION ///////////////////
-PEVENT_INFORMATION PopEventResult() {
-  PEVENT_INFORMATION eventResult = NULL;
-  EnterCriticalSection(&g_EventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_EventResultPool) > 0) {
-      eventResult =
-          *(PEVENT_INFORMATION *)DokanVector_GetLastItem(g_EventResultPool);
-      DokanVector_PopBack(g_EventResultPool);
+// Returns the first chunk of the first run of ChunkCount free chunks, or
+// Pool->ChunkCount if there is none. Pool lock must be held.
+ULONG FindFreeLargeBufferChunks(PDOKAN_LARGE_BUFFER_POOL Pool,
+                                ULONG ChunkCount) {
+  ULONG runStart = 0;
+  ULONG runLength = 0;
+
+  for (ULONG chunk = 0; chunk < Pool->ChunkCount; ++chunk) {
+    if (chunk % 64 == 0 && Pool->ChunkBitmap[chunk / 64] == MAXULONG64) {
+      // Skip the fully used words.
+      chunk += 63;
+      runLength = 0;
+      continue;
+    }
+    if (IsLargeBufferChunkUsed(Pool, chunk)) {
+      runLength = 0;
+      continue;
+    }
+    if (runLength++ == 0) {
+      runStart = chunk;
+    }
+    if (runLength == ChunkCount) {
+      return runStart;
     }
   }
-  LeaveCriticalSection(&g_EventResultCriticalSection);
-  if (!eventResult) {
-    eventResult = (PEVENT_INFORMATION)malloc(DOKAN_EVENT_INFO_DEFAULT_SIZE);
+  return Pool->ChunkCount;
+}
+
+PVOID PopLargeBuffer(PDOKAN_INSTANCE DokanInstance, SIZE_T Size) {
+  PDOKAN_LARGE_BUFFER_POOL pool = DokanInstance->LargeBufferPool;
+  ULONG chunkCount;
+  ULONG firstChunk;
+
+  if (!pool) {
+    return NULL;
+  }
+  if (Size > pool->RegionSize) {
+    InterlockedIncrement64(&pool->Fallbacks);
+    return NULL;
+  }
+  chunkCount = (ULONG)((Size + DOKAN_LARGE_BUFFER_CHUNK_SIZE - 1) /
+                       DOKAN_LARGE_BUFFER_CHUNK_SIZE);
+  AcquireSRWLockExclusive(&pool->Lock);
+  firstChunk = FindFreeLargeBufferChunks(pool, chunkCount);
+  if (firstChunk < pool->ChunkCount) {
+    SetLargeBufferChunks(pool, firstChunk, chunkCount, TRUE);
+    pool->UsedChunks += chunkCount;
+    pool->PeakUsedChunks = max(pool->PeakUsedChunks, pool->UsedChunks);
+    ++pool->Allocations;
+  }
+  ReleaseSRWLockExclusive(&pool->Lock);
+  if (firstChunk == pool->ChunkCount) {
+    InterlockedIncrement64(&pool->Fallbacks);
+    return NULL;
+  }
+  return pool->Region + (SIZE_T)firstChunk * DOKAN_LARGE_BUFFER_CHUNK_SIZE;
+}
+
+BOOL IsLargeBuffer(PDOKAN_INSTANCE DokanInstance, PVOID Buffer) {
+  PDOKAN_LARGE_BUFFER_POOL pool = DokanInstance->LargeBufferPool;
+  return pool && (PCHAR)Buffer >= pool->Region &&
+         (PCHAR)Buffer < pool->Region + pool->RegionSize;
+}
+
+VOID PushLargeBuffer(PDOKAN_INSTANCE DokanInstance, PVOID Buffer,
+                     SIZE_T Size) {
+  PDOKAN_LARGE_BUFFER_POOL pool = DokanInstance->LargeBufferPool;
+  ULONG firstChunk = (ULONG)(((PCHAR)Buffer - pool->Region) /
+                             DOKAN_LARGE_BUFFER_CHUNK_SIZE);
+  ULONG chunkCount = (ULONG)((Size + DOKAN_LARGE_BUFFER_CHUNK_SIZE - 1) /
+                             DOKAN_LARGE_BUFFER_CHUNK_SIZE);
+
+  assert((PCHAR)Buffer >= pool->Region &&
+         (PCHAR)Buffer + Size <= pool->Region + pool->RegionSize);
+  AcquireSRWLockExclusive(&pool->Lock);
+  SetLargeBufferChunks(pool, firstChunk, chunkCount, FALSE);
+  pool->UsedChunks -= chunkCount;
+  ReleaseSRWLockExclusive(&pool->Lock);
+}
+
+BOOL DOKANAPI DokanGetLargeBufferPoolStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _Out_ PDOKAN_LARGE_BUFFER_POOL_STATISTICS Statistics) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  PDOKAN_LARGE_BUFFER_POOL pool;
+
+  if (!instance || !Statistics || !instance->LargeBufferPool) {
+    return FALSE;
+  }
+  pool = instance->LargeBufferPool;
+  Statistics->PoolSize = pool->RegionSize;
+  Statistics->CommittedBytes = pool->RegionSize;
+  Statistics->LargePages = pool->LargePages;
+  AcquireSRWLockShared(&pool->Lock);
+  Statistics->Allocations = pool->Allocations;
+  Statistics->BytesInUse =
+      (ULONG64)pool->UsedChunks * DOKAN_LARGE_BUFFER_CHUNK_SIZE;
+  Statistics->HighWaterBytes =
+      (ULONG64)pool->PeakUsedChunks * DOKAN_LARGE_BUFFER_CHUNK_SIZE;
+  ReleaseSRWLockShared(&pool->Lock);
+  Statistics->Fallbacks = pool->Fallbacks;
+  return TRUE;
+}
+
+BOOL CreateInstancePools(PDOKAN_INSTANCE DokanInstance, BOOL PerNumaNode) {
+  PDOKAN_OPTIONS options = DokanInstance->DokanOptions;
+  ULONG highestNodeNumber = 0;
+  ULONG poolSetCount = 1;
+
+  assert(!DokanInstance->PoolSets);
+  if (PerNumaNode && GetNumaHighestNodeNumber(&highestNodeNumber) &&
+      highestNodeNumber > 0) {
+    poolSetCount = highestNodeNumber + 1;
+  } else {
+    PerNumaNode = FALSE;
+  }
+  DokanInstance->PoolSets =
+      (PDOKAN_POOL_SET *)calloc(poolSetCount, sizeof(PDOKAN_POOL_SET));
+  if (!DokanInstance->PoolSets) {
+    return FALSE;
+  }
+  for (ULONG i = 0; i < poolSetCount; ++i) {
+    DokanInstance->PoolSets[i] =
+        CreatePoolSet(PerNumaNode ? i : NUMA_NO_PREFERRED_NODE);
+    if (!DokanInstance->PoolSets[i]) {
+      DeleteInstancePools(DokanInstance);
+      return FALSE;
+    }
+    DokanInstance->PoolSetCount = i + 1;
+  }
+  if (options->Options & DOKAN_OPTION_LARGE_BUFFER_POOL) {
+    DokanInstance->LargeBufferPool = CreateLargeBufferPool(
+        options->LargeBufferPoolSize ? options->LargeBufferPoolSize
+                                     : DOKAN_DEFAULT_LARGE_BUFFER_POOL_SIZE,
+        options->Options & DOKAN_OPTION_LARGE_PAGE_BUFFERS);
+    if (!DokanInstance->LargeBufferPool) {
+      DeleteInstancePools(DokanInstance);
+      return FALSE;
+    }
   }
-  if (eventResult) {
-    RtlZeroMemory(eventResult, DOKAN_EVENT_INFO_DEFAULT_SIZE);
+  if (!CreateDirectoryCache(DokanInstance)) {
+    DeleteInstancePools(DokanInstance);
+    return FALSE;
   }
-  return eventResult;
+  return TRUE;
 }
 
-VOID FreeEventResult(PEVENT_INFORMATION EventResult) {
-  if (EventResult) {
-    free(EventResult);
+VOID DeleteInstancePools(PDOKAN_INSTANCE DokanInstance) {
+  if (!DokanInstance->PoolSets) {
+    return;
   }
+  // The cached listings go back to the pool sets.
+  DeleteDirectoryCache(DokanInstance);
+  for (ULONG i = 0; i < DokanInstance->PoolSetCount; ++i) {
+    DeletePoolSet(DokanInstance->PoolSets[i]);
+  }
+  free(DokanInstance->PoolSets);
+  DokanInstance->PoolSets = NULL;
+  DokanInstance->PoolSetCount = 0;
+  DeleteLargeBufferPool(DokanInstance->LargeBufferPool);
+  DokanInstance->LargeBufferPool = NULL;
 }
 
-VOID PushEventResult(PEVENT_INFORMATION EventResult) {
-  assert(EventResult);
-  EnterCriticalSection(&g_EventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_EventResultPool) < DOKAN_IO_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_EventResultPool, &EventResult);
-      EventResult = NULL;
+// Returns the pool set of the instance for the NUMA node of the calling
+// thread.
+PDOKAN_POOL_SET GetInstancePoolSet(PDOKAN_INSTANCE DokanInstance) {
+  assert(DokanInstance && DokanInstance->PoolSets);
+  if (DokanInstance->PoolSetCount > 1) {
+    PROCESSOR_NUMBER processorNumber;
+    USHORT nodeNumber;
+    GetCurrentProcessorNumberEx(&processorNumber);
+    if (GetNumaProcessorNodeEx(&processorNumber, &nodeNumber) &&
+        nodeNumber < DokanInstance->PoolSetCount) {
+      return DokanInstance->PoolSets[nodeNumber];
     }
   }
-  LeaveCriticalSection(&g_EventResultCriticalSection);
-  if (EventResult) {
-    FreeEventResult(EventResult);
-  }
+  return DokanInstance->PoolSets[0];
 }
 
-/////////////////// EVENT_INFORMATION 16K ///////////////////
-PEVENT_INFORMATION Pop16KEventResult() {
-  PEVENT_INFORMATION eventResult = NULL;
-  EnterCriticalSection(&g_16KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_16KEventResultPool) > 0) {
-      eventResult =
-          *(PEVENT_INFORMATION *)DokanVector_GetLastItem(g_16KEventResultPool);
-      DokanVector_PopBack(g_16KEventResultPool);
-    }
+int InitializePool() {
+  if (g_ThreadPool) {
+    DokanDbgPrint("Dokan Error: Thread pool has already been created.\n");
+    return DOKAN_DRIVER_INSTALL_ERROR;
   }
-  LeaveCriticalSection(&g_16KEventResultCriticalSection);
-  if (!eventResult) {
-    eventResult = (PEVENT_INFORMATION)malloc(DOKAN_EVENT_INFO_16K_SIZE);
+
+  // It seems this is only needed if LoadLibrary() and FreeLibrary() are used and it should be called by the exe
+  // SetThreadpoolCallbackLibrary(&g_ThreadPoolCallbackEnvironment, hModule);
+  g_ThreadPool = CreateThreadpool(NULL);
+  if (!g_ThreadPool) {
+    DokanDbgPrint("Dokan Error: Failed to create thread pool.\n");
+    return DOKAN_DRIVER_INSTALL_ERROR;
   }
-  if (eventResult) {
-    RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+
+  g_PoolTrimTimer = CreateThreadpoolTimer(TrimPoolsCallback, NULL, NULL);
+  if (g_PoolTrimTimer) {
+    FILETIME dueTime;
+    ULARGE_INTEGER relativeDueTime;
+    // Negative due time is relative, in 100 nanoseconds unit.
+    relativeDueTime.QuadPart =
+        (ULONGLONG)(-(LONGLONG)DOKAN_POOL_TRIM_INTERVAL_MS * 10000);
+    dueTime.dwLowDateTime = relativeDueTime.LowPart;
+    dueTime.dwHighDateTime = relativeDueTime.HighPart;
+    SetThreadpoolTimer(g_PoolTrimTimer, &dueTime, DOKAN_POOL_TRIM_INTERVAL_MS,
+                       DOKAN_POOL_TRIM_INTERVAL_MS / 10);
+  } else {
+    // Pools keep their initial size.
+    DokanDbgPrint("Dokan Warning: Failed to create pool trim timer.\n");
   }
-  return eventResult;
+  return DOKAN_SUCCESS;
 }
 
-VOID Push16KEventResult(PEVENT_INFORMATION EventResult) {
-  assert(EventResult);
-  EnterCriticalSection(&g_16KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_16KEventResultPool) <
-        DOKAN_IO_EXTRA_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_16KEventResultPool, &EventResult);
-      EventResult = NULL;
-    }
+VOID CleanupPool() {
+  if (g_PoolTrimTimer) {
+    SetThreadpoolTimer(g_PoolTrimTimer, NULL, 0, 0);
+    WaitForThreadpoolTimerCallbacks(g_PoolTrimTimer, TRUE);
+    CloseThreadpoolTimer(g_PoolTrimTimer);
+    g_PoolTrimTimer = NULL;
   }
-  LeaveCriticalSection(&g_16KEventResultCriticalSection);
-  if (EventResult) {
-    FreeEventResult(EventResult);
+  if (g_ThreadPool) {
+    CloseThreadpool(g_ThreadPool);
+    g_ThreadPool = NULL;
   }
+  RtlZeroMemory(g_DeletedPoolSetsCounters, sizeof(g_DeletedPoolSetsCounters));
+  RtlZeroMemory(g_PoolNames, sizeof(g_PoolNames));
+  RtlZeroMemory(g_PoolObjectSizes, sizeof(g_PoolObjectSizes));
 }
 
-/////////////////// EVENT_INFORMATION 32K ///////////////////
-PEVENT_INFORMATION Pop32KEventResult() {
-  PEVENT_INFORMATION eventResult = NULL;
-  EnterCriticalSection(&g_32KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_32KEventResultPool) > 0) {
-      eventResult =
-          *(PEVENT_INFORMATION *)DokanVector_GetLastItem(g_32KEventResultPool);
-      DokanVector_PopBack(g_32KEventResultPool);
+/////////////////// Statistics ///////////////////
+// Adds the counters of the pool set to Counters. g_PoolSetsLock must be held.
+VOID AddPoolSetCounters(PDOKAN_POOL_SET PoolSet,
+                        DOKAN_POOL_COUNTERS Counters[DokanPoolCount]) {
+  AcquireSRWLockShared(&PoolSet->ThreadCachesLock);
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    AddPoolCounters(&Counters[i], &PoolSet->Pools[i].RetiredCounters);
+  }
+  for (PLIST_ENTRY entry = PoolSet->ThreadCaches.Flink;
+       entry != &PoolSet->ThreadCaches; entry = entry->Flink) {
+    PDOKAN_POOL_THREAD_CACHE cache =
+        CONTAINING_RECORD(entry, DOKAN_POOL_THREAD_CACHE, ListEntry);
+    for (ULONG i = 0; i < DokanPoolCount; ++i) {
+      AddPoolCounters(&Counters[i], &cache->Counters[i]);
     }
   }
-  LeaveCriticalSection(&g_32KEventResultCriticalSection);
-  if (!eventResult) {
-    eventResult = (PEVENT_INFORMATION)malloc(DOKAN_EVENT_INFO_32K_SIZE);
+  ReleaseSRWLockShared(&PoolSet->ThreadCachesLock);
+}
+
+VOID FillPoolStatistics(DOKAN_POOL_COUNTERS Counters[DokanPoolCount],
+                        LONG64 HighWaterObjects[DokanPoolCount],
+                        PDOKAN_POOL_STATISTICS Statistics, ULONG Count) {
+  for (ULONG i = 0; i < DokanPoolCount && i < Count; ++i) {
+    LONG64 outstanding =
+        Counters[i].Hits + Counters[i].Misses - Counters[i].Pushes;
+    // Counters of other threads are read while they change.
+    if (outstanding < 0) {
+      outstanding = 0;
+    }
+    Statistics[i].Name = g_PoolNames[i];
+    Statistics[i].ObjectSize = g_PoolObjectSizes[i];
+    Statistics[i].Hits = Counters[i].Hits;
+    Statistics[i].Misses = Counters[i].Misses;
+    Statistics[i].DroppedPushes = Counters[i].DroppedPushes;
+    Statistics[i].HighWaterObjects = HighWaterObjects[i];
+    Statistics[i].ObjectsOutstanding = outstanding;
+    Statistics[i].BytesOutstanding = outstanding * g_PoolObjectSizes[i];
   }
-  if (eventResult) {
-    RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+}
+
+ULONG DOKANAPI DokanGetPoolStatistics(PDOKAN_POOL_STATISTICS Statistics,
+                                      ULONG Count) {
+  DOKAN_POOL_COUNTERS counters[DokanPoolCount];
+  LONG64 highWaterObjects[DokanPoolCount];
+
+  if (!Statistics || Count == 0) {
+    return DokanPoolCount;
+  }
+  RtlZeroMemory(counters, sizeof(counters));
+  RtlZeroMemory(highWaterObjects, sizeof(highWaterObjects));
+  AcquireSRWLockShared(&g_PoolSetsLock);
+  // The counters of the unmounted pool sets are still reported.
+  if (!g_PoolNames[0]) {
+    ReleaseSRWLockShared(&g_PoolSetsLock);
+    return 0;
+  }
+  for (ULONG i = 0; i < DokanPoolCount; ++i) {
+    AddPoolCounters(&counters[i], &g_DeletedPoolSetsCounters[i]);
+  }
+  for (PLIST_ENTRY entry = g_PoolSets.Flink; entry != &g_PoolSets;
+       entry = entry->Flink) {
+    PDOKAN_POOL_SET poolSet =
+        CONTAINING_RECORD(entry, DOKAN_POOL_SET, ListEntry);
+    AddPoolSetCounters(poolSet, counters);
+    for (ULONG i = 0; i < DokanPoolCount; ++i) {
+      highWaterObjects[i] += poolSet->Pools[i].PeakLiveObjects;
+    }
   }
-  return eventResult;
+  FillPoolStatistics(counters, highWaterObjects, Statistics, Count);
+  ReleaseSRWLockShared(&g_PoolSetsLock);
+  return DokanPoolCount;
 }
 
-VOID Push32KEventResult(PEVENT_INFORMATION EventResult) {
-  assert(EventResult);
-  EnterCriticalSection(&g_32KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_32KEventResultPool) <
-        DOKAN_IO_EXTRA_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_32KEventResultPool, &EventResult);
-      EventResult = NULL;
+ULONG DOKANAPI DokanGetInstancePoolStatistics(
+    _In_ DOKAN_HANDLE DokanInstance, PDOKAN_POOL_STATISTICS Statistics,
+    ULONG Count) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_POOL_COUNTERS counters[DokanPoolCount];
+  LONG64 highWaterObjects[DokanPoolCount];
+
+  if (!instance || !instance->PoolSets) {
+    return 0;
+  }
+  if (!Statistics || Count == 0) {
+    return DokanPoolCount;
+  }
+  RtlZeroMemory(counters, sizeof(counters));
+  RtlZeroMemory(highWaterObjects, sizeof(highWaterObjects));
+  AcquireSRWLockShared(&g_PoolSetsLock);
+  for (ULONG i = 0; i < instance->PoolSetCount; ++i) {
+    PDOKAN_POOL_SET poolSet = instance->PoolSets[i];
+    AddPoolSetCounters(poolSet, counters);
+    for (ULONG j = 0; j < DokanPoolCount; ++j) {
+      highWaterObjects[j] += poolSet->Pools[j].PeakLiveObjects;
     }
   }
-  LeaveCriticalSection(&g_32KEventResultCriticalSection);
-  if (EventResult) {
-    FreeEventResult(EventResult);
+  FillPoolStatistics(counters, highWaterObjects, Statistics, Count);
+  ReleaseSRWLockShared(&g_PoolSetsLock);
+  return DokanPoolCount;
+}
+
+/////////////////// DOKAN_IO_BATCH ///////////////////
+PDOKAN_IO_BATCH PopIoBatchBuffer(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_POOL_SET poolSet = GetInstancePoolSet(DokanInstance);
+  PDOKAN_IO_BATCH ioBatch =
+      (PDOKAN_IO_BATCH)PopObject(poolSet, DokanPoolIoBatch);
+  if (ioBatch) {
+    RtlZeroMemory(ioBatch, FIELD_OFFSET(DOKAN_IO_BATCH, EventContext));
+    ioBatch->DokanInstance = DokanInstance;
+    ioBatch->PoolSet = poolSet;
+    ioBatch->PoolAllocated = TRUE;
   }
+  return ioBatch;
 }
 
-/////////////////// EVENT_INFORMATION 64K ///////////////////
-PEVENT_INFORMATION Pop64KEventResult() {
-  PEVENT_INFORMATION eventResult = NULL;
-  EnterCriticalSection(&g_64KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_64KEventResultPool) > 0) {
-      eventResult =
-          *(PEVENT_INFORMATION *)DokanVector_GetLastItem(g_64KEventResultPool);
-      DokanVector_PopBack(g_64KEventResultPool);
-    }
+VOID FreeIoBatchBuffer(PDOKAN_IO_BATCH IoBatch) {
+  if (!IoBatch) {
+    return;
   }
-  LeaveCriticalSection(&g_64KEventResultCriticalSection);
-  if (!eventResult) {
-    eventResult = (PEVENT_INFORMATION)malloc(DOKAN_EVENT_INFO_64K_SIZE);
+  if (IoBatch->LargeBufferSize) {
+    PushLargeBuffer(IoBatch->DokanInstance, IoBatch, IoBatch->LargeBufferSize);
+    return;
+  }
+  free(IoBatch);
+}
+
+VOID PushIoBatchBuffer(PDOKAN_IO_BATCH IoBatch) {
+  assert(IoBatch);
+  LONG currentEventContextBatchCount =
+      InterlockedDecrement(&IoBatch->EventContextBatchCount);
+  if (currentEventContextBatchCount > 0) {
+    return;
   }
-  if (eventResult) {
-    RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+  if (!IoBatch->PoolAllocated) {
+    FreeIoBatchBuffer(IoBatch);
+    return;
   }
-  return eventResult;
+  PushObject(IoBatch->PoolSet, DokanPoolIoBatch, IoBatch);
 }
 
-VOID Push64KEventResult(PEVENT_INFORMATION EventResult) {
-  assert(EventResult);
-  EnterCriticalSection(&g_64KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_64KEventResultPool) <
-        DOKAN_IO_EXTRA_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_64KEventResultPool, &EventResult);
-      EventResult = NULL;
-    }
+/////////////////// DOKAN_IO_EVENT ///////////////////
+PDOKAN_IO_EVENT PopIoEventBuffer(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_POOL_SET poolSet = GetInstancePoolSet(DokanInstance);
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)PopObject(poolSet, DokanPoolIoEvent);
+  if (ioEvent) {
+    POOL_POISON_BUFFER(ioEvent, sizeof(DOKAN_IO_EVENT));
+    RtlZeroMemory(ioEvent, DOKAN_IO_EVENT_RESET_SIZE);
+    ioEvent->DokanInstance = DokanInstance;
+    ioEvent->PoolSet = poolSet;
   }
-  LeaveCriticalSection(&g_64KEventResultCriticalSection);
-  if (EventResult) {
-    FreeEventResult(EventResult);
+  return ioEvent;
+}
+
+VOID PushIoEventBuffer(PDOKAN_IO_EVENT IoEvent) {
+  assert(IoEvent);
+  PushObject(IoEvent->PoolSet, DokanPoolIoEvent, IoEvent);
+}
+
+/////////////////// EVENT_INFORMATION ///////////////////
+ULONG GetEventResultSizeClass(ULONG BufferSize) {
+  ULONG sizeClass = 0;
+  while (DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(sizeClass) < BufferSize) {
+    ++sizeClass;
   }
+  assert(sizeClass < DOKAN_EVENT_RESULT_CLASS_COUNT);
+  return sizeClass;
 }
 
-/////////////////// EVENT_INFORMATION 128K ///////////////////
-PEVENT_INFORMATION Pop128KEventResult() {
-  PEVENT_INFORMATION eventResult = NULL;
-  EnterCriticalSection(&g_128KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_128KEventResultPool) > 0) {
-      eventResult =
-          *(PEVENT_INFORMATION *)DokanVector_GetLastItem(g_128KEventResultPool);
-      DokanVector_PopBack(g_128KEventResultPool);
+PEVENT_INFORMATION PopEventResult(PDOKAN_INSTANCE DokanInstance,
+                                  ULONG BufferSize, PULONG EventResultSize) {
+  ULONG sizeClass;
+  PEVENT_INFORMATION eventResult;
+
+  if (BufferSize > DOKAN_LARGE_BUFFER_MIN_SIZE) {
+    ULONG size = FIELD_OFFSET(EVENT_INFORMATION, Buffer) + BufferSize;
+    eventResult = (PEVENT_INFORMATION)PopLargeBuffer(DokanInstance, size);
+    if (eventResult) {
+      *EventResultSize = size;
+      RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+      POOL_POISON_BUFFER(eventResult->Buffer, BufferSize);
+      return eventResult;
     }
   }
-  LeaveCriticalSection(&g_128KEventResultCriticalSection);
-  if (!eventResult) {
-    eventResult = (PEVENT_INFORMATION)malloc(DOKAN_EVENT_INFO_128K_SIZE);
-  }
-  if (eventResult) {
-    RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+  if (BufferSize > DOKAN_EVENT_RESULT_MAX_POOLED_BUFFER_SIZE) {
+    return NULL;
   }
+  sizeClass = GetEventResultSizeClass(BufferSize);
+  eventResult = (PEVENT_INFORMATION)PopObject(
+      GetInstancePoolSet(DokanInstance),
+      (DOKAN_POOL_INDEX)(DokanPoolEventResult + sizeClass));
+  if (!eventResult) {
+    return NULL;
+  }
+  *EventResultSize = FIELD_OFFSET(EVENT_INFORMATION, Buffer) +
+                     DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(sizeClass);
+  // The buffer is filled by the dispatcher, that clears it when needed.
+  RtlZeroMemory(eventResult, FIELD_OFFSET(EVENT_INFORMATION, Buffer));
+  POOL_POISON_BUFFER(eventResult->Buffer,
+                     DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(sizeClass));
   return eventResult;
 }
 
-VOID Push128KEventResult(PEVENT_INFORMATION EventResult) {
-  assert(EventResult);
-  EnterCriticalSection(&g_128KEventResultCriticalSection);
-  {
-    if (DokanVector_GetCount(g_128KEventResultPool) <
-        DOKAN_IO_EXTRA_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_128KEventResultPool, &EventResult);
-      EventResult = NULL;
-    }
-  }
-  LeaveCriticalSection(&g_128KEventResultCriticalSection);
+VOID FreeEventResult(PEVENT_INFORMATION EventResult) {
   if (EventResult) {
-    FreeEventResult(EventResult);
+    free(EventResult);
   }
 }
 
-/////////////////// DOKAN_OPEN_INFO ///////////////////
-PDOKAN_OPEN_INFO PopFileOpenInfo() {
-  PDOKAN_OPEN_INFO fileInfo = NULL;
-  EnterCriticalSection(&g_FileInfoCriticalSection);
-  {
-    if (DokanVector_GetCount(g_FileInfoPool) > 0) {
-      fileInfo = *(PDOKAN_OPEN_INFO *)DokanVector_GetLastItem(g_FileInfoPool);
-      DokanVector_PopBack(g_FileInfoPool);
-    }
-  }
-  LeaveCriticalSection(&g_FileInfoCriticalSection);
-  if (!fileInfo) {
-    fileInfo = (PDOKAN_OPEN_INFO)malloc(sizeof(DOKAN_OPEN_INFO));
-    if (!fileInfo) {
-      DokanDbgPrint("Dokan Error: Failed to allocate DOKAN_OPEN_INFO.\n");
-      return NULL;
-    }
-    RtlZeroMemory(fileInfo, sizeof(DOKAN_OPEN_INFO));
-    InitializeCriticalSection(&fileInfo->CriticalSection);
+VOID PushEventResult(PDOKAN_INSTANCE DokanInstance,
+                     PEVENT_INFORMATION EventResult, ULONG EventResultSize) {
+  assert(EventResult);
+  ULONG bufferSize =
+      EventResultSize - FIELD_OFFSET(EVENT_INFORMATION, Buffer);
+  if (IsLargeBuffer(DokanInstance, EventResult)) {
+    PushLargeBuffer(DokanInstance, EventResult, EventResultSize);
+    return;
   }
+  ULONG sizeClass = GetEventResultSizeClass(bufferSize);
+  assert(bufferSize == DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(sizeClass));
+  PushObject(GetEventResultPoolSet(EventResult),
+             (DOKAN_POOL_INDEX)(DokanPoolEventResult + sizeClass),
+             EventResult);
+}
+
+/////////////////// DOKAN_OPEN_INFO ///////////////////
+PDOKAN_OPEN_INFO PopFileOpenInfo(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_POOL_SET poolSet = GetInstancePoolSet(DokanInstance);
+  PDOKAN_OPEN_INFO fileInfo =
+      (PDOKAN_OPEN_INFO)PopObject(poolSet, DokanPoolFileOpenInfo);
   if (fileInfo) {
-    fileInfo->DokanInstance = NULL;
+    fileInfo->DokanInstance = DokanInstance;
+    fileInfo->PoolSet = poolSet;
     fileInfo->DirList = NULL;
     fileInfo->DirListSearchPattern= NULL;
+    RtlZeroMemory(&fileInfo->DirListCursor, sizeof(DOKAN_DIR_LIST_CURSOR));
     fileInfo->UnimplementedFindFilesWithPattern = FALSE;
     fileInfo->UserContext = 0;
     fileInfo->EventId = 0;
@@ -572,13 +1315,15 @@ PDOKAN_OPEN_INFO PopFileOpenInfo() {
     fileInfo->CloseFileName = NULL;
     fileInfo->CloseUserContext = 0;
     fileInfo->EventContext = NULL;
+    fileInfo->OrderedDispatchBusy = FALSE;
+    InitializeListHead(&fileInfo->OrderedEvents);
   }
   return fileInfo;
 }
 
 VOID CleanupFileOpenInfo(PDOKAN_OPEN_INFO FileInfo) {
   assert(FileInfo);
-  PDOKAN_VECTOR dirList = NULL;
+  PDOKAN_DIRECTORY_LIST dirList = NULL;
   EnterCriticalSection(&FileInfo->CriticalSection);
   {
     if (FileInfo->DirListSearchPattern) {
@@ -589,11 +1334,12 @@ VOID CleanupFileOpenInfo(PDOKAN_OPEN_INFO FileInfo) {
     if (FileInfo->DirList) {
       dirList = FileInfo->DirList;
       FileInfo->DirList = NULL;
+      RtlZeroMemory(&FileInfo->DirListCursor, sizeof(DOKAN_DIR_LIST_CURSOR));
     }
   }
   LeaveCriticalSection(&FileInfo->CriticalSection);
   if (dirList) {
-    PushDirectoryList(dirList);
+    PushDirectoryList(FileInfo->DokanInstance, dirList);
   }
 }
 
@@ -608,55 +1354,30 @@ VOID FreeFileOpenInfo(PDOKAN_OPEN_INFO FileInfo) {
 VOID PushFileOpenInfo(PDOKAN_OPEN_INFO FileInfo) {
   assert(FileInfo);
   CleanupFileOpenInfo(FileInfo);
-  EnterCriticalSection(&g_FileInfoCriticalSection);
-  {
-    if (DokanVector_GetCount(g_FileInfoPool) < DOKAN_IO_EVENT_POOL_SIZE) {
-      DokanVector_PushBack(g_FileInfoPool, &FileInfo);
-      FileInfo = NULL;
-    }
-  }
-  LeaveCriticalSection(&g_FileInfoCriticalSection);
-  if (FileInfo) {
-    FreeFileOpenInfo(FileInfo);
-  }
+  PushObject(FileInfo->PoolSet, DokanPoolFileOpenInfo, FileInfo);
 }
 
 /////////////////// Directory list ///////////////////
-PDOKAN_VECTOR PopDirectoryList() {
-  PDOKAN_VECTOR directoryList = NULL;
-  EnterCriticalSection(&g_DirectoryListCriticalSection);
-  {
-    if (DokanVector_GetCount(g_DirectoryListPool) > 0) {
-      directoryList =
-          *(PDOKAN_VECTOR *)DokanVector_GetLastItem(g_DirectoryListPool);
-      DokanVector_PopBack(g_DirectoryListPool);
-    }
-  }
-  LeaveCriticalSection(&g_DirectoryListCriticalSection);
-  if (!directoryList) {
-    directoryList = DokanVector_Alloc(sizeof(WIN32_FIND_DATAW));
-  }
+PDOKAN_DIRECTORY_LIST PopDirectoryList(PDOKAN_INSTANCE DokanInstance) {
+  PDOKAN_POOL_SET poolSet = GetInstancePoolSet(DokanInstance);
+  PDOKAN_DIRECTORY_LIST directoryList =
+      (PDOKAN_DIRECTORY_LIST)PopObject(poolSet, DokanPoolDirectoryList);
   if (directoryList) {
-    DokanVector_Clear(directoryList);
+    ClearDirectoryList(directoryList);
+    directoryList->PoolSet = poolSet;
+    directoryList->ReferenceCount = 1;
   }
   return directoryList;
 }
 
-VOID PushDirectoryList(PDOKAN_VECTOR DirectoryList) {
+VOID PushDirectoryList(PDOKAN_INSTANCE DokanInstance,
+                       PDOKAN_DIRECTORY_LIST DirectoryList) {
   assert(DirectoryList);
-  assert(DokanVector_GetItemSize(DirectoryList) == sizeof(WIN32_FIND_DATAW));
-  EnterCriticalSection(&g_DirectoryListCriticalSection);
-  {
-    if (DokanVector_GetCount(g_DirectoryListPool) <
-        DOKAN_DIRECTORY_LIST_POOL_SIZE) {
-      DokanVector_PushBack(g_DirectoryListPool, &DirectoryList);
-      DirectoryList = NULL;
-    }
-  }
-  LeaveCriticalSection(&g_DirectoryListCriticalSection);
-  if (DirectoryList) {
-    DokanVector_Free(DirectoryList);
+  if (InterlockedDecrement(&DirectoryList->ReferenceCount) > 0) {
+    return;
   }
+  UNREFERENCED_PARAMETER(DokanInstance);
+  PushObject(DirectoryList->PoolSet, DokanPoolDirectoryList, DirectoryList);
 }
 
-/////////////////// Push/Pop pattern finished ///////////////////
\ No newline at end of file
+/////////////////// Push/Pop pattern finished ///////////////////
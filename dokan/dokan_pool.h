@@ -32,46 +32,79 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
   ((SIZE_T)(FIELD_OFFSET(DOKAN_IO_BATCH, EventContext)) +                      \
    BATCH_EVENT_CONTEXT_SIZE)
 
-#define DOKAN_EVENT_INFO_16K_SIZE                                              \
-  (FIELD_OFFSET(EVENT_INFORMATION, Buffer) + (16 * 1024))
-#define DOKAN_EVENT_INFO_32K_SIZE                                              \
-  (FIELD_OFFSET(EVENT_INFORMATION, Buffer) + (32 * 1024))
-#define DOKAN_EVENT_INFO_64K_SIZE                                              \
-  (FIELD_OFFSET(EVENT_INFORMATION, Buffer) + (64 * 1024))
-#define DOKAN_EVENT_INFO_128K_SIZE                                             \
-  (FIELD_OFFSET(EVENT_INFORMATION, Buffer) + (128 * 1024))
+// EVENT_INFORMATION buffers are pooled in power of two size classes, from
+// DOKAN_EVENT_INFO_DEFAULT_BUFFER_SIZE up to
+// DOKAN_EVENT_RESULT_MAX_POOLED_BUFFER_SIZE (1 MiB). Larger results are
+// allocated from the heap. With DOKAN_OPTION_LARGE_BUFFER_POOL, results above
+// DOKAN_LARGE_BUFFER_MIN_SIZE come from the large buffer pool of the instance
+// first, then from the size classes or the heap when it has no room for them.
+#define DOKAN_EVENT_RESULT_CLASS_COUNT 9
+#define DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(SizeClass)                        \
+  ((ULONG)DOKAN_EVENT_INFO_DEFAULT_BUFFER_SIZE << (SizeClass))
+#define DOKAN_EVENT_RESULT_MAX_POOLED_BUFFER_SIZE                              \
+  DOKAN_EVENT_RESULT_CLASS_BUFFER_SIZE(DOKAN_EVENT_RESULT_CLASS_COUNT - 1)
+#define DOKAN_LARGE_BUFFER_MIN_SIZE (128 * 1024)
+
+// Pops only reset the part of the objects the library relies on being zero.
+// Debug builds fill the rest with DOKAN_POOL_POISON_BYTE so that reads of
+// uninitialized data stand out.
+#ifdef _DEBUG
+#define DOKAN_POOL_POISON_BYTE 0xDB
+#define POOL_POISON_BUFFER(Buffer, Length)                                     \
+  FillMemory((Buffer), (Length), DOKAN_POOL_POISON_BYTE)
+#else
+#define POOL_POISON_BUFFER(Buffer, Length) ((VOID)0)
+#endif
 
 PTP_POOL GetThreadPool();
 int InitializePool();
 VOID CleanupPool();
 
-PDOKAN_IO_BATCH PopIoBatchBuffer();
+// Creates the object pools owned by the instance, one set per NUMA node when
+// PerNumaNode is TRUE. Pool functions taking a DokanInstance use the set of
+// the NUMA node of the calling thread.
+BOOL CreateInstancePools(PDOKAN_INSTANCE DokanInstance, BOOL PerNumaNode);
+// Releases the instance pools. No thread may use them anymore.
+VOID DeleteInstancePools(PDOKAN_INSTANCE DokanInstance);
+
+// The returned batch is bound to DokanInstance, that is also the pool it is
+// pushed back to.
+PDOKAN_IO_BATCH PopIoBatchBuffer(PDOKAN_INSTANCE DokanInstance);
 VOID PushIoBatchBuffer(PDOKAN_IO_BATCH IoBatch);
 VOID FreeIoBatchBuffer(PDOKAN_IO_BATCH IoBatch);
 
-PDOKAN_IO_EVENT PopIoEventBuffer();
+// The returned event is bound to DokanInstance, that is also the pool it is
+// pushed back to. Fields up to DOKAN_IO_EVENT_RESET_SIZE are cleared.
+PDOKAN_IO_EVENT PopIoEventBuffer(PDOKAN_INSTANCE DokanInstance);
 VOID PushIoEventBuffer(PDOKAN_IO_EVENT IoEvent);
 
-// Default Event size.
-PEVENT_INFORMATION PopEventResult();
-VOID PushEventResult(PEVENT_INFORMATION EventResult);
+// Returns an event whose buffer holds at least BufferSize bytes, or NULL if
+// it cannot be pooled. EventResultSize receives the allocated size that must
+// be given back to PushEventResult. Only the header is cleared, the buffer
+// content is undefined.
+PEVENT_INFORMATION PopEventResult(PDOKAN_INSTANCE DokanInstance,
+                                  ULONG BufferSize, PULONG EventResultSize);
+VOID PushEventResult(PDOKAN_INSTANCE DokanInstance,
+                     PEVENT_INFORMATION EventResult, ULONG EventResultSize);
 VOID FreeEventResult(PEVENT_INFORMATION EventResult);
 
-// Event with extra memory allocated for events holding additional data. 
-PEVENT_INFORMATION Pop16KEventResult();
-VOID Push16KEventResult(PEVENT_INFORMATION EventResult);
-PEVENT_INFORMATION Pop32KEventResult();
-VOID Push32KEventResult(PEVENT_INFORMATION EventResult);
-PEVENT_INFORMATION Pop64KEventResult();
-VOID Push64KEventResult(PEVENT_INFORMATION EventResult);
-PEVENT_INFORMATION Pop128KEventResult();
-VOID Push128KEventResult(PEVENT_INFORMATION EventResult);
-
-PDOKAN_OPEN_INFO PopFileOpenInfo();
+// Returns a buffer of at least Size bytes carved from the large buffer pool of
+// the instance, or NULL if the instance has no pool or it has no room for it.
+// Meant for the buffers larger than DOKAN_LARGE_BUFFER_MIN_SIZE. The buffer
+// must be given back to PushLargeBuffer with the same Size.
+PVOID PopLargeBuffer(PDOKAN_INSTANCE DokanInstance, SIZE_T Size);
+VOID PushLargeBuffer(PDOKAN_INSTANCE DokanInstance, PVOID Buffer, SIZE_T Size);
+// Returns whether Buffer was carved from the large buffer pool of the instance.
+BOOL IsLargeBuffer(PDOKAN_INSTANCE DokanInstance, PVOID Buffer);
+
+// The returned open info is bound to DokanInstance, that is also the pool it
+// is pushed back to.
+PDOKAN_OPEN_INFO PopFileOpenInfo(PDOKAN_INSTANCE DokanInstance);
 VOID PushFileOpenInfo(PDOKAN_OPEN_INFO FileInfo);
 VOID FreeFileOpenInfo(PDOKAN_OPEN_INFO FileInfo);
 
-PDOKAN_VECTOR PopDirectoryList();
-VOID PushDirectoryList(PDOKAN_VECTOR DirectoryList);
+PDOKAN_DIRECTORY_LIST PopDirectoryList(PDOKAN_INSTANCE DokanInstance);
+VOID PushDirectoryList(PDOKAN_INSTANCE DokanInstance,
+                       PDOKAN_DIRECTORY_LIST DirectoryList);
 
 #endif
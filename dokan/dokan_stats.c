@@ -0,0 +1,227 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+// Times below DOKAN_LATENCY_EXACT_BUCKETS microseconds have their own bucket,
+// longer ones share the bucket of their 3 highest bits.
+#define DOKAN_LATENCY_SUB_BUCKET_BITS 3
+#define DOKAN_LATENCY_EXACT_BUCKETS (1 << DOKAN_LATENCY_SUB_BUCKET_BITS)
+
+LONG64 GetPerformanceCounter() {
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return counter.QuadPart;
+}
+
+ULONG GetOperationSlot(PEVENT_CONTEXT EventContext) {
+  ULONG informationClass;
+  switch (EventContext->MajorFunction) {
+  case IRP_MJ_QUERY_INFORMATION:
+    informationClass = EventContext->Operation.File.FileInformationClass;
+    if (informationClass < DOKAN_FILE_INFORMATION_CLASS_COUNT) {
+      return DOKAN_OPERATION_QUERY_INFORMATION_SLOT + informationClass;
+    }
+    break;
+  case IRP_MJ_SET_INFORMATION:
+    informationClass = EventContext->Operation.SetFile.FileInformationClass;
+    if (informationClass < DOKAN_FILE_INFORMATION_CLASS_COUNT) {
+      return DOKAN_OPERATION_SET_INFORMATION_SLOT + informationClass;
+    }
+    break;
+  }
+  // Driver log messages and unknown classes are not measured.
+  return EventContext->MajorFunction < DOKAN_MAJOR_FUNCTION_COUNT
+             ? EventContext->MajorFunction
+             : DOKAN_OPERATION_SLOT_COUNT;
+}
+
+ULONG GetLatencyBucket(ULONG64 Microseconds) {
+  ULONG value = (ULONG)min(Microseconds, (ULONG64)MAXULONG);
+  ULONG highestBit;
+  if (value < DOKAN_LATENCY_EXACT_BUCKETS) {
+    return value;
+  }
+  _BitScanReverse(&highestBit, value);
+  return DOKAN_LATENCY_EXACT_BUCKETS +
+         (highestBit - DOKAN_LATENCY_SUB_BUCKET_BITS) *
+             DOKAN_LATENCY_EXACT_BUCKETS +
+         ((value >> (highestBit - DOKAN_LATENCY_SUB_BUCKET_BITS)) &
+          (DOKAN_LATENCY_EXACT_BUCKETS - 1));
+}
+
+ULONG64 DOKANAPI DokanGetLatencyBucketStart(ULONG Bucket) {
+  ULONG shift;
+  if (Bucket < DOKAN_LATENCY_EXACT_BUCKETS) {
+    return Bucket;
+  }
+  Bucket = min(Bucket, DOKAN_LATENCY_HISTOGRAM_BUCKET_COUNT - 1);
+  shift = (Bucket - DOKAN_LATENCY_EXACT_BUCKETS) / DOKAN_LATENCY_EXACT_BUCKETS;
+  return (ULONG64)(DOKAN_LATENCY_EXACT_BUCKETS +
+                   Bucket % DOKAN_LATENCY_EXACT_BUCKETS)
+         << shift;
+}
+
+// Returns the counters of the operation, allocating them on first use.
+DOKAN_OPERATION_COUNTERS *GetOperationCounters(PDOKAN_INSTANCE DokanInstance,
+                                               ULONG OperationSlot) {
+  DOKAN_OPERATION_COUNTERS *counters =
+      DokanInstance->OperationCounters[OperationSlot];
+  DOKAN_OPERATION_COUNTERS *newCounters;
+  if (counters) {
+    return counters;
+  }
+  newCounters = (DOKAN_OPERATION_COUNTERS *)calloc(
+      1, sizeof(DOKAN_OPERATION_COUNTERS));
+  if (!newCounters) {
+    return NULL;
+  }
+  counters = (DOKAN_OPERATION_COUNTERS *)InterlockedCompareExchangePointer(
+      (PVOID volatile *)&DokanInstance->OperationCounters[OperationSlot],
+      newCounters, NULL);
+  if (counters) {
+    // Another thread allocated them first.
+    free(newCounters);
+    return counters;
+  }
+  return newCounters;
+}
+
+VOID RecordOperationStage(PDOKAN_INSTANCE DokanInstance, ULONG OperationSlot,
+                          ULONG Stage, LONG64 Ticks) {
+  DOKAN_OPERATION_COUNTERS *counters;
+  PDOKAN_LATENCY_HISTOGRAM histogram;
+  LONG64 microseconds;
+  LONG64 maxUs;
+
+  if (OperationSlot >= DOKAN_OPERATION_SLOT_COUNT) {
+    return;
+  }
+  counters = GetOperationCounters(DokanInstance, OperationSlot);
+  if (!counters) {
+    return;
+  }
+  histogram = &counters->Stages[Stage];
+  microseconds =
+      Ticks > 0 ? Ticks * 1000000 / DokanInstance->TicksPerSecond : 0;
+  InterlockedIncrement64(
+      (LONG64 volatile *)&histogram->Buckets[GetLatencyBucket(microseconds)]);
+  InterlockedIncrement64((LONG64 volatile *)&histogram->Count);
+  InterlockedAdd64((LONG64 volatile *)&histogram->TotalUs, microseconds);
+  maxUs = (LONG64)histogram->MaxUs;
+  while (microseconds > maxUs) {
+    LONG64 previousMaxUs = InterlockedCompareExchange64(
+        (LONG64 volatile *)&histogram->MaxUs, microseconds, maxUs);
+    if (previousMaxUs == maxUs) {
+      break;
+    }
+    maxUs = previousMaxUs;
+  }
+}
+
+// Counts the time the replies waited since their result was ready and adds
+// them to the timeline.
+VOID RecordReplies(PDOKAN_INSTANCE DokanInstance, DOKAN_QUEUED_REPLY *Replies,
+                   ULONG Count) {
+  LONG64 now = GetPerformanceCounter();
+  for (ULONG i = 0; i < Count; ++i) {
+    ULONG slot = Replies[i].OperationSlot;
+    RecordOperationStage(DokanInstance, slot, DOKAN_OPERATION_STAGE_REPLY,
+                         now - Replies[i].ReadyTime);
+    RecordTimeline(DokanInstance, DOKAN_TIMELINE_REPLY,
+                   (UCHAR)(slot >= DOKAN_OPERATION_SET_INFORMATION_SLOT
+                               ? IRP_MJ_SET_INFORMATION
+                           : slot >= DOKAN_OPERATION_QUERY_INFORMATION_SLOT
+                               ? IRP_MJ_QUERY_INFORMATION
+                               : slot),
+                   Replies[i].EventResult->SerialNumber);
+  }
+}
+
+VOID FreeOperationCounters(PDOKAN_INSTANCE DokanInstance) {
+  for (ULONG i = 0; i < DOKAN_OPERATION_SLOT_COUNT; ++i) {
+    free(DokanInstance->OperationCounters[i]);
+    DokanInstance->OperationCounters[i] = NULL;
+  }
+}
+
+ULONG64 ReadLatencyCounter(ULONG64 *Counter, BOOL Reset) {
+  LONG64 volatile *counter = (LONG64 volatile *)Counter;
+  return (ULONG64)(Reset ? InterlockedExchange64(counter, 0)
+                         : InterlockedCompareExchange64(counter, 0, 0));
+}
+
+VOID ReadLatencyHistogram(PDOKAN_LATENCY_HISTOGRAM Histogram,
+                          PDOKAN_LATENCY_HISTOGRAM Snapshot, BOOL Reset) {
+  Snapshot->Count = ReadLatencyCounter(&Histogram->Count, Reset);
+  Snapshot->TotalUs = ReadLatencyCounter(&Histogram->TotalUs, Reset);
+  Snapshot->MaxUs = ReadLatencyCounter(&Histogram->MaxUs, Reset);
+  for (ULONG i = 0; i < DOKAN_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+    Snapshot->Buckets[i] = ReadLatencyCounter(&Histogram->Buckets[i], Reset);
+  }
+}
+
+ULONG DOKANAPI DokanGetOperationStatistics(
+    _In_ DOKAN_HANDLE DokanInstance, PDOKAN_OPERATION_STATISTICS Statistics,
+    ULONG Count, BOOL Reset) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  ULONG operationCount = 0;
+
+  if (!instance) {
+    return 0;
+  }
+  for (ULONG slot = 0; slot < DOKAN_OPERATION_SLOT_COUNT; ++slot) {
+    DOKAN_OPERATION_COUNTERS *counters = instance->OperationCounters[slot];
+    ULONG64 eventCount = 0;
+    if (!counters) {
+      continue;
+    }
+    for (ULONG stage = 0; stage < DOKAN_OPERATION_STAGE_COUNT; ++stage) {
+      eventCount += ReadLatencyCounter(&counters->Stages[stage].Count, FALSE);
+    }
+    if (!eventCount) {
+      continue;
+    }
+    if (Statistics && operationCount < Count) {
+      PDOKAN_OPERATION_STATISTICS statistics = &Statistics[operationCount];
+      if (slot >= DOKAN_OPERATION_SET_INFORMATION_SLOT) {
+        statistics->MajorFunction = IRP_MJ_SET_INFORMATION;
+        statistics->FileInformationClass =
+            slot - DOKAN_OPERATION_SET_INFORMATION_SLOT;
+      } else if (slot >= DOKAN_OPERATION_QUERY_INFORMATION_SLOT) {
+        statistics->MajorFunction = IRP_MJ_QUERY_INFORMATION;
+        statistics->FileInformationClass =
+            slot - DOKAN_OPERATION_QUERY_INFORMATION_SLOT;
+      } else {
+        statistics->MajorFunction = slot;
+        statistics->FileInformationClass = 0;
+      }
+      ReadLatencyHistogram(
+          &counters->Stages[DOKAN_OPERATION_STAGE_QUEUE_WAIT],
+          &statistics->QueueWait, Reset);
+      ReadLatencyHistogram(&counters->Stages[DOKAN_OPERATION_STAGE_CALLBACK],
+                           &statistics->Callback, Reset);
+      ReadLatencyHistogram(&counters->Stages[DOKAN_OPERATION_STAGE_REPLY],
+                           &statistics->Reply, Reset);
+    }
+    ++operationCount;
+  }
+  return operationCount;
+}
@@ -0,0 +1,376 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+#include <stdlib.h>
+#include <strsafe.h>
+
+// Number of entries kept per thread, a power of two.
+#define DOKAN_TIMELINE_RING_SIZE 4096
+
+// Size of the buffer the JSON is written with.
+#define DOKAN_TIMELINE_WRITE_BUFFER_SIZE (64 * 1024)
+
+typedef struct _DOKAN_TIMELINE_ENTRY {
+  /** Performance counter when the entry was recorded */
+  LONG64 Time;
+  PDOKAN_INSTANCE DokanInstance;
+  ULONG ThreadId;
+  /** Serial number of the event, or number of events for TIMELINE_PULLED */
+  ULONG Value;
+  UCHAR Kind;
+  UCHAR MajorFunction;
+} DOKAN_TIMELINE_ENTRY;
+
+/**
+ * \struct DOKAN_TIMELINE_RING
+ * \brief Last timeline entries recorded by a thread
+ *
+ * Only written by its thread. A ring left by an exited thread is reused by
+ * the next thread needing one, so there are no more rings than threads
+ * recording at once.
+ */
+typedef struct _DOKAN_TIMELINE_RING {
+  LIST_ENTRY ListEntry;
+  /** Whether a thread records in the ring. Protected by g_TimelineLock. */
+  BOOL InUse;
+  /** Number of entries ever recorded, the next one goes to Next % size */
+  volatile LONG64 Next;
+  DOKAN_TIMELINE_ENTRY Entries[DOKAN_TIMELINE_RING_SIZE];
+} DOKAN_TIMELINE_RING;
+
+// TLS slot holding the DOKAN_TIMELINE_RING of the current thread.
+DWORD g_TimelineTlsIndex = TLS_OUT_OF_INDEXES;
+// Protects g_TimelineRings and the InUse of the rings.
+SRWLOCK g_TimelineLock = SRWLOCK_INIT;
+// Every DOKAN_TIMELINE_RING allocated.
+LIST_ENTRY g_TimelineRings;
+
+VOID InitializeTimeline() {
+  InitializeListHead(&g_TimelineRings);
+  g_TimelineTlsIndex = TlsAlloc();
+}
+
+VOID CleanupTimeline() {
+  AcquireSRWLockExclusive(&g_TimelineLock);
+  while (!IsListEmpty(&g_TimelineRings)) {
+    PLIST_ENTRY entry = RemoveHeadList(&g_TimelineRings);
+    free(CONTAINING_RECORD(entry, DOKAN_TIMELINE_RING, ListEntry));
+  }
+  ReleaseSRWLockExclusive(&g_TimelineLock);
+  if (g_TimelineTlsIndex != TLS_OUT_OF_INDEXES) {
+    TlsFree(g_TimelineTlsIndex);
+    g_TimelineTlsIndex = TLS_OUT_OF_INDEXES;
+  }
+}
+
+VOID ReleaseTimelineRing() {
+  DOKAN_TIMELINE_RING *ring;
+
+  if (g_TimelineTlsIndex == TLS_OUT_OF_INDEXES) {
+    return;
+  }
+  ring = (DOKAN_TIMELINE_RING *)TlsGetValue(g_TimelineTlsIndex);
+  if (!ring) {
+    return;
+  }
+  AcquireSRWLockExclusive(&g_TimelineLock);
+  ring->InUse = FALSE;
+  ReleaseSRWLockExclusive(&g_TimelineLock);
+  TlsSetValue(g_TimelineTlsIndex, NULL);
+}
+
+DOKAN_TIMELINE_RING *GetTimelineRing() {
+  DOKAN_TIMELINE_RING *ring;
+
+  if (g_TimelineTlsIndex == TLS_OUT_OF_INDEXES) {
+    return NULL;
+  }
+  ring = (DOKAN_TIMELINE_RING *)TlsGetValue(g_TimelineTlsIndex);
+  if (ring) {
+    return ring;
+  }
+  AcquireSRWLockExclusive(&g_TimelineLock);
+  for (PLIST_ENTRY entry = g_TimelineRings.Flink; entry != &g_TimelineRings;
+       entry = entry->Flink) {
+    DOKAN_TIMELINE_RING *unusedRing =
+        CONTAINING_RECORD(entry, DOKAN_TIMELINE_RING, ListEntry);
+    if (!unusedRing->InUse) {
+      ring = unusedRing;
+      break;
+    }
+  }
+  if (!ring) {
+    ring = (DOKAN_TIMELINE_RING *)malloc(sizeof(DOKAN_TIMELINE_RING));
+    if (ring) {
+      ring->Next = 0;
+      InsertTailList(&g_TimelineRings, &ring->ListEntry);
+    }
+  }
+  if (ring) {
+    ring->InUse = TRUE;
+  }
+  ReleaseSRWLockExclusive(&g_TimelineLock);
+  if (ring) {
+    TlsSetValue(g_TimelineTlsIndex, ring);
+  }
+  return ring;
+}
+
+VOID RecordTimeline(PDOKAN_INSTANCE DokanInstance, UCHAR Kind,
+                    UCHAR MajorFunction, ULONG Value) {
+  DOKAN_TIMELINE_RING *ring;
+  DOKAN_TIMELINE_ENTRY *entry;
+
+  if (!(DokanInstance->DokanOptions->Options & DOKAN_OPTION_EVENT_TIMELINE)) {
+    return;
+  }
+  ring = GetTimelineRing();
+  if (!ring) {
+    return;
+  }
+  entry = &ring->Entries[ring->Next & (DOKAN_TIMELINE_RING_SIZE - 1)];
+  entry->Time = GetPerformanceCounter();
+  entry->DokanInstance = DokanInstance;
+  entry->ThreadId = GetCurrentThreadId();
+  entry->Value = Value;
+  entry->Kind = Kind;
+  entry->MajorFunction = MajorFunction;
+  // Publishes the entry to DokanWriteEventTimeline.
+  InterlockedIncrement64(&ring->Next);
+}
+
+const char *GetMajorFunctionName(UCHAR MajorFunction) {
+  static const char *names[DOKAN_MAJOR_FUNCTION_COUNT] = {
+      "Create", "CreateNamedPipe", "Close", "Read", "Write",
+      "QueryInformation", "SetInformation", "QueryEa", "SetEa",
+      "FlushBuffers", "QueryVolumeInformation", "SetVolumeInformation",
+      "DirectoryControl", "FileSystemControl", "DeviceControl",
+      "InternalDeviceControl", "Shutdown", "LockControl", "Cleanup",
+      "CreateMailslot", "QuerySecurity", "SetSecurity", "Power",
+      "SystemControl", "DeviceChange", "QueryQuota", "SetQuota", "Pnp"};
+  if (MajorFunction == DOKAN_IRP_LOG_MESSAGE) {
+    return "DriverLog";
+  }
+  return MajorFunction < DOKAN_MAJOR_FUNCTION_COUNT ? names[MajorFunction]
+                                                    : "Unknown";
+}
+
+// Copies the entries of the instance still in the rings. Returns FALSE if they
+// cannot be allocated.
+BOOL CopyTimelineEntries(PDOKAN_INSTANCE DokanInstance,
+                         DOKAN_TIMELINE_ENTRY **Entries, PULONG Count) {
+  DOKAN_TIMELINE_ENTRY *entries = NULL;
+  ULONG ringCount = 0;
+  ULONG count = 0;
+
+  AcquireSRWLockShared(&g_TimelineLock);
+  for (PLIST_ENTRY entry = g_TimelineRings.Flink; entry != &g_TimelineRings;
+       entry = entry->Flink) {
+    ++ringCount;
+  }
+  if (ringCount) {
+    entries = (DOKAN_TIMELINE_ENTRY *)malloc(
+        (SIZE_T)ringCount * DOKAN_TIMELINE_RING_SIZE *
+        sizeof(DOKAN_TIMELINE_ENTRY));
+    if (!entries) {
+      ReleaseSRWLockShared(&g_TimelineLock);
+      return FALSE;
+    }
+  }
+  for (PLIST_ENTRY entry = g_TimelineRings.Flink; entry != &g_TimelineRings;
+       entry = entry->Flink) {
+    DOKAN_TIMELINE_RING *ring =
+        CONTAINING_RECORD(entry, DOKAN_TIMELINE_RING, ListEntry);
+    LONG64 end = InterlockedCompareExchange64(&ring->Next, 0, 0);
+    LONG64 begin = max(end - DOKAN_TIMELINE_RING_SIZE, 0);
+    ULONG first = count;
+    for (LONG64 i = begin; i < end; ++i) {
+      entries[count++] = ring->Entries[i & (DOKAN_TIMELINE_RING_SIZE - 1)];
+    }
+    // The thread may have overwritten the oldest entries meanwhile, up to
+    // the one it is writing now.
+    LONG64 next = InterlockedCompareExchange64(&ring->Next, 0, 0);
+    LONG64 valid = max(begin, next - DOKAN_TIMELINE_RING_SIZE + 1);
+    ULONG kept = first;
+    for (ULONG i = first; i < count; ++i) {
+      if (begin + (i - first) >= valid &&
+          entries[i].DokanInstance == DokanInstance) {
+        entries[kept++] = entries[i];
+      }
+    }
+    count = kept;
+  }
+  ReleaseSRWLockShared(&g_TimelineLock);
+  *Entries = entries;
+  *Count = count;
+  return TRUE;
+}
+
+typedef struct _DOKAN_TIMELINE_WRITER {
+  HANDLE File;
+  CHAR Buffer[DOKAN_TIMELINE_WRITE_BUFFER_SIZE];
+  size_t Used;
+  BOOL Failed;
+} DOKAN_TIMELINE_WRITER;
+
+VOID FlushTimelineWriter(DOKAN_TIMELINE_WRITER *Writer) {
+  DWORD written;
+  if (Writer->Used && !Writer->Failed &&
+      !WriteFile(Writer->File, Writer->Buffer, (DWORD)Writer->Used, &written,
+                 NULL)) {
+    Writer->Failed = TRUE;
+  }
+  Writer->Used = 0;
+}
+
+VOID WriteTimelineLine(DOKAN_TIMELINE_WRITER *Writer, const char *Format,
+                       ...) {
+  CHAR line[512];
+  size_t length;
+  va_list args;
+
+  va_start(args, Format);
+  if (FAILED(StringCchVPrintfA(line, sizeof(line), Format, args))) {
+    va_end(args);
+    return;
+  }
+  va_end(args);
+  length = strlen(line);
+  if (Writer->Used + length > sizeof(Writer->Buffer)) {
+    FlushTimelineWriter(Writer);
+  }
+  CopyMemory(Writer->Buffer + Writer->Used, line, length);
+  Writer->Used += length;
+}
+
+// Writes the entry as Chrome trace events. Dispatches are spans on their
+// thread, linked to the thread that queued them by a flow arrow.
+VOID WriteTimelineEntry(DOKAN_TIMELINE_WRITER *Writer,
+                        DOKAN_TIMELINE_ENTRY *Entry, LONG64 StartTime,
+                        LONG64 TicksPerSecond, DWORD ProcessId) {
+  double ts = (double)(Entry->Time - StartTime) * 1000000 / TicksPerSecond;
+  const char *name = GetMajorFunctionName(Entry->MajorFunction);
+
+  switch (Entry->Kind) {
+  case DOKAN_TIMELINE_PULL_BEGIN:
+  case DOKAN_TIMELINE_PULL_END:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"Pull\",\"cat\":\"pull\",\"ph\":\"%s\","
+                      "\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+                      Entry->Kind == DOKAN_TIMELINE_PULL_BEGIN ? "B" : "E", ts,
+                      ProcessId, Entry->ThreadId);
+    break;
+  case DOKAN_TIMELINE_PULLED:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"Pulled\",\"cat\":\"pull\",\"ph\":\"i\","
+                      "\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,"
+                      "\"args\":{\"events\":%lu}}",
+                      ts, ProcessId, Entry->ThreadId, Entry->Value);
+    break;
+  case DOKAN_TIMELINE_QUEUED:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"Dispatch\",\"cat\":\"event\","
+                      "\"ph\":\"s\",\"id\":%lu,\"ts\":%.3f,\"pid\":%lu,"
+                      "\"tid\":%lu}",
+                      Entry->Value, ts, ProcessId, Entry->ThreadId);
+    break;
+  case DOKAN_TIMELINE_DISPATCH_BEGIN:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"%s\",\"cat\":\"dispatch\",\"ph\":\"B\","
+                      "\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,"
+                      "\"args\":{\"serial\":%lu}}",
+                      name, ts, ProcessId, Entry->ThreadId, Entry->Value);
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"Dispatch\",\"cat\":\"event\","
+                      "\"ph\":\"f\",\"bp\":\"e\",\"id\":%lu,\"ts\":%.3f,"
+                      "\"pid\":%lu,\"tid\":%lu}",
+                      Entry->Value, ts, ProcessId, Entry->ThreadId);
+    break;
+  case DOKAN_TIMELINE_DISPATCH_END:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"%s\",\"cat\":\"dispatch\",\"ph\":\"E\","
+                      "\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+                      name, ts, ProcessId, Entry->ThreadId);
+    break;
+  case DOKAN_TIMELINE_REPLY:
+    WriteTimelineLine(Writer,
+                      ",\n{\"name\":\"Reply\",\"cat\":\"reply\",\"ph\":\"i\","
+                      "\"s\":\"t\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,"
+                      "\"args\":{\"serial\":%lu,\"major\":\"%s\"}}",
+                      ts, ProcessId, Entry->ThreadId, Entry->Value, name);
+    break;
+  }
+}
+
+BOOL DOKANAPI DokanWriteEventTimeline(_In_ DOKAN_HANDLE DokanInstance,
+                                      _In_ LPCWSTR FileName) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_TIMELINE_WRITER *writer;
+  DOKAN_TIMELINE_ENTRY *entries;
+  LONG64 startTime = MAXLONGLONG;
+  DWORD processId = GetCurrentProcessId();
+  ULONG count;
+  BOOL success;
+
+  if (!instance || !FileName) {
+    return FALSE;
+  }
+  if (!CopyTimelineEntries(instance, &entries, &count)) {
+    return FALSE;
+  }
+  writer = (DOKAN_TIMELINE_WRITER *)malloc(sizeof(DOKAN_TIMELINE_WRITER));
+  if (!writer) {
+    free(entries);
+    return FALSE;
+  }
+  writer->Used = 0;
+  writer->Failed = FALSE;
+  writer->File = CreateFileW(FileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL, NULL);
+  if (writer->File == INVALID_HANDLE_VALUE) {
+    DbgPrintW(L"Dokan Error: Failed to create the event timeline %s: %d\n",
+              FileName, GetLastError());
+    free(writer);
+    free(entries);
+    return FALSE;
+  }
+
+  for (ULONG i = 0; i < count; ++i) {
+    startTime = min(startTime, entries[i].Time);
+  }
+  WriteTimelineLine(writer,
+                    "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+                    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,"
+                    "\"args\":{\"name\":\"dokan\"}}",
+                    processId);
+  for (ULONG i = 0; i < count; ++i) {
+    WriteTimelineEntry(writer, &entries[i], startTime, instance->TicksPerSecond,
+                       processId);
+  }
+  WriteTimelineLine(writer, "\n]}\n");
+  FlushTimelineWriter(writer);
+  success = !writer->Failed;
+  CloseHandle(writer->File);
+  free(writer);
+  free(entries);
+  return success;
+}
@@ -0,0 +1,485 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+
+#include <stdlib.h>
+
+// A trace file starts with a DOKAN_EVENT_TRACE_HEADER followed by records,
+// each made of a DOKAN_EVENT_TRACE_RECORD and Length bytes of data:
+// - DOKAN_EVENT_TRACE_BATCH: the events of a pull, as received.
+// - DOKAN_EVENT_TRACE_OPEN: a DOKAN_EVENT_TRACE_OPEN_DATA for a create that
+//   succeeded, needed to find the open of the later events on replay.
+
+#define DOKAN_EVENT_TRACE_MAGIC 0x52544b44 // "DKTR"
+#define DOKAN_EVENT_TRACE_VERSION 1
+
+#define DOKAN_EVENT_TRACE_BATCH 1
+#define DOKAN_EVENT_TRACE_OPEN 2
+
+// Records are buffered up to this size before being written to the file.
+#define DOKAN_EVENT_TRACE_BUFFER_SIZE (1024 * 1024)
+
+typedef struct _DOKAN_EVENT_TRACE_HEADER {
+  ULONG Magic;
+  ULONG Version;
+} DOKAN_EVENT_TRACE_HEADER;
+
+typedef struct _DOKAN_EVENT_TRACE_RECORD {
+  ULONG Type;
+  ULONG Length;
+  /** Time since the trace started */
+  ULONG64 TimeUs;
+} DOKAN_EVENT_TRACE_RECORD;
+
+typedef struct _DOKAN_EVENT_TRACE_OPEN_DATA {
+  /** SerialNumber of the create */
+  ULONG SerialNumber;
+  ULONG Reserved;
+  /** Context given to the events of the open */
+  ULONG64 Context;
+} DOKAN_EVENT_TRACE_OPEN_DATA;
+
+// Must be called with the lock held.
+VOID FlushEventTrace(DOKAN_EVENT_TRACE *Trace) {
+  DWORD written;
+  if (Trace->BufferUsed &&
+      !WriteFile(Trace->File, Trace->Buffer, Trace->BufferUsed, &written,
+                 NULL)) {
+    DbgPrint("Dokan Error: Failed to write the event trace: %d\n",
+             GetLastError());
+  }
+  Trace->BufferUsed = 0;
+}
+
+VOID WriteEventTraceRecord(PDOKAN_INSTANCE DokanInstance, ULONG Type,
+                           PVOID Data, ULONG Length) {
+  DOKAN_EVENT_TRACE *trace = &DokanInstance->EventTrace;
+  DOKAN_EVENT_TRACE_RECORD record;
+  LARGE_INTEGER now;
+  DWORD written;
+
+  QueryPerformanceCounter(&now);
+  AcquireSRWLockExclusive(&trace->Lock);
+  if (!trace->File) {
+    ReleaseSRWLockExclusive(&trace->Lock);
+    return;
+  }
+  record.Type = Type;
+  record.Length = Length;
+  record.TimeUs = (ULONG64)(now.QuadPart - trace->Start.QuadPart) * 1000000 /
+                  trace->Frequency.QuadPart;
+  if (trace->BufferUsed + sizeof(record) + Length >
+      DOKAN_EVENT_TRACE_BUFFER_SIZE) {
+    FlushEventTrace(trace);
+  }
+  if (sizeof(record) + Length > DOKAN_EVENT_TRACE_BUFFER_SIZE) {
+    if (!WriteFile(trace->File, &record, sizeof(record), &written, NULL) ||
+        !WriteFile(trace->File, Data, Length, &written, NULL)) {
+      DbgPrint("Dokan Error: Failed to write the event trace: %d\n",
+               GetLastError());
+    }
+  } else {
+    CopyMemory(trace->Buffer + trace->BufferUsed, &record, sizeof(record));
+    CopyMemory(trace->Buffer + trace->BufferUsed + sizeof(record), Data,
+               Length);
+    trace->BufferUsed += sizeof(record) + Length;
+  }
+  ReleaseSRWLockExclusive(&trace->Lock);
+}
+
+VOID TraceEventBatch(PDOKAN_INSTANCE DokanInstance, PEVENT_CONTEXT EventContext,
+                     DWORD Size) {
+  if (!DokanInstance->EventTrace.File || !Size) {
+    return;
+  }
+  WriteEventTraceRecord(DokanInstance, DOKAN_EVENT_TRACE_BATCH, EventContext,
+                        Size);
+}
+
+VOID TraceEventOpen(PDOKAN_INSTANCE DokanInstance, ULONG SerialNumber,
+                    ULONG64 Context) {
+  DOKAN_EVENT_TRACE_OPEN_DATA open;
+  if (!DokanInstance->EventTrace.File) {
+    return;
+  }
+  open.SerialNumber = SerialNumber;
+  open.Reserved = 0;
+  open.Context = Context;
+  WriteEventTraceRecord(DokanInstance, DOKAN_EVENT_TRACE_OPEN, &open,
+                        sizeof(open));
+}
+
+VOID StopEventTrace(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_EVENT_TRACE *trace = &DokanInstance->EventTrace;
+
+  AcquireSRWLockExclusive(&trace->Lock);
+  if (trace->File) {
+    FlushEventTrace(trace);
+    CloseHandle(trace->File);
+    trace->File = NULL;
+    free(trace->Buffer);
+    trace->Buffer = NULL;
+  }
+  ReleaseSRWLockExclusive(&trace->Lock);
+}
+
+BOOL DOKANAPI DokanStartEventTrace(_In_ DOKAN_HANDLE DokanInstance,
+                                   _In_ LPCWSTR FileName) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_EVENT_TRACE *trace;
+  DOKAN_EVENT_TRACE_HEADER header;
+  HANDLE file;
+  PCHAR buffer;
+  DWORD written;
+
+  if (!instance || !FileName) {
+    return FALSE;
+  }
+  trace = &instance->EventTrace;
+  buffer = (PCHAR)malloc(DOKAN_EVENT_TRACE_BUFFER_SIZE);
+  if (!buffer) {
+    return FALSE;
+  }
+  file = CreateFileW(FileName, GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                     CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    DbgPrintW(L"Dokan Error: Failed to create the event trace %s: %d\n",
+              FileName, GetLastError());
+    free(buffer);
+    return FALSE;
+  }
+  header.Magic = DOKAN_EVENT_TRACE_MAGIC;
+  header.Version = DOKAN_EVENT_TRACE_VERSION;
+  if (!WriteFile(file, &header, sizeof(header), &written, NULL)) {
+    CloseHandle(file);
+    free(buffer);
+    return FALSE;
+  }
+
+  AcquireSRWLockExclusive(&trace->Lock);
+  if (trace->File) {
+    ReleaseSRWLockExclusive(&trace->Lock);
+    CloseHandle(file);
+    free(buffer);
+    return FALSE;
+  }
+  trace->Buffer = buffer;
+  trace->BufferUsed = 0;
+  QueryPerformanceFrequency(&trace->Frequency);
+  QueryPerformanceCounter(&trace->Start);
+  trace->File = file;
+  ReleaseSRWLockExclusive(&trace->Lock);
+  return TRUE;
+}
+
+VOID DOKANAPI DokanStopEventTrace(_In_ DOKAN_HANDLE DokanInstance) {
+  if (DokanInstance) {
+    StopEventTrace((PDOKAN_INSTANCE)DokanInstance);
+  }
+}
+
+// Open of the trace being replayed, found by the serial number of its create.
+typedef struct _DOKAN_REPLAY_OPEN {
+  ULONG SerialNumber;
+  ULONG64 Context;
+} DOKAN_REPLAY_OPEN;
+
+// Context of the recorded opens, and whether a replayed create gave it.
+typedef struct _DOKAN_REPLAY_KEY {
+  ULONG64 Context;
+  BOOL Open;
+} DOKAN_REPLAY_KEY;
+
+typedef struct _DOKAN_REPLAY {
+  HANDLE File;
+  /** Data of the last record read */
+  PCHAR Data;
+  ULONG DataSize;
+  /** Large write rebuilt with its data */
+  PEVENT_CONTEXT Write;
+  ULONG WriteSize;
+  DOKAN_REPLAY_OPEN *Opens;
+  ULONG OpenCount;
+  DOKAN_REPLAY_KEY *Keys;
+  ULONG KeyCount;
+} DOKAN_REPLAY;
+
+int __cdecl CompareReplayOpens(const void *Left, const void *Right) {
+  ULONG left = ((const DOKAN_REPLAY_OPEN *)Left)->SerialNumber;
+  ULONG right = ((const DOKAN_REPLAY_OPEN *)Right)->SerialNumber;
+  return left < right ? -1 : left > right;
+}
+
+int __cdecl CompareReplayKeys(const void *Left, const void *Right) {
+  ULONG64 left = ((const DOKAN_REPLAY_KEY *)Left)->Context;
+  ULONG64 right = ((const DOKAN_REPLAY_KEY *)Right)->Context;
+  return left < right ? -1 : left > right;
+}
+
+// Reads the next record in Replay->Data. Returns ERROR_HANDLE_EOF at the end
+// of the trace.
+DWORD ReadReplayRecord(DOKAN_REPLAY *Replay,
+                       DOKAN_EVENT_TRACE_RECORD *Record) {
+  DWORD read;
+
+  if (!ReadFile(Replay->File, Record, sizeof(*Record), &read, NULL)) {
+    return GetLastError();
+  }
+  if (!read) {
+    return ERROR_HANDLE_EOF;
+  }
+  if (read != sizeof(*Record)) {
+    return ERROR_INVALID_DATA;
+  }
+  if (Record->Length > Replay->DataSize) {
+    PCHAR data = (PCHAR)realloc(Replay->Data, Record->Length);
+    if (!data) {
+      return ERROR_OUTOFMEMORY;
+    }
+    Replay->Data = data;
+    Replay->DataSize = Record->Length;
+  }
+  if (!ReadFile(Replay->File, Replay->Data, Record->Length, &read, NULL)) {
+    return GetLastError();
+  }
+  return read == Record->Length ? 0 : ERROR_INVALID_DATA;
+}
+
+// Reads the opens of the whole trace, sorted by create and by context.
+DWORD ReadReplayOpens(DOKAN_REPLAY *Replay) {
+  DOKAN_EVENT_TRACE_RECORD record;
+  ULONG capacity = 0;
+  DWORD error;
+
+  while (!(error = ReadReplayRecord(Replay, &record))) {
+    if (record.Type != DOKAN_EVENT_TRACE_OPEN ||
+        record.Length < sizeof(DOKAN_EVENT_TRACE_OPEN_DATA)) {
+      continue;
+    }
+    if (Replay->OpenCount == capacity) {
+      capacity = max(capacity * 2, 256);
+      DOKAN_REPLAY_OPEN *opens = (DOKAN_REPLAY_OPEN *)realloc(
+          Replay->Opens, capacity * sizeof(DOKAN_REPLAY_OPEN));
+      if (!opens) {
+        return ERROR_OUTOFMEMORY;
+      }
+      Replay->Opens = opens;
+    }
+    DOKAN_EVENT_TRACE_OPEN_DATA *data =
+        (DOKAN_EVENT_TRACE_OPEN_DATA *)Replay->Data;
+    Replay->Opens[Replay->OpenCount].SerialNumber = data->SerialNumber;
+    Replay->Opens[Replay->OpenCount].Context = data->Context;
+    ++Replay->OpenCount;
+  }
+  if (error != ERROR_HANDLE_EOF) {
+    return error;
+  }
+  if (!Replay->OpenCount) {
+    return 0;
+  }
+  qsort(Replay->Opens, Replay->OpenCount, sizeof(DOKAN_REPLAY_OPEN),
+        CompareReplayOpens);
+
+  Replay->Keys = (DOKAN_REPLAY_KEY *)malloc(Replay->OpenCount *
+                                            sizeof(DOKAN_REPLAY_KEY));
+  if (!Replay->Keys) {
+    return ERROR_OUTOFMEMORY;
+  }
+  for (ULONG i = 0; i < Replay->OpenCount; ++i) {
+    Replay->Keys[i].Context = Replay->Opens[i].Context;
+    Replay->Keys[i].Open = FALSE;
+  }
+  qsort(Replay->Keys, Replay->OpenCount, sizeof(DOKAN_REPLAY_KEY),
+        CompareReplayKeys);
+  // Contexts are reused once their open is closed.
+  Replay->KeyCount = 1;
+  for (ULONG i = 1; i < Replay->OpenCount; ++i) {
+    if (Replay->Keys[i].Context != Replay->Keys[Replay->KeyCount - 1].Context) {
+      Replay->Keys[Replay->KeyCount++] = Replay->Keys[i];
+    }
+  }
+  return 0;
+}
+
+// Returns the recorded event to submit, with its data when only the head of a
+// large write was recorded.
+PEVENT_CONTEXT GetReplayEvent(DOKAN_REPLAY *Replay,
+                              PEVENT_CONTEXT EventContext) {
+  ULONG length = EventContext->Operation.Write.RequestLength;
+
+  if (EventContext->MajorFunction != IRP_MJ_WRITE ||
+      length <= EventContext->Length) {
+    return EventContext;
+  }
+  if (length > Replay->WriteSize) {
+    free(Replay->Write);
+    Replay->Write = (PEVENT_CONTEXT)malloc(length);
+    Replay->WriteSize = Replay->Write ? length : 0;
+    if (!Replay->Write) {
+      return NULL;
+    }
+  }
+  ZeroMemory(Replay->Write, length);
+  CopyMemory(Replay->Write, EventContext, EventContext->Length);
+  Replay->Write->Length = length;
+  Replay->Write->Operation.Write.RequestLength = 0;
+  return Replay->Write;
+}
+
+// Submits the events of a recorded batch, leaving out the ones of opens made
+// before the trace started.
+DWORD SubmitReplayBatch(PDOKAN_INSTANCE DokanInstance, DOKAN_REPLAY *Replay,
+                        ULONG Size, PDOKAN_REPLAY_STATISTICS Statistics) {
+  ULONG offset = 0;
+
+  while (offset < Size) {
+    PEVENT_CONTEXT context = (PEVENT_CONTEXT)(Replay->Data + offset);
+    DOKAN_REPLAY_KEY *key = NULL;
+    if (Size - offset < sizeof(EVENT_CONTEXT) ||
+        context->Length < sizeof(EVENT_CONTEXT) ||
+        context->Length > Size - offset) {
+      return ERROR_INVALID_DATA;
+    }
+    offset += context->Length;
+    if (context->MajorFunction == DOKAN_IRP_LOG_MESSAGE) {
+      continue;
+    }
+    if (context->MajorFunction == IRP_MJ_CREATE) {
+      DOKAN_REPLAY_OPEN search = {context->SerialNumber, 0};
+      DOKAN_REPLAY_OPEN *open = (DOKAN_REPLAY_OPEN *)bsearch(
+          &search, Replay->Opens, Replay->OpenCount, sizeof(DOKAN_REPLAY_OPEN),
+          CompareReplayOpens);
+      // The create is submitted with the context it gave to find its open.
+      context->Context = open ? open->Context : 0;
+    }
+    if (context->Context) {
+      DOKAN_REPLAY_KEY search = {context->Context, FALSE};
+      key = (DOKAN_REPLAY_KEY *)bsearch(&search, Replay->Keys,
+                                        Replay->KeyCount,
+                                        sizeof(DOKAN_REPLAY_KEY),
+                                        CompareReplayKeys);
+      if (!key || (context->MajorFunction != IRP_MJ_CREATE && !key->Open)) {
+        ++Statistics->SkippedEvents;
+        continue;
+      }
+    }
+    PEVENT_CONTEXT event = GetReplayEvent(Replay, context);
+    if (!event) {
+      return ERROR_OUTOFMEMORY;
+    }
+    if (!DokanMemoryTransportSubmit(DokanInstance, event)) {
+      return ERROR_OPERATION_ABORTED;
+    }
+    if (key) {
+      key->Open = context->MajorFunction != IRP_MJ_CLOSE;
+    }
+    ++Statistics->Events;
+  }
+  return 0;
+}
+
+BOOL DOKANAPI
+DokanReplayEventTrace(_In_ DOKAN_HANDLE DokanInstance, _In_ LPCWSTR FileName,
+                      _In_ BOOL OriginalSpeed,
+                      _Out_opt_ PDOKAN_REPLAY_STATISTICS Statistics) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_REPLAY_STATISTICS statistics;
+  DOKAN_REPLAY replay;
+  DOKAN_EVENT_TRACE_HEADER header;
+  DOKAN_EVENT_TRACE_RECORD record;
+  LARGE_INTEGER frequency, start, now;
+  ULONG64 firstTimeUs = 0;
+  BOOL firstRecord = TRUE;
+  DWORD read;
+  DWORD error;
+
+  if (!instance || !FileName || instance->Transport != &g_MemoryTransport) {
+    return FALSE;
+  }
+  ZeroMemory(&statistics, sizeof(statistics));
+  ZeroMemory(&replay, sizeof(replay));
+  replay.File = CreateFileW(FileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (replay.File == INVALID_HANDLE_VALUE) {
+    DbgPrintW(L"Dokan Error: Failed to open the event trace %s: %d\n",
+              FileName, GetLastError());
+    return FALSE;
+  }
+  if (!ReadFile(replay.File, &header, sizeof(header), &read, NULL) ||
+      read != sizeof(header) || header.Magic != DOKAN_EVENT_TRACE_MAGIC ||
+      header.Version != DOKAN_EVENT_TRACE_VERSION) {
+    error = ERROR_INVALID_DATA;
+  } else {
+    error = ReadReplayOpens(&replay);
+  }
+  if (!error && SetFilePointer(replay.File, sizeof(header), NULL,
+                               FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
+    error = GetLastError();
+  }
+
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&start);
+  while (!error && !(error = ReadReplayRecord(&replay, &record))) {
+    if (record.Type != DOKAN_EVENT_TRACE_BATCH) {
+      continue;
+    }
+    if (firstRecord) {
+      firstTimeUs = record.TimeUs;
+      firstRecord = FALSE;
+    }
+    if (OriginalSpeed) {
+      QueryPerformanceCounter(&now);
+      ULONG64 elapsedUs =
+          (ULONG64)(now.QuadPart - start.QuadPart) * 1000000 /
+          frequency.QuadPart;
+      ULONG64 recordUs = record.TimeUs - firstTimeUs;
+      if (recordUs > elapsedUs + 1000) {
+        Sleep((DWORD)((recordUs - elapsedUs) / 1000));
+      }
+    }
+    error = SubmitReplayBatch(instance, &replay, record.Length, &statistics);
+  }
+  if (error == ERROR_HANDLE_EOF) {
+    error = 0;
+    DokanWaitForMemoryTransportIdle(instance, INFINITE);
+  }
+  QueryPerformanceCounter(&now);
+  statistics.ElapsedUs = (ULONG64)(now.QuadPart - start.QuadPart) * 1000000 /
+                         frequency.QuadPart;
+  if (statistics.ElapsedUs) {
+    statistics.EventsPerSecond =
+        statistics.Events * 1000000 / statistics.ElapsedUs;
+  }
+  if (error) {
+    DbgPrintW(L"Dokan Error: Failed to replay the event trace %s: %d\n",
+              FileName, error);
+  }
+
+  CloseHandle(replay.File);
+  free(replay.Data);
+  free(replay.Write);
+  free(replay.Opens);
+  free(replay.Keys);
+  if (Statistics) {
+    *Statistics = statistics;
+  }
+  return error == 0;
+}
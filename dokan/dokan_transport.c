@@ -0,0 +1,860 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dokani.h"
+#include "dokan_pool.h"
+
+#include <assert.h>
+
+DWORD DeviceProcessAndPull(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                           DWORD InputBufferSize, PVOID OutputBuffer,
+                           DWORD OutputBufferSize, PDWORD BytesReturned) {
+  if (!DeviceIoControl(DokanInstance->Device,      // Handle to device
+                       FSCTL_EVENT_PROCESS_N_PULL, // IO Control code
+                       InputBuffer,                // Input Buffer to driver.
+                       InputBufferSize,  // Length of input buffer in bytes.
+                       OutputBuffer,     // Output Buffer from driver.
+                       OutputBufferSize, // Length of output buffer in bytes.
+                       BytesReturned,    // Bytes placed in buffer.
+                       NULL              // asynchronous call
+                       )) {
+    return GetLastError();
+  }
+  return 0;
+}
+
+DWORD DeviceFetchWrite(PDOKAN_INSTANCE DokanInstance,
+                       PEVENT_INFORMATION EventInfo, DWORD EventInfoSize,
+                       PEVENT_CONTEXT EventContext, DWORD EventContextSize,
+                       PDWORD BytesReturned) {
+  if (!DeviceIoControl(DokanInstance->Device, FSCTL_EVENT_WRITE, EventInfo,
+                       EventInfoSize, EventContext, EventContextSize,
+                       BytesReturned, NULL)) {
+    return GetLastError();
+  }
+  return 0;
+}
+
+DWORD DeviceNotifyPath(PDOKAN_INSTANCE DokanInstance,
+                       PDOKAN_NOTIFY_PATH_INTERMEDIATE NotifyPath,
+                       DWORD Length) {
+  DWORD returnedLength;
+  if (!DeviceIoControl(DokanInstance->NotifyHandle, FSCTL_NOTIFY_PATH,
+                       NotifyPath, Length, NULL, 0, &returnedLength, NULL)) {
+    return GetLastError();
+  }
+  return 0;
+}
+
+VOID DeviceRelease(PDOKAN_INSTANCE DokanInstance) {
+  // The driver fails the pulls once the volume is unmounted.
+  DokanRemoveMountPoint(DokanInstance->MountPoint);
+}
+
+VOID DeviceDelete(PDOKAN_INSTANCE DokanInstance) {
+  UNREFERENCED_PARAMETER(DokanInstance);
+}
+
+VOID CALLBACK DevicePullCallback(PTP_CALLBACK_INSTANCE Instance,
+                                 PVOID Context, PVOID Overlapped,
+                                 ULONG IoResult,
+                                 ULONG_PTR NumberOfBytesTransferred,
+                                 PTP_IO Io) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Io);
+
+  CompleteOverlappedPull(
+      (PDOKAN_INSTANCE)Context,
+      CONTAINING_RECORD(Overlapped, DOKAN_IO_BATCH, Overlapped), IoResult,
+      (DWORD)NumberOfBytesTransferred);
+}
+
+BOOL DeviceStartPulls(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+  WCHAR rawDeviceName[MAX_PATH];
+
+  // A handle of its own so that cancelling the pulls leaves the other device
+  // calls alone.
+  GetRawDeviceName(DokanInstance->DeviceName, rawDeviceName, MAX_PATH);
+  DokanInstance->PullDevice =
+      CreateFile(rawDeviceName, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                 OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+  if (DokanInstance->PullDevice == INVALID_HANDLE_VALUE) {
+    DokanDbgPrintW(L"Dokan Error: CreatFile failed to open %s: %d\n",
+                   rawDeviceName, GetLastError());
+    return FALSE;
+  }
+  threadInfo->PullIo =
+      CreateThreadpoolIo(DokanInstance->PullDevice, DevicePullCallback,
+                         DokanInstance, &threadInfo->CallbackEnvironment);
+  if (!threadInfo->PullIo) {
+    DokanDbgPrintW(L"Dokan Error: CreateThreadpoolIo() has returned error "
+                   L"code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+DWORD DevicePostPull(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                     DWORD InputBufferSize, PDOKAN_IO_BATCH IoBatch) {
+  DOKAN_INSTANCE_THREADINFO *threadInfo = &DokanInstance->ThreadInfo;
+  DWORD lastError = 0;
+
+  StartThreadpoolIo(threadInfo->PullIo);
+  if (!DeviceIoControl(DokanInstance->PullDevice, // Handle to device
+                       FSCTL_EVENT_PROCESS_N_PULL, // IO Control code
+                       InputBuffer,                // Input Buffer to driver.
+                       InputBufferSize, // Length of input buffer in bytes.
+                       &IoBatch->EventContext[0], // Output Buffer from driver.
+                       BATCH_EVENT_CONTEXT_SIZE,  // Length of output buffer.
+                       NULL,                      // Completion reports it.
+                       &IoBatch->Overlapped       // asynchronous call
+                       )) {
+    lastError = GetLastError();
+  }
+  if (lastError == ERROR_IO_PENDING) {
+    // A pull posted while StopOverlappedPulls cancels them is not cancelled.
+    if (threadInfo->PullsStopped) {
+      CancelIoEx(DokanInstance->PullDevice, &IoBatch->Overlapped);
+    }
+    return 0;
+  }
+  if (lastError) {
+    CancelThreadpoolIo(threadInfo->PullIo);
+  }
+  return lastError;
+}
+
+VOID DeviceCancelPulls(PDOKAN_INSTANCE DokanInstance) {
+  CancelIoEx(DokanInstance->PullDevice, NULL);
+}
+
+VOID DeviceWaitForPulls(PDOKAN_INSTANCE DokanInstance) {
+  if (DokanInstance->ThreadInfo.PullIo) {
+    WaitForThreadpoolIoCallbacks(DokanInstance->ThreadInfo.PullIo, FALSE);
+  }
+}
+
+const DOKAN_TRANSPORT g_DeviceTransport = {
+    DeviceProcessAndPull, DeviceFetchWrite,  DeviceNotifyPath,
+    DeviceRelease,        DeviceDelete,      DeviceStartPulls,
+    DevicePostPull,       DeviceCancelPulls, DeviceWaitForPulls};
+
+/**
+ * \struct DOKAN_MEMORY_EVENT
+ * \brief Event submitted to the memory transport
+ *
+ * Lives in Submitted until pulled, then in Pulled until its result is
+ * received. Events without result, like Close, are freed when pulled.
+ */
+typedef struct _DOKAN_MEMORY_EVENT {
+  LIST_ENTRY ListEntry;
+  ULONG SerialNumber;
+  UCHAR MajorFunction;
+  /** Submitted Context, identifying the open of the event */
+  ULONG64 OpenKey;
+  /** Time of the submission */
+  LARGE_INTEGER SubmitTime;
+  /** Copy of the submitted event */
+  EVENT_CONTEXT EventContext;
+} DOKAN_MEMORY_EVENT;
+
+/**
+ * \struct DOKAN_MEMORY_OPEN
+ * \brief Open made by a create submitted to the memory transport
+ *
+ * Stands for the CCB the driver keeps for a file object, holding the Context
+ * given by the DLL to the open.
+ */
+typedef struct _DOKAN_MEMORY_OPEN {
+  LIST_ENTRY ListEntry;
+  /** Context of the submitted events of the open */
+  ULONG64 Key;
+  /** Context returned by the create, 0 until it completes */
+  ULONG64 Context;
+  /** Pulled events of the open waiting for their result */
+  ULONG InFlight;
+} DOKAN_MEMORY_OPEN;
+
+#define DOKAN_MEMORY_OPEN_BUCKETS 64
+
+/**
+ * \struct DOKAN_MEMORY_PULL
+ * \brief Overlapped pull posted on the memory transport
+ *
+ * Lives in PostedPulls until events are copied in its batch or it fails, then
+ * in CompletedPulls until a PullCompletion callback reports it.
+ */
+typedef struct _DOKAN_MEMORY_PULL {
+  LIST_ENTRY ListEntry;
+  PDOKAN_IO_BATCH IoBatch;
+  /** Win32 error the pull completed with */
+  DWORD Error;
+  /** Size of the events copied in IoBatch */
+  DWORD BytesTransferred;
+} DOKAN_MEMORY_PULL;
+
+/**
+ * \struct DOKAN_MEMORY_TRANSPORT
+ * \brief State of the memory transport of an instance
+ *
+ * Stands for the driver: events are pulled in submission order and batched
+ * like the driver does, writes larger than EVENT_CONTEXT_MAX_SIZE go through
+ * FetchWrite and results are matched to their event by serial number.
+ */
+typedef struct _DOKAN_MEMORY_TRANSPORT {
+  /** Protects every field */
+  SRWLOCK Lock;
+  /** Signaled when an event is submitted or the transport released */
+  CONDITION_VARIABLE EventSubmitted;
+  /** Signaled when the last outstanding event completes */
+  CONDITION_VARIABLE EventsCompleted;
+  /** DOKAN_MEMORY_EVENT not pulled yet */
+  LIST_ENTRY Submitted;
+  /** DOKAN_MEMORY_EVENT waiting for their result, by serial number */
+  LIST_ENTRY Pulled;
+  /** DOKAN_MEMORY_OPEN hashed by Key */
+  LIST_ENTRY Opens[DOKAN_MEMORY_OPEN_BUCKETS];
+  /** DOKAN_MEMORY_PULL waiting for events */
+  LIST_ENTRY PostedPulls;
+  /** DOKAN_MEMORY_PULL waiting for their completion callback */
+  LIST_ENTRY CompletedPulls;
+  /** Reports one of CompletedPulls, like a completion port */
+  PTP_WORK PullCompletion;
+  LARGE_INTEGER Frequency;
+  ULONG NextSerialNumber;
+  BOOL Released;
+  DOKAN_MEMORY_TRANSPORT_STATISTICS Statistics;
+} DOKAN_MEMORY_TRANSPORT;
+
+DOKAN_MEMORY_TRANSPORT *GetMemoryTransport(PDOKAN_INSTANCE DokanInstance) {
+  if (DokanInstance->Transport != &g_MemoryTransport) {
+    return NULL;
+  }
+  return (DOKAN_MEMORY_TRANSPORT *)DokanInstance->TransportContext;
+}
+
+// Must be called with the lock held.
+VOID CompleteMemoryEvent(DOKAN_MEMORY_TRANSPORT *Transport,
+                         DOKAN_MEMORY_EVENT *Event) {
+  if (Event->MajorFunction < DOKAN_MAJOR_FUNCTION_COUNT) {
+    PDOKAN_LATENCY_STATISTICS latency =
+        &Transport->Statistics.Latency[Event->MajorFunction];
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    ULONG64 elapsedUs = (ULONG64)(now.QuadPart - Event->SubmitTime.QuadPart) *
+                        1000000 / Transport->Frequency.QuadPart;
+    ++latency->Count;
+    latency->TotalUs += elapsedUs;
+    latency->MaxUs = max(latency->MaxUs, elapsedUs);
+  }
+  free(Event);
+  ++Transport->Statistics.CompletedEvents;
+  if (Transport->Statistics.SubmittedEvents ==
+      Transport->Statistics.CompletedEvents) {
+    WakeAllConditionVariable(&Transport->EventsCompleted);
+  }
+}
+
+// Must be called with the lock held.
+DOKAN_MEMORY_EVENT *FindPulledMemoryEvent(DOKAN_MEMORY_TRANSPORT *Transport,
+                                          ULONG SerialNumber) {
+  for (PLIST_ENTRY entry = Transport->Pulled.Flink;
+       entry != &Transport->Pulled; entry = entry->Flink) {
+    DOKAN_MEMORY_EVENT *event =
+        CONTAINING_RECORD(entry, DOKAN_MEMORY_EVENT, ListEntry);
+    if (event->SerialNumber == SerialNumber) {
+      return event;
+    }
+  }
+  return NULL;
+}
+
+// Must be called with the lock held.
+DOKAN_MEMORY_OPEN *FindMemoryOpen(DOKAN_MEMORY_TRANSPORT *Transport,
+                                  ULONG64 Key) {
+  PLIST_ENTRY bucket =
+      &Transport->Opens[(Key >> 4) % DOKAN_MEMORY_OPEN_BUCKETS];
+  for (PLIST_ENTRY entry = bucket->Flink; entry != bucket;
+       entry = entry->Flink) {
+    DOKAN_MEMORY_OPEN *open =
+        CONTAINING_RECORD(entry, DOKAN_MEMORY_OPEN, ListEntry);
+    if (open->Key == Key) {
+      return open;
+    }
+  }
+  return NULL;
+}
+
+// Decides whether Event can be pulled now and gives it the Context of its
+// open. Like the I/O manager ensures for a file object, the events of an open
+// wait for its create to complete and Close waits for the other events of the
+// open. Must be called with the lock held.
+BOOL PrepareMemoryEvent(DOKAN_MEMORY_TRANSPORT *Transport,
+                        DOKAN_MEMORY_EVENT *Event) {
+  DOKAN_MEMORY_OPEN *open;
+
+  if (!Event->OpenKey) {
+    return TRUE;
+  }
+  open = FindMemoryOpen(Transport, Event->OpenKey);
+  if (Event->MajorFunction == IRP_MJ_CREATE) {
+    if (open) {
+      // The previous open with the same key is not closed yet.
+      return FALSE;
+    }
+    Event->EventContext.Context = 0;
+    open = (DOKAN_MEMORY_OPEN *)malloc(sizeof(DOKAN_MEMORY_OPEN));
+    if (open) {
+      open->Key = Event->OpenKey;
+      open->Context = 0;
+      open->InFlight = 1;
+      InsertTailList(
+          &Transport->Opens[(open->Key >> 4) % DOKAN_MEMORY_OPEN_BUCKETS],
+          &open->ListEntry);
+    }
+    return TRUE;
+  }
+  if (!open) {
+    Event->EventContext.Context = 0;
+    return TRUE;
+  }
+  if (!open->Context ||
+      (Event->MajorFunction == IRP_MJ_CLOSE && open->InFlight)) {
+    return FALSE;
+  }
+  Event->EventContext.Context = open->Context;
+  if (Event->MajorFunction == IRP_MJ_CLOSE) {
+    RemoveEntryList(&open->ListEntry);
+    free(open);
+  } else {
+    ++open->InFlight;
+  }
+  return TRUE;
+}
+
+// Updates the open of Event with its result. Must be called with the lock
+// held.
+VOID CompleteMemoryOpenEvent(DOKAN_MEMORY_TRANSPORT *Transport,
+                             DOKAN_MEMORY_EVENT *Event,
+                             PEVENT_INFORMATION EventInfo) {
+  DOKAN_MEMORY_OPEN *open = FindMemoryOpen(Transport, Event->OpenKey);
+  if (!open) {
+    return;
+  }
+  --open->InFlight;
+  if (Event->MajorFunction == IRP_MJ_CREATE) {
+    if (NT_SUCCESS(EventInfo->Status) && EventInfo->Context) {
+      open->Context = EventInfo->Context;
+    } else {
+      RemoveEntryList(&open->ListEntry);
+      free(open);
+    }
+  }
+  // Events waiting for the open can be pulled.
+  WakeAllConditionVariable(&Transport->EventSubmitted);
+}
+
+// Completes the events of the results in Buffer, walking a batch of results
+// the same way the driver does. Must be called with the lock held.
+DWORD CompleteMemoryEvents(DOKAN_MEMORY_TRANSPORT *Transport, PCHAR Buffer,
+                           DWORD BufferSize) {
+  DWORD offset = 0;
+
+  while (offset + sizeof(EVENT_INFORMATION) <= BufferSize) {
+    PEVENT_INFORMATION eventInfo = (PEVENT_INFORMATION)(Buffer + offset);
+    DOKAN_MEMORY_EVENT *event =
+        FindPulledMemoryEvent(Transport, eventInfo->SerialNumber);
+    ULONG64 size;
+    if (eventInfo->Status == STATUS_BUFFER_OVERFLOW) {
+      // A partial result only has the size of the buffer to tell its own.
+      size = BufferSize - offset;
+    } else if ((event && event->MajorFunction == IRP_MJ_WRITE) ||
+        (eventInfo->Flags & DOKAN_EVENT_INFO_FIXED_SIZE)) {
+      size = sizeof(EVENT_INFORMATION);
+    } else {
+      size = max((ULONG64)sizeof(EVENT_INFORMATION),
+                 (ULONG64)FIELD_OFFSET(EVENT_INFORMATION, Buffer[0]) +
+                     eventInfo->BufferLength);
+    }
+    if (offset + size > BufferSize) {
+      return ERROR_INVALID_PARAMETER;
+    }
+    offset += (DWORD)size;
+    ++Transport->Statistics.Results;
+    if (event) {
+      RemoveEntryList(&event->ListEntry);
+      if (event->OpenKey) {
+        CompleteMemoryOpenEvent(Transport, event, eventInfo);
+      }
+      CompleteMemoryEvent(Transport, event);
+    }
+    if (eventInfo->Status == STATUS_BUFFER_OVERFLOW ||
+        !(eventInfo->Flags & DOKAN_EVENT_INFO_BATCHED)) {
+      // Only batched results are followed by another one.
+      break;
+    }
+  }
+  return 0;
+}
+
+// Copies as many submitted events as fit in Buffer, skipping the ones waiting
+// for their open. Must be called with the lock held.
+DWORD PullMemoryEvents(PDOKAN_INSTANCE DokanInstance,
+                       DOKAN_MEMORY_TRANSPORT *Transport, PCHAR Buffer,
+                       DWORD BufferSize) {
+  DWORD offset = 0;
+  PLIST_ENTRY next = Transport->Submitted.Flink;
+
+  while (next != &Transport->Submitted) {
+    DOKAN_MEMORY_EVENT *event =
+        CONTAINING_RECORD(next, DOKAN_MEMORY_EVENT, ListEntry);
+    PEVENT_CONTEXT context = &event->EventContext;
+    ULONG length = context->Length;
+    BOOL largeWrite = context->MajorFunction == IRP_MJ_WRITE &&
+                      length > EVENT_CONTEXT_MAX_SIZE;
+    if (largeWrite) {
+      // Like the driver, only send what precedes the data and let the DLL
+      // fetch the whole event.
+      length = max((ULONG)sizeof(EVENT_CONTEXT),
+                   context->Operation.Write.BufferOffset);
+    }
+    if (offset + length > BufferSize) {
+      break;
+    }
+    next = next->Flink;
+    if (!PrepareMemoryEvent(Transport, event)) {
+      continue;
+    }
+    RemoveEntryList(&event->ListEntry);
+    CopyMemory(Buffer + offset, context, length);
+    if (largeWrite) {
+      PEVENT_CONTEXT header = (PEVENT_CONTEXT)(Buffer + offset);
+      header->Length = length;
+      header->Operation.Write.RequestLength = context->Length;
+      ++Transport->Statistics.LargeWrites;
+    }
+    offset += length;
+    ++Transport->Statistics.PulledEvents;
+    if (event->MajorFunction == IRP_MJ_CLOSE) {
+      CompleteMemoryEvent(Transport, event);
+    } else {
+      InsertTailList(&Transport->Pulled, &event->ListEntry);
+    }
+    if (!(DokanInstance->DokanOptions->Options &
+          DOKAN_OPTION_ALLOW_IPC_BATCHING)) {
+      break;
+    }
+  }
+  return offset;
+}
+
+// Queues the completion of Pull. Must be called with the lock held.
+VOID CompleteMemoryPull(DOKAN_MEMORY_TRANSPORT *Transport,
+                        DOKAN_MEMORY_PULL *Pull) {
+  RemoveEntryList(&Pull->ListEntry);
+  InsertTailList(&Transport->CompletedPulls, &Pull->ListEntry);
+  SubmitThreadpoolWork(Transport->PullCompletion);
+}
+
+// Copies the events that can be pulled in the posted pulls, in their posting
+// order, and fails them once the transport is released. Must be called with
+// the lock held.
+VOID ServeMemoryPulls(PDOKAN_INSTANCE DokanInstance,
+                      DOKAN_MEMORY_TRANSPORT *Transport) {
+  while (!IsListEmpty(&Transport->PostedPulls)) {
+    DOKAN_MEMORY_PULL *pull = CONTAINING_RECORD(Transport->PostedPulls.Flink,
+                                                DOKAN_MEMORY_PULL, ListEntry);
+    if (Transport->Released) {
+      pull->Error = ERROR_NO_SUCH_DEVICE;
+    } else {
+      pull->BytesTransferred = PullMemoryEvents(
+          DokanInstance, Transport, (PCHAR)pull->IoBatch->EventContext,
+          BATCH_EVENT_CONTEXT_SIZE);
+      if (!pull->BytesTransferred) {
+        break;
+      }
+    }
+    CompleteMemoryPull(Transport, pull);
+  }
+}
+
+DWORD MemoryProcessAndPull(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                           DWORD InputBufferSize, PVOID OutputBuffer,
+                           DWORD OutputBufferSize, PDWORD BytesReturned) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+  DWORD timeoutMs = INFINITE;
+  DWORD error = 0;
+
+  *BytesReturned = 0;
+  AcquireSRWLockExclusive(&transport->Lock);
+  if (InputBuffer && InputBufferSize >= sizeof(EVENT_INFORMATION)) {
+    ULONG pullTimeoutMs = ((PEVENT_INFORMATION)InputBuffer)->PullEventTimeoutMs;
+    if (pullTimeoutMs) {
+      timeoutMs = pullTimeoutMs;
+    }
+    error = CompleteMemoryEvents(transport, (PCHAR)InputBuffer,
+                                 InputBufferSize);
+    // The events waiting for the completed opens can be pulled.
+    ServeMemoryPulls(DokanInstance, transport);
+  }
+  if (!error && OutputBuffer && OutputBufferSize >= sizeof(EVENT_CONTEXT)) {
+    ++transport->Statistics.Pulls;
+    while (TRUE) {
+      if (transport->Released) {
+        error = ERROR_NO_SUCH_DEVICE;
+        break;
+      }
+      *BytesReturned = PullMemoryEvents(DokanInstance, transport,
+                                        (PCHAR)OutputBuffer, OutputBufferSize);
+      if (*BytesReturned ||
+          !SleepConditionVariableSRW(&transport->EventSubmitted,
+                                     &transport->Lock, timeoutMs, 0)) {
+        break;
+      }
+    }
+  }
+  ReleaseSRWLockExclusive(&transport->Lock);
+  return error;
+}
+
+DWORD MemoryFetchWrite(PDOKAN_INSTANCE DokanInstance,
+                       PEVENT_INFORMATION EventInfo, DWORD EventInfoSize,
+                       PEVENT_CONTEXT EventContext, DWORD EventContextSize,
+                       PDWORD BytesReturned) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+  DWORD error = ERROR_OPERATION_ABORTED;
+
+  UNREFERENCED_PARAMETER(EventInfoSize);
+  *BytesReturned = 0;
+  AcquireSRWLockShared(&transport->Lock);
+  DOKAN_MEMORY_EVENT *event =
+      FindPulledMemoryEvent(transport, EventInfo->SerialNumber);
+  if (event) {
+    if (EventContextSize < event->EventContext.Length) {
+      error = ERROR_INSUFFICIENT_BUFFER;
+    } else {
+      CopyMemory(EventContext, &event->EventContext,
+                 event->EventContext.Length);
+      *BytesReturned = event->EventContext.Length;
+      error = 0;
+    }
+  }
+  ReleaseSRWLockShared(&transport->Lock);
+  return error;
+}
+
+DWORD MemoryNotifyPath(PDOKAN_INSTANCE DokanInstance,
+                       PDOKAN_NOTIFY_PATH_INTERMEDIATE NotifyPath,
+                       DWORD Length) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  UNREFERENCED_PARAMETER(NotifyPath);
+  UNREFERENCED_PARAMETER(Length);
+  AcquireSRWLockExclusive(&transport->Lock);
+  ++transport->Statistics.Notifications;
+  ReleaseSRWLockExclusive(&transport->Lock);
+  return 0;
+}
+
+VOID MemoryRelease(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  AcquireSRWLockExclusive(&transport->Lock);
+  transport->Released = TRUE;
+  ServeMemoryPulls(DokanInstance, transport);
+  ReleaseSRWLockExclusive(&transport->Lock);
+  WakeAllConditionVariable(&transport->EventSubmitted);
+  WakeAllConditionVariable(&transport->EventsCompleted);
+}
+
+VOID FreeMemoryEventList(PLIST_ENTRY Events) {
+  while (!IsListEmpty(Events)) {
+    PLIST_ENTRY entry = RemoveHeadList(Events);
+    free(CONTAINING_RECORD(entry, DOKAN_MEMORY_EVENT, ListEntry));
+  }
+}
+
+VOID CALLBACK MemoryPullCompletionCallback(PTP_CALLBACK_INSTANCE Instance,
+                                           PVOID Context, PTP_WORK Work) {
+  UNREFERENCED_PARAMETER(Instance);
+  UNREFERENCED_PARAMETER(Work);
+
+  PDOKAN_INSTANCE dokanInstance = (PDOKAN_INSTANCE)Context;
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(dokanInstance);
+  DOKAN_MEMORY_PULL pull;
+
+  // Each callback reports one of the completed pulls.
+  AcquireSRWLockExclusive(&transport->Lock);
+  PLIST_ENTRY entry = RemoveHeadList(&transport->CompletedPulls);
+  ReleaseSRWLockExclusive(&transport->Lock);
+  pull = *CONTAINING_RECORD(entry, DOKAN_MEMORY_PULL, ListEntry);
+  free(CONTAINING_RECORD(entry, DOKAN_MEMORY_PULL, ListEntry));
+  CompleteOverlappedPull(dokanInstance, pull.IoBatch, pull.Error,
+                         pull.BytesTransferred);
+}
+
+BOOL MemoryStartPulls(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  transport->PullCompletion = CreateThreadpoolWork(
+      MemoryPullCompletionCallback, DokanInstance,
+      &DokanInstance->ThreadInfo.CallbackEnvironment);
+  if (!transport->PullCompletion) {
+    DokanDbgPrintW(L"Dokan Error: CreateThreadpoolWork() has returned error "
+                   L"code %u.\n",
+                   GetLastError());
+    return FALSE;
+  }
+  return TRUE;
+}
+
+DWORD MemoryPostPull(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                     DWORD InputBufferSize, PDOKAN_IO_BATCH IoBatch) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+  DOKAN_MEMORY_PULL *pull;
+  DWORD error = 0;
+
+  pull = (DOKAN_MEMORY_PULL *)calloc(1, sizeof(DOKAN_MEMORY_PULL));
+  if (!pull) {
+    return ERROR_OUTOFMEMORY;
+  }
+  pull->IoBatch = IoBatch;
+  AcquireSRWLockExclusive(&transport->Lock);
+  if (InputBuffer && InputBufferSize >= sizeof(EVENT_INFORMATION)) {
+    error = CompleteMemoryEvents(transport, (PCHAR)InputBuffer,
+                                 InputBufferSize);
+  }
+  if (!error && transport->Released) {
+    error = ERROR_NO_SUCH_DEVICE;
+  }
+  if (error) {
+    ReleaseSRWLockExclusive(&transport->Lock);
+    free(pull);
+    return error;
+  }
+  ++transport->Statistics.Pulls;
+  InsertTailList(&transport->PostedPulls, &pull->ListEntry);
+  if (DokanInstance->ThreadInfo.PullsStopped) {
+    // Posted while StopOverlappedPulls cancels the pulls.
+    pull->Error = ERROR_OPERATION_ABORTED;
+    CompleteMemoryPull(transport, pull);
+  } else {
+    ServeMemoryPulls(DokanInstance, transport);
+  }
+  ReleaseSRWLockExclusive(&transport->Lock);
+  return 0;
+}
+
+VOID MemoryCancelPulls(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  AcquireSRWLockExclusive(&transport->Lock);
+  while (!IsListEmpty(&transport->PostedPulls)) {
+    DOKAN_MEMORY_PULL *pull = CONTAINING_RECORD(transport->PostedPulls.Flink,
+                                                DOKAN_MEMORY_PULL, ListEntry);
+    pull->Error = ERROR_OPERATION_ABORTED;
+    CompleteMemoryPull(transport, pull);
+  }
+  ReleaseSRWLockExclusive(&transport->Lock);
+}
+
+VOID MemoryWaitForPulls(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  if (transport->PullCompletion) {
+    WaitForThreadpoolWorkCallbacks(transport->PullCompletion, FALSE);
+  }
+}
+
+VOID MemoryDelete(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport = GetMemoryTransport(DokanInstance);
+
+  if (!transport) {
+    return;
+  }
+  FreeMemoryEventList(&transport->Submitted);
+  FreeMemoryEventList(&transport->Pulled);
+  // The pulls are all completed once the dispatch is stopped.
+  assert(IsListEmpty(&transport->PostedPulls));
+  assert(IsListEmpty(&transport->CompletedPulls));
+  for (ULONG i = 0; i < DOKAN_MEMORY_OPEN_BUCKETS; ++i) {
+    while (!IsListEmpty(&transport->Opens[i])) {
+      PLIST_ENTRY entry = RemoveHeadList(&transport->Opens[i]);
+      free(CONTAINING_RECORD(entry, DOKAN_MEMORY_OPEN, ListEntry));
+    }
+  }
+  free(transport);
+  DokanInstance->TransportContext = NULL;
+}
+
+const DOKAN_TRANSPORT g_MemoryTransport = {
+    MemoryProcessAndPull, MemoryFetchWrite,  MemoryNotifyPath,
+    MemoryRelease,        MemoryDelete,      MemoryStartPulls,
+    MemoryPostPull,       MemoryCancelPulls, MemoryWaitForPulls};
+
+BOOL CreateMemoryTransport(PDOKAN_INSTANCE DokanInstance) {
+  DOKAN_MEMORY_TRANSPORT *transport =
+      (DOKAN_MEMORY_TRANSPORT *)malloc(sizeof(DOKAN_MEMORY_TRANSPORT));
+  if (!transport) {
+    return FALSE;
+  }
+  ZeroMemory(transport, sizeof(DOKAN_MEMORY_TRANSPORT));
+  InitializeSRWLock(&transport->Lock);
+  InitializeConditionVariable(&transport->EventSubmitted);
+  InitializeConditionVariable(&transport->EventsCompleted);
+  InitializeListHead(&transport->Submitted);
+  InitializeListHead(&transport->Pulled);
+  for (ULONG i = 0; i < DOKAN_MEMORY_OPEN_BUCKETS; ++i) {
+    InitializeListHead(&transport->Opens[i]);
+  }
+  InitializeListHead(&transport->PostedPulls);
+  InitializeListHead(&transport->CompletedPulls);
+  QueryPerformanceFrequency(&transport->Frequency);
+  DokanInstance->Transport = &g_MemoryTransport;
+  DokanInstance->TransportContext = transport;
+  return TRUE;
+}
+
+DOKAN_MEMORY_EVENT *NewMemoryEvent(PDOKAN_INSTANCE DokanInstance,
+                                   PEVENT_CONTEXT EventContext) {
+  DOKAN_MEMORY_EVENT *event;
+
+  if (!EventContext || EventContext->Length < sizeof(EVENT_CONTEXT)) {
+    return NULL;
+  }
+  event = (DOKAN_MEMORY_EVENT *)malloc(
+      FIELD_OFFSET(DOKAN_MEMORY_EVENT, EventContext) + EventContext->Length);
+  if (!event) {
+    return NULL;
+  }
+  CopyMemory(&event->EventContext, EventContext, EventContext->Length);
+  event->MajorFunction = (UCHAR)EventContext->MajorFunction;
+  event->OpenKey = EventContext->Context;
+  event->EventContext.MountId = DokanInstance->MountId;
+  if (event->MajorFunction == IRP_MJ_WRITE) {
+    // Large writes are split when pulled.
+    event->EventContext.Operation.Write.RequestLength = 0;
+  }
+  return event;
+}
+
+BOOL DOKANAPI DokanMemoryTransportSubmit(_In_ DOKAN_HANDLE DokanInstance,
+                                         _In_ PEVENT_CONTEXT EventContext) {
+  return DokanMemoryTransportSubmitBatch(DokanInstance, &EventContext, 1);
+}
+
+BOOL DOKANAPI
+DokanMemoryTransportSubmitBatch(_In_ DOKAN_HANDLE DokanInstance,
+                                _In_reads_(Count) PEVENT_CONTEXT *EventContexts,
+                                _In_ ULONG Count) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_MEMORY_TRANSPORT *transport;
+  LIST_ENTRY events;
+
+  if (!instance || !EventContexts || Count == 0) {
+    return FALSE;
+  }
+  transport = GetMemoryTransport(instance);
+  if (!transport) {
+    return FALSE;
+  }
+  InitializeListHead(&events);
+  for (ULONG i = 0; i < Count; ++i) {
+    DOKAN_MEMORY_EVENT *event = NewMemoryEvent(instance, EventContexts[i]);
+    if (!event) {
+      FreeMemoryEventList(&events);
+      return FALSE;
+    }
+    InsertTailList(&events, &event->ListEntry);
+  }
+
+  AcquireSRWLockExclusive(&transport->Lock);
+  if (transport->Released) {
+    ReleaseSRWLockExclusive(&transport->Lock);
+    FreeMemoryEventList(&events);
+    return FALSE;
+  }
+  while (!IsListEmpty(&events)) {
+    DOKAN_MEMORY_EVENT *event = CONTAINING_RECORD(
+        RemoveHeadList(&events), DOKAN_MEMORY_EVENT, ListEntry);
+    QueryPerformanceCounter(&event->SubmitTime);
+    event->SerialNumber = ++transport->NextSerialNumber;
+    event->EventContext.SerialNumber = event->SerialNumber;
+    InsertTailList(&transport->Submitted, &event->ListEntry);
+    ++transport->Statistics.SubmittedEvents;
+  }
+  ServeMemoryPulls(instance, transport);
+  ReleaseSRWLockExclusive(&transport->Lock);
+  // Without IPC batching, each event of the batch needs its own pull.
+  if (Count == 1) {
+    WakeConditionVariable(&transport->EventSubmitted);
+  } else {
+    WakeAllConditionVariable(&transport->EventSubmitted);
+  }
+  return TRUE;
+}
+
+BOOL DOKANAPI DokanWaitForMemoryTransportIdle(_In_ DOKAN_HANDLE DokanInstance,
+                                              _In_ DWORD Milliseconds) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_MEMORY_TRANSPORT *transport;
+  BOOL idle;
+
+  if (!instance) {
+    return FALSE;
+  }
+  transport = GetMemoryTransport(instance);
+  if (!transport) {
+    return FALSE;
+  }
+  AcquireSRWLockExclusive(&transport->Lock);
+  while (!transport->Released && transport->Statistics.SubmittedEvents !=
+                                     transport->Statistics.CompletedEvents) {
+    if (!SleepConditionVariableSRW(&transport->EventsCompleted,
+                                   &transport->Lock, Milliseconds, 0)) {
+      break;
+    }
+  }
+  idle = transport->Statistics.SubmittedEvents ==
+         transport->Statistics.CompletedEvents;
+  ReleaseSRWLockExclusive(&transport->Lock);
+  return idle;
+}
+
+BOOL DOKANAPI DokanGetMemoryTransportStatistics(
+    _In_ DOKAN_HANDLE DokanInstance,
+    _Out_ PDOKAN_MEMORY_TRANSPORT_STATISTICS Statistics) {
+  PDOKAN_INSTANCE instance = (PDOKAN_INSTANCE)DokanInstance;
+  DOKAN_MEMORY_TRANSPORT *transport;
+
+  if (!instance || !Statistics) {
+    return FALSE;
+  }
+  transport = GetMemoryTransport(instance);
+  if (!transport) {
+    return FALSE;
+  }
+  AcquireSRWLockShared(&transport->Lock);
+  *Statistics = transport->Statistics;
+  ReleaseSRWLockShared(&transport->Lock);
+  return TRUE;
+}
@@ -32,15 +32,279 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 #include "dokanc.h"
 #include "list.h"
 #include "dokan_vector.h"
+#include "dokan_name_matcher.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * \struct DOKAN_DISPATCH_QUEUE
+ * \brief Batched events waiting for a pool thread
+ *
+ * Events are queued in order in the lane of their type and Work is submitted
+ * once per queued event, as long as fewer than WorkerLimit events are being
+ * dispatched. The work object lives as long as the instance so dispatching a
+ * batch does not allocate any thread pool object.
+ *
+ * Each run of Work takes the next event of the first lane, in
+ * DOKAN_DISPATCH_LANE order, that has events and credits left. A new round
+ * starts, with the credits reset to the lane weights, when no lane with
+ * events has credits left.
+ */
+typedef struct _DOKAN_DISPATCH_QUEUE {
+  /** Protects the queue fields except Work */
+  SRWLOCK Lock;
+  /** DOKAN_IO_EVENT of each lane linked by their DispatchListEntry */
+  LIST_ENTRY Lanes[DOKAN_DISPATCH_LANE_COUNT];
+  /** Events each lane can still dispatch in the current round */
+  ULONG Credits[DOKAN_DISPATCH_LANE_COUNT];
+  /** Events each lane dispatches per round */
+  ULONG Weights[DOKAN_DISPATCH_LANE_COUNT];
+  /** Number of events in Lanes */
+  ULONG QueuedEvents;
+  /** Submissions of Work that did not take their event yet */
+  ULONG PendingSubmits;
+  /** Number of queued events being dispatched */
+  ULONG ActiveWorkers;
+  /** Maximum of PendingSubmits + ActiveWorkers, set by the controller */
+  ULONG WorkerLimit;
+  /** Work object running one queued event per submission */
+  PTP_WORK Work;
+} DOKAN_DISPATCH_QUEUE;
+
+/**
+ * \struct DOKAN_DISPATCH_CONTROLLER
+ * \brief Adapts the number of pulling and dispatching threads of a mount
+ *
+ * Pool threads that completed a batched event only pull again while fewer
+ * than PullerLimit of them are pulling, the others send their result alone
+ * and exit. The dispatch queue runs at most its WorkerLimit events at once.
+ *
+ * Every DOKAN_DISPATCH_CONTROLLER_INTERVAL_MS the timer adjusts both limits
+ * from the counters of the interval. Counters are updated with interlocked
+ * operations and reset by the timer.
+ */
+typedef struct _DOKAN_DISPATCH_CONTROLLER {
+  PTP_TIMER Timer;
+  /** Bounds of PullerLimit */
+  LONG MinPullers;
+  LONG MaxPullers;
+  /** Bounds of DOKAN_DISPATCH_QUEUE.WorkerLimit */
+  ULONG MinWorkers;
+  ULONG MaxWorkers;
+  volatile LONG PullerLimit;
+  /** Pool threads currently pulling */
+  volatile LONG ActivePullers;
+  /** Pulls completed during the interval */
+  volatile LONG64 Pulls;
+  /** Pulls of the interval that returned no event */
+  volatile LONG64 EmptyPulls;
+  /** Events pulled during the interval */
+  volatile LONG64 PulledEvents;
+  /** Events dispatched during the interval */
+  volatile LONG64 DispatchedEvents;
+  /** Performance counter ticks spent dispatching events during the interval */
+  volatile LONG64 DispatchTicks;
+  /** Queued events that found no free worker during the interval */
+  volatile LONG64 WaitingEvents;
+  /** Performance counter frequency */
+  LONG64 TicksPerSecond;
+  /** Protects Statistics */
+  SRWLOCK StatisticsLock;
+  /** Last interval values and decision counters */
+  DOKAN_DISPATCH_STATISTICS Statistics;
+} DOKAN_DISPATCH_CONTROLLER;
+
+/** Number of replies after which the reply batch is sent */
+#define DOKAN_REPLY_BATCH_MAX_COUNT 16
+/** Total reply size after which the reply batch is sent */
+#define DOKAN_REPLY_BATCH_MAX_SIZE (DOKAN_EVENT_INFO_DEFAULT_SIZE * 4)
+/** Replies larger than this are never queued in the reply batch */
+#define DOKAN_REPLY_BATCH_MAX_REPLY_SIZE DOKAN_EVENT_INFO_DEFAULT_SIZE
+/** Longest time a reply waits in the reply batch */
+#define DOKAN_REPLY_BATCH_TIMEOUT_MS 1
+
+/**
+ * \struct DOKAN_QUEUED_REPLY
+ * \brief Event result waiting to be sent with other results
+ */
+typedef struct _DOKAN_QUEUED_REPLY {
+  PEVENT_INFORMATION EventResult;
+  /** Allocated size of EventResult */
+  ULONG EventResultSize;
+  /** Size of the reply sent to the driver */
+  ULONG EventInfoSize;
+  /** EVENT_INFORMATION.Flags to set when sent in a batch */
+  ULONG BatchFlags;
+  BOOL PoolAllocated;
+  /** DOKAN_IO_EVENT.OperationSlot of the event */
+  ULONG OperationSlot;
+  /** Performance counter when the result was ready */
+  LONG64 ReadyTime;
+} DOKAN_QUEUED_REPLY;
+
+/**
+ * \struct DOKAN_REPLY_BATCH
+ * \brief Event results waiting to be sent together to the driver
+ *
+ * With IPC batching, results sent without pulling new events are queued
+ * instead of each taking its own device call, as long as a thread dispatching
+ * an event will send them with its own result soon. The queued results are
+ * sent, sorted by serial number, in the same buffer as the next result sent
+ * or pulled with, or on their own once DOKAN_REPLY_BATCH_MAX_COUNT or
+ * DOKAN_REPLY_BATCH_MAX_SIZE is reached or DOKAN_REPLY_BATCH_TIMEOUT_MS after
+ * the first was queued.
+ */
+typedef struct _DOKAN_REPLY_BATCH {
+  /** Protects the batch fields except Timer */
+  SRWLOCK Lock;
+  DOKAN_QUEUED_REPLY Replies[DOKAN_REPLY_BATCH_MAX_COUNT];
+  volatile ULONG Count;
+  /** Sum of the EventInfoSize of Replies */
+  ULONG Size;
+  /**
+   * Threads dispatching a pulled event, which send a result or pull next.
+   * Results are only queued while one of them can carry them.
+   */
+  volatile LONG Dispatchers;
+  /** Sends the replies queued for DOKAN_REPLY_BATCH_TIMEOUT_MS */
+  PTP_TIMER Timer;
+} DOKAN_REPLY_BATCH;
+
+/** Buckets of DOKAN_ADMISSION.Processes */
+#define DOKAN_ADMISSION_BUCKET_COUNT 64
+/** Processes tracked above which the idle ones are forgotten */
+#define DOKAN_ADMISSION_MAX_IDLE_PROCESSES 64
+
+/**
+ * \struct DOKAN_PROCESS_ADMISSION
+ * \brief Admission state of the events of a requesting process
+ */
+typedef struct _DOKAN_PROCESS_ADMISSION {
+  /** Entry in its DOKAN_ADMISSION.Processes bucket */
+  LIST_ENTRY ListEntry;
+  /** Entry in DOKAN_ADMISSION.WaitingProcesses while it has waiting events */
+  LIST_ENTRY WaitingListEntry;
+  ULONG ProcessId;
+  /** Events admitted and not completed yet */
+  ULONG InFlightEvents;
+  /** DOKAN_IO_EVENT waiting to be admitted, linked by DispatchListEntry */
+  LIST_ENTRY WaitingEvents;
+  ULONG WaitingEventCount;
+  /** Token bucket, in performance counter ticks: one event costs a second */
+  LONG64 Tokens;
+  /** Performance counter when Tokens was last refilled */
+  LONG64 RefillTime;
+  ULONG64 AdmittedEvents;
+  /** Admitted events that had to wait */
+  ULONG64 DelayedEvents;
+} DOKAN_PROCESS_ADMISSION;
+
+/**
+ * \struct DOKAN_ADMISSION
+ * \brief Per-process admission control of the events of a mount
+ *
+ * An event is only dispatched once its process has fewer than MaxInFlight
+ * events being dispatched and a token left in its bucket, refilled at Rate
+ * tokens per second up to Burst. Events over the limits wait in the queue of
+ * their process. Processes with waiting events are served in round robin,
+ * one event each, when an event completes or the timer sees new tokens.
+ */
+typedef struct _DOKAN_ADMISSION {
+  /** Protects the admission fields except Timer */
+  SRWLOCK Lock;
+  /** DOKAN_PROCESS_ADMISSION hashed by ProcessId */
+  LIST_ENTRY Processes[DOKAN_ADMISSION_BUCKET_COUNT];
+  ULONG ProcessCount;
+  /** DOKAN_PROCESS_ADMISSION with waiting events, in round robin order */
+  LIST_ENTRY WaitingProcesses;
+  ULONG WaitingProcessCount;
+  /** Limits, 0 when disabled */
+  ULONG MaxInFlight;
+  ULONG Rate;
+  ULONG Burst;
+  /** Performance counter frequency */
+  LONG64 TicksPerSecond;
+  /** Admits the waiting events once their process has tokens again */
+  PTP_TIMER Timer;
+  /** Performance counter when Timer is due, 0 if it is not set */
+  LONG64 TimerDueTime;
+} DOKAN_ADMISSION;
+
+typedef struct _DOKAN_POOL_SET DOKAN_POOL_SET, *PDOKAN_POOL_SET;
+typedef struct _DOKAN_LARGE_BUFFER_POOL DOKAN_LARGE_BUFFER_POOL,
+    *PDOKAN_LARGE_BUFFER_POOL;
+typedef struct _DOKAN_DIRECTORY_CACHE DOKAN_DIRECTORY_CACHE,
+    *PDOKAN_DIRECTORY_CACHE;
+
+// Operations measured apart: the major functions, then the information
+// classes of IRP_MJ_QUERY_INFORMATION and of IRP_MJ_SET_INFORMATION.
+#define DOKAN_OPERATION_QUERY_INFORMATION_SLOT DOKAN_MAJOR_FUNCTION_COUNT
+#define DOKAN_OPERATION_SET_INFORMATION_SLOT                                   \
+  (DOKAN_OPERATION_QUERY_INFORMATION_SLOT + DOKAN_FILE_INFORMATION_CLASS_COUNT)
+#define DOKAN_OPERATION_SLOT_COUNT                                             \
+  (DOKAN_OPERATION_SET_INFORMATION_SLOT + DOKAN_FILE_INFORMATION_CLASS_COUNT)
+
+#define DOKAN_OPERATION_STAGE_QUEUE_WAIT 0
+#define DOKAN_OPERATION_STAGE_CALLBACK 1
+#define DOKAN_OPERATION_STAGE_REPLY 2
+#define DOKAN_OPERATION_STAGE_COUNT 3
+
+/**
+ * \struct DOKAN_OPERATION_COUNTERS
+ * \brief Latency histograms of an operation, updated with interlocked calls
+ */
+typedef struct _DOKAN_OPERATION_COUNTERS {
+  DOKAN_LATENCY_HISTOGRAM Stages[DOKAN_OPERATION_STAGE_COUNT];
+} DOKAN_OPERATION_COUNTERS;
+
+/**
+ * \struct DOKAN_EVENT_TRACE
+ * \brief Trace of the events of a mount being recorded
+ *
+ * Written by DokanStartEventTrace until DokanStopEventTrace.
+ * \see dokan_trace.c for the file format.
+ */
+typedef struct _DOKAN_EVENT_TRACE {
+  /** Protects every field except the unlocked check of File */
+  SRWLOCK Lock;
+  /** Trace file, NULL when no trace is recorded */
+  HANDLE volatile File;
+  /** Records not written to File yet */
+  PCHAR Buffer;
+  ULONG BufferUsed;
+  /** Time the trace started at, the record times are relative to it */
+  LARGE_INTEGER Start;
+  LARGE_INTEGER Frequency;
+} DOKAN_EVENT_TRACE;
+
 typedef struct _DOKAN_INSTANCE_THREADINFO {
   PTP_POOL ThreadPool;
   PTP_CLEANUP_GROUP CleanupGroup;
   TP_CALLBACK_ENVIRON CallbackEnvironment;
+  /** Batched events dispatch queue. Only used with IPC batching. */
+  DOKAN_DISPATCH_QUEUE DispatchQueue;
+  /** Thread count controller. Only used with IPC batching. */
+  DOKAN_DISPATCH_CONTROLLER DispatchController;
+  /** Results waiting to be sent together. Only used with IPC batching. */
+  DOKAN_REPLY_BATCH ReplyBatch;
+  /**
+   * Per-process limits of the dispatched events.
+   * Only used with DOKAN_OPTION_PROCESS_ADMISSION.
+   */
+  DOKAN_ADMISSION Admission;
+  /**
+   * Completion of the overlapped pulls posted on PullDevice by the device
+   * transport. Only used with DOKAN_OPTION_OVERLAPPED_PULL.
+   */
+  PTP_IO PullIo;
+  /** Overlapped pulls posted and not yet harvested */
+  volatile LONG PostedPulls;
+  /** Whether new pulls must no longer be posted */
+  volatile LONG PullsStopped;
+  /** Set when PostedPulls drops to 0 once PullsStopped is set */
+  HANDLE PullsDrainedEvent;
 } DOKAN_INSTANCE_THREADINFO;
 
 /**
@@ -76,12 +340,46 @@ typedef struct _DOKAN_INSTANCE {
   LIST_ENTRY ListEntry;
   /** Global Dokan Kernel device handle */
   HANDLE GlobalDevice;
+  /** Channel of the events and results. The driver unless created in memory. */
+  const struct _DOKAN_TRANSPORT *Transport;
+  /** State of Transport, owned by it */
+  PVOID TransportContext;
+  /** Events recorded with DokanStartEventTrace */
+  DOKAN_EVENT_TRACE EventTrace;
+  /**
+   * Latency histograms by DOKAN_IO_EVENT.OperationSlot, allocated when the
+   * first event of the operation is measured.
+   */
+  DOKAN_OPERATION_COUNTERS *volatile
+      OperationCounters[DOKAN_OPERATION_SLOT_COUNT];
+  /** Frequency of the performance counter */
+  LONG64 TicksPerSecond;
   /** Device handle used to communicate with the kernel mount instance */
   HANDLE Device;
+  /**
+   * Device handle the overlapped pulls are posted on, bound to
+   * DOKAN_INSTANCE_THREADINFO.PullIo. Only used with
+   * DOKAN_OPTION_OVERLAPPED_PULL.
+   */
+  HANDLE PullDevice;
   /** Device unmount event. It is set when the device is stopped */
   HANDLE DeviceClosedWaitHandle;
   /** Thread pool context of the mount instance */
   DOKAN_INSTANCE_THREADINFO ThreadInfo;
+  /**
+   * Memory pools of the mount. One per NUMA node when DOKAN_OPTION_NUMA_POOLS
+   * is set.
+   */
+  PDOKAN_POOL_SET *PoolSets;
+  /** Number of entries in PoolSets */
+  ULONG PoolSetCount;
+  /** Buffers of the reads and writes too large for the pool sets */
+  PDOKAN_LARGE_BUFFER_POOL LargeBufferPool;
+  /**
+   * Directory listings shared by the opens of a directory. Only created with
+   * DOKAN_OPTION_DIRECTORY_CACHE.
+   */
+  PDOKAN_DIRECTORY_CACHE DirectoryCache;
   /** Handle with the notify file opened at mount */
   HANDLE NotifyHandle;
   /** Handle of the Keepalive file opened at mount */
@@ -95,6 +393,166 @@ typedef struct _DOKAN_INSTANCE {
   LONG UnmountedCalled;
 } DOKAN_INSTANCE, *PDOKAN_INSTANCE;
 
+struct _DOKAN_IO_BATCH;
+
+/**
+ * \struct DOKAN_TRANSPORT
+ * \brief Channel between a mount instance and the source of its events
+ *
+ * Every call returns 0 or a Win32 error code, like the device calls they stand
+ * for. g_DeviceTransport talks to the driver, g_MemoryTransport serves the
+ * events submitted with DokanMemoryTransportSubmit without any driver.
+ */
+typedef struct _DOKAN_TRANSPORT {
+  /**
+   * Completes the event results of InputBuffer, then waits for new events to
+   * copy in OutputBuffer unless it is NULL. FSCTL_EVENT_PROCESS_N_PULL.
+   */
+  DWORD (*ProcessAndPull)(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                          DWORD InputBufferSize, PVOID OutputBuffer,
+                          DWORD OutputBufferSize, PDWORD BytesReturned);
+  /** Fetches the whole event context of a large write. FSCTL_EVENT_WRITE. */
+  DWORD (*FetchWrite)(PDOKAN_INSTANCE DokanInstance,
+                      PEVENT_INFORMATION EventInfo, DWORD EventInfoSize,
+                      PEVENT_CONTEXT EventContext, DWORD EventContextSize,
+                      PDWORD BytesReturned);
+  /** Reports a change made outside of the mount. FSCTL_NOTIFY_PATH. */
+  DWORD (*NotifyPath)(PDOKAN_INSTANCE DokanInstance,
+                      PDOKAN_NOTIFY_PATH_INTERMEDIATE NotifyPath,
+                      DWORD Length);
+  /** Fails the pending and next pulls, which stops the instance. */
+  VOID (*Release)(PDOKAN_INSTANCE DokanInstance);
+  /** Frees TransportContext once no thread uses the transport anymore. */
+  VOID (*Delete)(PDOKAN_INSTANCE DokanInstance);
+  /**
+   * Prepares the posting of overlapped pulls. Only called with
+   * DOKAN_OPTION_OVERLAPPED_PULL, like the three calls below.
+   */
+  BOOL (*StartPulls)(PDOKAN_INSTANCE DokanInstance);
+  /**
+   * Completes the event results of InputBuffer, then posts a pull of new
+   * events in IoBatch without waiting for it. Unless it returns an error,
+   * CompleteOverlappedPull is called once the pull completed.
+   */
+  DWORD (*PostPull)(PDOKAN_INSTANCE DokanInstance, PVOID InputBuffer,
+                    DWORD InputBufferSize, struct _DOKAN_IO_BATCH *IoBatch);
+  /** Fails the posted pulls with ERROR_OPERATION_ABORTED. */
+  VOID (*CancelPulls)(PDOKAN_INSTANCE DokanInstance);
+  /** Waits for the CompleteOverlappedPull calls to return. */
+  VOID (*WaitForPulls)(PDOKAN_INSTANCE DokanInstance);
+} DOKAN_TRANSPORT;
+
+extern const DOKAN_TRANSPORT g_DeviceTransport;
+extern const DOKAN_TRANSPORT g_MemoryTransport;
+
+BOOL CreateMemoryTransport(PDOKAN_INSTANCE DokanInstance);
+
+VOID TraceEventBatch(PDOKAN_INSTANCE DokanInstance, PEVENT_CONTEXT EventContext,
+                     DWORD Size);
+VOID TraceEventOpen(PDOKAN_INSTANCE DokanInstance, ULONG SerialNumber,
+                    ULONG64 Context);
+VOID StopEventTrace(PDOKAN_INSTANCE DokanInstance);
+
+LONG64 GetPerformanceCounter();
+ULONG GetOperationSlot(PEVENT_CONTEXT EventContext);
+VOID RecordOperationStage(PDOKAN_INSTANCE DokanInstance, ULONG OperationSlot,
+                          ULONG Stage, LONG64 Ticks);
+VOID RecordReplies(PDOKAN_INSTANCE DokanInstance, DOKAN_QUEUED_REPLY *Replies,
+                   ULONG Count);
+VOID FreeOperationCounters(PDOKAN_INSTANCE DokanInstance);
+
+// Kinds of the entries recorded with DOKAN_OPTION_EVENT_TIMELINE.
+#define DOKAN_TIMELINE_PULL_BEGIN 1
+#define DOKAN_TIMELINE_PULL_END 2
+#define DOKAN_TIMELINE_PULLED 3
+#define DOKAN_TIMELINE_QUEUED 4
+#define DOKAN_TIMELINE_DISPATCH_BEGIN 5
+#define DOKAN_TIMELINE_DISPATCH_END 6
+#define DOKAN_TIMELINE_REPLY 7
+
+VOID InitializeTimeline();
+VOID CleanupTimeline();
+VOID ReleaseTimelineRing();
+VOID RecordTimeline(PDOKAN_INSTANCE DokanInstance, UCHAR Kind,
+                    UCHAR MajorFunction, ULONG Value);
+
+/**
+ * \struct DOKAN_DIRECTORY_ENTRY
+ * \brief Entry of a DOKAN_DIRECTORY_LIST
+ *
+ * Only keeps what the directory information classes return, with the name
+ * stored apart in DOKAN_DIRECTORY_LIST.Names.
+ */
+typedef struct _DOKAN_DIRECTORY_ENTRY {
+  LONG64 CreationTime;
+  LONG64 LastAccessTime;
+  LONG64 LastWriteTime;
+  LONG64 FileSize;
+  DWORD FileAttributes;
+  /** Offset in WCHAR of the NUL terminated name in the list Names */
+  ULONG NameOffset;
+  /** Length in WCHAR of the name, without the NUL */
+  USHORT NameLength;
+} DOKAN_DIRECTORY_ENTRY, *PDOKAN_DIRECTORY_ENTRY;
+
+/**
+ * \struct DOKAN_DIRECTORY_LIST
+ * \brief Directory entries returned by FindFiles
+ *
+ * The names are packed one after the other in a single buffer rather than
+ * kept in a WIN32_FIND_DATAW each, which is mostly unused MAX_PATH space.
+ */
+typedef struct _DOKAN_DIRECTORY_LIST {
+  /** DOKAN_DIRECTORY_ENTRY in listing order */
+  PDOKAN_VECTOR Entries;
+  /** WCHAR of the NUL terminated names of Entries */
+  PDOKAN_VECTOR Names;
+  /** Whether the entries come from DOKAN_OPERATIONS.FindFilesPage */
+  BOOL Paged;
+  /** Whether FindFilesPage has more entries to add from Continuation */
+  BOOL MoreEntries;
+  ULONG64 Continuation;
+  /** Whether "." and ".." were added by the library, skipped in later pages */
+  BOOL HasDotEntries;
+  /**
+   * Holders of the list: the opens using it and the directory cache. It goes
+   * back to the pool when the last one pushes it.
+   */
+  volatile LONG ReferenceCount;
+  /** Directory cache generation read before the listing started */
+  ULONG64 CacheGeneration;
+  /** Pool set the list was popped from and is pushed back to */
+  PDOKAN_POOL_SET PoolSet;
+} DOKAN_DIRECTORY_LIST, *PDOKAN_DIRECTORY_LIST;
+
+PDOKAN_DIRECTORY_LIST CreateDirectoryList();
+VOID DeleteDirectoryList(PDOKAN_DIRECTORY_LIST DirectoryList);
+VOID ClearDirectoryList(PDOKAN_DIRECTORY_LIST DirectoryList);
+
+// Complete listings of the directories shared by all their opens until they
+// expire or a change in the directory is dispatched or notified.
+BOOL CreateDirectoryCache(PDOKAN_INSTANCE DokanInstance);
+VOID DeleteDirectoryCache(PDOKAN_INSTANCE DokanInstance);
+ULONG64 GetDirectoryCacheGeneration(PDOKAN_INSTANCE DokanInstance);
+PDOKAN_DIRECTORY_LIST LookupDirectoryCache(PDOKAN_INSTANCE DokanInstance,
+                                           LPCWSTR Path);
+VOID InsertDirectoryCache(PDOKAN_INSTANCE DokanInstance, LPCWSTR Path,
+                          PDOKAN_DIRECTORY_LIST DirList);
+VOID InvalidateDirectoryCache(PDOKAN_INSTANCE DokanInstance, LPCWSTR Path);
+
+/**
+ * \struct DOKAN_DIR_LIST_CURSOR
+ * \brief Where the last enumeration of a directory list stopped
+ *
+ * MatchIndex entries of the list matched the search pattern before the entry
+ * at Position. A continuation asking for a later index resumes from there
+ * instead of matching the list again from its first entry.
+ */
+typedef struct _DOKAN_DIR_LIST_CURSOR {
+  ULONG MatchIndex;
+  size_t Position;
+} DOKAN_DIR_LIST_CURSOR, *PDOKAN_DIR_LIST_CURSOR;
+
 /**
  * \struct DOKAN_OPEN_INFO
  * \brief Dokan open file informations
@@ -105,8 +563,12 @@ typedef struct _DOKAN_OPEN_INFO {
   CRITICAL_SECTION CriticalSection;
   /** Dokan instance linked to the open */
   PDOKAN_INSTANCE DokanInstance;
-  PDOKAN_VECTOR DirList;
+  /** Pool set the open was popped from and is pushed back to */
+  PDOKAN_POOL_SET PoolSet;
+  PDOKAN_DIRECTORY_LIST DirList;
   PWCHAR DirListSearchPattern;
+  /** Resume point of the enumeration of DirList, reset with it */
+  DOKAN_DIR_LIST_CURSOR DirListCursor;
   /** Whether the FindFilesWithPattern has returned STATUS_NOT_IMPLEMENTED */
   BOOLEAN UnimplementedFindFilesWithPattern;
   /** User Context see DOKAN_FILE_INFO.Context */
@@ -122,6 +584,16 @@ typedef struct _DOKAN_OPEN_INFO {
   LONG64 CloseUserContext;
   /** Event context */
   PEVENT_CONTEXT EventContext;
+  /**
+   * Whether an event of the open is being dispatched.
+   * Only used with DOKAN_OPTION_ORDERED_FILE_DISPATCH.
+   */
+  BOOL OrderedDispatchBusy;
+  /**
+   * DOKAN_IO_EVENT of the open waiting for the dispatched one to complete,
+   * linked by their DispatchListEntry in the order they were pulled.
+   */
+  LIST_ENTRY OrderedEvents;
 } DOKAN_OPEN_INFO, *PDOKAN_OPEN_INFO;
 
 /**
@@ -138,6 +610,8 @@ typedef struct _DOKAN_OPEN_INFO {
 typedef struct _DOKAN_IO_BATCH {
   /** Dokan instance linked to the batch */
   PDOKAN_INSTANCE DokanInstance;
+  /** Pool set the batch was popped from and is pushed back to */
+  PDOKAN_POOL_SET PoolSet;
   /** Size read from kernel that is hold in EventContext */
   DWORD NumberOfBytesTransferred;
   /** Whether it is used by the Main pull thread that wait indefinitely in kernel compared to volatile pool threads */
@@ -147,12 +621,18 @@ typedef struct _DOKAN_IO_BATCH {
    * Large Write events will allocate a specific buffer that will not come from the memory pool.
    */
   BOOL PoolAllocated;
+  /** Size of the buffer when it was carved from the large buffer pool, 0 otherwise */
+  SIZE_T LargeBufferSize;
   /**
    * Number of actual EVENT_CONTEXT stored in EventContext.
    * This is used as a shared buffer counter that is decremented when an event is processed.
    * When it reaches 0, the buffer is free or pushed to the memory pool.
    */
   LONG EventContextBatchCount;
+  /** Used when the batch is pulled by an overlapped pull */
+  OVERLAPPED Overlapped;
+  /** Performance counter when the events were pulled */
+  LONG64 PullTime;
   /**
    * The actual buffer used to pull events from kernel.
    * It may contain multiple EVENT_CONTEXT depending on what the kernel has to offer right now.
@@ -194,8 +674,54 @@ typedef struct _DOKAN_IO_EVENT {
    * When it is free, the EventContext of this IoEvent is no longer safe to access.
    */
   PDOKAN_IO_BATCH IoBatch;
+  /**
+   * Whether the event owns the ordered dispatch of its open.
+   * \see DOKAN_OPEN_INFO.OrderedEvents
+   */
+  BOOL OrderedDispatch;
+  /**
+   * Whether the operation callback returned STATUS_PENDING. The event is then
+   * completed by a DokanEndDispatch function, possibly on another thread.
+   */
+  BOOL CallbackPending;
+  /** Operation of the event in DOKAN_INSTANCE.OperationCounters */
+  ULONG OperationSlot;
+  /** Performance counter when the dispatch started */
+  LONG64 DispatchTime;
+  /**
+   * Admission of the process of the event, set once it is admitted.
+   * \see DOKAN_ADMISSION
+   */
+  DOKAN_PROCESS_ADMISSION *ProcessAdmission;
+  /**
+   * DOKAN_IO_EVENT_DISPATCHING, DOKAN_IO_EVENT_PENDING or
+   * DOKAN_IO_EVENT_COMPLETED. Decides whether the dispatching or the completing
+   * thread sends the result of a pending event.
+   */
+  volatile LONG CompletionState;
+  /**
+   * Entry in DOKAN_DISPATCH_QUEUE.Lanes, DOKAN_OPEN_INFO.OrderedEvents or
+   * DOKAN_PROCESS_ADMISSION.WaitingEvents while waiting to be dispatched.
+   * This field and the following ones are not cleared when the event is
+   * reset and must be initialized before use.
+   */
+  LIST_ENTRY DispatchListEntry;
+  /**
+   * Pool set the event was popped from and is pushed back to. Kept when the
+   * event is reset by the thread that reuses it.
+   */
+  PDOKAN_POOL_SET PoolSet;
 } DOKAN_IO_EVENT, *PDOKAN_IO_EVENT;
 
+// DOKAN_IO_EVENT.CompletionState values.
+#define DOKAN_IO_EVENT_DISPATCHING 0
+#define DOKAN_IO_EVENT_PENDING 1
+#define DOKAN_IO_EVENT_COMPLETED 2
+
+// Size of the DOKAN_IO_EVENT fields that are cleared when an event is reset.
+#define DOKAN_IO_EVENT_RESET_SIZE                                              \
+  FIELD_OFFSET(DOKAN_IO_EVENT, DispatchListEntry)
+
 #define IOEVENT_RESULT_BUFFER_SIZE(ioEvent)                                    \
   ((ioEvent)->EventResultSize >= offsetof(EVENT_INFORMATION, Buffer)           \
        ? (ioEvent)->EventResultSize - offsetof(EVENT_INFORMATION, Buffer)      \
@@ -217,12 +743,87 @@ VOID ALIGN_ALLOCATION_SIZE(PLARGE_INTEGER size, PDOKAN_OPTIONS DokanOptions);
 BOOL DokanMount(PDOKAN_INSTANCE DokanInstance,
                 PDOKAN_OPTIONS DokanOptions);
 
+BOOL EnableTokenPrivilege(LPCTSTR lpszSystemName, BOOL bEnable);
+
+// Same as EnableTokenPrivilege, also telling in pbWasEnabled whether the
+// privilege was enabled before, to restore it.
+BOOL EnableTokenPrivilegeEx(LPCTSTR lpszSystemName, BOOL bEnable,
+                            PBOOL pbWasEnabled);
+
 BOOL IsMountPointDriveLetter(LPCWSTR mountPoint);
 
 VOID EventCompletion(PDOKAN_IO_EVENT EventInfo);
 
+// Returns TRUE if the operation callback of the event returned STATUS_PENDING
+// and is allowed to complete asynchronously. The dispatcher must then return
+// without touching the event anymore.
+BOOL IsDispatchPending(PDOKAN_IO_EVENT IoEvent, NTSTATUS Status);
+
+// Called by the dispatching thread after a callback returned STATUS_PENDING.
+// Returns TRUE if the completing thread now owns the event and sends its
+// result, FALSE if the event is already completed and its result is to be
+// sent as usual.
+BOOL HandOffPendingIoEvent(PDOKAN_IO_EVENT IoEvent);
+
+// Sends the result of a pending event completed after its hand-off. Must be
+// the last use of the event.
+VOID CompletePendingDispatch(PDOKAN_IO_EVENT IoEvent);
+
+BOOL StartDispatchController(PDOKAN_INSTANCE DokanInstance,
+                             ULONG MainPullThreadCount);
+
+BOOL StartReplyBatch(PDOKAN_INSTANCE DokanInstance);
+
+// Releases the replies left in the reply batch once no thread can use it.
+VOID DiscardQueuedReplies(PDOKAN_INSTANCE DokanInstance);
+
+// Posts PullCount overlapped pulls on the transport.
+BOOL StartOverlappedPulls(PDOKAN_INSTANCE DokanInstance, ULONG PullCount);
+
+// Called by the transport once an overlapped pull posted on it completed:
+// posts a new pull and dispatches the pulled events.
+VOID CompleteOverlappedPull(PDOKAN_INSTANCE DokanInstance,
+                            PDOKAN_IO_BATCH IoBatch, DWORD IoResult,
+                            DWORD NumberOfBytesTransferred);
+
+// Cancels the posted overlapped pulls and waits for their completion.
+VOID StopOverlappedPulls(PDOKAN_INSTANCE DokanInstance);
+
+// Returns FALSE if the pool thread should not pull new events. Every
+// successful call must be followed by EndPoolPull.
+BOOL BeginPoolPull(PDOKAN_INSTANCE DokanInstance);
+
+VOID EndPoolPull(PDOKAN_INSTANCE DokanInstance);
+
+VOID RecordPull(PDOKAN_INSTANCE DokanInstance, ULONG EventCount);
+
+VOID RecordDispatch(PDOKAN_INSTANCE DokanInstance, LONG64 DispatchTicks);
+
+BOOL StartProcessAdmission(PDOKAN_INSTANCE DokanInstance);
+
+// Releases the process admissions once no thread can use them.
+VOID FreeProcessAdmission(PDOKAN_INSTANCE DokanInstance);
+
+// Admits the event for dispatch. Returns FALSE if its process is over its
+// limits, the event is then queued and dispatched once admitted.
+BOOL BeginAdmittedDispatch(PDOKAN_IO_EVENT IoEvent);
+
+// Releases the admission of a completed event and queues for dispatch the
+// waiting events it allows.
+VOID EndAdmittedDispatch(PDOKAN_IO_EVENT IoEvent);
+
+// Appends the events to the dispatch queue of the instance. Events is emptied.
+VOID QueueIoEventList(PDOKAN_INSTANCE DokanInstance, PLIST_ENTRY Events);
+
+// Reserves the submissions of the dispatch queue work object allowed by the
+// worker limit. The queue lock must be held exclusively. The returned number
+// of submissions is to be done with SubmitQueuedIoWork once it is released.
+ULONG ReserveQueuedIoWork(DOKAN_DISPATCH_QUEUE *Queue);
+
+VOID SubmitQueuedIoWork(DOKAN_DISPATCH_QUEUE *Queue, ULONG Count);
+
 VOID CreateDispatchCommon(PDOKAN_IO_EVENT IoEvent, ULONG SizeOfEventInfo,
-                          BOOL UseExtraMemoryPool, BOOL ClearNonPoolBuffer);
+                          BOOL UseExtraMemoryPool, BOOL ClearBuffer);
 
 VOID DispatchDirectoryInformation(PDOKAN_IO_EVENT IoEvent);
 
@@ -304,37 +304,39 @@ BOOL WINAPI DokanFillFindStreamData(PWIN32_FIND_STREAM_DATA FindStreamData,
 }
 
 VOID DOKANAPI DokanEndDispatchGetFileInformation(
-    PDOKAN_IO_EVENT IoEvent, PBY_HANDLE_FILE_INFORMATION ByHandleFileInfo,
-    NTSTATUS Status) {
-  ULONG remainingLength = IoEvent->EventContext->Operation.File.BufferLength;
+    PDOKAN_FILE_INFO DokanFileInfo,
+    PBY_HANDLE_FILE_INFORMATION ByHandleFileInfo, NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  ULONG remainingLength = ioEvent->EventContext->Operation.File.BufferLength;
 
   DbgPrint("\tresult =  %lx\n", Status);
 
   if (Status != STATUS_SUCCESS) {
-    IoEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
-    IoEvent->EventResult->BufferLength = 0;
+    ioEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
+    ioEvent->EventResult->BufferLength = 0;
   } else {
     ULONG fileInformationClass =
-        IoEvent->EventContext->Operation.File.FileInformationClass;
+        ioEvent->EventContext->Operation.File.FileInformationClass;
     switch (fileInformationClass) {
     case FileBasicInformation:
       DbgPrint("\tFileBasicInformation\n");
       Status = DokanFillFileBasicInfo(
-          (PFILE_BASIC_INFORMATION)IoEvent->EventResult->Buffer,
+          (PFILE_BASIC_INFORMATION)ioEvent->EventResult->Buffer,
           ByHandleFileInfo, &remainingLength);
       break;
 
     case FileIdInformation:
       DbgPrint("\tFileIdInformation\n");
       Status =
-          DokanFillIdInfo((PFILE_ID_INFORMATION)IoEvent->EventResult->Buffer,
+          DokanFillIdInfo((PFILE_ID_INFORMATION)ioEvent->EventResult->Buffer,
                           ByHandleFileInfo, &remainingLength);
       break;
 
     case FileInternalInformation:
       DbgPrint("\tFileInternalInformation\n");
       Status = DokanFillInternalInfo(
-          (PFILE_INTERNAL_INFORMATION)IoEvent->EventResult->Buffer,
+          (PFILE_INTERNAL_INFORMATION)ioEvent->EventResult->Buffer,
           ByHandleFileInfo, &remainingLength);
       break;
 
@@ -348,15 +350,15 @@ VOID DOKANAPI DokanEndDispatchGetFileInformation(
     case FileStandardInformation:
       DbgPrint("\tFileStandardInformation\n");
       Status = DokanFillFileStandardInfo(
-          (PFILE_STANDARD_INFORMATION)IoEvent->EventResult->Buffer,
-          ByHandleFileInfo, &remainingLength, IoEvent->DokanInstance);
+          (PFILE_STANDARD_INFORMATION)ioEvent->EventResult->Buffer,
+          ByHandleFileInfo, &remainingLength, ioEvent->DokanInstance);
       break;
 
     case FileAllInformation:
       DbgPrint("\tFileAllInformation\n");
       Status = DokanFillFileAllInfo(
-          (PFILE_ALL_INFORMATION)IoEvent->EventResult->Buffer, ByHandleFileInfo,
-          &remainingLength, IoEvent->DokanInstance);
+          (PFILE_ALL_INFORMATION)ioEvent->EventResult->Buffer, ByHandleFileInfo,
+          &remainingLength, ioEvent->DokanInstance);
       break;
 
     case FileAlternateNameInformation:
@@ -367,7 +369,7 @@ VOID DOKANAPI DokanEndDispatchGetFileInformation(
     case FileAttributeTagInformation:
       DbgPrint("\tFileAttributeTagInformation\n");
       Status = DokanFillFileAttributeTagInfo(
-          (PFILE_ATTRIBUTE_TAG_INFORMATION)IoEvent->EventResult->Buffer,
+          (PFILE_ATTRIBUTE_TAG_INFORMATION)ioEvent->EventResult->Buffer,
           ByHandleFileInfo, &remainingLength);
       break;
 
@@ -385,22 +387,22 @@ VOID DOKANAPI DokanEndDispatchGetFileInformation(
         DbgPrint("\tFileNameInformation\n");
       }
       Status = DokanFillFileNameInfo(
-          (PFILE_NAME_INFORMATION)IoEvent->EventResult->Buffer,
-          ByHandleFileInfo, &remainingLength, IoEvent->EventContext);
+          (PFILE_NAME_INFORMATION)ioEvent->EventResult->Buffer,
+          ByHandleFileInfo, &remainingLength, ioEvent->EventContext);
       break;
 
     case FileNetworkOpenInformation:
       DbgPrint("\tFileNetworkOpenInformation\n");
       Status = DokanFillNetworkOpenInfo(
-          (PFILE_NETWORK_OPEN_INFORMATION)IoEvent->EventResult->Buffer,
-          ByHandleFileInfo, &remainingLength, IoEvent->DokanInstance);
+          (PFILE_NETWORK_OPEN_INFORMATION)ioEvent->EventResult->Buffer,
+          ByHandleFileInfo, &remainingLength, ioEvent->DokanInstance);
       break;
 
     case FilePositionInformation:
       // this case is not used because driver deal with
       DbgPrint("\tFilePositionInformation\n");
       Status = DokanFillFilePositionInfo(
-          (PFILE_POSITION_INFORMATION)IoEvent->EventResult->Buffer,
+          (PFILE_POSITION_INFORMATION)ioEvent->EventResult->Buffer,
           ByHandleFileInfo, &remainingLength);
       break;
     case FileStreamInformation:
@@ -414,21 +416,23 @@ VOID DOKANAPI DokanEndDispatchGetFileInformation(
     } break;
     }
 
-    IoEvent->EventResult->Status = Status;
-    IoEvent->EventResult->BufferLength =
-        IoEvent->EventContext->Operation.File.BufferLength - remainingLength;
+    ioEvent->EventResult->Status = Status;
+    ioEvent->EventResult->BufferLength =
+        ioEvent->EventContext->Operation.File.BufferLength - remainingLength;
   }
 
   DbgPrint("\tDispatchQueryInformation result =  %lx\n", Status);
-  EventCompletion(IoEvent);
+  EventCompletion(ioEvent);
 }
 
-VOID DOKANAPI DokanEndDispatchFindStreams(PDOKAN_IO_EVENT IoEvent,
+VOID DOKANAPI DokanEndDispatchFindStreams(PDOKAN_FILE_INFO DokanFileInfo,
                                           NTSTATUS Status) {
-  ULONG resultBufferSize = IOEVENT_RESULT_BUFFER_SIZE(IoEvent);
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  ULONG resultBufferSize = IOEVENT_RESULT_BUFFER_SIZE(ioEvent);
   PFILE_STREAM_INFORMATION streamInfo =
-      (PFILE_STREAM_INFORMATION)&IoEvent->EventResult
-          ->Buffer[IoEvent->EventResult->BufferLength];
+      (PFILE_STREAM_INFORMATION)&ioEvent->EventResult
+          ->Buffer[ioEvent->EventResult->BufferLength];
 
   DbgPrint("\tresult =  %lx\n", Status);
 
@@ -436,13 +440,13 @@ VOID DOKANAPI DokanEndDispatchFindStreams(PDOKAN_IO_EVENT IoEvent,
   assert(streamInfo->NextEntryOffset % DOKAN_STREAM_ENTRY_ALIGNMENT == 0);
 
   // Ensure that the last entry doesn't point to another entry.
-  IoEvent->EventResult->BufferLength += streamInfo->NextEntryOffset;
+  ioEvent->EventResult->BufferLength += streamInfo->NextEntryOffset;
   streamInfo->NextEntryOffset = 0;
 
-  assert(IoEvent->EventResult->BufferLength <= resultBufferSize);
+  assert(ioEvent->EventResult->BufferLength <= resultBufferSize);
 
-  if (IoEvent->EventResult->BufferLength > resultBufferSize) {
-    IoEvent->EventResult->BufferLength = 0;
+  if (ioEvent->EventResult->BufferLength > resultBufferSize) {
+    ioEvent->EventResult->BufferLength = 0;
     Status = STATUS_BUFFER_OVERFLOW;
   }
 
@@ -453,9 +457,9 @@ VOID DOKANAPI DokanEndDispatchFindStreams(PDOKAN_IO_EVENT IoEvent,
     Status = STATUS_INTERNAL_ERROR;
   }
 
-  IoEvent->EventResult->Status = Status;
+  ioEvent->EventResult->Status = Status;
   DbgPrint("\tDokanEndDispatchFindStreams result =  0x%x\n", Status);
-  EventCompletion(IoEvent);
+  EventCompletion(ioEvent);
 }
 
 VOID DispatchQueryInformation(PDOKAN_IO_EVENT IoEvent) {
@@ -473,7 +477,7 @@ VOID DispatchQueryInformation(PDOKAN_IO_EVENT IoEvent) {
   CreateDispatchCommon(IoEvent,
                        IoEvent->EventContext->Operation.File.BufferLength,
                        /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   if (IoEvent->EventContext->Operation.File.FileInformationClass ==
       FileStreamInformation) {
@@ -488,7 +492,11 @@ VOID DispatchQueryInformation(PDOKAN_IO_EVENT IoEvent) {
       status = IoEvent->DokanInstance->DokanOperations->FindStreams(
           IoEvent->EventContext->Operation.File.FileName,
           DokanFillFindStreamData, IoEvent, &IoEvent->DokanFileInfo);
-      DokanEndDispatchFindStreams(IoEvent, status);
+      if (IsDispatchPending(IoEvent, status)) {
+        return;
+      }
+      DokanEndDispatchFindStreams(&IoEvent->DokanFileInfo, status);
+      return;
     } else {
       status = STATUS_NOT_IMPLEMENTED;
     }
@@ -498,9 +506,18 @@ VOID DispatchQueryInformation(PDOKAN_IO_EVENT IoEvent) {
     status = IoEvent->DokanInstance->DokanOperations->GetFileInformation(
         IoEvent->EventContext->Operation.File.FileName, &byHandleFileInfo,
         &IoEvent->DokanFileInfo);
-    DokanEndDispatchGetFileInformation(IoEvent, &byHandleFileInfo, status);
+    if (IsDispatchPending(IoEvent, status)) {
+      return;
+    }
+    DokanEndDispatchGetFileInformation(&IoEvent->DokanFileInfo,
+                                       &byHandleFileInfo, status);
+    return;
   } else {
 
     status = STATUS_NOT_IMPLEMENTED;
   }
+
+  // The operation is not supported, the open still has to be released.
+  IoEvent->EventResult->Status = status;
+  EventCompletion(IoEvent);
 }
\ No newline at end of file
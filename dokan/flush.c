@@ -22,13 +22,28 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "dokani.h"
 
+VOID DOKANAPI DokanEndDispatchFlush(PDOKAN_FILE_INFO DokanFileInfo,
+                                    NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+
+  if (Status == STATUS_NOT_IMPLEMENTED) {
+    ioEvent->EventResult->Status = STATUS_SUCCESS;
+  } else {
+    ioEvent->EventResult->Status =
+        Status != STATUS_SUCCESS ? STATUS_NOT_SUPPORTED : STATUS_SUCCESS;
+  }
+
+  EventCompletion(ioEvent);
+}
+
 VOID DispatchFlush(PDOKAN_IO_EVENT IoEvent) {
   NTSTATUS status;
 
   CheckFileName(IoEvent->EventContext->Operation.Flush.FileName);
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   DbgPrint("###Flush file handle = 0x%p, eventID = %04d, event Info = 0x%p\n",
            IoEvent->DokanOpenInfo,
@@ -43,12 +58,8 @@ VOID DispatchFlush(PDOKAN_IO_EVENT IoEvent) {
     status = STATUS_NOT_IMPLEMENTED;
   }
 
-  if (status == STATUS_NOT_IMPLEMENTED) {
-    IoEvent->EventResult->Status = STATUS_SUCCESS;
-  } else {
-    IoEvent->EventResult->Status =
-        status != STATUS_SUCCESS ? STATUS_NOT_SUPPORTED : STATUS_SUCCESS;
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  EventCompletion(IoEvent);
+  DokanEndDispatchFlush(&IoEvent->DokanFileInfo, status);
 }
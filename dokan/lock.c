@@ -23,13 +23,31 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 #include "dokani.h"
 #include "fileinfo.h"
 
+VOID DOKANAPI DokanEndDispatchLock(PDOKAN_FILE_INFO DokanFileInfo,
+                                   NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+
+  if (Status != STATUS_NOT_IMPLEMENTED) {
+    if (ioEvent->EventContext->MinorFunction == IRP_MN_LOCK) {
+      ioEvent->EventResult->Status =
+          Status != STATUS_SUCCESS ? STATUS_LOCK_NOT_GRANTED : STATUS_SUCCESS;
+    } else {
+      ioEvent->EventResult->Status =
+          STATUS_SUCCESS; // always succeeds so it cannot fail ?
+    }
+  }
+
+  EventCompletion(ioEvent);
+}
+
 VOID DispatchLock(PDOKAN_IO_EVENT IoEvent) {
-  NTSTATUS status;
+  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
 
   CheckFileName(IoEvent->EventContext->Operation.Lock.FileName);
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   DbgPrint("###Lock file handle = 0x%p, eventID = %04d, event Info = 0x%p\n",
            IoEvent->DokanOpenInfo,
@@ -49,11 +67,6 @@ VOID DispatchLock(PDOKAN_IO_EVENT IoEvent) {
           IoEvent->EventContext->Operation.Lock.Length.QuadPart,
           // EventContext->Operation.Lock.Key,
           &IoEvent->DokanFileInfo);
-
-      if (status != STATUS_NOT_IMPLEMENTED) {
-        IoEvent->EventResult->Status =
-            status != STATUS_SUCCESS ? STATUS_LOCK_NOT_GRANTED : STATUS_SUCCESS;
-      }
     }
     break;
   case IRP_MN_UNLOCK_ALL:
@@ -69,11 +82,6 @@ VOID DispatchLock(PDOKAN_IO_EVENT IoEvent) {
           IoEvent->EventContext->Operation.Lock.Length.QuadPart,
           // EventContext->Operation.Lock.Key,
           &IoEvent->DokanFileInfo);
-
-      if (status != STATUS_NOT_IMPLEMENTED) {
-        IoEvent->EventResult->Status =
-            STATUS_SUCCESS; // always succeeds so it cannot fail ?
-      }
     }
     break;
   default:
@@ -81,5 +89,8 @@ VOID DispatchLock(PDOKAN_IO_EVENT IoEvent) {
              IoEvent->EventContext->MinorFunction);
   }
 
-  EventCompletion(IoEvent);
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
+  }
+  DokanEndDispatchLock(&IoEvent->DokanFileInfo, status);
 }
@@ -525,18 +525,35 @@ BOOL DeleteMountPoint(LPCWSTR MountPoint) {
 }
 
 BOOL EnableTokenPrivilege(LPCTSTR lpszSystemName, BOOL bEnable) {
+  return EnableTokenPrivilegeEx(lpszSystemName, bEnable, NULL);
+}
+
+BOOL EnableTokenPrivilegeEx(LPCTSTR lpszSystemName, BOOL bEnable,
+                            PBOOL pbWasEnabled) {
   HANDLE hToken = NULL;
   if (OpenProcessToken(GetCurrentProcess(),
                        TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
     TOKEN_PRIVILEGES tp = {0};
+    TOKEN_PRIVILEGES previous = {0};
+    DWORD previousLength = 0;
     if (LookupPrivilegeValue(NULL, lpszSystemName, &tp.Privileges[0].Luid)) {
       tp.PrivilegeCount = 1;
       tp.Privileges[0].Attributes = (bEnable ? SE_PRIVILEGE_ENABLED : 0);
 
       if (AdjustTokenPrivileges(hToken, FALSE, &tp, sizeof(TOKEN_PRIVILEGES),
-                                (PTOKEN_PRIVILEGES)NULL, NULL)) {
+                                &previous, &previousLength)) {
+        BOOL result = GetLastError() == ERROR_SUCCESS;
         CloseHandle(hToken);
-        return GetLastError() == ERROR_SUCCESS;
+        if (result && pbWasEnabled) {
+          // Only the privileges that changed are listed in the previous
+          // state.
+          *pbWasEnabled =
+              previous.PrivilegeCount == 0
+                  ? bEnable
+                  : (previous.Privileges[0].Attributes &
+                     SE_PRIVILEGE_ENABLED) != 0;
+        }
+        return result;
       }
     }
   }
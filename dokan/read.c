@@ -22,16 +22,80 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "dokani.h"
 
+VOID DOKANAPI DokanEndDispatchRead(PDOKAN_FILE_INFO DokanFileInfo,
+                                   DWORD ReadLength, NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+
+  ioEvent->EventResult->BufferLength = 0;
+  ioEvent->EventResult->Status = Status;
+
+  if (Status == STATUS_SUCCESS) {
+    if (ReadLength == 0) {
+      ioEvent->EventResult->Status = STATUS_END_OF_FILE;
+    } else {
+      ioEvent->EventResult->BufferLength = ReadLength;
+      ioEvent->EventResult->Operation.Read.CurrentByteOffset.QuadPart =
+          ioEvent->EventContext->Operation.Read.ByteOffset.QuadPart +
+          ReadLength;
+    }
+  }
+
+  EventCompletion(ioEvent);
+}
+
+VOID DOKANAPI DokanEndDispatchReadBuffer(PDOKAN_FILE_INFO DokanFileInfo,
+                                         PDOKAN_READ_BUFFER ReadBuffer,
+                                         NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  DWORD readLength = 0;
+
+  if (Status == STATUS_SUCCESS && ReadBuffer->Buffer) {
+    readLength = min(ReadBuffer->Length,
+                     ioEvent->EventContext->Operation.Read.BufferLength);
+  }
+  // The reply is only as large as the data, which is copied once into it.
+  CreateDispatchCommon(ioEvent, readLength, /*UseExtraMemoryPool=*/TRUE,
+                       /*ClearBuffer=*/FALSE);
+  if (readLength) {
+    CopyMemory(ioEvent->EventResult->Buffer, ReadBuffer->Buffer, readLength);
+  }
+  if (ReadBuffer->Release) {
+    ReadBuffer->Release(ReadBuffer->ReleaseContext);
+  }
+  DokanEndDispatchRead(DokanFileInfo, readLength, Status);
+}
+
 VOID DispatchRead(PDOKAN_IO_EVENT IoEvent) {
   ULONG readLength = 0;
   NTSTATUS status = STATUS_NOT_IMPLEMENTED;
 
   CheckFileName(IoEvent->EventContext->Operation.Read.FileName);
 
+  // Older DOKAN_OPERATIONS end before ReadFileBuffer.
+  if ((IoEvent->DokanInstance->DokanOptions->Options &
+       DOKAN_OPTION_READ_FILE_BUFFER) &&
+      IoEvent->DokanInstance->DokanOperations->ReadFileBuffer) {
+    DOKAN_READ_BUFFER readBuffer = {0};
+    status = IoEvent->DokanInstance->DokanOperations->ReadFileBuffer(
+        IoEvent->EventContext->Operation.Read.FileName,
+        IoEvent->EventContext->Operation.Read.BufferLength,
+        IoEvent->EventContext->Operation.Read.ByteOffset.QuadPart, &readBuffer,
+        &IoEvent->DokanFileInfo);
+    if (status != STATUS_NOT_IMPLEMENTED) {
+      if (IsDispatchPending(IoEvent, status)) {
+        return;
+      }
+      DokanEndDispatchReadBuffer(&IoEvent->DokanFileInfo, &readBuffer, status);
+      return;
+    }
+  }
+
   CreateDispatchCommon(IoEvent,
                        IoEvent->EventContext->Operation.Read.BufferLength,
                        /*UseExtraMemoryPool=*/TRUE,
-                       /*ClearNonPoolBuffer=*/FALSE);
+                       /*ClearBuffer=*/FALSE);
 
   DbgPrint("###Read file handle = 0x%p, eventID = %04d, event Info = 0x%p\n",
            IoEvent->DokanOpenInfo,
@@ -48,19 +112,8 @@ VOID DispatchRead(PDOKAN_IO_EVENT IoEvent) {
         &IoEvent->DokanFileInfo);
   }
 
-  IoEvent->EventResult->BufferLength = 0;
-  IoEvent->EventResult->Status = status;
-
-  if (status == STATUS_SUCCESS) {
-    if (readLength == 0) {
-      IoEvent->EventResult->Status = STATUS_END_OF_FILE;
-    } else {
-      IoEvent->EventResult->BufferLength = readLength;
-      IoEvent->EventResult->Operation.Read.CurrentByteOffset.QuadPart =
-          IoEvent->EventContext->Operation.Read.ByteOffset.QuadPart +
-          readLength;
-    }
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  EventCompletion(IoEvent);
+  DokanEndDispatchRead(&IoEvent->DokanFileInfo, readLength, status);
 }
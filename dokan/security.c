@@ -127,6 +127,38 @@ NTSTATUS DefaultGetFileSecurity(LPCWSTR FileName,
   return STATUS_SUCCESS;
 }
 
+VOID DOKANAPI DokanEndDispatchGetFileSecurity(PDOKAN_FILE_INFO DokanFileInfo,
+                                              ULONG LengthNeeded,
+                                              NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+
+  if (Status == STATUS_NOT_IMPLEMENTED) {
+    Status = DefaultGetFileSecurity(
+        ioEvent->EventContext->Operation.Security.FileName,
+        &ioEvent->EventContext->Operation.Security.SecurityInformation,
+        &ioEvent->EventResult->Buffer,
+        ioEvent->EventContext->Operation.Security.BufferLength, &LengthNeeded,
+        DokanFileInfo);
+  }
+
+  ioEvent->EventResult->Status = Status;
+
+  if (Status != STATUS_SUCCESS && Status != STATUS_BUFFER_OVERFLOW) {
+    ioEvent->EventResult->BufferLength = 0;
+  } else {
+    ioEvent->EventResult->BufferLength = LengthNeeded;
+
+    if (ioEvent->EventContext->Operation.Security.BufferLength < LengthNeeded) {
+      // Filesystem Application should return STATUS_BUFFER_OVERFLOW in this
+      // case.
+      ioEvent->EventResult->Status = STATUS_BUFFER_OVERFLOW;
+    }
+  }
+
+  EventCompletion(ioEvent);
+}
+
 VOID DispatchQuerySecurity(PDOKAN_IO_EVENT IoEvent) {
   NTSTATUS status = STATUS_NOT_IMPLEMENTED;
   ULONG lengthNeeded = 0;
@@ -136,7 +168,7 @@ VOID DispatchQuerySecurity(PDOKAN_IO_EVENT IoEvent) {
   CreateDispatchCommon(IoEvent,
                        IoEvent->EventContext->Operation.Security.BufferLength,
                        /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   DbgPrint("###GetFileSecurity file handle = 0x%p, eventID = %04d, event Info "
            "= 0x%p\n",
@@ -154,30 +186,27 @@ VOID DispatchQuerySecurity(PDOKAN_IO_EVENT IoEvent) {
         &IoEvent->DokanFileInfo);
   }
 
-  if (status == STATUS_NOT_IMPLEMENTED) {
-    status = DefaultGetFileSecurity(
-        IoEvent->EventContext->Operation.Security.FileName,
-        &IoEvent->EventContext->Operation.Security.SecurityInformation,
-        &IoEvent->EventResult->Buffer,
-        IoEvent->EventContext->Operation.Security.BufferLength, &lengthNeeded,
-        &IoEvent->DokanFileInfo);
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
+  DokanEndDispatchGetFileSecurity(&IoEvent->DokanFileInfo, lengthNeeded,
+                                  status);
+}
 
-  IoEvent->EventResult->Status = status;
+VOID DOKANAPI DokanEndDispatchSetFileSecurity(PDOKAN_FILE_INFO DokanFileInfo,
+                                              NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
 
-  if (status != STATUS_SUCCESS && status != STATUS_BUFFER_OVERFLOW) {
-    IoEvent->EventResult->BufferLength = 0;
+  if (Status != STATUS_SUCCESS) {
+    ioEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
+    ioEvent->EventResult->BufferLength = 0;
   } else {
-    IoEvent->EventResult->BufferLength = lengthNeeded;
-
-    if (IoEvent->EventContext->Operation.Security.BufferLength < lengthNeeded) {
-      // Filesystem Application should return STATUS_BUFFER_OVERFLOW in this
-      // case.
-      IoEvent->EventResult->Status = STATUS_BUFFER_OVERFLOW;
-    }
+    ioEvent->EventResult->Status = STATUS_SUCCESS;
+    ioEvent->EventResult->BufferLength = 0;
   }
 
-  EventCompletion(IoEvent);
+  EventCompletion(ioEvent);
 }
 
 VOID DispatchSetSecurity(PDOKAN_IO_EVENT IoEvent) {
@@ -187,7 +216,7 @@ VOID DispatchSetSecurity(PDOKAN_IO_EVENT IoEvent) {
   CheckFileName(IoEvent->EventContext->Operation.SetSecurity.FileName);
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   DbgPrint(
       "###SetSecurity file handle = 0x%p, eventID = %04d, event Info = 0x%p\n",
@@ -207,13 +236,8 @@ VOID DispatchSetSecurity(PDOKAN_IO_EVENT IoEvent) {
         IoEvent->EventContext->Operation.SetSecurity.BufferLength, &IoEvent->DokanFileInfo);
   }
 
-  if (status != STATUS_SUCCESS) {
-    IoEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
-    IoEvent->EventResult->BufferLength = 0;
-  } else {
-    IoEvent->EventResult->Status = STATUS_SUCCESS;
-    IoEvent->EventResult->BufferLength = 0;
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  EventCompletion(IoEvent);
+  DokanEndDispatchSetFileSecurity(&IoEvent->DokanFileInfo, status);
 }
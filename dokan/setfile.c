@@ -57,6 +57,7 @@ DokanSetBasicInformation(PEVENT_CONTEXT EventContext, PDOKAN_FILE_INFO FileInfo,
                          PDOKAN_OPERATIONS DokanOperations) {
   FILETIME creation, lastAccess, lastWrite;
   NTSTATUS status;
+  UCHAR asyncDispatch;
 
   PFILE_BASIC_INFORMATION basicInfo = (PFILE_BASIC_INFORMATION)(
       (PCHAR)EventContext + EventContext->Operation.SetFile.BufferOffset);
@@ -67,9 +68,13 @@ DokanSetBasicInformation(PEVENT_CONTEXT EventContext, PDOKAN_FILE_INFO FileInfo,
   if (!DokanOperations->SetFileTime)
     return STATUS_NOT_IMPLEMENTED;
 
+  // Only the last callback of the operation can complete asynchronously.
+  asyncDispatch = FileInfo->AsyncDispatch;
+  FileInfo->AsyncDispatch = FALSE;
   status = DokanOperations->SetFileAttributes(
       EventContext->Operation.SetFile.FileName, basicInfo->FileAttributes,
       FileInfo);
+  FileInfo->AsyncDispatch = asyncDispatch;
 
   if (status != STATUS_SUCCESS)
     return status;
@@ -86,39 +91,47 @@ DokanSetBasicInformation(PEVENT_CONTEXT EventContext, PDOKAN_FILE_INFO FileInfo,
                                       FileInfo);
 }
 
-NTSTATUS
-DokanSetDispositionInformation(PEVENT_CONTEXT EventContext,
-                               PDOKAN_FILE_INFO FileInfo,
-                               PDOKAN_OPERATIONS DokanOperations) {
-
-  BOOLEAN DeleteFileFlag = FALSE;
-  NTSTATUS result;
-
+// Returns the delete flag of a FileDispositionInformation(Ex) request.
+BOOLEAN
+GetDispositionDeleteFlag(PEVENT_CONTEXT EventContext) {
   switch (EventContext->Operation.SetFile.FileInformationClass) {
   case FileDispositionInformation: {
     PFILE_DISPOSITION_INFORMATION dispositionInfo =
         (PFILE_DISPOSITION_INFORMATION)(
             (PCHAR)EventContext + EventContext->Operation.SetFile.BufferOffset);
-    DeleteFileFlag = dispositionInfo->DeleteFile;
-  } break;
+    return dispositionInfo->DeleteFile;
+  }
   case FileDispositionInformationEx: {
     PFILE_DISPOSITION_INFORMATION_EX dispositionexInfo =
         (PFILE_DISPOSITION_INFORMATION_EX)(
             (PCHAR)EventContext + EventContext->Operation.SetFile.BufferOffset);
-    DeleteFileFlag = (dispositionexInfo->Flags & FILE_DISPOSITION_DELETE) != 0;
-  } break;
+    return (dispositionexInfo->Flags & FILE_DISPOSITION_DELETE) != 0;
+  }
   default:
-    return STATUS_INVALID_PARAMETER;
+    return FALSE;
   }
+}
+
+NTSTATUS
+DokanSetDispositionInformation(PEVENT_CONTEXT EventContext,
+                               PDOKAN_FILE_INFO FileInfo,
+                               PDOKAN_OPERATIONS DokanOperations) {
+
+  BOOLEAN DeleteFileFlag = GetDispositionDeleteFlag(EventContext);
+  NTSTATUS result;
 
   if (!DokanOperations->DeleteFile || !DokanOperations->DeleteDirectory)
     return STATUS_NOT_IMPLEMENTED;
 
   if (DokanOperations->GetFileInformation && DeleteFileFlag) {
     BY_HANDLE_FILE_INFORMATION byHandleFileInfo;
+    UCHAR asyncDispatch = FileInfo->AsyncDispatch;
     ZeroMemory(&byHandleFileInfo, sizeof(BY_HANDLE_FILE_INFORMATION));
+    // Only the delete callback can complete asynchronously.
+    FileInfo->AsyncDispatch = FALSE;
     result = DokanOperations->GetFileInformation(
         EventContext->Operation.SetFile.FileName, &byHandleFileInfo, FileInfo);
+    FileInfo->AsyncDispatch = asyncDispatch;
 
     if (result == STATUS_SUCCESS &&
         (byHandleFileInfo.dwFileAttributes & FILE_ATTRIBUTE_READONLY) != 0)
@@ -134,8 +147,6 @@ DokanSetDispositionInformation(PEVENT_CONTEXT EventContext,
     result = DokanOperations->DeleteFile(EventContext->Operation.SetFile.FileName,
                                        FileInfo);
   }
-  // Double set for later be sure FS user did not changed it
-  FileInfo->DeletePending = DeleteFileFlag;
   return result;
 }
 
@@ -170,11 +181,12 @@ DokanSetRenameInformation(PEVENT_CONTEXT EventContext,
     return STATUS_INSUFFICIENT_RESOURCES;
   RtlCopyMemory(newFileName, renameInfo->FileName, renameInfo->FileNameLength);
   newFileName[renameInfo->FileNameLength / sizeof(WCHAR)] = L'\0';
+  // Freed by DokanEndDispatchSetInformation.
+  FileInfo->ProcessingContext = newFileName;
 
   status = DokanOperations->MoveFile(EventContext->Operation.SetFile.FileName,
                                      newFileName, renameInfo->ReplaceIfExists,
                                      FileInfo);
-  free(newFileName);
   return status;
 }
 
@@ -194,6 +206,54 @@ DokanSetValidDataLengthInformation(PEVENT_CONTEXT EventContext,
                                        FileInfo);
 }
 
+VOID DOKANAPI DokanEndDispatchSetInformation(PDOKAN_FILE_INFO DokanFileInfo,
+                                             NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  ULONG fileInformationClass =
+      ioEvent->EventContext->Operation.SetFile.FileInformationClass;
+
+  ioEvent->EventResult->BufferLength = 0;
+  ioEvent->EventResult->Status = Status;
+
+  if (Status == STATUS_SUCCESS) {
+    if (fileInformationClass == FileDispositionInformation ||
+        fileInformationClass == FileDispositionInformationEx) {
+      // Double set for later be sure FS user did not changed it
+      DokanFileInfo->DeletePending =
+          GetDispositionDeleteFlag(ioEvent->EventContext);
+      ioEvent->EventResult->Operation.Delete.DeletePending =
+          DokanFileInfo->DeletePending;
+      DbgPrint("  dispositionInfo->DeletePending = %d\n",
+               DokanFileInfo->DeletePending);
+    } else if (fileInformationClass == FileRenameInformation ||
+               fileInformationClass == FileRenameInformationEx) {
+      PDOKAN_RENAME_INFORMATION renameInfo =
+          (PDOKAN_RENAME_INFORMATION)((PCHAR)ioEvent->EventContext +
+                                      ioEvent->EventContext->Operation.SetFile
+                                          .BufferOffset);
+      ioEvent->EventResult->BufferLength = renameInfo->FileNameLength;
+      CopyMemory(ioEvent->EventResult->Buffer, renameInfo->FileName,
+                 renameInfo->FileNameLength);
+      InvalidateDirectoryCache(
+          ioEvent->DokanInstance,
+          ioEvent->EventContext->Operation.SetFile.FileName);
+      // The new name copied by DokanSetRenameInformation.
+      InvalidateDirectoryCache(ioEvent->DokanInstance,
+                               (LPCWSTR)DokanFileInfo->ProcessingContext);
+    }
+  }
+
+  if (DokanFileInfo->ProcessingContext) {
+    free(DokanFileInfo->ProcessingContext);
+    DokanFileInfo->ProcessingContext = NULL;
+  }
+
+  DbgPrint("\tDispatchSetInformation result =  %lx\n", Status);
+
+  EventCompletion(ioEvent);
+}
+
 VOID DispatchSetInformation(PDOKAN_IO_EVENT IoEvent) {
   NTSTATUS status = STATUS_INVALID_PARAMETER;
   ULONG fileInformationClass =
@@ -207,10 +267,10 @@ VOID DispatchSetInformation(PDOKAN_IO_EVENT IoEvent) {
                                         .BufferOffset);
     CreateDispatchCommon(IoEvent, renameInfo->FileNameLength,
                          /*UseExtraMemoryPool=*/FALSE,
-                         /*ClearNonPoolBuffer=*/TRUE);
+                         /*ClearBuffer=*/TRUE);
   } else {
     CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                         /*ClearNonPoolBuffer=*/TRUE);
+                         /*ClearBuffer=*/TRUE);
   }
 
   CheckFileName(IoEvent->EventContext->Operation.SetFile.FileName);
@@ -270,29 +330,8 @@ VOID DispatchSetInformation(PDOKAN_IO_EVENT IoEvent) {
     break;
   }
 
-  IoEvent->EventResult->BufferLength = 0;
-  IoEvent->EventResult->Status = status;
-
-  if (status == STATUS_SUCCESS) {
-    if (fileInformationClass == FileDispositionInformation ||
-        fileInformationClass == FileDispositionInformationEx) {
-      IoEvent->EventResult->Operation.Delete.DeletePending =
-          IoEvent->DokanFileInfo.DeletePending;
-      DbgPrint("  dispositionInfo->DeletePending = %d\n",
-               IoEvent->DokanFileInfo.DeletePending);
-    } else if (fileInformationClass == FileRenameInformation ||
-               fileInformationClass == FileRenameInformationEx) {
-      PDOKAN_RENAME_INFORMATION renameInfo =
-          (PDOKAN_RENAME_INFORMATION)((PCHAR)IoEvent->EventContext +
-                                      IoEvent->EventContext->Operation.SetFile
-                                          .BufferOffset);
-      IoEvent->EventResult->BufferLength = renameInfo->FileNameLength;
-      CopyMemory(IoEvent->EventResult->Buffer, renameInfo->FileName,
-                 renameInfo->FileNameLength);
-    }
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  DbgPrint("\tDispatchSetInformation result =  %lx\n", status);
-
-  EventCompletion(IoEvent);
+  DokanEndDispatchSetInformation(&IoEvent->DokanFileInfo, status);
 }
@@ -0,0 +1,298 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Drives the DOKAN_OPERATIONS built by dokan::coro::make_operations the way
+// the dispatch threads do: an operation that does not suspend is returned
+// synchronously, a suspended one returns STATUS_PENDING under AsyncDispatch
+// and is completed with its DokanEndDispatch function, which the test records,
+// and without AsyncDispatch the dispatch thread waits for it. Every coroutine
+// frame must be destroyed once the operation is completed either way.
+
+// The DokanEndDispatch functions are defined here instead of by the library.
+#define _EXPORTING
+#define NOMINMAX
+
+#include "../dokan_coro.h"
+
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+
+ULONG g_TestFailures;
+
+namespace {
+
+struct end_dispatch_call {
+  PDOKAN_FILE_INFO DokanFileInfo;
+  DWORD Length;
+  NTSTATUS Status;
+};
+
+std::mutex g_EndDispatchMutex;
+std::vector<end_dispatch_call> g_EndDispatchCalls;
+
+std::vector<end_dispatch_call> TakeEndDispatchCalls() {
+  std::lock_guard<std::mutex> lock(g_EndDispatchMutex);
+  return std::exchange(g_EndDispatchCalls, {});
+}
+
+// Counts the live coroutine frames of the operations.
+std::atomic<int> g_LiveOperations;
+
+struct live_operation {
+  live_operation() { ++g_LiveOperations; }
+  ~live_operation() { --g_LiveOperations; }
+  live_operation(const live_operation &) = delete;
+  live_operation &operator=(const live_operation &) = delete;
+};
+
+enum class read_mode { synchronous, completion };
+
+class test_filesystem {
+ public:
+  read_mode Mode = read_mode::synchronous;
+  dokan::coro::executor *Executor = nullptr;
+  std::mutex Mutex;
+  std::vector<dokan::coro::completion<DWORD>> Pending;
+
+  dokan::coro::task<dokan::coro::io_result>
+  read(LPCWSTR FileName, LPVOID Buffer, DWORD BufferLength, LONGLONG Offset,
+       PDOKAN_FILE_INFO DokanFileInfo) {
+    live_operation live;
+    UNREFERENCED_PARAMETER(FileName);
+    UNREFERENCED_PARAMETER(Buffer);
+    UNREFERENCED_PARAMETER(Offset);
+    UNREFERENCED_PARAMETER(DokanFileInfo);
+    if (Mode == read_mode::synchronous)
+      co_return dokan::coro::io_result{STATUS_SUCCESS, BufferLength};
+    dokan::coro::completion<DWORD> completion(Executor);
+    {
+      std::lock_guard<std::mutex> lock(Mutex);
+      Pending.push_back(completion);
+    }
+    DWORD length = co_await completion;
+    co_return dokan::coro::io_result{STATUS_SUCCESS, length};
+  }
+
+  dokan::coro::task<NTSTATUS> flush(LPCWSTR FileName,
+                                    PDOKAN_FILE_INFO DokanFileInfo) {
+    live_operation live;
+    UNREFERENCED_PARAMETER(FileName);
+    UNREFERENCED_PARAMETER(DokanFileInfo);
+    co_await std::suspend_never{};
+    throw std::runtime_error("flush failed");
+  }
+
+  // Takes the completion of the only pending read.
+  dokan::coro::completion<DWORD> TakePending() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    CHECK(Pending.size() == 1);
+    dokan::coro::completion<DWORD> completion = Pending.back();
+    Pending.clear();
+    return completion;
+  }
+};
+
+struct test_mount {
+  test_filesystem Filesystem;
+  DOKAN_OPTIONS Options = {};
+  DOKAN_FILE_INFO FileInfo = {};
+  DOKAN_OPERATIONS Operations;
+
+  test_mount() : Operations(dokan::coro::make_operations<test_filesystem>()) {
+    Options.GlobalContext = reinterpret_cast<ULONG_PTR>(&Filesystem);
+    FileInfo.DokanOptions = &Options;
+  }
+
+  NTSTATUS Read(DWORD BufferLength, DWORD *ReadLength) {
+    char buffer[16];
+    return Operations.ReadFile(L"\\file", buffer, BufferLength, ReadLength, 0,
+                               &FileInfo);
+  }
+};
+
+void TestOnlyDeclaredOperationsAreSet() {
+  test_mount mount;
+  CHECK(mount.Operations.ReadFile != NULL);
+  CHECK(mount.Operations.FlushFileBuffers != NULL);
+  CHECK(mount.Operations.WriteFile == NULL);
+  CHECK(mount.Operations.ZwCreateFile == NULL);
+  CHECK(mount.Operations.FindFiles == NULL);
+}
+
+void TestSynchronousCompletion() {
+  test_mount mount;
+  DWORD readLength = 0;
+  for (UCHAR async = 0; async <= 1; ++async) {
+    mount.FileInfo.AsyncDispatch = async;
+    CHECK(mount.Read(12, &readLength) == STATUS_SUCCESS);
+    CHECK(readLength == 12);
+    CHECK(TakeEndDispatchCalls().empty());
+    CHECK(g_LiveOperations == 0);
+  }
+}
+
+void TestPendingCompletionOnExecutor() {
+  test_mount mount;
+  dokan::coro::manual_executor executor;
+  DWORD readLength = 0;
+  mount.Filesystem.Mode = read_mode::completion;
+  mount.Filesystem.Executor = &executor;
+  mount.FileInfo.AsyncDispatch = TRUE;
+
+  CHECK(mount.Read(12, &readLength) == STATUS_PENDING);
+  CHECK(g_LiveOperations == 1);
+  CHECK(executor.empty());
+
+  mount.Filesystem.TakePending().complete(DWORD{7});
+  // The completion only posts the coroutine, nothing is ended until the
+  // executor runs it.
+  CHECK(!executor.empty());
+  CHECK(TakeEndDispatchCalls().empty());
+  CHECK(executor.run() == 1);
+
+  std::vector<end_dispatch_call> calls = TakeEndDispatchCalls();
+  CHECK(calls.size() == 1);
+  if (calls.size() == 1) {
+    CHECK(calls[0].DokanFileInfo == &mount.FileInfo);
+    CHECK(calls[0].Length == 7);
+    CHECK(calls[0].Status == STATUS_SUCCESS);
+  }
+  CHECK(g_LiveOperations == 0);
+}
+
+void TestSynchronousWaitForCompletion() {
+  test_mount mount;
+  dokan::coro::manual_executor executor;
+  DWORD readLength = 0;
+  mount.Filesystem.Mode = read_mode::completion;
+  mount.Filesystem.Executor = &executor;
+  mount.FileInfo.AsyncDispatch = FALSE;
+
+  // The dispatch thread waits for the coroutine, which another thread
+  // completes and resumes on the executor.
+  std::thread completer([&mount, &executor] {
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> lock(mount.Filesystem.Mutex);
+        if (!mount.Filesystem.Pending.empty())
+          break;
+      }
+      std::this_thread::yield();
+    }
+    mount.Filesystem.TakePending().complete(DWORD{5});
+    executor.run();
+  });
+  CHECK(mount.Read(12, &readLength) == STATUS_SUCCESS);
+  completer.join();
+  CHECK(readLength == 5);
+  CHECK(TakeEndDispatchCalls().empty());
+  CHECK(g_LiveOperations == 0);
+}
+
+// The completion races with the return of the callback: either the callback
+// returns the result or the coroutine ends the dispatch, never both, and the
+// frame is destroyed once.
+void TestCrossThreadCompletion(UCHAR AsyncDispatch) {
+  const int kIterations = 2000;
+  test_mount mount;
+  int synchronous = 0;
+  int pending = 0;
+  mount.Filesystem.Mode = read_mode::completion;
+  mount.FileInfo.AsyncDispatch = AsyncDispatch;
+
+  for (int i = 0; i < kIterations; ++i) {
+    DWORD readLength = 0;
+    std::thread completer([&mount] {
+      for (;;) {
+        {
+          std::lock_guard<std::mutex> lock(mount.Filesystem.Mutex);
+          if (!mount.Filesystem.Pending.empty())
+            break;
+        }
+        std::this_thread::yield();
+      }
+      // Resumed inline on this thread, without executor.
+      mount.Filesystem.TakePending().complete(DWORD{3});
+    });
+    NTSTATUS status = mount.Read(12, &readLength);
+    completer.join();
+
+    std::vector<end_dispatch_call> calls = TakeEndDispatchCalls();
+    if (status == STATUS_PENDING) {
+      ++pending;
+      CHECK(calls.size() == 1);
+      CHECK(calls.size() != 1 || calls[0].Length == 3);
+    } else {
+      ++synchronous;
+      CHECK(status == STATUS_SUCCESS);
+      CHECK(readLength == 3);
+      CHECK(calls.empty());
+    }
+    CHECK(g_LiveOperations == 0);
+  }
+  CHECK(synchronous + pending == kIterations);
+  if (!AsyncDispatch) {
+    CHECK(pending == 0);
+  }
+}
+
+void TestExceptionIsInternalError() {
+  test_mount mount;
+  for (UCHAR async = 0; async <= 1; ++async) {
+    mount.FileInfo.AsyncDispatch = async;
+    CHECK(mount.Operations.FlushFileBuffers(L"\\file", &mount.FileInfo) ==
+          STATUS_INTERNAL_ERROR);
+    CHECK(TakeEndDispatchCalls().empty());
+    CHECK(g_LiveOperations == 0);
+  }
+}
+
+} // namespace
+
+extern "C" {
+
+VOID DOKANAPI DokanEndDispatchRead(PDOKAN_FILE_INFO DokanFileInfo,
+                                   DWORD ReadLength, NTSTATUS Status) {
+  std::lock_guard<std::mutex> lock(g_EndDispatchMutex);
+  g_EndDispatchCalls.push_back({DokanFileInfo, ReadLength, Status});
+}
+
+VOID DOKANAPI DokanEndDispatchFlush(PDOKAN_FILE_INFO DokanFileInfo,
+                                    NTSTATUS Status) {
+  std::lock_guard<std::mutex> lock(g_EndDispatchMutex);
+  g_EndDispatchCalls.push_back({DokanFileInfo, 0, Status});
+}
+
+} // extern "C"
+
+int main() {
+  TestOnlyDeclaredOperationsAreSet();
+  TestSynchronousCompletion();
+  TestPendingCompletionOnExecutor();
+  TestSynchronousWaitForCompletion();
+  TestCrossThreadCompletion(FALSE);
+  TestCrossThreadCompletion(TRUE);
+  TestExceptionIsInternalError();
+  return TEST_RESULT();
+}
@@ -0,0 +1,193 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Times the listing of directories of 10k, 100k and 1M entries in 64 KiB
+// FileIdBothDirectoryInformation replies through FillDirectoryResults and
+// MatchFiles, without pattern and with patterns matching all and few of the
+// entries. Each reply resumes from the cursor left by the previous one, like
+// the successive IRP_MJ_DIRECTORY_CONTROL of a same open. Not run by ctest,
+// pass a repetition factor to scale it.
+
+#include "../dokani.h"
+
+// Defined in directory.c.
+int WINAPI DokanFillFileData(PWIN32_FIND_DATAW FindData,
+                             PDOKAN_FILE_INFO FileInfo);
+NTSTATUS FillDirectoryResults(PDOKAN_IO_EVENT IoEvent,
+                              PDOKAN_DIRECTORY_LIST DirList,
+                              PDOKAN_DIR_LIST_CURSOR Cursor);
+
+#define REPLY_BUFFER_LENGTH (64 * 1024)
+#define MAX_PATTERN_LENGTH 16
+
+typedef struct _BENCHMARK_LISTING {
+  DOKAN_OPTIONS Options;
+  DOKAN_OPERATIONS Operations;
+  DOKAN_INSTANCE Instance;
+  DOKAN_OPEN_INFO OpenInfo;
+  DOKAN_IO_EVENT IoEvent;
+  PDOKAN_DIRECTORY_LIST DirList;
+} BENCHMARK_LISTING, *PBENCHMARK_LISTING;
+
+static double NowSeconds() {
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static BOOL CreateBenchmarkListing(PBENCHMARK_LISTING Listing,
+                                   ULONG EntryCount) {
+  ULONG contextSize = sizeof(EVENT_CONTEXT) +
+                      (MAX_PATTERN_LENGTH + 2) * sizeof(WCHAR);
+  WIN32_FIND_DATAW findData;
+
+  RtlZeroMemory(Listing, sizeof(BENCHMARK_LISTING));
+  // Set by the mount, FILE_ID_BOTH_DIR_INFORMATION sizes are rounded to it.
+  Listing->Options.AllocationUnitSize = DOKAN_DEFAULT_ALLOCATION_UNIT_SIZE;
+  Listing->Options.SectorSize = DOKAN_DEFAULT_SECTOR_SIZE;
+  Listing->Instance.DokanOptions = &Listing->Options;
+  Listing->Instance.DokanOperations = &Listing->Operations;
+  Listing->IoEvent.DokanInstance = &Listing->Instance;
+  Listing->IoEvent.DokanOpenInfo = &Listing->OpenInfo;
+  Listing->IoEvent.EventContext = (PEVENT_CONTEXT)calloc(1, contextSize);
+  Listing->IoEvent.EventResultSize =
+      FIELD_OFFSET(EVENT_INFORMATION, Buffer) + REPLY_BUFFER_LENGTH;
+  Listing->IoEvent.EventResult =
+      (PEVENT_INFORMATION)calloc(1, Listing->IoEvent.EventResultSize);
+  Listing->DirList = CreateDirectoryList();
+  if (!Listing->IoEvent.EventContext || !Listing->IoEvent.EventResult ||
+      !Listing->DirList) {
+    return FALSE;
+  }
+  Listing->IoEvent.EventContext->Operation.Directory.FileInformationClass =
+      FileIdBothDirectoryInformation;
+  Listing->IoEvent.EventContext->Operation.Directory.BufferLength =
+      REPLY_BUFFER_LENGTH;
+  Listing->IoEvent.EventContext->Operation.Directory.DirectoryNameLength =
+      sizeof(WCHAR);
+  Listing->IoEvent.EventContext->Operation.Directory.DirectoryName[0] = L'\\';
+
+  RtlZeroMemory(&findData, sizeof(WIN32_FIND_DATAW));
+  findData.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+  Listing->IoEvent.DokanFileInfo.ProcessingContext = Listing->DirList;
+  for (ULONG i = 0; i < EntryCount; ++i) {
+    findData.nFileSizeLow = i;
+    swprintf(findData.cFileName, MAX_PATH, L"document%07lu.txt", i);
+    DokanFillFileData(&findData, &Listing->IoEvent.DokanFileInfo);
+  }
+  Listing->IoEvent.DokanFileInfo.ProcessingContext = NULL;
+  return TRUE;
+}
+
+static VOID DeleteBenchmarkListing(PBENCHMARK_LISTING Listing) {
+  if (Listing->DirList) {
+    DeleteDirectoryList(Listing->DirList);
+  }
+  free(Listing->IoEvent.EventResult);
+  free(Listing->IoEvent.EventContext);
+}
+
+static VOID SetPattern(PBENCHMARK_LISTING Listing, LPCWSTR Pattern) {
+  // The pattern is stored after the directory name.
+  const ULONG patternOffset = 2 * sizeof(WCHAR);
+  PDIRECTORY_CONTEXT directory =
+      &Listing->IoEvent.EventContext->Operation.Directory;
+
+  directory->SearchPatternOffset = Pattern ? patternOffset : 0;
+  directory->SearchPatternLength =
+      Pattern ? (ULONG)(wcslen(Pattern) * sizeof(WCHAR)) : 0;
+  if (Pattern) {
+    wcscpy_s((PWCHAR)((PCHAR)&directory->SearchPatternBase[0] +
+                      patternOffset),
+             MAX_PATTERN_LENGTH, Pattern);
+  }
+}
+
+// Lists the whole directory from index 0. Returns the number of replies and
+// the number of entries returned.
+static ULONG ListDirectory(PBENCHMARK_LISTING Listing, PULONG64 Entries) {
+  DOKAN_DIR_LIST_CURSOR cursor = {0};
+  PEVENT_INFORMATION eventResult = Listing->IoEvent.EventResult;
+  ULONG fileIndex = 0;
+  ULONG replies = 0;
+
+  for (;;) {
+    Listing->IoEvent.EventContext->Operation.Directory.FileIndex = fileIndex;
+    eventResult->Status = STATUS_SUCCESS;
+    eventResult->BufferLength = 0;
+    if (FillDirectoryResults(&Listing->IoEvent, Listing->DirList, &cursor) !=
+        STATUS_SUCCESS) {
+      break;
+    }
+    ++replies;
+    *Entries += eventResult->Operation.Directory.Index - fileIndex;
+    fileIndex = eventResult->Operation.Directory.Index;
+  }
+  return replies;
+}
+
+int main(int argc, char **argv) {
+  static const ULONG entryCounts[] = {10000, 100000, 1000000};
+  static const LPCWSTR patterns[] = {NULL, L"*.txt", L"document00000*"};
+  ULONG factor = argc > 1 ? (ULONG)strtoul(argv[1], NULL, 10) : 1;
+
+  if (factor == 0) {
+    factor = 1;
+  }
+  // Each entry is otherwise traced by MatchFiles.
+  DokanDebugMode(FALSE);
+  printf("%-10s %-16s %10s %10s %12s %14s\n", "entries", "pattern",
+         "replies", "matches", "ms/listing", "Mentries/s");
+  for (ULONG c = 0; c < _countof(entryCounts); ++c) {
+    BENCHMARK_LISTING listing;
+    double fillTime = NowSeconds();
+    if (!CreateBenchmarkListing(&listing, entryCounts[c])) {
+      fprintf(stderr, "CreateBenchmarkListing failed\n");
+      DeleteBenchmarkListing(&listing);
+      return 1;
+    }
+    fillTime = NowSeconds() - fillTime;
+    printf("%-10lu %-16s %10s %10s %12.2f %14.2f\n", entryCounts[c], "(fill)",
+           "", "", fillTime * 1e3, entryCounts[c] / fillTime / 1e6);
+
+    for (ULONG p = 0; p < _countof(patterns); ++p) {
+      ULONG64 matches = 0;
+      ULONG replies = 0;
+      double elapsed;
+      double startTime;
+
+      SetPattern(&listing, patterns[p]);
+      startTime = NowSeconds();
+      for (ULONG repetition = 0; repetition < factor; ++repetition) {
+        matches = 0;
+        replies = ListDirectory(&listing, &matches);
+      }
+      elapsed = (NowSeconds() - startTime) / factor;
+      printf("%-10lu %-16ls %10lu %10llu %12.2f %14.2f\n", entryCounts[c],
+             patterns[p] ? patterns[p] : L"(none)", replies, matches,
+             elapsed * 1e3, entryCounts[c] / elapsed / 1e6);
+    }
+    DeleteBenchmarkListing(&listing);
+  }
+  return 0;
+}
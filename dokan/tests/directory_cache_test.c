@@ -0,0 +1,280 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// Checks the directory cache of a mount: listings expire after
+// DirectoryCacheTimeout, the least recently used ones are dropped to stay
+// under DirectoryCacheSize, a change drops the listings of its parent, its
+// own and the ones below it, a listing started before an invalidation is not
+// cached, paths are folded unless the mount is case sensitive, and a listing
+// shared by two opens stays valid until both released it.
+
+#include "../dokan_pool.h"
+#include "test.h"
+
+ULONG g_TestFailures;
+
+// Defined in directory.c.
+int WINAPI DokanFillFileData(PWIN32_FIND_DATAW FindData,
+                             PDOKAN_FILE_INFO FileInfo);
+
+// Defined in dokan_directory_cache.c.
+SIZE_T GetDirectoryListSize(PDOKAN_DIRECTORY_LIST DirList);
+
+#define LISTING_ENTRY_COUNT 100
+// More than the cache entry of a listing takes besides the listing.
+#define CACHE_ENTRY_OVERHEAD 512
+
+typedef struct _TEST_MOUNT {
+  DOKAN_OPTIONS Options;
+  DOKAN_INSTANCE Instance;
+} TEST_MOUNT, *PTEST_MOUNT;
+
+static VOID CreateTestMount(PTEST_MOUNT Mount, ULONG Options, ULONG Timeout,
+                            ULONG Size) {
+  RtlZeroMemory(Mount, sizeof(TEST_MOUNT));
+  Mount->Options.Options = DOKAN_OPTION_DIRECTORY_CACHE | Options;
+  Mount->Options.DirectoryCacheTimeout = Timeout;
+  Mount->Options.DirectoryCacheSize = Size;
+  Mount->Instance.DokanOptions = &Mount->Options;
+  // Creates the directory cache too.
+  CHECK(CreateInstancePools(&Mount->Instance, FALSE));
+  CHECK(Mount->Instance.DirectoryCache != NULL);
+}
+
+static VOID DeleteTestMount(PTEST_MOUNT Mount) {
+  DeleteInstancePools(&Mount->Instance);
+}
+
+// Lists a directory of EntryCount files like an open does: the cache
+// generation is read before the listing starts. The open holds the only
+// reference.
+static PDOKAN_DIRECTORY_LIST ListDirectory(PTEST_MOUNT Mount,
+                                           ULONG EntryCount) {
+  PDOKAN_DIRECTORY_LIST dirList = PopDirectoryList(&Mount->Instance);
+  DOKAN_FILE_INFO fileInfo;
+  WIN32_FIND_DATAW findData;
+
+  CHECK(dirList != NULL);
+  if (!dirList) {
+    return NULL;
+  }
+  dirList->CacheGeneration = GetDirectoryCacheGeneration(&Mount->Instance);
+  RtlZeroMemory(&fileInfo, sizeof(DOKAN_FILE_INFO));
+  RtlZeroMemory(&findData, sizeof(WIN32_FIND_DATAW));
+  fileInfo.ProcessingContext = dirList;
+  findData.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+  for (ULONG i = 0; i < EntryCount; ++i) {
+    swprintf(findData.cFileName, MAX_PATH, L"file%04lu", i);
+    DokanFillFileData(&findData, &fileInfo);
+  }
+  return dirList;
+}
+
+// Caches the listing of Path and closes the open that made it.
+static VOID CacheDirectory(PTEST_MOUNT Mount, LPCWSTR Path) {
+  PDOKAN_DIRECTORY_LIST dirList = ListDirectory(Mount, 1);
+  if (dirList) {
+    InsertDirectoryCache(&Mount->Instance, Path, dirList);
+    PushDirectoryList(&Mount->Instance, dirList);
+  }
+}
+
+// Returns whether Path is cached, without keeping the reference.
+static BOOL IsCached(PTEST_MOUNT Mount, LPCWSTR Path) {
+  PDOKAN_DIRECTORY_LIST dirList =
+      LookupDirectoryCache(&Mount->Instance, Path);
+  if (!dirList) {
+    return FALSE;
+  }
+  PushDirectoryList(&Mount->Instance, dirList);
+  return TRUE;
+}
+
+static VOID TestExpiry() {
+  TEST_MOUNT mount;
+  PDOKAN_DIRECTORY_LIST dirList;
+
+  CreateTestMount(&mount, 0, /*Timeout=*/100, 0);
+  dirList = ListDirectory(&mount, 1);
+  InsertDirectoryCache(&mount.Instance, L"\\dir", dirList);
+  CHECK(dirList->ReferenceCount == 2);
+  CHECK(IsCached(&mount, L"\\dir"));
+  Sleep(200);
+  // The expired listing is dropped by the lookup, which releases the
+  // reference of the cache.
+  CHECK(!IsCached(&mount, L"\\dir"));
+  CHECK(dirList->ReferenceCount == 1);
+  PushDirectoryList(&mount.Instance, dirList);
+  DeleteTestMount(&mount);
+}
+
+static VOID TestLeastRecentlyUsedEviction() {
+  TEST_MOUNT mount;
+  PDOKAN_DIRECTORY_LIST dirLists[3];
+  SIZE_T listSize;
+
+  // Room for two listings only, their size is measured on a first mount.
+  CreateTestMount(&mount, 0, 0, 0);
+  dirLists[0] = ListDirectory(&mount, LISTING_ENTRY_COUNT);
+  listSize = GetDirectoryListSize(dirLists[0]);
+  PushDirectoryList(&mount.Instance, dirLists[0]);
+  DeleteTestMount(&mount);
+  CHECK(listSize > 3 * CACHE_ENTRY_OVERHEAD);
+
+  CreateTestMount(&mount, 0, 0,
+                  (ULONG)(2 * (listSize + CACHE_ENTRY_OVERHEAD)));
+  for (ULONG i = 0; i < _countof(dirLists); ++i) {
+    dirLists[i] = ListDirectory(&mount, LISTING_ENTRY_COUNT);
+    CHECK(GetDirectoryListSize(dirLists[i]) == listSize);
+  }
+  InsertDirectoryCache(&mount.Instance, L"\\a", dirLists[0]);
+  InsertDirectoryCache(&mount.Instance, L"\\b", dirLists[1]);
+  // \a becomes the most recently used, \b is dropped for \c.
+  CHECK(IsCached(&mount, L"\\a"));
+  InsertDirectoryCache(&mount.Instance, L"\\c", dirLists[2]);
+  CHECK(IsCached(&mount, L"\\a"));
+  CHECK(!IsCached(&mount, L"\\b"));
+  CHECK(IsCached(&mount, L"\\c"));
+  CHECK(dirLists[1]->ReferenceCount == 1);
+  for (ULONG i = 0; i < _countof(dirLists); ++i) {
+    PushDirectoryList(&mount.Instance, dirLists[i]);
+  }
+  DeleteTestMount(&mount);
+}
+
+static VOID TestInvalidation() {
+  static const LPCWSTR paths[] = {L"\\",       L"\\a",     L"\\a\\b",
+                                  L"\\a\\b\\c", L"\\a\\bc", L"\\a2",
+                                  L"\\x"};
+  TEST_MOUNT mount;
+
+  CreateTestMount(&mount, 0, 0, 0);
+  for (ULONG i = 0; i < _countof(paths); ++i) {
+    CacheDirectory(&mount, paths[i]);
+  }
+  // The parent, the directory itself and the directories below it, not the
+  // siblings sharing a prefix of the name.
+  InvalidateDirectoryCache(&mount.Instance, L"\\a\\b");
+  CHECK(IsCached(&mount, L"\\"));
+  CHECK(!IsCached(&mount, L"\\a"));
+  CHECK(!IsCached(&mount, L"\\a\\b"));
+  CHECK(!IsCached(&mount, L"\\a\\b\\c"));
+  CHECK(IsCached(&mount, L"\\a\\bc"));
+  CHECK(IsCached(&mount, L"\\a2"));
+  CHECK(IsCached(&mount, L"\\x"));
+
+  // A file of the root only drops the root listing.
+  InvalidateDirectoryCache(&mount.Instance, L"\\file.txt");
+  CHECK(!IsCached(&mount, L"\\"));
+  CHECK(IsCached(&mount, L"\\x"));
+
+  // Everything is below the root.
+  CacheDirectory(&mount, L"\\");
+  InvalidateDirectoryCache(&mount.Instance, L"\\");
+  for (ULONG i = 0; i < _countof(paths); ++i) {
+    CHECK(!IsCached(&mount, paths[i]));
+  }
+  DeleteTestMount(&mount);
+}
+
+static VOID TestInvalidationDuringListing() {
+  TEST_MOUNT mount;
+  PDOKAN_DIRECTORY_LIST dirList;
+
+  CreateTestMount(&mount, 0, 0, 0);
+  // Any invalidation between the start of the listing and its insertion,
+  // even of another directory, keeps it out of the cache.
+  dirList = ListDirectory(&mount, 1);
+  InvalidateDirectoryCache(&mount.Instance, L"\\other\\file");
+  InsertDirectoryCache(&mount.Instance, L"\\dir", dirList);
+  CHECK(!IsCached(&mount, L"\\dir"));
+  CHECK(dirList->ReferenceCount == 1);
+  PushDirectoryList(&mount.Instance, dirList);
+
+  CacheDirectory(&mount, L"\\dir");
+  CHECK(IsCached(&mount, L"\\dir"));
+  DeleteTestMount(&mount);
+}
+
+static VOID TestCaseFolding() {
+  TEST_MOUNT mount;
+
+  CreateTestMount(&mount, 0, 0, 0);
+  CacheDirectory(&mount, L"\\Dir\\Sub");
+  CHECK(IsCached(&mount, L"\\DIR\\sub"));
+  CHECK(IsCached(&mount, L"/dir/SUB/"));
+  InvalidateDirectoryCache(&mount.Instance, L"\\DIR\\SUB\\file");
+  CHECK(!IsCached(&mount, L"\\Dir\\Sub"));
+  DeleteTestMount(&mount);
+
+  CreateTestMount(&mount, DOKAN_OPTION_CASE_SENSITIVE, 0, 0);
+  CacheDirectory(&mount, L"\\Dir\\Sub");
+  CHECK(!IsCached(&mount, L"\\DIR\\sub"));
+  CHECK(IsCached(&mount, L"/Dir/Sub/"));
+  InvalidateDirectoryCache(&mount.Instance, L"\\DIR\\SUB\\file");
+  CHECK(IsCached(&mount, L"\\Dir\\Sub"));
+  InvalidateDirectoryCache(&mount.Instance, L"\\Dir\\Sub\\file");
+  CHECK(!IsCached(&mount, L"\\Dir\\Sub"));
+  DeleteTestMount(&mount);
+}
+
+static VOID TestSharedListing() {
+  TEST_MOUNT mount;
+  PDOKAN_DIRECTORY_LIST firstOpen;
+  PDOKAN_DIRECTORY_LIST secondOpen;
+
+  CreateTestMount(&mount, 0, 0, 0);
+  firstOpen = ListDirectory(&mount, LISTING_ENTRY_COUNT);
+  InsertDirectoryCache(&mount.Instance, L"\\dir", firstOpen);
+  secondOpen = LookupDirectoryCache(&mount.Instance, L"\\dir");
+  CHECK(secondOpen == firstOpen);
+  CHECK(firstOpen->ReferenceCount == 3);
+
+  // Neither the close of the first open nor the invalidation take the
+  // listing from the second open.
+  PushDirectoryList(&mount.Instance, firstOpen);
+  InvalidateDirectoryCache(&mount.Instance, L"\\dir\\file");
+  CHECK(!IsCached(&mount, L"\\dir"));
+  CHECK(secondOpen->ReferenceCount == 1);
+  CHECK(DokanVector_GetCount(secondOpen->Entries) == LISTING_ENTRY_COUNT);
+  PushDirectoryList(&mount.Instance, secondOpen);
+
+  // Paged listings are never shared.
+  firstOpen = ListDirectory(&mount, 1);
+  firstOpen->Paged = TRUE;
+  InsertDirectoryCache(&mount.Instance, L"\\paged", firstOpen);
+  CHECK(!IsCached(&mount, L"\\paged"));
+  CHECK(firstOpen->ReferenceCount == 1);
+  PushDirectoryList(&mount.Instance, firstOpen);
+  DeleteTestMount(&mount);
+}
+
+int main() {
+  DokanDebugMode(FALSE);
+  TestExpiry();
+  TestLeastRecentlyUsedEviction();
+  TestInvalidation();
+  TestInvalidationDuringListing();
+  TestCaseFolding();
+  TestSharedListing();
+  return TEST_RESULT();
+}
@@ -0,0 +1,295 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks that listings sent over several replies resume where the previous
+// reply stopped: every entry is returned once and in order whether the reply
+// ends inside a page of DOKAN_OPERATIONS.FindFilesPage or on its last entry,
+// with and without a search pattern and SL_RETURN_SINGLE_ENTRY, and that a
+// continuation from an earlier index does not resume from the cursor.
+
+#include "../dokani.h"
+#include "test.h"
+
+ULONG g_TestFailures;
+
+// Defined in directory.c.
+int WINAPI DokanFillFileData(PWIN32_FIND_DATAW FindData,
+                             PDOKAN_FILE_INFO FileInfo);
+size_t GetDirectoryEntryCount(PDOKAN_DIRECTORY_LIST DirectoryList);
+PDOKAN_DIRECTORY_ENTRY GetDirectoryEntry(PDOKAN_DIRECTORY_LIST DirectoryList,
+                                         size_t Index);
+LPCWSTR GetDirectoryEntryName(PDOKAN_DIRECTORY_LIST DirectoryList,
+                              PDOKAN_DIRECTORY_ENTRY Entry);
+NTSTATUS FetchDirectoryPage(PDOKAN_IO_EVENT IoEvent,
+                            PDOKAN_DIRECTORY_LIST DirList);
+NTSTATUS FillDirectoryResults(PDOKAN_IO_EVENT IoEvent,
+                              PDOKAN_DIRECTORY_LIST DirList,
+                              PDOKAN_DIR_LIST_CURSOR Cursor);
+
+#define ENTRY_COUNT 200
+// Not a multiple of the entries of a reply, so that replies end both inside
+// pages and on their last entry.
+#define PAGE_ENTRY_COUNT 37
+#define PAGE_COUNT ((ENTRY_COUNT + PAGE_ENTRY_COUNT - 1) / PAGE_ENTRY_COUNT)
+#define REPLY_ENTRY_COUNT 10
+#define NAME_LENGTH 9
+
+typedef struct _TEST_LISTING {
+  DOKAN_OPTIONS Options;
+  DOKAN_OPERATIONS Operations;
+  DOKAN_INSTANCE Instance;
+  DOKAN_OPEN_INFO OpenInfo;
+  DOKAN_IO_EVENT IoEvent;
+  PDOKAN_DIRECTORY_LIST DirList;
+  DOKAN_DIR_LIST_CURSOR Cursor;
+} TEST_LISTING, *PTEST_LISTING;
+
+static ULONG g_PagesFetched;
+
+// The second page only has names that "file*" skips, so that a reply finds
+// no match in a whole page.
+static VOID GetTestName(ULONG Index, WCHAR Name[NAME_LENGTH]) {
+  LPCWSTR prefix = Index / PAGE_ENTRY_COUNT == 1 || Index % 4 == 0
+                       ? L"other"
+                       : L"file";
+  size_t length = wcslen(prefix);
+
+  wcscpy_s(Name, NAME_LENGTH, prefix);
+  Name[length] = (WCHAR)(L'0' + Index / 100);
+  Name[length + 1] = (WCHAR)(L'0' + Index / 10 % 10);
+  Name[length + 2] = (WCHAR)(L'0' + Index % 10);
+  Name[length + 3] = L'\0';
+}
+
+static VOID AddTestEntry(ULONG Index, PFillFindData FillFindData,
+                         PDOKAN_FILE_INFO DokanFileInfo) {
+  WIN32_FIND_DATAW findData;
+
+  RtlZeroMemory(&findData, sizeof(WIN32_FIND_DATAW));
+  findData.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+  findData.nFileSizeLow = Index;
+  GetTestName(Index, findData.cFileName);
+  FillFindData(&findData, DokanFileInfo);
+}
+
+// Continuation is the index of the first entry of the page.
+static NTSTATUS DOKAN_CALLBACK TestFindFilesPage(
+    LPCWSTR PathName, LPCWSTR SearchPattern, PULONG64 Continuation,
+    PFillFindData FillFindData, PDOKAN_FILE_INFO DokanFileInfo) {
+  ULONG index = (ULONG)*Continuation;
+  ULONG end = min(index + PAGE_ENTRY_COUNT, ENTRY_COUNT);
+
+  UNREFERENCED_PARAMETER(PathName);
+  UNREFERENCED_PARAMETER(SearchPattern);
+  for (; index < end; ++index) {
+    AddTestEntry(index, FillFindData, DokanFileInfo);
+  }
+  *Continuation = index < ENTRY_COUNT ? index : 0;
+  ++g_PagesFetched;
+  return STATUS_SUCCESS;
+}
+
+static ULONG GetReplyBufferLength() {
+  return REPLY_ENTRY_COUNT *
+         QuadAlign(sizeof(FILE_NAMES_INFORMATION) +
+                   (NAME_LENGTH - 1) * sizeof(WCHAR));
+}
+
+static VOID CreateTestListing(PTEST_LISTING Listing, LPCWSTR Pattern,
+                              ULONG Flags, BOOL Paged) {
+  // The pattern is stored after the directory name.
+  const ULONG patternOffset = 4 * sizeof(WCHAR);
+  ULONG contextSize = sizeof(EVENT_CONTEXT) + 32 * sizeof(WCHAR);
+  PEVENT_CONTEXT eventContext;
+  PDIRECTORY_CONTEXT directory;
+
+  RtlZeroMemory(Listing, sizeof(TEST_LISTING));
+  Listing->Instance.DokanOptions = &Listing->Options;
+  Listing->Instance.DokanOperations = &Listing->Operations;
+  if (Paged) {
+    Listing->Options.Options |= DOKAN_OPTION_FIND_FILES_PAGE;
+    Listing->Operations.FindFilesPage = TestFindFilesPage;
+  }
+  Listing->IoEvent.DokanInstance = &Listing->Instance;
+  Listing->IoEvent.DokanOpenInfo = &Listing->OpenInfo;
+
+  eventContext = (PEVENT_CONTEXT)calloc(1, contextSize);
+  CHECK(eventContext != NULL);
+  eventContext->Flags = Flags;
+  directory = &eventContext->Operation.Directory;
+  directory->FileInformationClass = FileNamesInformation;
+  directory->BufferLength = GetReplyBufferLength();
+  directory->DirectoryNameLength = sizeof(WCHAR);
+  directory->DirectoryName[0] = L'\\';
+  if (Pattern) {
+    directory->SearchPatternOffset = patternOffset;
+    directory->SearchPatternLength = (ULONG)(wcslen(Pattern) * sizeof(WCHAR));
+    wcscpy_s((PWCHAR)((PCHAR)&directory->SearchPatternBase[0] + patternOffset),
+             16, Pattern);
+  }
+  Listing->IoEvent.EventContext = eventContext;
+  Listing->IoEvent.EventResultSize =
+      FIELD_OFFSET(EVENT_INFORMATION, Buffer) + directory->BufferLength;
+  Listing->IoEvent.EventResult =
+      (PEVENT_INFORMATION)calloc(1, Listing->IoEvent.EventResultSize);
+  CHECK(Listing->IoEvent.EventResult != NULL);
+
+  Listing->DirList = CreateDirectoryList();
+  CHECK(Listing->DirList != NULL);
+  g_PagesFetched = 0;
+  if (Paged) {
+    CHECK(FetchDirectoryPage(&Listing->IoEvent, Listing->DirList) ==
+          STATUS_SUCCESS);
+    CHECK(Listing->DirList->Paged && Listing->DirList->MoreEntries);
+  } else {
+    Listing->IoEvent.DokanFileInfo.ProcessingContext = Listing->DirList;
+    for (ULONG i = 0; i < ENTRY_COUNT; ++i) {
+      AddTestEntry(i, DokanFillFileData, &Listing->IoEvent.DokanFileInfo);
+    }
+    Listing->IoEvent.DokanFileInfo.ProcessingContext = NULL;
+  }
+}
+
+static VOID DeleteTestListing(PTEST_LISTING Listing) {
+  DeleteDirectoryList(Listing->DirList);
+  free(Listing->IoEvent.EventResult);
+  free(Listing->IoEvent.EventContext);
+}
+
+static BOOL IsExpectedName(LPCWSTR Pattern, LPCWSTR Name) {
+  return !Pattern || wcscmp(Pattern, L"*") == 0 ||
+         wcsncmp(Name, L"file", 4) == 0;
+}
+
+// Checks the invariant of DOKAN_DIR_LIST_CURSOR: MatchIndex entries before
+// Position match the pattern.
+static VOID CheckCursor(PTEST_LISTING Listing, LPCWSTR Pattern) {
+  ULONG matches = 0;
+
+  CHECK(Listing->Cursor.Position <= GetDirectoryEntryCount(Listing->DirList));
+  for (size_t i = 0; i < Listing->Cursor.Position; ++i) {
+    if (IsExpectedName(Pattern,
+                       GetDirectoryEntryName(
+                           Listing->DirList,
+                           GetDirectoryEntry(Listing->DirList, i)))) {
+      ++matches;
+    }
+  }
+  CHECK(matches == Listing->Cursor.MatchIndex);
+}
+
+// Sends one reply from FileIndex and checks that it holds the expected
+// entries from there. Returns the status of the reply and the next index.
+static NTSTATUS ListFrom(PTEST_LISTING Listing, LPCWSTR Pattern,
+                         LPCWSTR *ExpectedNames, ULONG ExpectedCount,
+                         ULONG FileIndex, PULONG NextIndex) {
+  PEVENT_INFORMATION eventResult = Listing->IoEvent.EventResult;
+  PCHAR entry = (PCHAR)eventResult->Buffer;
+  ULONG index = FileIndex;
+  NTSTATUS status;
+
+  Listing->IoEvent.EventContext->Operation.Directory.FileIndex = FileIndex;
+  eventResult->Status = STATUS_SUCCESS;
+  eventResult->BufferLength = 0;
+  status = FillDirectoryResults(&Listing->IoEvent, Listing->DirList,
+                                &Listing->Cursor);
+  *NextIndex = eventResult->Operation.Directory.Index;
+  if (status != STATUS_SUCCESS) {
+    CHECK(*NextIndex == FileIndex);
+    return status;
+  }
+  CHECK(eventResult->BufferLength > 0);
+  for (;;) {
+    PFILE_NAMES_INFORMATION names = (PFILE_NAMES_INFORMATION)entry;
+    ULONG nameLength = names->FileNameLength / sizeof(WCHAR);
+
+    CHECK(index < ExpectedCount);
+    if (index >= ExpectedCount) {
+      break;
+    }
+    CHECK(names->FileIndex == index + 1);
+    CHECK(nameLength == wcslen(ExpectedNames[index]) &&
+          wcsncmp(names->FileName, ExpectedNames[index], nameLength) == 0);
+    ++index;
+    if (names->NextEntryOffset == 0) {
+      break;
+    }
+    entry += names->NextEntryOffset;
+    CHECK(entry < (PCHAR)eventResult->Buffer + eventResult->BufferLength);
+  }
+  CHECK(*NextIndex == index);
+  CHECK(Listing->Cursor.MatchIndex == index);
+  CheckCursor(Listing, Pattern);
+  return status;
+}
+
+static VOID TestListing(LPCWSTR Pattern, ULONG Flags, BOOL Paged) {
+  static WCHAR names[ENTRY_COUNT][NAME_LENGTH];
+  LPCWSTR expectedNames[ENTRY_COUNT];
+  ULONG expectedCount = 0;
+  ULONG replyCount = 0;
+  ULONG fileIndex = 0;
+  ULONG nextIndex;
+  TEST_LISTING listing;
+  NTSTATUS status;
+
+  for (ULONG i = 0; i < ENTRY_COUNT; ++i) {
+    GetTestName(i, names[i]);
+    if (IsExpectedName(Pattern, names[i])) {
+      expectedNames[expectedCount++] = names[i];
+    }
+  }
+
+  CreateTestListing(&listing, Pattern, Flags, Paged);
+  while ((status = ListFrom(&listing, Pattern, expectedNames, expectedCount,
+                            fileIndex, &nextIndex)) == STATUS_SUCCESS) {
+    CHECK(nextIndex > fileIndex);
+    fileIndex = nextIndex;
+    // Pages are only fetched when the entries left cannot fill the reply.
+    if (Paged && ++replyCount == 1) {
+      CHECK(g_PagesFetched < PAGE_COUNT);
+    }
+  }
+  CHECK(status == STATUS_NO_MORE_FILES);
+  CHECK(fileIndex == expectedCount);
+  CHECK(!Paged || g_PagesFetched == PAGE_COUNT);
+  CHECK(GetDirectoryEntryCount(listing.DirList) == ENTRY_COUNT);
+
+  // Enumerating again from an earlier index ignores the cursor at the end.
+  CHECK(ListFrom(&listing, Pattern, expectedNames, expectedCount, 5,
+                 &nextIndex) == STATUS_SUCCESS);
+  CHECK(nextIndex > 5);
+  CHECK(ListFrom(&listing, Pattern, expectedNames, expectedCount, 0,
+                 &nextIndex) == STATUS_SUCCESS);
+  CHECK(nextIndex > 0);
+  DeleteTestListing(&listing);
+}
+
+int main() {
+  for (int paged = 0; paged <= 1; ++paged) {
+    TestListing(NULL, 0, paged);
+    TestListing(L"*", 0, paged);
+    TestListing(L"file*", 0, paged);
+    TestListing(NULL, SL_RETURN_SINGLE_ENTRY, paged);
+    TestListing(L"file*", SL_RETURN_SINGLE_ENTRY, paged);
+  }
+  return TEST_RESULT();
+}
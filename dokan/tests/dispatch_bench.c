@@ -0,0 +1,182 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times reads submitted to a memory file system in batches of 1 to 256
+// events, each pulled at once and spread over the dispatch threads, with pull
+// threads and with overlapped pulls. Not run by ctest, pass a repetition
+// factor to scale it.
+
+#include "memory_events.h"
+
+#define MAX_BATCH_SIZE 256
+#define EVENTS_PER_BATCH_SIZE 65536
+#define READ_LENGTH 512
+#define OPEN_KEY 1
+
+static const ULONG g_BatchSizes[] = {1, 8, 64, MAX_BATCH_SIZE};
+
+static double NowSeconds() {
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static NTSTATUS DOKAN_CALLBACK
+BenchCreateFile(LPCWSTR FileName, PDOKAN_IO_SECURITY_CONTEXT SecurityContext,
+                ACCESS_MASK DesiredAccess, ULONG FileAttributes,
+                ULONG ShareAccess, ULONG CreateDisposition,
+                ULONG CreateOptions, PDOKAN_FILE_INFO DokanFileInfo) {
+  UNREFERENCED_PARAMETER(FileName);
+  UNREFERENCED_PARAMETER(SecurityContext);
+  UNREFERENCED_PARAMETER(DesiredAccess);
+  UNREFERENCED_PARAMETER(FileAttributes);
+  UNREFERENCED_PARAMETER(ShareAccess);
+  UNREFERENCED_PARAMETER(CreateDisposition);
+  UNREFERENCED_PARAMETER(CreateOptions);
+  UNREFERENCED_PARAMETER(DokanFileInfo);
+  return STATUS_SUCCESS;
+}
+
+static NTSTATUS DOKAN_CALLBACK BenchReadFile(LPCWSTR FileName, LPVOID Buffer,
+                                             DWORD BufferLength,
+                                             LPDWORD ReadLength,
+                                             LONGLONG Offset,
+                                             PDOKAN_FILE_INFO DokanFileInfo) {
+  UNREFERENCED_PARAMETER(FileName);
+  UNREFERENCED_PARAMETER(Buffer);
+  UNREFERENCED_PARAMETER(Offset);
+  UNREFERENCED_PARAMETER(DokanFileInfo);
+  *ReadLength = BufferLength;
+  return STATUS_SUCCESS;
+}
+
+static BOOL SubmitAndFree(DOKAN_HANDLE Instance, PEVENT_CONTEXT EventContext) {
+  BOOL submitted = EventContext && DokanMemoryTransportSubmit(Instance,
+                                                              EventContext);
+  free(EventContext);
+  return submitted;
+}
+
+// Returns the reads per second of EventCount reads submitted BatchSize at a
+// time, each batch waited for before the next, and the events taken by a pull.
+static double TimeBatches(DOKAN_HANDLE Instance, PEVENT_CONTEXT *Reads,
+                          ULONG BatchSize, ULONG EventCount,
+                          double *EventsPerPull) {
+  DOKAN_MEMORY_TRANSPORT_STATISTICS before;
+  DOKAN_MEMORY_TRANSPORT_STATISTICS after;
+  ULONG batchCount = EventCount / BatchSize;
+  double startTime;
+  double elapsed;
+
+  DokanGetMemoryTransportStatistics(Instance, &before);
+  startTime = NowSeconds();
+  for (ULONG i = 0; i < batchCount; ++i) {
+    if (!DokanMemoryTransportSubmitBatch(Instance, Reads, BatchSize) ||
+        !DokanWaitForMemoryTransportIdle(Instance, INFINITE)) {
+      fprintf(stderr, "Submitting a batch failed\n");
+      exit(1);
+    }
+  }
+  elapsed = NowSeconds() - startTime;
+  DokanGetMemoryTransportStatistics(Instance, &after);
+  *EventsPerPull = (double)(after.PulledEvents - before.PulledEvents) /
+                   (double)(after.Pulls - before.Pulls);
+  return (double)batchCount * BatchSize / elapsed;
+}
+
+// Times every batch size on a new memory file system with Options.
+static VOID TimeBatchSizes(ULONG Options, PEVENT_CONTEXT *Reads,
+                           ULONG EventCount, double *EventsPerSecond,
+                           double *EventsPerPull) {
+  DOKAN_OPTIONS options;
+  DOKAN_OPERATIONS operations;
+  DOKAN_HANDLE instance = NULL;
+
+  ZeroMemory(&options, sizeof(DOKAN_OPTIONS));
+  options.Version = DOKAN_VERSION;
+  options.Options = Options;
+  ZeroMemory(&operations, sizeof(DOKAN_OPERATIONS));
+  operations.ZwCreateFile = BenchCreateFile;
+  operations.ReadFile = BenchReadFile;
+  if (DokanCreateMemoryFileSystem(&options, &operations, &instance) !=
+          DOKAN_SUCCESS ||
+      !SubmitAndFree(instance, BuildCreateEvent(OPEN_KEY, L"\\file")) ||
+      !DokanWaitForMemoryTransportIdle(instance, INFINITE)) {
+    fprintf(stderr, "Creating the memory file system failed\n");
+    exit(1);
+  }
+  for (ULONG i = 0; i < sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0]); ++i) {
+    EventsPerSecond[i] = TimeBatches(instance, Reads, g_BatchSizes[i],
+                                     EventCount, &EventsPerPull[i]);
+  }
+  if (!SubmitAndFree(instance, BuildCleanupEvent(OPEN_KEY, L"\\file")) ||
+      !SubmitAndFree(instance, BuildCloseEvent(OPEN_KEY, L"\\file")) ||
+      !DokanWaitForMemoryTransportIdle(instance, INFINITE)) {
+    fprintf(stderr, "Closing the file failed\n");
+    exit(1);
+  }
+  DokanCloseHandle(instance);
+}
+
+int main(int argc, char **argv) {
+  ULONG factor = argc > 1 ? (ULONG)strtoul(argv[1], NULL, 10) : 1;
+  ULONG sizeCount = sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0]);
+  PEVENT_CONTEXT reads[MAX_BATCH_SIZE];
+  double threads[sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0])];
+  double threadsPerPull[sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0])];
+  double overlapped[sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0])];
+  double overlappedPerPull[sizeof(g_BatchSizes) / sizeof(g_BatchSizes[0])];
+
+  if (factor == 0) {
+    factor = 1;
+  }
+  DokanInit();
+  DokanDebugMode(FALSE);
+  for (ULONG i = 0; i < MAX_BATCH_SIZE; ++i) {
+    reads[i] = BuildReadEvent(OPEN_KEY, L"\\file", READ_LENGTH,
+                              (LONGLONG)i * READ_LENGTH);
+    if (!reads[i]) {
+      fprintf(stderr, "BuildReadEvent failed\n");
+      return 1;
+    }
+  }
+
+  TimeBatchSizes(DOKAN_OPTION_ALLOW_IPC_BATCHING, reads,
+                 EVENTS_PER_BATCH_SIZE * factor, threads, threadsPerPull);
+  TimeBatchSizes(DOKAN_OPTION_ALLOW_IPC_BATCHING |
+                     DOKAN_OPTION_OVERLAPPED_PULL,
+                 reads, EVENTS_PER_BATCH_SIZE * factor, overlapped,
+                 overlappedPerPull);
+
+  printf("%-6s %14s %10s %16s %10s\n", "batch", "threads ev/s", "ev/pull",
+         "overlapped ev/s", "ev/pull");
+  for (ULONG i = 0; i < sizeCount; ++i) {
+    printf("%-6lu %14.0f %10.1f %16.0f %10.1f\n", g_BatchSizes[i], threads[i],
+           threadsPerPull[i], overlapped[i], overlappedPerPull[i]);
+  }
+
+  for (ULONG i = 0; i < MAX_BATCH_SIZE; ++i) {
+    free(reads[i]);
+  }
+  DokanShutdown();
+  return 0;
+}
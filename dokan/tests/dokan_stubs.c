@@ -0,0 +1,86 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Definitions the library takes from the sources that are not built for the
+// host tests: mount.c, ntstatus.c, security.c and version.c.
+
+#include "../dokani.h"
+
+// Driver and security functions, the memory transport never reaches them.
+static VOID NotBuiltForHostTests(const char *Function) {
+  fprintf(stderr, "%s is not built for the host tests\n", Function);
+  abort();
+}
+
+BOOL DokanMount(PDOKAN_INSTANCE DokanInstance, PDOKAN_OPTIONS DokanOptions) {
+  UNREFERENCED_PARAMETER(DokanInstance);
+  UNREFERENCED_PARAMETER(DokanOptions);
+  NotBuiltForHostTests(__func__);
+  return FALSE;
+}
+
+BOOL DOKANAPI DokanRemoveMountPoint(LPCWSTR MountPoint) {
+  UNREFERENCED_PARAMETER(MountPoint);
+  NotBuiltForHostTests(__func__);
+  return FALSE;
+}
+
+// Without mount point, only the file system is told.
+VOID DokanNotifyUnmounted(PDOKAN_INSTANCE DokanInstance) {
+  if (DokanInstance->DokanOperations->Unmounted) {
+    DOKAN_FILE_INFO fileInfo;
+    RtlZeroMemory(&fileInfo, sizeof(DOKAN_FILE_INFO));
+    fileInfo.DokanOptions = DokanInstance->DokanOptions;
+    DokanInstance->DokanOperations->Unmounted(&fileInfo);
+  }
+}
+
+BOOL EnableTokenPrivilege(LPCTSTR lpszSystemName, BOOL bEnable) {
+  UNREFERENCED_PARAMETER(lpszSystemName);
+  UNREFERENCED_PARAMETER(bEnable);
+  NotBuiltForHostTests(__func__);
+  return FALSE;
+}
+
+BOOL EnableTokenPrivilegeEx(LPCTSTR lpszSystemName, BOOL bEnable,
+                            PBOOL pbWasEnabled) {
+  UNREFERENCED_PARAMETER(lpszSystemName);
+  UNREFERENCED_PARAMETER(bEnable);
+  UNREFERENCED_PARAMETER(pbWasEnabled);
+  NotBuiltForHostTests(__func__);
+  return FALSE;
+}
+
+// The host errors are not mapped, they get the default of the conversion.
+NTSTATUS DOKANAPI DokanNtStatusFromWin32(DWORD Error) {
+  UNREFERENCED_PARAMETER(Error);
+  return STATUS_ACCESS_DENIED;
+}
+
+VOID DispatchQuerySecurity(PDOKAN_IO_EVENT IoEvent) {
+  UNREFERENCED_PARAMETER(IoEvent);
+  NotBuiltForHostTests(__func__);
+}
+
+VOID DispatchSetSecurity(PDOKAN_IO_EVENT IoEvent) {
+  UNREFERENCED_PARAMETER(IoEvent);
+  NotBuiltForHostTests(__func__);
+}
@@ -0,0 +1,24 @@
+// String functions of strsafe.h the library sources use, implemented in
+// win32.c. Truncated output fails with STRSAFE_E_INSUFFICIENT_BUFFER.
+
+#ifndef DOKAN_TESTS_HOST_STRSAFE_H_
+#define DOKAN_TESTS_HOST_STRSAFE_H_
+
+#include <windows.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STRSAFE_E_INSUFFICIENT_BUFFER ((HRESULT)0x8007007AL)
+
+HRESULT StringCchVPrintfA(LPSTR Destination, size_t DestinationCount,
+                          LPCSTR Format, va_list Args);
+HRESULT StringCbPrintfW(LPWSTR Destination, size_t DestinationSize,
+                        LPCWSTR Format, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DOKAN_TESTS_HOST_STRSAFE_H_
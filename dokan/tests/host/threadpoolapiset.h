@@ -0,0 +1,2 @@
+// Part of windows.h on the host.
+#include <windows.h>
@@ -0,0 +1,1265 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <strsafe.h>
+#include <windows.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/////////////////// Synchronization ///////////////////
+VOID InitializeCriticalSection(PCRITICAL_SECTION CriticalSection) {
+  pthread_mutexattr_t attributes;
+  pthread_mutexattr_init(&attributes);
+  pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&CriticalSection->Mutex, &attributes);
+  pthread_mutexattr_destroy(&attributes);
+}
+
+BOOL InitializeCriticalSectionAndSpinCount(PCRITICAL_SECTION CriticalSection,
+                                           DWORD SpinCount) {
+  UNREFERENCED_PARAMETER(SpinCount);
+  InitializeCriticalSection(CriticalSection);
+  return TRUE;
+}
+
+VOID EnterCriticalSection(PCRITICAL_SECTION CriticalSection) {
+  pthread_mutex_lock(&CriticalSection->Mutex);
+}
+
+VOID LeaveCriticalSection(PCRITICAL_SECTION CriticalSection) {
+  pthread_mutex_unlock(&CriticalSection->Mutex);
+}
+
+VOID DeleteCriticalSection(PCRITICAL_SECTION CriticalSection) {
+  pthread_mutex_destroy(&CriticalSection->Mutex);
+}
+
+VOID InitializeSRWLock(PSRWLOCK Lock) {
+  pthread_rwlock_init(&Lock->Lock, NULL);
+}
+
+VOID AcquireSRWLockExclusive(PSRWLOCK Lock) {
+  pthread_rwlock_wrlock(&Lock->Lock);
+}
+
+VOID ReleaseSRWLockExclusive(PSRWLOCK Lock) {
+  pthread_rwlock_unlock(&Lock->Lock);
+}
+
+VOID AcquireSRWLockShared(PSRWLOCK Lock) { pthread_rwlock_rdlock(&Lock->Lock); }
+
+VOID ReleaseSRWLockShared(PSRWLOCK Lock) { pthread_rwlock_unlock(&Lock->Lock); }
+
+// Used for every timed wait, CLOCK_REALTIME is the clock of the conditions
+// initialized without attributes.
+static VOID GetDeadline(DWORD Milliseconds, struct timespec *Deadline) {
+  clock_gettime(CLOCK_REALTIME, Deadline);
+  Deadline->tv_sec += Milliseconds / 1000;
+  Deadline->tv_nsec += (long)(Milliseconds % 1000) * 1000000;
+  if (Deadline->tv_nsec >= 1000000000) {
+    Deadline->tv_sec += 1;
+    Deadline->tv_nsec -= 1000000000;
+  }
+}
+
+// Waits on Condition until Done is set or the wait times out. Returns FALSE
+// on time out, Mutex must be held.
+static BOOL WaitForCondition(pthread_cond_t *Condition, pthread_mutex_t *Mutex,
+                             BOOL (*Done)(PVOID Context), PVOID Context,
+                             DWORD Milliseconds) {
+  struct timespec deadline;
+  if (Milliseconds != INFINITE) {
+    GetDeadline(Milliseconds, &deadline);
+  }
+  while (!Done(Context)) {
+    if (Milliseconds == INFINITE) {
+      pthread_cond_wait(Condition, Mutex);
+    } else if (pthread_cond_timedwait(Condition, Mutex, &deadline) ==
+               ETIMEDOUT) {
+      return Done(Context);
+    }
+  }
+  return TRUE;
+}
+
+VOID InitializeConditionVariable(PCONDITION_VARIABLE ConditionVariable) {
+  pthread_mutex_init(&ConditionVariable->Mutex, NULL);
+  pthread_cond_init(&ConditionVariable->Condition, NULL);
+  ConditionVariable->Generation = 0;
+}
+
+typedef struct _HOST_CONDITION_WAIT {
+  PCONDITION_VARIABLE ConditionVariable;
+  ULONG Generation;
+} HOST_CONDITION_WAIT;
+
+static BOOL IsConditionWoken(PVOID Context) {
+  HOST_CONDITION_WAIT *wait = (HOST_CONDITION_WAIT *)Context;
+  return wait->ConditionVariable->Generation != wait->Generation;
+}
+
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE ConditionVariable,
+                               PSRWLOCK Lock, DWORD Milliseconds, ULONG Flags) {
+  HOST_CONDITION_WAIT wait;
+  BOOL woken;
+  pthread_mutex_lock(&ConditionVariable->Mutex);
+  wait.ConditionVariable = ConditionVariable;
+  wait.Generation = ConditionVariable->Generation;
+  pthread_rwlock_unlock(&Lock->Lock);
+  woken = WaitForCondition(&ConditionVariable->Condition,
+                           &ConditionVariable->Mutex, IsConditionWoken, &wait,
+                           Milliseconds);
+  pthread_mutex_unlock(&ConditionVariable->Mutex);
+  if (Flags & CONDITION_VARIABLE_LOCKMODE_SHARED) {
+    AcquireSRWLockShared(Lock);
+  } else {
+    AcquireSRWLockExclusive(Lock);
+  }
+  if (!woken) {
+    SetLastError(ERROR_TIMEOUT);
+  }
+  return woken;
+}
+
+// Waking one waiter could wake one that started waiting after the wake and
+// leave the earlier one asleep, every waiter is woken instead.
+VOID WakeConditionVariable(PCONDITION_VARIABLE ConditionVariable) {
+  WakeAllConditionVariable(ConditionVariable);
+}
+
+VOID WakeAllConditionVariable(PCONDITION_VARIABLE ConditionVariable) {
+  pthread_mutex_lock(&ConditionVariable->Mutex);
+  ++ConditionVariable->Generation;
+  pthread_cond_broadcast(&ConditionVariable->Condition);
+  pthread_mutex_unlock(&ConditionVariable->Mutex);
+}
+
+
+/////////////////// Interlocked singly linked lists ///////////////////
+VOID InitializeSListHead(PSLIST_HEADER ListHead) {
+  pthread_mutex_init(&ListHead->Lock, NULL);
+  ListHead->First = NULL;
+  ListHead->Depth = 0;
+}
+
+PSLIST_ENTRY InterlockedPushEntrySList(PSLIST_HEADER ListHead,
+                                       PSLIST_ENTRY ListEntry) {
+  PSLIST_ENTRY first;
+  pthread_mutex_lock(&ListHead->Lock);
+  first = ListHead->First;
+  ListEntry->Next = first;
+  ListHead->First = ListEntry;
+  ++ListHead->Depth;
+  pthread_mutex_unlock(&ListHead->Lock);
+  return first;
+}
+
+PSLIST_ENTRY InterlockedPopEntrySList(PSLIST_HEADER ListHead) {
+  PSLIST_ENTRY first;
+  pthread_mutex_lock(&ListHead->Lock);
+  first = ListHead->First;
+  if (first) {
+    ListHead->First = first->Next;
+    --ListHead->Depth;
+  }
+  pthread_mutex_unlock(&ListHead->Lock);
+  return first;
+}
+
+PSLIST_ENTRY InterlockedFlushSList(PSLIST_HEADER ListHead) {
+  PSLIST_ENTRY first;
+  pthread_mutex_lock(&ListHead->Lock);
+  first = ListHead->First;
+  ListHead->First = NULL;
+  ListHead->Depth = 0;
+  pthread_mutex_unlock(&ListHead->Lock);
+  return first;
+}
+
+USHORT QueryDepthSList(PSLIST_HEADER ListHead) {
+  return __atomic_load_n(&ListHead->Depth, __ATOMIC_RELAXED);
+}
+
+/////////////////// Handles ///////////////////
+typedef enum _HOST_HANDLE_TYPE {
+  HostThreadHandle = 1,
+  HostEventHandle,
+} HOST_HANDLE_TYPE;
+
+typedef struct _HOST_HANDLE {
+  HOST_HANDLE_TYPE Type;
+} HOST_HANDLE, *PHOST_HANDLE;
+
+typedef struct _HOST_THREAD {
+  HOST_HANDLE Header;
+  pthread_t Thread;
+  LPTHREAD_START_ROUTINE StartAddress;
+  LPVOID Parameter;
+  BOOL Joined;
+} HOST_THREAD, *PHOST_THREAD;
+
+typedef struct _HOST_EVENT {
+  HOST_HANDLE Header;
+  pthread_mutex_t Mutex;
+  pthread_cond_t Signaled;
+  BOOL ManualReset;
+  BOOL State;
+} HOST_EVENT, *PHOST_EVENT;
+
+static void *RunThread(void *Context) {
+  PHOST_THREAD thread = (PHOST_THREAD)Context;
+  return (void *)(ULONG_PTR)thread->StartAddress(thread->Parameter);
+}
+
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES ThreadAttributes, SIZE_T StackSize,
+                    LPTHREAD_START_ROUTINE StartAddress, LPVOID Parameter,
+                    DWORD CreationFlags, LPDWORD ThreadId) {
+  PHOST_THREAD thread = (PHOST_THREAD)calloc(1, sizeof(HOST_THREAD));
+  UNREFERENCED_PARAMETER(ThreadAttributes);
+  UNREFERENCED_PARAMETER(StackSize);
+  UNREFERENCED_PARAMETER(CreationFlags);
+  if (!thread) {
+    return NULL;
+  }
+  thread->Header.Type = HostThreadHandle;
+  thread->StartAddress = StartAddress;
+  thread->Parameter = Parameter;
+  if (pthread_create(&thread->Thread, NULL, RunThread, thread) != 0) {
+    free(thread);
+    return NULL;
+  }
+  if (ThreadId) {
+    *ThreadId = 0;
+  }
+  return thread;
+}
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES EventAttributes, BOOL ManualReset,
+                    BOOL InitialState, LPCWSTR Name) {
+  PHOST_EVENT event = (PHOST_EVENT)calloc(1, sizeof(HOST_EVENT));
+  UNREFERENCED_PARAMETER(EventAttributes);
+  UNREFERENCED_PARAMETER(Name);
+  if (!event) {
+    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    return NULL;
+  }
+  event->Header.Type = HostEventHandle;
+  pthread_mutex_init(&event->Mutex, NULL);
+  pthread_cond_init(&event->Signaled, NULL);
+  event->ManualReset = ManualReset;
+  event->State = InitialState;
+  return event;
+}
+
+BOOL SetEvent(HANDLE Event) {
+  PHOST_EVENT event = (PHOST_EVENT)Event;
+  pthread_mutex_lock(&event->Mutex);
+  event->State = TRUE;
+  pthread_cond_broadcast(&event->Signaled);
+  pthread_mutex_unlock(&event->Mutex);
+  return TRUE;
+}
+
+BOOL ResetEvent(HANDLE Event) {
+  PHOST_EVENT event = (PHOST_EVENT)Event;
+  pthread_mutex_lock(&event->Mutex);
+  event->State = FALSE;
+  pthread_mutex_unlock(&event->Mutex);
+  return TRUE;
+}
+
+static BOOL IsEventSignaled(PVOID Context) {
+  return ((PHOST_EVENT)Context)->State;
+}
+
+DWORD WaitForSingleObject(HANDLE Handle, DWORD Milliseconds) {
+  PHOST_HANDLE handle = (PHOST_HANDLE)Handle;
+  if (handle->Type == HostThreadHandle) {
+    PHOST_THREAD thread = (PHOST_THREAD)Handle;
+    pthread_join(thread->Thread, NULL);
+    thread->Joined = TRUE;
+    return WAIT_OBJECT_0;
+  }
+  PHOST_EVENT event = (PHOST_EVENT)Handle;
+  BOOL signaled;
+  pthread_mutex_lock(&event->Mutex);
+  signaled = WaitForCondition(&event->Signaled, &event->Mutex,
+                              IsEventSignaled, event, Milliseconds);
+  if (signaled && !event->ManualReset) {
+    event->State = FALSE;
+  }
+  pthread_mutex_unlock(&event->Mutex);
+  return signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+}
+
+BOOL CloseHandle(HANDLE Object) {
+  PHOST_HANDLE handle = (PHOST_HANDLE)Object;
+  if (handle->Type == HostThreadHandle) {
+    PHOST_THREAD thread = (PHOST_THREAD)Object;
+    if (!thread->Joined) {
+      pthread_detach(thread->Thread);
+    }
+  } else {
+    PHOST_EVENT event = (PHOST_EVENT)Object;
+    pthread_cond_destroy(&event->Signaled);
+    pthread_mutex_destroy(&event->Mutex);
+  }
+  free(Object);
+  return TRUE;
+}
+
+BOOL RegisterWaitForSingleObject(PHANDLE NewWaitObject, HANDLE Object,
+                                 WAITORTIMERCALLBACKFUNC Callback,
+                                 PVOID Context, ULONG Milliseconds,
+                                 ULONG Flags) {
+  UNREFERENCED_PARAMETER(Object);
+  UNREFERENCED_PARAMETER(Callback);
+  UNREFERENCED_PARAMETER(Context);
+  UNREFERENCED_PARAMETER(Milliseconds);
+  UNREFERENCED_PARAMETER(Flags);
+  *NewWaitObject = NULL;
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+BOOL UnregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent) {
+  UNREFERENCED_PARAMETER(WaitHandle);
+  UNREFERENCED_PARAMETER(CompletionEvent);
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+/////////////////// Fiber local storage ///////////////////
+static PFLS_CALLBACK_FUNCTION g_FlsCallbacks[PTHREAD_KEYS_MAX];
+
+DWORD FlsAlloc(PFLS_CALLBACK_FUNCTION Callback) {
+  pthread_key_t key;
+  if (pthread_key_create(&key, Callback) != 0) {
+    return FLS_OUT_OF_INDEXES;
+  }
+  if (key >= PTHREAD_KEYS_MAX) {
+    pthread_key_delete(key);
+    return FLS_OUT_OF_INDEXES;
+  }
+  g_FlsCallbacks[key] = Callback;
+  return (DWORD)key;
+}
+
+// FlsFree runs the callback for the value of every thread. Only the one of the
+// calling thread is left here, the tests join their other threads first.
+BOOL FlsFree(DWORD FlsIndex) {
+  PVOID flsData = pthread_getspecific((pthread_key_t)FlsIndex);
+  if (pthread_key_delete((pthread_key_t)FlsIndex) != 0) {
+    return FALSE;
+  }
+  if (flsData && g_FlsCallbacks[FlsIndex]) {
+    g_FlsCallbacks[FlsIndex](flsData);
+  }
+  g_FlsCallbacks[FlsIndex] = NULL;
+  return TRUE;
+}
+
+PVOID FlsGetValue(DWORD FlsIndex) {
+  return pthread_getspecific((pthread_key_t)FlsIndex);
+}
+
+BOOL FlsSetValue(DWORD FlsIndex, PVOID FlsData) {
+  return pthread_setspecific((pthread_key_t)FlsIndex, FlsData) == 0;
+}
+
+/////////////////// Thread local storage ///////////////////
+DWORD TlsAlloc(void) {
+  pthread_key_t key;
+  if (pthread_key_create(&key, NULL) != 0) {
+    return TLS_OUT_OF_INDEXES;
+  }
+  return (DWORD)key;
+}
+
+BOOL TlsFree(DWORD TlsIndex) {
+  return pthread_key_delete((pthread_key_t)TlsIndex) == 0;
+}
+
+PVOID TlsGetValue(DWORD TlsIndex) {
+  return pthread_getspecific((pthread_key_t)TlsIndex);
+}
+
+BOOL TlsSetValue(DWORD TlsIndex, PVOID TlsValue) {
+  return pthread_setspecific((pthread_key_t)TlsIndex, TlsValue) == 0;
+}
+
+/////////////////// Thread pool ///////////////////
+struct _TP_POOL {
+  int Unused;
+};
+
+typedef struct _HOST_CALLBACK_OBJECT HOST_CALLBACK_OBJECT;
+
+// Header of the pool objects whose callbacks are queued to the threads.
+struct _HOST_CALLBACK_OBJECT {
+  // Runs one callback of the object.
+  VOID (*Run)(HOST_CALLBACK_OBJECT *Object);
+  // Stops new callbacks from being queued, can be NULL.
+  VOID (*Stop)(HOST_CALLBACK_OBJECT *Object);
+  PTP_CLEANUP_GROUP CleanupGroup;
+  LIST_ENTRY CleanupEntry;
+  // Callbacks queued or running.
+  ULONG Pending;
+  // Freed once its last pending callback returns.
+  BOOL Closed;
+};
+
+struct _TP_CLEANUP_GROUP {
+  LIST_ENTRY Members;
+};
+
+struct _TP_WORK {
+  HOST_CALLBACK_OBJECT Object;
+  PTP_WORK_CALLBACK Callback;
+  PVOID Context;
+};
+
+struct _TP_TIMER {
+  HOST_CALLBACK_OBJECT Object;
+  PTP_TIMER_CALLBACK Callback;
+  PVOID Context;
+  // In the timers of the pool while set.
+  LIST_ENTRY TimerEntry;
+  BOOL Set;
+  // GetTickCount64 time of the next expiration.
+  ULONGLONG DueTime;
+  DWORD Period;
+};
+
+typedef struct _HOST_SIMPLE_CALLBACK {
+  HOST_CALLBACK_OBJECT Object;
+  PTP_SIMPLE_CALLBACK Callback;
+  PVOID Context;
+} HOST_SIMPLE_CALLBACK, *PHOST_SIMPLE_CALLBACK;
+
+typedef struct _HOST_QUEUED_CALLBACK {
+  struct _HOST_QUEUED_CALLBACK *Next;
+  HOST_CALLBACK_OBJECT *Object;
+} HOST_QUEUED_CALLBACK;
+
+BOOL g_HostTimersStopped;
+
+// Protected by Lock.
+static struct {
+  pthread_mutex_t Lock;
+  // Signaled when a callback is queued.
+  pthread_cond_t CallbackQueued;
+  // Signaled when a callback returns.
+  pthread_cond_t CallbackCompleted;
+  // Signaled when a timer is set.
+  pthread_cond_t TimerSet;
+  HOST_QUEUED_CALLBACK *QueueHead;
+  HOST_QUEUED_CALLBACK *QueueTail;
+  ULONG QueuedCallbacks;
+  ULONG IdleThreads;
+  LIST_ENTRY Timers;
+  BOOL TimerThreadStarted;
+} g_HostPool = {PTHREAD_MUTEX_INITIALIZER,
+                PTHREAD_COND_INITIALIZER,
+                PTHREAD_COND_INITIALIZER,
+                PTHREAD_COND_INITIALIZER,
+                NULL,
+                NULL,
+                0,
+                0,
+                {&g_HostPool.Timers, &g_HostPool.Timers},
+                FALSE};
+
+static VOID StartDetachedThread(void *(*StartRoutine)(void *)) {
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, StartRoutine, NULL) != 0) {
+    fprintf(stderr, "The host thread pool cannot start a thread\n");
+    abort();
+  }
+  pthread_detach(thread);
+}
+
+static VOID RemoveEntry(PLIST_ENTRY Entry) {
+  Entry->Blink->Flink = Entry->Flink;
+  Entry->Flink->Blink = Entry->Blink;
+}
+
+static VOID InsertTailEntry(PLIST_ENTRY ListHead, PLIST_ENTRY Entry) {
+  Entry->Flink = ListHead;
+  Entry->Blink = ListHead->Blink;
+  ListHead->Blink->Flink = Entry;
+  ListHead->Blink = Entry;
+}
+
+static void *RunPoolThread(void *Parameter) {
+  UNREFERENCED_PARAMETER(Parameter);
+  pthread_mutex_lock(&g_HostPool.Lock);
+  for (;;) {
+    HOST_QUEUED_CALLBACK *callback;
+    HOST_CALLBACK_OBJECT *object;
+    while (!g_HostPool.QueueHead) {
+      ++g_HostPool.IdleThreads;
+      pthread_cond_wait(&g_HostPool.CallbackQueued, &g_HostPool.Lock);
+      --g_HostPool.IdleThreads;
+    }
+    callback = g_HostPool.QueueHead;
+    g_HostPool.QueueHead = callback->Next;
+    if (!g_HostPool.QueueHead) {
+      g_HostPool.QueueTail = NULL;
+    }
+    --g_HostPool.QueuedCallbacks;
+    object = callback->Object;
+    free(callback);
+    pthread_mutex_unlock(&g_HostPool.Lock);
+    object->Run(object);
+    pthread_mutex_lock(&g_HostPool.Lock);
+    if (--object->Pending == 0 && object->Closed) {
+      free(object);
+    }
+    pthread_cond_broadcast(&g_HostPool.CallbackCompleted);
+  }
+  return NULL;
+}
+
+// Must be called with the lock held.
+static VOID QueueCallback(HOST_CALLBACK_OBJECT *Object) {
+  HOST_QUEUED_CALLBACK *callback =
+      (HOST_QUEUED_CALLBACK *)malloc(sizeof(HOST_QUEUED_CALLBACK));
+  if (!callback) {
+    fprintf(stderr, "The host thread pool cannot queue a callback\n");
+    abort();
+  }
+  callback->Next = NULL;
+  callback->Object = Object;
+  if (g_HostPool.QueueTail) {
+    g_HostPool.QueueTail->Next = callback;
+  } else {
+    g_HostPool.QueueHead = callback;
+  }
+  g_HostPool.QueueTail = callback;
+  ++Object->Pending;
+  // Each idle thread takes one of the queued callbacks.
+  if (++g_HostPool.QueuedCallbacks > g_HostPool.IdleThreads) {
+    StartDetachedThread(RunPoolThread);
+  } else {
+    pthread_cond_signal(&g_HostPool.CallbackQueued);
+  }
+}
+
+// Must be called with the lock held.
+static VOID CancelQueuedCallbacks(HOST_CALLBACK_OBJECT *Object) {
+  HOST_QUEUED_CALLBACK **next = &g_HostPool.QueueHead;
+  g_HostPool.QueueTail = NULL;
+  while (*next) {
+    HOST_QUEUED_CALLBACK *callback = *next;
+    if (callback->Object == Object) {
+      *next = callback->Next;
+      --Object->Pending;
+      --g_HostPool.QueuedCallbacks;
+      free(callback);
+    } else {
+      g_HostPool.QueueTail = callback;
+      next = &callback->Next;
+    }
+  }
+}
+
+static BOOL HasNoPendingCallback(PVOID Context) {
+  return ((HOST_CALLBACK_OBJECT *)Context)->Pending == 0;
+}
+
+// Must be called with the lock held.
+static VOID WaitForCallbacks(HOST_CALLBACK_OBJECT *Object,
+                             BOOL CancelPendingCallbacks) {
+  if (CancelPendingCallbacks) {
+    CancelQueuedCallbacks(Object);
+  }
+  WaitForCondition(&g_HostPool.CallbackCompleted, &g_HostPool.Lock,
+                   HasNoPendingCallback, Object, INFINITE);
+}
+
+static VOID InitializeCallbackObject(HOST_CALLBACK_OBJECT *Object,
+                                     VOID (*Run)(HOST_CALLBACK_OBJECT *),
+                                     VOID (*Stop)(HOST_CALLBACK_OBJECT *),
+                                     PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  Object->Run = Run;
+  Object->Stop = Stop;
+  if (CallbackEnvironment && CallbackEnvironment->CleanupGroup) {
+    pthread_mutex_lock(&g_HostPool.Lock);
+    Object->CleanupGroup = CallbackEnvironment->CleanupGroup;
+    InsertTailEntry(&Object->CleanupGroup->Members, &Object->CleanupEntry);
+    pthread_mutex_unlock(&g_HostPool.Lock);
+  }
+}
+
+static VOID CloseCallbackObject(HOST_CALLBACK_OBJECT *Object) {
+  pthread_mutex_lock(&g_HostPool.Lock);
+  if (Object->Stop) {
+    Object->Stop(Object);
+  }
+  if (Object->CleanupGroup) {
+    RemoveEntry(&Object->CleanupEntry);
+    Object->CleanupGroup = NULL;
+  }
+  if (Object->Pending) {
+    Object->Closed = TRUE;
+  } else {
+    free(Object);
+  }
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+PTP_POOL CreateThreadpool(PVOID Reserved) {
+  UNREFERENCED_PARAMETER(Reserved);
+  return (PTP_POOL)calloc(1, sizeof(struct _TP_POOL));
+}
+
+VOID CloseThreadpool(PTP_POOL Pool) { free(Pool); }
+
+VOID InitializeThreadpoolEnvironment(PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  RtlZeroMemory(CallbackEnvironment, sizeof(TP_CALLBACK_ENVIRON));
+}
+
+VOID SetThreadpoolCallbackPool(PTP_CALLBACK_ENVIRON CallbackEnvironment,
+                               PTP_POOL Pool) {
+  CallbackEnvironment->Pool = Pool;
+}
+
+VOID SetThreadpoolCallbackCleanupGroup(
+    PTP_CALLBACK_ENVIRON CallbackEnvironment, PTP_CLEANUP_GROUP CleanupGroup,
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CleanupGroupCancelCallback) {
+  UNREFERENCED_PARAMETER(CleanupGroupCancelCallback);
+  CallbackEnvironment->CleanupGroup = CleanupGroup;
+}
+
+VOID DestroyThreadpoolEnvironment(PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  UNREFERENCED_PARAMETER(CallbackEnvironment);
+}
+
+PTP_CLEANUP_GROUP CreateThreadpoolCleanupGroup(void) {
+  PTP_CLEANUP_GROUP cleanupGroup =
+      (PTP_CLEANUP_GROUP)malloc(sizeof(struct _TP_CLEANUP_GROUP));
+  if (cleanupGroup) {
+    cleanupGroup->Members.Flink = &cleanupGroup->Members;
+    cleanupGroup->Members.Blink = &cleanupGroup->Members;
+  }
+  return cleanupGroup;
+}
+
+// Must be called with the lock held.
+static HOST_CALLBACK_OBJECT *
+FindPendingMember(PTP_CLEANUP_GROUP CleanupGroup) {
+  for (PLIST_ENTRY entry = CleanupGroup->Members.Flink;
+       entry != &CleanupGroup->Members; entry = entry->Flink) {
+    HOST_CALLBACK_OBJECT *object =
+        CONTAINING_RECORD(entry, HOST_CALLBACK_OBJECT, CleanupEntry);
+    if (object->Pending) {
+      return object;
+    }
+  }
+  return NULL;
+}
+
+// Members created by the callbacks waited for are released as well. The
+// callbacks can queue callbacks of members already waited for, so no member
+// is freed before none of them has a pending callback.
+VOID CloseThreadpoolCleanupGroupMembers(PTP_CLEANUP_GROUP CleanupGroup,
+                                        BOOL CancelPendingCallbacks,
+                                        PVOID CleanupContext) {
+  HOST_CALLBACK_OBJECT *object;
+
+  UNREFERENCED_PARAMETER(CleanupContext);
+  pthread_mutex_lock(&g_HostPool.Lock);
+  for (PLIST_ENTRY entry = CleanupGroup->Members.Flink;
+       entry != &CleanupGroup->Members; entry = entry->Flink) {
+    object = CONTAINING_RECORD(entry, HOST_CALLBACK_OBJECT, CleanupEntry);
+    if (object->Stop) {
+      object->Stop(object);
+    }
+  }
+  while ((object = FindPendingMember(CleanupGroup)) != NULL) {
+    WaitForCallbacks(object, CancelPendingCallbacks);
+  }
+  while (CleanupGroup->Members.Flink != &CleanupGroup->Members) {
+    object = CONTAINING_RECORD(CleanupGroup->Members.Flink,
+                               HOST_CALLBACK_OBJECT, CleanupEntry);
+    RemoveEntry(&object->CleanupEntry);
+    object->CleanupGroup = NULL;
+    if (object->Stop) {
+      object->Stop(object);
+    }
+    free(object);
+  }
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+VOID CloseThreadpoolCleanupGroup(PTP_CLEANUP_GROUP CleanupGroup) {
+  free(CleanupGroup);
+}
+
+static VOID RunWork(HOST_CALLBACK_OBJECT *Object) {
+  PTP_WORK work = (PTP_WORK)Object;
+  work->Callback(NULL, work->Context, work);
+}
+
+PTP_WORK CreateThreadpoolWork(PTP_WORK_CALLBACK Callback, PVOID Context,
+                              PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  PTP_WORK work = (PTP_WORK)calloc(1, sizeof(struct _TP_WORK));
+  if (!work) {
+    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    return NULL;
+  }
+  work->Callback = Callback;
+  work->Context = Context;
+  InitializeCallbackObject(&work->Object, RunWork, NULL, CallbackEnvironment);
+  return work;
+}
+
+VOID SubmitThreadpoolWork(PTP_WORK Work) {
+  pthread_mutex_lock(&g_HostPool.Lock);
+  QueueCallback(&Work->Object);
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+VOID WaitForThreadpoolWorkCallbacks(PTP_WORK Work,
+                                    BOOL CancelPendingCallbacks) {
+  pthread_mutex_lock(&g_HostPool.Lock);
+  WaitForCallbacks(&Work->Object, CancelPendingCallbacks);
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+VOID CloseThreadpoolWork(PTP_WORK Work) { CloseCallbackObject(&Work->Object); }
+
+static VOID RunTimer(HOST_CALLBACK_OBJECT *Object) {
+  PTP_TIMER timer = (PTP_TIMER)Object;
+  timer->Callback(NULL, timer->Context, timer);
+}
+
+// Must be called with the lock held.
+static VOID StopTimer(HOST_CALLBACK_OBJECT *Object) {
+  PTP_TIMER timer = (PTP_TIMER)Object;
+  if (timer->Set) {
+    RemoveEntry(&timer->TimerEntry);
+    timer->Set = FALSE;
+  }
+}
+
+// Queues the callbacks of the expired timers and waits for the next
+// expiration.
+static void *RunTimerThread(void *Parameter) {
+  UNREFERENCED_PARAMETER(Parameter);
+  pthread_mutex_lock(&g_HostPool.Lock);
+  for (;;) {
+    ULONGLONG now = GetTickCount64();
+    ULONGLONG nextDueTime = MAXULONG64;
+    struct timespec deadline;
+    // Checked again every 10 ms while the timers are stopped.
+    if (__atomic_load_n(&g_HostTimersStopped, __ATOMIC_RELAXED)) {
+      nextDueTime = now + 10;
+    } else {
+      PLIST_ENTRY entry = g_HostPool.Timers.Flink;
+      while (entry != &g_HostPool.Timers) {
+        PTP_TIMER timer = CONTAINING_RECORD(entry, struct _TP_TIMER,
+                                            TimerEntry);
+        entry = entry->Flink;
+        if (timer->DueTime <= now) {
+          QueueCallback(&timer->Object);
+          if (!timer->Period) {
+            StopTimer(&timer->Object);
+            continue;
+          }
+          timer->DueTime = max(timer->DueTime + timer->Period, now + 1);
+        }
+        nextDueTime = min(nextDueTime, timer->DueTime);
+      }
+    }
+    if (nextDueTime == MAXULONG64) {
+      pthread_cond_wait(&g_HostPool.TimerSet, &g_HostPool.Lock);
+      continue;
+    }
+    GetDeadline((DWORD)(nextDueTime - now), &deadline);
+    pthread_cond_timedwait(&g_HostPool.TimerSet, &g_HostPool.Lock, &deadline);
+  }
+  return NULL;
+}
+
+PTP_TIMER CreateThreadpoolTimer(PTP_TIMER_CALLBACK Callback, PVOID Context,
+                                PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  PTP_TIMER timer = (PTP_TIMER)calloc(1, sizeof(struct _TP_TIMER));
+  if (!timer) {
+    SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+    return NULL;
+  }
+  timer->Callback = Callback;
+  timer->Context = Context;
+  InitializeCallbackObject(&timer->Object, RunTimer, StopTimer,
+                           CallbackEnvironment);
+  return timer;
+}
+
+VOID SetThreadpoolTimer(PTP_TIMER Timer, PFILETIME DueTime, DWORD Period,
+                        DWORD WindowLength) {
+  ULONGLONG now = GetTickCount64();
+  UNREFERENCED_PARAMETER(WindowLength);
+  pthread_mutex_lock(&g_HostPool.Lock);
+  StopTimer(&Timer->Object);
+  if (DueTime) {
+    ULARGE_INTEGER dueTime;
+    LONGLONG delay;
+    dueTime.LowPart = DueTime->dwLowDateTime;
+    dueTime.HighPart = DueTime->dwHighDateTime;
+    // Negative times are relative, positive ones are system times, both in
+    // 100 nanoseconds intervals.
+    delay = -(LONGLONG)dueTime.QuadPart;
+    if (delay < 0) {
+      FILETIME systemTime;
+      ULARGE_INTEGER currentTime;
+      GetSystemTimeAsFileTime(&systemTime);
+      currentTime.LowPart = systemTime.dwLowDateTime;
+      currentTime.HighPart = systemTime.dwHighDateTime;
+      delay = (LONGLONG)(dueTime.QuadPart - currentTime.QuadPart);
+    }
+    Timer->DueTime = now + (ULONGLONG)max(delay, 0) / 10000;
+    Timer->Period = Period;
+    Timer->Set = TRUE;
+    InsertTailEntry(&g_HostPool.Timers, &Timer->TimerEntry);
+    if (!g_HostPool.TimerThreadStarted) {
+      g_HostPool.TimerThreadStarted = TRUE;
+      StartDetachedThread(RunTimerThread);
+    }
+    pthread_cond_signal(&g_HostPool.TimerSet);
+  }
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+VOID WaitForThreadpoolTimerCallbacks(PTP_TIMER Timer,
+                                     BOOL CancelPendingCallbacks) {
+  pthread_mutex_lock(&g_HostPool.Lock);
+  WaitForCallbacks(&Timer->Object, CancelPendingCallbacks);
+  pthread_mutex_unlock(&g_HostPool.Lock);
+}
+
+VOID CloseThreadpoolTimer(PTP_TIMER Timer) {
+  CloseCallbackObject(&Timer->Object);
+}
+
+PTP_IO CreateThreadpoolIo(HANDLE File, PTP_WIN32_IO_CALLBACK Callback,
+                          PVOID Context,
+                          PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  UNREFERENCED_PARAMETER(File);
+  UNREFERENCED_PARAMETER(Callback);
+  UNREFERENCED_PARAMETER(Context);
+  UNREFERENCED_PARAMETER(CallbackEnvironment);
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return NULL;
+}
+
+VOID StartThreadpoolIo(PTP_IO Io) { UNREFERENCED_PARAMETER(Io); }
+
+VOID CancelThreadpoolIo(PTP_IO Io) { UNREFERENCED_PARAMETER(Io); }
+
+VOID WaitForThreadpoolIoCallbacks(PTP_IO Io, BOOL CancelPendingCallbacks) {
+  UNREFERENCED_PARAMETER(Io);
+  UNREFERENCED_PARAMETER(CancelPendingCallbacks);
+}
+
+VOID CloseThreadpoolIo(PTP_IO Io) { UNREFERENCED_PARAMETER(Io); }
+
+static VOID RunSimpleCallback(HOST_CALLBACK_OBJECT *Object) {
+  PHOST_SIMPLE_CALLBACK callback = (PHOST_SIMPLE_CALLBACK)Object;
+  callback->Callback(NULL, callback->Context);
+}
+
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK Callback, PVOID Context,
+                                 PTP_CALLBACK_ENVIRON CallbackEnvironment) {
+  PHOST_SIMPLE_CALLBACK callback =
+      (PHOST_SIMPLE_CALLBACK)calloc(1, sizeof(HOST_SIMPLE_CALLBACK));
+  UNREFERENCED_PARAMETER(CallbackEnvironment);
+  if (!callback) {
+    return FALSE;
+  }
+  callback->Callback = Callback;
+  callback->Context = Context;
+  InitializeCallbackObject(&callback->Object, RunSimpleCallback, NULL, NULL);
+  pthread_mutex_lock(&g_HostPool.Lock);
+  QueueCallback(&callback->Object);
+  // Freed once it has run.
+  callback->Object.Closed = TRUE;
+  pthread_mutex_unlock(&g_HostPool.Lock);
+  return TRUE;
+}
+
+/////////////////// Files and devices ///////////////////
+HANDLE CreateFileW(LPCWSTR FileName, DWORD DesiredAccess, DWORD ShareMode,
+                   LPSECURITY_ATTRIBUTES SecurityAttributes,
+                   DWORD CreationDisposition, DWORD FlagsAndAttributes,
+                   HANDLE TemplateFile) {
+  UNREFERENCED_PARAMETER(FileName);
+  UNREFERENCED_PARAMETER(DesiredAccess);
+  UNREFERENCED_PARAMETER(ShareMode);
+  UNREFERENCED_PARAMETER(SecurityAttributes);
+  UNREFERENCED_PARAMETER(CreationDisposition);
+  UNREFERENCED_PARAMETER(FlagsAndAttributes);
+  UNREFERENCED_PARAMETER(TemplateFile);
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return INVALID_HANDLE_VALUE;
+}
+
+BOOL ReadFile(HANDLE File, LPVOID Buffer, DWORD NumberOfBytesToRead,
+              LPDWORD NumberOfBytesRead, LPOVERLAPPED Overlapped) {
+  UNREFERENCED_PARAMETER(File);
+  UNREFERENCED_PARAMETER(Buffer);
+  UNREFERENCED_PARAMETER(NumberOfBytesToRead);
+  UNREFERENCED_PARAMETER(Overlapped);
+  if (NumberOfBytesRead) {
+    *NumberOfBytesRead = 0;
+  }
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+BOOL WriteFile(HANDLE File, LPCVOID Buffer, DWORD NumberOfBytesToWrite,
+               LPDWORD NumberOfBytesWritten, LPOVERLAPPED Overlapped) {
+  UNREFERENCED_PARAMETER(File);
+  UNREFERENCED_PARAMETER(Buffer);
+  UNREFERENCED_PARAMETER(NumberOfBytesToWrite);
+  UNREFERENCED_PARAMETER(Overlapped);
+  if (NumberOfBytesWritten) {
+    *NumberOfBytesWritten = 0;
+  }
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+DWORD SetFilePointer(HANDLE File, LONG DistanceToMove,
+                     PLONG DistanceToMoveHigh, DWORD MoveMethod) {
+  UNREFERENCED_PARAMETER(File);
+  UNREFERENCED_PARAMETER(DistanceToMove);
+  UNREFERENCED_PARAMETER(DistanceToMoveHigh);
+  UNREFERENCED_PARAMETER(MoveMethod);
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return INVALID_SET_FILE_POINTER;
+}
+
+BOOL DeviceIoControl(HANDLE Device, DWORD IoControlCode, LPVOID InBuffer,
+                     DWORD InBufferSize, LPVOID OutBuffer, DWORD OutBufferSize,
+                     LPDWORD BytesReturned, LPOVERLAPPED Overlapped) {
+  UNREFERENCED_PARAMETER(Device);
+  UNREFERENCED_PARAMETER(IoControlCode);
+  UNREFERENCED_PARAMETER(InBuffer);
+  UNREFERENCED_PARAMETER(InBufferSize);
+  UNREFERENCED_PARAMETER(OutBuffer);
+  UNREFERENCED_PARAMETER(OutBufferSize);
+  UNREFERENCED_PARAMETER(Overlapped);
+  if (BytesReturned) {
+    *BytesReturned = 0;
+  }
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+BOOL CancelIoEx(HANDLE File, LPOVERLAPPED Overlapped) {
+  UNREFERENCED_PARAMETER(File);
+  UNREFERENCED_PARAMETER(Overlapped);
+  SetLastError(ERROR_NOT_SUPPORTED);
+  return FALSE;
+}
+
+DWORD QueryDosDeviceW(LPCWSTR DeviceName, LPWSTR TargetPath, DWORD Max) {
+  UNREFERENCED_PARAMETER(DeviceName);
+  UNREFERENCED_PARAMETER(TargetPath);
+  UNREFERENCED_PARAMETER(Max);
+  SetLastError(ERROR_FILE_NOT_FOUND);
+  return 0;
+}
+
+DWORD GetLogicalDrives(void) { return 0; }
+
+/////////////////// Memory ///////////////////
+PVOID VirtualAlloc(PVOID Address, SIZE_T Size, DWORD AllocationType,
+                   DWORD Protect) {
+  int protection =
+      (AllocationType & MEM_COMMIT) ? PROT_READ | PROT_WRITE : PROT_NONE;
+  UNREFERENCED_PARAMETER(Protect);
+  if (AllocationType & MEM_LARGE_PAGES) {
+    return NULL;
+  }
+  if (Address) {
+    // Commit of pages of a reserved region.
+    return mprotect(Address, Size, protection) == 0 ? Address : NULL;
+  }
+  Address = mmap(NULL, Size, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return Address == MAP_FAILED ? NULL : Address;
+}
+
+PVOID VirtualAllocExNuma(HANDLE Process, PVOID Address, SIZE_T Size,
+                         DWORD AllocationType, DWORD Protect, DWORD Node) {
+  UNREFERENCED_PARAMETER(Process);
+  UNREFERENCED_PARAMETER(Node);
+  return VirtualAlloc(Address, Size, AllocationType, Protect);
+}
+
+// The mapping size is not known on release, the regions are leaked.
+BOOL VirtualFree(PVOID Address, SIZE_T Size, DWORD FreeType) {
+  UNREFERENCED_PARAMETER(Address);
+  UNREFERENCED_PARAMETER(Size);
+  UNREFERENCED_PARAMETER(FreeType);
+  return TRUE;
+}
+
+SIZE_T GetLargePageMinimum(void) { return 0; }
+
+void *_aligned_malloc(size_t Size, size_t Alignment) {
+  void *memory = NULL;
+  if (posix_memalign(&memory, Alignment, Size) != 0) {
+    return NULL;
+  }
+  return memory;
+}
+
+void _aligned_free(void *Memory) { free(Memory); }
+
+/////////////////// System ///////////////////
+static __thread DWORD g_LastError;
+
+HANDLE GetCurrentProcess(void) { return (HANDLE)(LONG_PTR)-1; }
+
+DWORD GetCurrentProcessId(void) { return (DWORD)getpid(); }
+
+BOOL GetProcessAffinityMask(HANDLE Process, PDWORD_PTR ProcessAffinityMask,
+                            PDWORD_PTR SystemAffinityMask) {
+  cpu_set_t cpus;
+  UNREFERENCED_PARAMETER(Process);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+    SetLastError(ERROR_NOT_SUPPORTED);
+    return FALSE;
+  }
+  *ProcessAffinityMask = 0;
+  for (ULONG i = 0; i < sizeof(DWORD_PTR) * 8; ++i) {
+    if (CPU_ISSET(i, &cpus)) {
+      *ProcessAffinityMask |= (DWORD_PTR)1 << i;
+    }
+  }
+  *SystemAffinityMask = *ProcessAffinityMask;
+  return TRUE;
+}
+
+VOID RaiseException(DWORD ExceptionCode, DWORD ExceptionFlags,
+                    DWORD NumberOfArguments, const ULONG_PTR *Arguments) {
+  UNREFERENCED_PARAMETER(ExceptionFlags);
+  UNREFERENCED_PARAMETER(NumberOfArguments);
+  UNREFERENCED_PARAMETER(Arguments);
+  fprintf(stderr, "Exception 0x%x raised\n", ExceptionCode);
+  abort();
+}
+
+VOID GetCurrentProcessorNumberEx(PPROCESSOR_NUMBER ProcessorNumber) {
+  RtlZeroMemory(ProcessorNumber, sizeof(PROCESSOR_NUMBER));
+}
+
+ULONG g_HostHighestNumaNode;
+__thread USHORT g_HostNumaNode;
+
+BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber) {
+  *HighestNodeNumber = g_HostHighestNumaNode;
+  return TRUE;
+}
+
+BOOL GetNumaProcessorNodeEx(PPROCESSOR_NUMBER Processor, PUSHORT NodeNumber) {
+  UNREFERENCED_PARAMETER(Processor);
+  *NodeNumber = g_HostNumaNode;
+  return TRUE;
+}
+
+VOID GetSystemTimeAsFileTime(LPFILETIME SystemTimeAsFileTime) {
+  struct timespec now;
+  ULARGE_INTEGER time;
+  clock_gettime(CLOCK_REALTIME, &now);
+  // 100 nanoseconds intervals since January 1, 1601.
+  time.QuadPart = ((ULONGLONG)now.tv_sec + 11644473600ULL) * 10000000 +
+                  (ULONGLONG)now.tv_nsec / 100;
+  SystemTimeAsFileTime->dwLowDateTime = time.LowPart;
+  SystemTimeAsFileTime->dwHighDateTime = time.HighPart;
+}
+
+ULONGLONG GetTickCount64(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (ULONGLONG)now.tv_sec * 1000 + (ULONGLONG)now.tv_nsec / 1000000;
+}
+
+BOOL QueryPerformanceCounter(PLARGE_INTEGER PerformanceCount) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  PerformanceCount->QuadPart =
+      (LONGLONG)now.tv_sec * 1000000000 + (LONGLONG)now.tv_nsec;
+  return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(PLARGE_INTEGER Frequency) {
+  Frequency->QuadPart = 1000000000;
+  return TRUE;
+}
+
+DWORD GetCurrentThreadId(void) { return (DWORD)gettid(); }
+
+DWORD GetLastError(void) { return g_LastError; }
+
+VOID SetLastError(DWORD ErrorCode) { g_LastError = ErrorCode; }
+
+VOID Sleep(DWORD Milliseconds) { usleep((useconds_t)Milliseconds * 1000); }
+
+/////////////////// C runtime ///////////////////
+VOID OutputDebugStringA(LPCSTR OutputString) { fputs(OutputString, stderr); }
+
+VOID OutputDebugStringW(LPCWSTR OutputString) {
+  fprintf(stderr, "%ls", OutputString);
+}
+
+wchar_t *_wcsdup(const wchar_t *String) { return wcsdup(String); }
+
+int _wcsicmp(const wchar_t *String1, const wchar_t *String2) {
+  return wcscasecmp(String1, String2);
+}
+
+int _wcsnicmp(const wchar_t *String1, const wchar_t *String2, size_t Count) {
+  return wcsncasecmp(String1, String2, Count);
+}
+
+int _vscprintf(const char *Format, va_list Args) {
+  return vsnprintf(NULL, 0, Format, Args);
+}
+
+// The wide functions cannot measure their output, grow until it fits.
+int _vscwprintf(const wchar_t *Format, va_list Args) {
+  size_t size = 256;
+  for (;;) {
+    wchar_t *buffer = (wchar_t *)malloc(size * sizeof(wchar_t));
+    va_list args;
+    int length;
+    if (!buffer) {
+      return -1;
+    }
+    va_copy(args, Args);
+    length = vswprintf(buffer, size, Format, args);
+    va_end(args);
+    free(buffer);
+    if (length >= 0) {
+      return length;
+    }
+    if (size >= 1024 * 1024) {
+      return -1;
+    }
+    size *= 2;
+  }
+}
+
+int vsprintf_s(char *Buffer, size_t Size, const char *Format, va_list Args) {
+  return vsnprintf(Buffer, Size, Format, Args);
+}
+
+int vswprintf_s(wchar_t *Buffer, size_t Size, const wchar_t *Format,
+                va_list Args) {
+  return vswprintf(Buffer, Size, Format, Args);
+}
+
+int wcscpy_s(wchar_t *Destination, size_t Size, const wchar_t *Source) {
+  if (wcslen(Source) >= Size) {
+    return ERANGE;
+  }
+  wcscpy(Destination, Source);
+  return 0;
+}
+
+int wcscat_s(wchar_t *Destination, size_t Size, const wchar_t *Source) {
+  if (wcslen(Destination) + wcslen(Source) >= Size) {
+    return ERANGE;
+  }
+  wcscat(Destination, Source);
+  return 0;
+}
+
+int wcsncpy_s(wchar_t *Destination, size_t Size, const wchar_t *Source,
+              size_t Count) {
+  size_t length = wcsnlen(Source, Count);
+  int result = 0;
+  if (length >= Size) {
+    if (Count != _TRUNCATE || Size == 0) {
+      return ERANGE;
+    }
+    length = Size - 1;
+    result = STRUNCATE;
+  }
+  wmemcpy(Destination, Source, length);
+  Destination[length] = L'\0';
+  return result;
+}
+
+int memcpy_s(void *Destination, size_t Size, const void *Source,
+             size_t Count) {
+  if (Count > Size) {
+    return ERANGE;
+  }
+  memcpy(Destination, Source, Count);
+  return 0;
+}
+
+int memmove_s(void *Destination, size_t Size, const void *Source,
+              size_t Count) {
+  if (Count > Size) {
+    return ERANGE;
+  }
+  memmove(Destination, Source, Count);
+  return 0;
+}
+
+HRESULT StringCchVPrintfA(LPSTR Destination, size_t DestinationCount,
+                          LPCSTR Format, va_list Args) {
+  int length = vsnprintf(Destination, DestinationCount, Format, Args);
+  if (length < 0 || (size_t)length >= DestinationCount) {
+    return STRSAFE_E_INSUFFICIENT_BUFFER;
+  }
+  return S_OK;
+}
+
+HRESULT StringCbPrintfW(LPWSTR Destination, size_t DestinationSize,
+                        LPCWSTR Format, ...) {
+  size_t count = DestinationSize / sizeof(WCHAR);
+  va_list args;
+  int length;
+  va_start(args, Format);
+  length = vswprintf(Destination, count, Format, args);
+  va_end(args);
+  if (length < 0) {
+    // Truncated, vswprintf leaves the buffer unterminated.
+    if (count) {
+      Destination[count - 1] = L'\0';
+    }
+    return STRSAFE_E_INSUFFICIENT_BUFFER;
+  }
+  return S_OK;
+}
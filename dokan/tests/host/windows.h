@@ -0,0 +1,665 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Subset of the Windows SDK the library sources tested on the host use, so
+// that they build unchanged with a POSIX compiler. WCHAR is the 4 bytes
+// wchar_t of the host, which the sources never depend on. The functions are
+// implemented in win32.c.
+
+#ifndef DOKAN_TESTS_HOST_WINDOWS_H_
+#define DOKAN_TESTS_HOST_WINDOWS_H_
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <wctype.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/////////////////// Annotations ///////////////////
+#define WINAPI
+#define CALLBACK
+#define NTAPI
+#define __stdcall
+#define __cdecl
+#define __declspec(x)
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _Success_(x)
+#define _When_(a, b)
+#define _In_reads_(x)
+#define _In_reads_bytes_(x)
+#define _Out_writes_(x)
+#define _Out_writes_bytes_(x)
+#ifndef __cplusplus
+// Only used by C sources, the C++ library names variables __in.
+#define __in
+#endif
+#define DUMMYUNIONNAME
+#define UNREFERENCED_PARAMETER(x) ((void)(x))
+#define FORCEINLINE static inline
+
+/////////////////// Types ///////////////////
+#define VOID void
+#define CONST const
+typedef void *PVOID, *LPVOID, *HANDLE, *HINSTANCE, *HMODULE, **PHANDLE;
+typedef const void *LPCVOID;
+typedef int BOOL, *PBOOL, *LPBOOL;
+typedef unsigned char BOOLEAN, UCHAR, BYTE, *PUCHAR, *PBOOLEAN, *PBYTE, *LPBYTE;
+typedef char CHAR, CCHAR, *PCHAR, *LPSTR;
+typedef const char *LPCSTR, *PCSTR;
+typedef short SHORT;
+typedef unsigned short USHORT, WORD, *PUSHORT;
+typedef wchar_t WCHAR, *PWCHAR, *LPWSTR, *PWSTR;
+typedef const wchar_t *LPCWSTR, *PCWSTR, *LPCTSTR;
+typedef int INT;
+typedef unsigned int UINT;
+typedef int32_t LONG, *PLONG;
+typedef uint32_t ULONG, DWORD, *PULONG, *PDWORD, *LPDWORD;
+typedef int64_t LONG64, LONGLONG, INT64, *PLONG64;
+typedef uint64_t ULONG64, ULONGLONG, DWORD64, UINT64, *PULONG64, *PULONGLONG;
+typedef uintptr_t ULONG_PTR, UINT_PTR, DWORD_PTR, SIZE_T, *PULONG_PTR,
+    *PSIZE_T, *PDWORD_PTR;
+typedef intptr_t LONG_PTR, INT_PTR;
+typedef LONG NTSTATUS, HRESULT;
+typedef DWORD ACCESS_MASK, *PACCESS_MASK;
+typedef DWORD SECURITY_INFORMATION, *PSECURITY_INFORMATION;
+typedef PVOID PSECURITY_DESCRIPTOR, PSID;
+typedef size_t rsize_t;
+typedef VOID(CALLBACK *WAITORTIMERCALLBACKFUNC)(PVOID Context,
+                                                BOOLEAN TimerOrWaitFired);
+
+typedef union _LARGE_INTEGER {
+  struct {
+    DWORD LowPart;
+    LONG HighPart;
+  };
+  struct {
+    DWORD LowPart;
+    LONG HighPart;
+  } u;
+  LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef union _ULARGE_INTEGER {
+  struct {
+    DWORD LowPart;
+    DWORD HighPart;
+  };
+  ULONGLONG QuadPart;
+} ULARGE_INTEGER, *PULARGE_INTEGER;
+
+typedef struct _FILETIME {
+  DWORD dwLowDateTime;
+  DWORD dwHighDateTime;
+} FILETIME, *PFILETIME, *LPFILETIME;
+
+typedef struct _GUID {
+  DWORD Data1;
+  WORD Data2;
+  WORD Data3;
+  BYTE Data4[8];
+} GUID;
+
+typedef struct _LIST_ENTRY {
+  struct _LIST_ENTRY *Flink;
+  struct _LIST_ENTRY *Blink;
+} LIST_ENTRY, *PLIST_ENTRY;
+
+typedef struct _SINGLE_LIST_ENTRY {
+  struct _SINGLE_LIST_ENTRY *Next;
+} SINGLE_LIST_ENTRY, *PSINGLE_LIST_ENTRY;
+
+typedef struct _OVERLAPPED {
+  ULONG_PTR Internal;
+  ULONG_PTR InternalHigh;
+  union {
+    struct {
+      DWORD Offset;
+      DWORD OffsetHigh;
+    };
+    PVOID Pointer;
+  };
+  HANDLE hEvent;
+} OVERLAPPED, *LPOVERLAPPED;
+
+typedef struct _SECURITY_ATTRIBUTES {
+  DWORD nLength;
+  LPVOID lpSecurityDescriptor;
+  BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+#define MAX_PATH 260
+
+typedef struct _WIN32_FIND_DATAW {
+  DWORD dwFileAttributes;
+  FILETIME ftCreationTime;
+  FILETIME ftLastAccessTime;
+  FILETIME ftLastWriteTime;
+  DWORD nFileSizeHigh;
+  DWORD nFileSizeLow;
+  DWORD dwReserved0;
+  DWORD dwReserved1;
+  WCHAR cFileName[MAX_PATH];
+  WCHAR cAlternateFileName[14];
+} WIN32_FIND_DATAW, *PWIN32_FIND_DATAW, *LPWIN32_FIND_DATAW;
+
+typedef struct _WIN32_FIND_STREAM_DATA {
+  LARGE_INTEGER StreamSize;
+  WCHAR cStreamName[MAX_PATH + 36];
+} WIN32_FIND_STREAM_DATA, *PWIN32_FIND_STREAM_DATA;
+
+typedef struct _BY_HANDLE_FILE_INFORMATION {
+  DWORD dwFileAttributes;
+  FILETIME ftCreationTime;
+  FILETIME ftLastAccessTime;
+  FILETIME ftLastWriteTime;
+  DWORD dwVolumeSerialNumber;
+  DWORD nFileSizeHigh;
+  DWORD nFileSizeLow;
+  DWORD nNumberOfLinks;
+  DWORD nFileIndexHigh;
+  DWORD nFileIndexLow;
+} BY_HANDLE_FILE_INFORMATION, *PBY_HANDLE_FILE_INFORMATION,
+    *LPBY_HANDLE_FILE_INFORMATION;
+
+typedef struct _FILE_ID_128 {
+  BYTE Identifier[16];
+} FILE_ID_128, *PFILE_ID_128;
+
+typedef struct _FILE_ID_EXTD_DIR_INFO {
+  ULONG NextEntryOffset;
+  ULONG FileIndex;
+  LARGE_INTEGER CreationTime;
+  LARGE_INTEGER LastAccessTime;
+  LARGE_INTEGER LastWriteTime;
+  LARGE_INTEGER ChangeTime;
+  LARGE_INTEGER EndOfFile;
+  LARGE_INTEGER AllocationSize;
+  ULONG FileAttributes;
+  ULONG FileNameLength;
+  ULONG EaSize;
+  ULONG ReparsePointTag;
+  FILE_ID_128 FileId;
+  WCHAR FileName[1];
+} FILE_ID_EXTD_DIR_INFO, *PFILE_ID_EXTD_DIR_INFO;
+
+typedef struct _PROCESSOR_NUMBER {
+  WORD Group;
+  BYTE Number;
+  BYTE Reserved;
+} PROCESSOR_NUMBER, *PPROCESSOR_NUMBER;
+
+/////////////////// Macros ///////////////////
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define MAXULONG 0xFFFFFFFFUL
+#define MAXLONGLONG 0x7FFFFFFFFFFFFFFFLL
+#define MAXULONG64 ((ULONG64)~((ULONG64)0))
+#define MEMORY_ALLOCATION_ALIGNMENT 16
+#define FIELD_OFFSET(Type, Field) ((LONG)offsetof(Type, Field))
+#define CONTAINING_RECORD(Address, Type, Field)                                \
+  ((Type *)((PCHAR)(Address)-offsetof(Type, Field)))
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define ZeroMemory RtlZeroMemory
+#define RtlCopyMemory memcpy
+#define CopyMemory memcpy
+#define RtlMoveMemory memmove
+#define MoveMemory memmove
+#define RtlFillMemory(Destination, Length, Fill)                               \
+  memset((Destination), (Fill), (Length))
+#define FillMemory RtlFillMemory
+#ifndef NOMINMAX
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#define _countof(Array) (sizeof(Array) / sizeof((Array)[0]))
+static inline BOOLEAN _BitScanReverse(PULONG Index, ULONG Mask) {
+  if (!Mask) {
+    return FALSE;
+  }
+  *Index = 31 - (ULONG)__builtin_clz(Mask);
+  return TRUE;
+}
+#define S_OK ((HRESULT)0L)
+#define SUCCEEDED(hr) ((HRESULT)(hr) >= 0)
+#define FAILED(hr) ((HRESULT)(hr) < 0)
+
+#define ERROR_SUCCESS 0L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_OUTOFMEMORY 14L
+#define ERROR_HANDLE_EOF 38L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_SUCH_DEVICE 433L
+#define ERROR_OPERATION_ABORTED 995L
+#define ERROR_IO_PENDING 997L
+#define ERROR_NO_SYSTEM_RESOURCES 1450L
+#define ERROR_TIMEOUT 1460L
+
+#define DELETE 0x00010000
+#define READ_CONTROL 0x00020000
+#define SYNCHRONIZE 0x00100000
+#define STANDARD_RIGHTS_REQUIRED 0x000F0000
+#define STANDARD_RIGHTS_READ READ_CONTROL
+#define STANDARD_RIGHTS_WRITE READ_CONTROL
+#define STANDARD_RIGHTS_EXECUTE READ_CONTROL
+#define MAXIMUM_ALLOWED 0x02000000
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define GENERIC_EXECUTE 0x20000000
+#define GENERIC_ALL 0x10000000
+#define FILE_READ_DATA 0x0001
+#define FILE_LIST_DIRECTORY 0x0001
+#define FILE_WRITE_DATA 0x0002
+#define FILE_APPEND_DATA 0x0004
+#define FILE_READ_EA 0x0008
+#define FILE_WRITE_EA 0x0010
+#define FILE_EXECUTE 0x0020
+#define FILE_DELETE_CHILD 0x0040
+#define FILE_READ_ATTRIBUTES 0x0080
+#define FILE_WRITE_ATTRIBUTES 0x0100
+#define FILE_ALL_ACCESS (STANDARD_RIGHTS_REQUIRED | SYNCHRONIZE | 0x1FF)
+#define FILE_GENERIC_READ                                                      \
+  (STANDARD_RIGHTS_READ | FILE_READ_DATA | FILE_READ_ATTRIBUTES |             \
+   FILE_READ_EA | SYNCHRONIZE)
+#define FILE_GENERIC_WRITE                                                     \
+  (STANDARD_RIGHTS_WRITE | FILE_WRITE_DATA | FILE_WRITE_ATTRIBUTES |          \
+   FILE_WRITE_EA | FILE_APPEND_DATA | SYNCHRONIZE)
+#define FILE_GENERIC_EXECUTE                                                   \
+  (STANDARD_RIGHTS_EXECUTE | FILE_READ_ATTRIBUTES | FILE_EXECUTE | SYNCHRONIZE)
+
+#define FILE_SHARE_READ 0x00000001
+#define FILE_SHARE_WRITE 0x00000002
+#define FILE_SHARE_DELETE 0x00000004
+#define CREATE_NEW 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define OPEN_ALWAYS 4
+#define TRUNCATE_EXISTING 5
+#define FILE_FLAG_WRITE_THROUGH 0x80000000
+#define FILE_FLAG_OVERLAPPED 0x40000000
+#define FILE_FLAG_NO_BUFFERING 0x20000000
+#define FILE_FLAG_RANDOM_ACCESS 0x10000000
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define FILE_FLAG_DELETE_ON_CLOSE 0x04000000
+#define FILE_FLAG_BACKUP_SEMANTICS 0x02000000
+#define FILE_FLAG_SESSION_AWARE 0x00800000
+#define FILE_FLAG_OPEN_REPARSE_POINT 0x00200000
+#define FILE_BEGIN 0
+#define INVALID_SET_FILE_POINTER ((DWORD)-1)
+
+#define FILE_NOTIFY_CHANGE_FILE_NAME 0x00000001
+#define FILE_NOTIFY_CHANGE_DIR_NAME 0x00000002
+#define FILE_NOTIFY_CHANGE_ATTRIBUTES 0x00000004
+#define FILE_ACTION_ADDED 0x00000001
+#define FILE_ACTION_REMOVED 0x00000002
+#define FILE_ACTION_MODIFIED 0x00000003
+#define FILE_ACTION_RENAMED_OLD_NAME 0x00000004
+#define FILE_ACTION_RENAMED_NEW_NAME 0x00000005
+
+#define FILE_CASE_SENSITIVE_SEARCH 0x00000001
+#define FILE_CASE_PRESERVED_NAMES 0x00000002
+#define FILE_UNICODE_ON_DISK 0x00000004
+#define FILE_SUPPORTS_REMOTE_STORAGE 0x00000100
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+#define EXCEPTION_NONCONTINUABLE 0x1
+
+#define FILE_ATTRIBUTE_READONLY 0x00000001
+#define FILE_ATTRIBUTE_DIRECTORY 0x00000010
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_RELEASE 0x00008000
+#define MEM_LARGE_PAGES 0x20000000
+#define PAGE_READWRITE 0x04
+#define NUMA_NO_PREFERRED_NODE ((DWORD)-1)
+#define SE_LOCK_MEMORY_NAME L"SeLockMemoryPrivilege"
+
+#define CTL_CODE(DeviceType, Function, Method, Access)                         \
+  (((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+#define FILE_DEVICE_FILE_SYSTEM 0x00000009
+#define FILE_DEVICE_UNKNOWN 0x00000022
+#define METHOD_BUFFERED 0
+#define METHOD_IN_DIRECT 1
+#define METHOD_OUT_DIRECT 2
+#define METHOD_NEITHER 3
+#define FILE_ANY_ACCESS 0
+
+/////////////////// Synchronization ///////////////////
+typedef struct _RTL_CRITICAL_SECTION {
+  pthread_mutex_t Mutex;
+} CRITICAL_SECTION, *PCRITICAL_SECTION, *LPCRITICAL_SECTION;
+
+typedef struct _RTL_SRWLOCK {
+  pthread_rwlock_t Lock;
+} SRWLOCK, *PSRWLOCK;
+#define SRWLOCK_INIT                                                           \
+  { PTHREAD_RWLOCK_INITIALIZER }
+
+// Waking increments Generation under Mutex, so that a waiter that released
+// its SRW lock cannot miss it.
+typedef struct _RTL_CONDITION_VARIABLE {
+  pthread_mutex_t Mutex;
+  pthread_cond_t Condition;
+  ULONG Generation;
+} CONDITION_VARIABLE, *PCONDITION_VARIABLE;
+#define CONDITION_VARIABLE_LOCKMODE_SHARED 0x1
+
+VOID InitializeCriticalSection(PCRITICAL_SECTION CriticalSection);
+BOOL InitializeCriticalSectionAndSpinCount(PCRITICAL_SECTION CriticalSection,
+                                           DWORD SpinCount);
+VOID EnterCriticalSection(PCRITICAL_SECTION CriticalSection);
+VOID LeaveCriticalSection(PCRITICAL_SECTION CriticalSection);
+VOID DeleteCriticalSection(PCRITICAL_SECTION CriticalSection);
+
+VOID InitializeSRWLock(PSRWLOCK Lock);
+VOID AcquireSRWLockExclusive(PSRWLOCK Lock);
+VOID ReleaseSRWLockExclusive(PSRWLOCK Lock);
+VOID AcquireSRWLockShared(PSRWLOCK Lock);
+VOID ReleaseSRWLockShared(PSRWLOCK Lock);
+
+VOID InitializeConditionVariable(PCONDITION_VARIABLE ConditionVariable);
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE ConditionVariable,
+                               PSRWLOCK Lock, DWORD Milliseconds, ULONG Flags);
+VOID WakeConditionVariable(PCONDITION_VARIABLE ConditionVariable);
+VOID WakeAllConditionVariable(PCONDITION_VARIABLE ConditionVariable);
+
+// Handles of threads and events. Threads can only be waited on without
+// timeout, and only once before CloseHandle.
+#define WAIT_OBJECT_0 0x00000000L
+#define WAIT_TIMEOUT 258L
+#define WT_EXECUTEONLYONCE 0x00000008
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES EventAttributes, BOOL ManualReset,
+                    BOOL InitialState, LPCWSTR Name);
+#define CreateEvent CreateEventW
+BOOL SetEvent(HANDLE Event);
+BOOL ResetEvent(HANDLE Event);
+DWORD WaitForSingleObject(HANDLE Handle, DWORD Milliseconds);
+BOOL CloseHandle(HANDLE Object);
+// Waits are not emulated, registering one fails.
+BOOL RegisterWaitForSingleObject(PHANDLE NewWaitObject, HANDLE Object,
+                                 WAITORTIMERCALLBACKFUNC Callback,
+                                 PVOID Context, ULONG Milliseconds,
+                                 ULONG Flags);
+BOOL UnregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent);
+
+#define InterlockedIncrement(Target)                                           \
+  __atomic_add_fetch((Target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(Target)                                           \
+  __atomic_sub_fetch((Target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedIncrement64 InterlockedIncrement
+#define InterlockedDecrement64 InterlockedDecrement
+#define InterlockedAdd(Target, Value)                                          \
+  __atomic_add_fetch((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedAdd64 InterlockedAdd
+#define InterlockedExchangeAdd(Target, Value)                                  \
+  __atomic_fetch_add((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchangeAdd64 InterlockedExchangeAdd
+#define InterlockedExchange(Target, Value)                                     \
+  __atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedExchange64 InterlockedExchange
+#define InterlockedExchangePointer InterlockedExchange
+#define InterlockedOr(Target, Value)                                           \
+  __atomic_fetch_or((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(Target, Exchange, Comparand)                \
+  __sync_val_compare_and_swap((Target), (Comparand), (Exchange))
+#define InterlockedCompareExchange64 InterlockedCompareExchange
+#define InterlockedCompareExchangePointer InterlockedCompareExchange
+#define MemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define YieldProcessor() ((void)0)
+#define ReadNoFence(Source) __atomic_load_n((Source), __ATOMIC_RELAXED)
+#define ReadAcquire(Source) __atomic_load_n((Source), __ATOMIC_ACQUIRE)
+#define WriteNoFence(Destination, Value)                                       \
+  __atomic_store_n((Destination), (Value), __ATOMIC_RELAXED)
+#define WriteRelease(Destination, Value)                                       \
+  __atomic_store_n((Destination), (Value), __ATOMIC_RELEASE)
+#define ReadNoFence64 ReadNoFence
+#define ReadAcquire64 ReadAcquire
+#define WriteNoFence64 WriteNoFence
+#define WriteRelease64 WriteRelease
+
+/////////////////// Interlocked singly linked lists ///////////////////
+// Protected by a lock instead of being lock-free, which only changes the
+// performance.
+typedef struct _SLIST_ENTRY {
+  struct _SLIST_ENTRY *Next;
+} SLIST_ENTRY, *PSLIST_ENTRY;
+
+typedef struct _SLIST_HEADER {
+  pthread_mutex_t Lock;
+  PSLIST_ENTRY First;
+  USHORT Depth;
+} SLIST_HEADER, *PSLIST_HEADER;
+
+VOID InitializeSListHead(PSLIST_HEADER ListHead);
+PSLIST_ENTRY InterlockedPushEntrySList(PSLIST_HEADER ListHead,
+                                       PSLIST_ENTRY ListEntry);
+PSLIST_ENTRY InterlockedPopEntrySList(PSLIST_HEADER ListHead);
+PSLIST_ENTRY InterlockedFlushSList(PSLIST_HEADER ListHead);
+USHORT QueryDepthSList(PSLIST_HEADER ListHead);
+
+/////////////////// Threads ///////////////////
+typedef DWORD(WINAPI *LPTHREAD_START_ROUTINE)(LPVOID Parameter);
+
+HANDLE CreateThread(LPSECURITY_ATTRIBUTES ThreadAttributes, SIZE_T StackSize,
+                    LPTHREAD_START_ROUTINE StartAddress, LPVOID Parameter,
+                    DWORD CreationFlags, LPDWORD ThreadId);
+
+/////////////////// Fiber local storage ///////////////////
+// Backed by pthread keys, the callbacks run when a thread exits.
+#define FLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
+typedef VOID(WINAPI *PFLS_CALLBACK_FUNCTION)(PVOID FlsData);
+
+DWORD FlsAlloc(PFLS_CALLBACK_FUNCTION Callback);
+BOOL FlsFree(DWORD FlsIndex);
+PVOID FlsGetValue(DWORD FlsIndex);
+BOOL FlsSetValue(DWORD FlsIndex, PVOID FlsData);
+
+/////////////////// Thread local storage ///////////////////
+#define TLS_OUT_OF_INDEXES ((DWORD)0xFFFFFFFF)
+
+DWORD TlsAlloc(void);
+BOOL TlsFree(DWORD TlsIndex);
+PVOID TlsGetValue(DWORD TlsIndex);
+BOOL TlsSetValue(DWORD TlsIndex, PVOID TlsValue);
+
+/////////////////// Thread pool ///////////////////
+// One process wide pool, whatever the PTP_POOL, that starts a thread whenever
+// a callback is queued and no thread is idle, like the system pool grows for
+// callbacks that block. The threads are never stopped. Timers fire once
+// their due time passes, unless g_HostTimersStopped is set. I/O objects
+// cannot be created, the host has no device to complete their I/O.
+typedef struct _TP_POOL *PTP_POOL;
+typedef struct _TP_WORK *PTP_WORK;
+typedef struct _TP_TIMER *PTP_TIMER;
+typedef struct _TP_WAIT *PTP_WAIT;
+typedef struct _TP_IO *PTP_IO;
+typedef struct _TP_CLEANUP_GROUP *PTP_CLEANUP_GROUP;
+typedef struct _TP_CALLBACK_INSTANCE *PTP_CALLBACK_INSTANCE;
+typedef struct _TP_CALLBACK_ENVIRON {
+  PTP_POOL Pool;
+  PTP_CLEANUP_GROUP CleanupGroup;
+} TP_CALLBACK_ENVIRON, *PTP_CALLBACK_ENVIRON;
+typedef VOID(CALLBACK *PTP_WORK_CALLBACK)(PTP_CALLBACK_INSTANCE Instance,
+                                          PVOID Context, PTP_WORK Work);
+typedef VOID(CALLBACK *PTP_TIMER_CALLBACK)(PTP_CALLBACK_INSTANCE Instance,
+                                           PVOID Context, PTP_TIMER Timer);
+typedef VOID(CALLBACK *PTP_WIN32_IO_CALLBACK)(
+    PTP_CALLBACK_INSTANCE Instance, PVOID Context, PVOID Overlapped,
+    ULONG IoResult, ULONG_PTR NumberOfBytesTransferred, PTP_IO Io);
+typedef VOID(CALLBACK *PTP_SIMPLE_CALLBACK)(PTP_CALLBACK_INSTANCE Instance,
+                                            PVOID Context);
+
+typedef VOID(CALLBACK *PTP_CLEANUP_GROUP_CANCEL_CALLBACK)(
+    PVOID ObjectContext, PVOID CleanupContext);
+
+PTP_POOL CreateThreadpool(PVOID Reserved);
+VOID CloseThreadpool(PTP_POOL Pool);
+VOID InitializeThreadpoolEnvironment(PTP_CALLBACK_ENVIRON CallbackEnvironment);
+VOID SetThreadpoolCallbackPool(PTP_CALLBACK_ENVIRON CallbackEnvironment,
+                               PTP_POOL Pool);
+VOID SetThreadpoolCallbackCleanupGroup(
+    PTP_CALLBACK_ENVIRON CallbackEnvironment, PTP_CLEANUP_GROUP CleanupGroup,
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CleanupGroupCancelCallback);
+VOID DestroyThreadpoolEnvironment(PTP_CALLBACK_ENVIRON CallbackEnvironment);
+PTP_CLEANUP_GROUP CreateThreadpoolCleanupGroup(void);
+VOID CloseThreadpoolCleanupGroupMembers(PTP_CLEANUP_GROUP CleanupGroup,
+                                        BOOL CancelPendingCallbacks,
+                                        PVOID CleanupContext);
+VOID CloseThreadpoolCleanupGroup(PTP_CLEANUP_GROUP CleanupGroup);
+PTP_WORK CreateThreadpoolWork(PTP_WORK_CALLBACK Callback, PVOID Context,
+                              PTP_CALLBACK_ENVIRON CallbackEnvironment);
+VOID SubmitThreadpoolWork(PTP_WORK Work);
+VOID WaitForThreadpoolWorkCallbacks(PTP_WORK Work,
+                                    BOOL CancelPendingCallbacks);
+VOID CloseThreadpoolWork(PTP_WORK Work);
+PTP_TIMER CreateThreadpoolTimer(PTP_TIMER_CALLBACK Callback, PVOID Context,
+                                PTP_CALLBACK_ENVIRON CallbackEnvironment);
+VOID SetThreadpoolTimer(PTP_TIMER Timer, PFILETIME DueTime, DWORD Period,
+                        DWORD WindowLength);
+VOID WaitForThreadpoolTimerCallbacks(PTP_TIMER Timer,
+                                     BOOL CancelPendingCallbacks);
+VOID CloseThreadpoolTimer(PTP_TIMER Timer);
+// Set by the tests to keep the timers from firing, their expirations are then
+// delayed until it is cleared.
+extern BOOL g_HostTimersStopped;
+PTP_IO CreateThreadpoolIo(HANDLE File, PTP_WIN32_IO_CALLBACK Callback,
+                          PVOID Context,
+                          PTP_CALLBACK_ENVIRON CallbackEnvironment);
+VOID StartThreadpoolIo(PTP_IO Io);
+VOID CancelThreadpoolIo(PTP_IO Io);
+VOID WaitForThreadpoolIoCallbacks(PTP_IO Io, BOOL CancelPendingCallbacks);
+VOID CloseThreadpoolIo(PTP_IO Io);
+// Runs the callback on a new detached thread.
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK Callback, PVOID Context,
+                                 PTP_CALLBACK_ENVIRON CallbackEnvironment);
+
+/////////////////// Files and devices ///////////////////
+// There are none on the host, opening one fails and so do the calls that
+// would need one.
+HANDLE CreateFileW(LPCWSTR FileName, DWORD DesiredAccess, DWORD ShareMode,
+                   LPSECURITY_ATTRIBUTES SecurityAttributes,
+                   DWORD CreationDisposition, DWORD FlagsAndAttributes,
+                   HANDLE TemplateFile);
+#define CreateFile CreateFileW
+BOOL ReadFile(HANDLE File, LPVOID Buffer, DWORD NumberOfBytesToRead,
+              LPDWORD NumberOfBytesRead, LPOVERLAPPED Overlapped);
+BOOL WriteFile(HANDLE File, LPCVOID Buffer, DWORD NumberOfBytesToWrite,
+               LPDWORD NumberOfBytesWritten, LPOVERLAPPED Overlapped);
+DWORD SetFilePointer(HANDLE File, LONG DistanceToMove,
+                     PLONG DistanceToMoveHigh, DWORD MoveMethod);
+BOOL DeviceIoControl(HANDLE Device, DWORD IoControlCode, LPVOID InBuffer,
+                     DWORD InBufferSize, LPVOID OutBuffer, DWORD OutBufferSize,
+                     LPDWORD BytesReturned, LPOVERLAPPED Overlapped);
+BOOL CancelIoEx(HANDLE File, LPOVERLAPPED Overlapped);
+DWORD QueryDosDeviceW(LPCWSTR DeviceName, LPWSTR TargetPath, DWORD Max);
+#define QueryDosDevice QueryDosDeviceW
+DWORD GetLogicalDrives(void);
+
+/////////////////// Memory ///////////////////
+// Reserved regions are mapped without access and committed by changing the
+// protection of their pages.
+PVOID VirtualAlloc(PVOID Address, SIZE_T Size, DWORD AllocationType,
+                   DWORD Protect);
+PVOID VirtualAllocExNuma(HANDLE Process, PVOID Address, SIZE_T Size,
+                         DWORD AllocationType, DWORD Protect, DWORD Node);
+BOOL VirtualFree(PVOID Address, SIZE_T Size, DWORD FreeType);
+SIZE_T GetLargePageMinimum(void);
+
+void *_aligned_malloc(size_t Size, size_t Alignment);
+void _aligned_free(void *Memory);
+#define _malloca(Size) malloc(Size)
+#define _freea(Memory) free(Memory)
+
+/////////////////// System ///////////////////
+HANDLE GetCurrentProcess(void);
+DWORD GetCurrentProcessId(void);
+BOOL GetProcessAffinityMask(HANDLE Process, PDWORD_PTR ProcessAffinityMask,
+                            PDWORD_PTR SystemAffinityMask);
+// Prints the exception code and aborts, there is no handler to run.
+VOID RaiseException(DWORD ExceptionCode, DWORD ExceptionFlags,
+                    DWORD NumberOfArguments, const ULONG_PTR *Arguments);
+VOID GetCurrentProcessorNumberEx(PPROCESSOR_NUMBER ProcessorNumber);
+BOOL GetNumaHighestNodeNumber(PULONG HighestNodeNumber);
+BOOL GetNumaProcessorNodeEx(PPROCESSOR_NUMBER Processor, PUSHORT NodeNumber);
+// Set by the tests to emulate a NUMA system of g_HostHighestNumaNode + 1 nodes
+// where the calling thread runs on g_HostNumaNode.
+#define HOST_NUMA_EMULATION
+extern ULONG g_HostHighestNumaNode;
+extern __thread USHORT g_HostNumaNode;
+VOID GetSystemTimeAsFileTime(LPFILETIME SystemTimeAsFileTime);
+ULONGLONG GetTickCount64(void);
+BOOL QueryPerformanceCounter(PLARGE_INTEGER PerformanceCount);
+BOOL QueryPerformanceFrequency(PLARGE_INTEGER Frequency);
+DWORD GetCurrentThreadId(void);
+DWORD GetLastError(void);
+VOID SetLastError(DWORD ErrorCode);
+VOID Sleep(DWORD Milliseconds);
+
+/////////////////// C runtime ///////////////////
+VOID OutputDebugStringA(LPCSTR OutputString);
+VOID OutputDebugStringW(LPCWSTR OutputString);
+wchar_t *_wcsdup(const wchar_t *String);
+int _wcsicmp(const wchar_t *String1, const wchar_t *String2);
+int _wcsnicmp(const wchar_t *String1, const wchar_t *String2, size_t Count);
+int _vscprintf(const char *Format, va_list Args);
+int _vscwprintf(const wchar_t *Format, va_list Args);
+int vsprintf_s(char *Buffer, size_t Size, const char *Format, va_list Args);
+int vswprintf_s(wchar_t *Buffer, size_t Size, const wchar_t *Format,
+                va_list Args);
+int wcscpy_s(wchar_t *Destination, size_t Size, const wchar_t *Source);
+int wcscat_s(wchar_t *Destination, size_t Size, const wchar_t *Source);
+#define _TRUNCATE ((size_t)-1)
+#define STRUNCATE 80
+int wcsncpy_s(wchar_t *Destination, size_t Size, const wchar_t *Source,
+              size_t Count);
+int memcpy_s(void *Destination, size_t Size, const void *Source, size_t Count);
+int memmove_s(void *Destination, size_t Size, const void *Source,
+              size_t Count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DOKAN_TESTS_HOST_WINDOWS_H_
@@ -0,0 +1,147 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// The events are laid out like the driver lays them out: the file name right
+// after the operation, and for a create the object name and type strings of
+// the access state, left empty, before it.
+
+#include "memory_events.h"
+
+static PEVENT_CONTEXT AllocateEvent(ULONG64 OpenKey, UCHAR MajorFunction,
+                                    ULONG Length) {
+  PEVENT_CONTEXT eventContext;
+
+  Length = max(Length, (ULONG)sizeof(EVENT_CONTEXT));
+  eventContext = (PEVENT_CONTEXT)malloc(Length);
+  if (!eventContext) {
+    return NULL;
+  }
+  ZeroMemory(eventContext, Length);
+  eventContext->Length = Length;
+  eventContext->ProcessId = GetCurrentProcessId();
+  eventContext->MajorFunction = MajorFunction;
+  eventContext->Context = OpenKey;
+  return eventContext;
+}
+
+PEVENT_CONTEXT BuildCreateEvent(ULONG64 OpenKey, LPCWSTR FileName) {
+  ULONG nameLength = (ULONG)(wcslen(FileName) * sizeof(WCHAR));
+  ULONG emptyStringLength =
+      (ULONG)sizeof(DOKAN_UNICODE_STRING_INTERMEDIATE);
+  ULONG objectNameOffset = (ULONG)sizeof(CREATE_CONTEXT);
+  ULONG objectTypeOffset = objectNameOffset + emptyStringLength;
+  ULONG fileNameOffset = objectTypeOffset + emptyStringLength;
+  PEVENT_CONTEXT eventContext = AllocateEvent(
+      OpenKey, IRP_MJ_CREATE,
+      (ULONG)FIELD_OFFSET(EVENT_CONTEXT, Operation.Create) + fileNameOffset +
+          nameLength + sizeof(WCHAR));
+  PCREATE_CONTEXT create;
+
+  if (!eventContext) {
+    return NULL;
+  }
+  create = &eventContext->Operation.Create;
+  create->SecurityContext.AccessState.UnicodeStringObjectNameOffset =
+      objectNameOffset;
+  create->SecurityContext.AccessState.UnicodeStringObjectTypeOffset =
+      objectTypeOffset;
+  create->SecurityContext.DesiredAccess = FILE_GENERIC_READ;
+  create->FileAttributes = FILE_ATTRIBUTE_NORMAL;
+  create->CreateOptions = (FILE_OPEN << 24) | FILE_NON_DIRECTORY_FILE;
+  create->ShareAccess = FILE_SHARE_READ;
+  create->FileNameLength = nameLength;
+  create->FileNameOffset = fileNameOffset;
+  CopyMemory((PCHAR)create + fileNameOffset, FileName, nameLength);
+  return eventContext;
+}
+
+PEVENT_CONTEXT BuildReadEvent(ULONG64 OpenKey, LPCWSTR FileName,
+                              ULONG Length, LONGLONG Offset) {
+  ULONG nameLength = (ULONG)(wcslen(FileName) * sizeof(WCHAR));
+  PEVENT_CONTEXT eventContext = AllocateEvent(
+      OpenKey, IRP_MJ_READ,
+      (ULONG)FIELD_OFFSET(EVENT_CONTEXT, Operation.Read.FileName) +
+          nameLength + sizeof(WCHAR));
+
+  if (!eventContext) {
+    return NULL;
+  }
+  eventContext->Operation.Read.ByteOffset.QuadPart = Offset;
+  eventContext->Operation.Read.BufferLength = Length;
+  eventContext->Operation.Read.FileNameLength = nameLength;
+  CopyMemory(eventContext->Operation.Read.FileName, FileName, nameLength);
+  return eventContext;
+}
+
+PEVENT_CONTEXT BuildCleanupEvent(ULONG64 OpenKey, LPCWSTR FileName) {
+  ULONG nameLength = (ULONG)(wcslen(FileName) * sizeof(WCHAR));
+  PEVENT_CONTEXT eventContext = AllocateEvent(
+      OpenKey, IRP_MJ_CLEANUP,
+      (ULONG)FIELD_OFFSET(EVENT_CONTEXT, Operation.Cleanup.FileName) +
+          nameLength + sizeof(WCHAR));
+
+  if (!eventContext) {
+    return NULL;
+  }
+  eventContext->Operation.Cleanup.FileNameLength = nameLength;
+  CopyMemory(eventContext->Operation.Cleanup.FileName, FileName, nameLength);
+  return eventContext;
+}
+
+PEVENT_CONTEXT BuildCloseEvent(ULONG64 OpenKey, LPCWSTR FileName) {
+  ULONG nameLength = (ULONG)(wcslen(FileName) * sizeof(WCHAR));
+  PEVENT_CONTEXT eventContext = AllocateEvent(
+      OpenKey, IRP_MJ_CLOSE,
+      (ULONG)FIELD_OFFSET(EVENT_CONTEXT, Operation.Close.FileName) +
+          nameLength + sizeof(WCHAR));
+
+  if (!eventContext) {
+    return NULL;
+  }
+  eventContext->Operation.Close.FileNameLength = nameLength;
+  CopyMemory(eventContext->Operation.Close.FileName, FileName, nameLength);
+  return eventContext;
+}
+
+static BOOL SubmitEvent(DOKAN_HANDLE DokanInstance,
+                        PEVENT_CONTEXT EventContext) {
+  BOOL submitted =
+      EventContext && DokanMemoryTransportSubmit(DokanInstance, EventContext);
+  free(EventContext);
+  return submitted;
+}
+
+BOOL SubmitOpenReadClose(DOKAN_HANDLE DokanInstance, ULONG64 OpenKey,
+                         LPCWSTR FileName, ULONG ReadCount,
+                         ULONG ReadLength) {
+  if (!SubmitEvent(DokanInstance, BuildCreateEvent(OpenKey, FileName))) {
+    return FALSE;
+  }
+  for (ULONG i = 0; i < ReadCount; ++i) {
+    if (!SubmitEvent(DokanInstance,
+                     BuildReadEvent(OpenKey, FileName, ReadLength,
+                                    (LONGLONG)i * ReadLength))) {
+      return FALSE;
+    }
+  }
+  return SubmitEvent(DokanInstance, BuildCleanupEvent(OpenKey, FileName)) &&
+         SubmitEvent(DokanInstance, BuildCloseEvent(OpenKey, FileName));
+}
@@ -0,0 +1,40 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DOKAN_TESTS_MEMORY_EVENTS_H_
+#define DOKAN_TESTS_MEMORY_EVENTS_H_
+
+#include "../dokani.h"
+
+// Builds the events the driver sends for an open of FileName, to give to
+// DokanMemoryTransportSubmit. OpenKey is the Context identifying the open.
+// The events are freed with free().
+PEVENT_CONTEXT BuildCreateEvent(ULONG64 OpenKey, LPCWSTR FileName);
+PEVENT_CONTEXT BuildReadEvent(ULONG64 OpenKey, LPCWSTR FileName,
+                              ULONG Length, LONGLONG Offset);
+PEVENT_CONTEXT BuildCleanupEvent(ULONG64 OpenKey, LPCWSTR FileName);
+PEVENT_CONTEXT BuildCloseEvent(ULONG64 OpenKey, LPCWSTR FileName);
+
+// Submits the create, ReadCount reads of ReadLength bytes, the cleanup and
+// the close of one open.
+BOOL SubmitOpenReadClose(DOKAN_HANDLE DokanInstance, ULONG64 OpenKey,
+                         LPCWSTR FileName, ULONG ReadCount, ULONG ReadLength);
+
+#endif // DOKAN_TESTS_MEMORY_EVENTS_H_
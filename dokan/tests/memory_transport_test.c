@@ -0,0 +1,250 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+// Runs the library against the memory transport standing for the driver:
+// creates, reads, cleanups and closes of many opens go through the pull
+// threads, the pools, the dispatching and the replies, with and without IPC
+// batching. Every event must be completed once, the events of an open must
+// see the context its create gave, and closing the file system must stop the
+// pull threads. With asynchronous dispatch, the reads are completed from
+// another thread once all of them are pending, with the timers stopped so
+// that a reply left for the reply batch timer never gets sent. Overlapped
+// pulls are posted on the memory transport, which completes them on the
+// thread pool: opens submitted in waves, with the timers stopped, are only
+// pulled if the harvested pulls are posted again and only complete if the
+// last reply of a wave is sent without waiting for another pull.
+
+#include "memory_events.h"
+#include "test.h"
+
+ULONG g_TestFailures;
+
+#define OPEN_COUNT 64
+#define READS_PER_OPEN 8
+#define READ_LENGTH 512
+#define OPEN_KEY(Index) ((ULONG64)((Index) + 1) << 4)
+
+static volatile LONG g_Creates;
+static volatile LONG g_Reads;
+static volatile LONG g_Cleanups;
+static volatile LONG g_Closes;
+static volatile LONG g_WrongContexts;
+
+// Reads returned pending, completed by CompletePendingReads.
+static PDOKAN_FILE_INFO g_PendingReads[OPEN_COUNT * READS_PER_OPEN];
+static volatile LONG g_PendingReadCount;
+
+// The context of an open is its file name index plus one, so that the other
+// events can check they were given the open of their create.
+static ULONG64 GetFileContext(LPCWSTR FileName) {
+  return wcstoul(FileName + wcslen(L"\\file"), NULL, 10) + 1;
+}
+
+static VOID CheckFileContext(LPCWSTR FileName,
+                             PDOKAN_FILE_INFO DokanFileInfo) {
+  if (DokanFileInfo->Context != GetFileContext(FileName)) {
+    InterlockedIncrement(&g_WrongContexts);
+  }
+}
+
+static NTSTATUS DOKAN_CALLBACK TestCreateFile(
+    LPCWSTR FileName, PDOKAN_IO_SECURITY_CONTEXT SecurityContext,
+    ACCESS_MASK DesiredAccess, ULONG FileAttributes, ULONG ShareAccess,
+    ULONG CreateDisposition, ULONG CreateOptions,
+    PDOKAN_FILE_INFO DokanFileInfo) {
+  UNREFERENCED_PARAMETER(SecurityContext);
+  UNREFERENCED_PARAMETER(DesiredAccess);
+  UNREFERENCED_PARAMETER(FileAttributes);
+  UNREFERENCED_PARAMETER(ShareAccess);
+  UNREFERENCED_PARAMETER(CreateOptions);
+  if (CreateDisposition != FILE_OPEN) {
+    return STATUS_INVALID_PARAMETER;
+  }
+  DokanFileInfo->Context = GetFileContext(FileName);
+  InterlockedIncrement(&g_Creates);
+  return STATUS_SUCCESS;
+}
+
+static NTSTATUS DOKAN_CALLBACK TestReadFile(LPCWSTR FileName, LPVOID Buffer,
+                                            DWORD BufferLength,
+                                            LPDWORD ReadLength,
+                                            LONGLONG Offset,
+                                            PDOKAN_FILE_INFO DokanFileInfo) {
+  CheckFileContext(FileName, DokanFileInfo);
+  for (DWORD i = 0; i < BufferLength; ++i) {
+    ((PUCHAR)Buffer)[i] = (UCHAR)(Offset + i);
+  }
+  InterlockedIncrement(&g_Reads);
+  if (DokanFileInfo->AsyncDispatch) {
+    LONG index = InterlockedIncrement(&g_PendingReadCount) - 1;
+    g_PendingReads[index] = DokanFileInfo;
+    return STATUS_PENDING;
+  }
+  *ReadLength = BufferLength;
+  return STATUS_SUCCESS;
+}
+
+// Completes the reads once all of them are pending, when no event is being
+// dispatched anymore.
+static DWORD WINAPI CompletePendingReads(LPVOID Parameter) {
+  UNREFERENCED_PARAMETER(Parameter);
+  while (InterlockedAdd(&g_PendingReadCount, 0) < OPEN_COUNT * READS_PER_OPEN) {
+    Sleep(1);
+  }
+  for (ULONG i = 0; i < OPEN_COUNT * READS_PER_OPEN; ++i) {
+    DokanEndDispatchRead(g_PendingReads[i], READ_LENGTH, STATUS_SUCCESS);
+  }
+  return 0;
+}
+
+static void DOKAN_CALLBACK TestCleanup(LPCWSTR FileName,
+                                       PDOKAN_FILE_INFO DokanFileInfo) {
+  CheckFileContext(FileName, DokanFileInfo);
+  InterlockedIncrement(&g_Cleanups);
+}
+
+static void DOKAN_CALLBACK TestCloseFile(LPCWSTR FileName,
+                                         PDOKAN_FILE_INFO DokanFileInfo) {
+  CheckFileContext(FileName, DokanFileInfo);
+  InterlockedIncrement(&g_Closes);
+}
+
+// Options and Operations must outlive the returned instance.
+static DOKAN_HANDLE CreateTestFileSystem(ULONG Options,
+                                         PDOKAN_OPTIONS DokanOptions,
+                                         PDOKAN_OPERATIONS DokanOperations) {
+  DOKAN_HANDLE instance = NULL;
+
+  g_Creates = g_Reads = g_Cleanups = g_Closes = g_WrongContexts = 0;
+  g_PendingReadCount = 0;
+  ZeroMemory(DokanOptions, sizeof(DOKAN_OPTIONS));
+  DokanOptions->Version = DOKAN_VERSION;
+  DokanOptions->Options = Options;
+  ZeroMemory(DokanOperations, sizeof(DOKAN_OPERATIONS));
+  DokanOperations->ZwCreateFile = TestCreateFile;
+  DokanOperations->ReadFile = TestReadFile;
+  DokanOperations->Cleanup = TestCleanup;
+  DokanOperations->CloseFile = TestCloseFile;
+  CHECK(DokanCreateMemoryFileSystem(DokanOptions, DokanOperations,
+                                    &instance) == DOKAN_SUCCESS);
+  return instance;
+}
+
+static VOID SubmitOpens(DOKAN_HANDLE Instance, ULONG First, ULONG Count) {
+  for (ULONG i = First; i < First + Count; ++i) {
+    WCHAR fileName[16];
+    swprintf(fileName, sizeof(fileName) / sizeof(WCHAR), L"\\file%lu", i);
+    CHECK(SubmitOpenReadClose(Instance, OPEN_KEY(i), fileName,
+                              READS_PER_OPEN, READ_LENGTH));
+  }
+}
+
+static VOID TestOpenReadClose(ULONG Options) {
+  DOKAN_OPTIONS options;
+  DOKAN_OPERATIONS operations;
+  DOKAN_HANDLE instance;
+  DOKAN_MEMORY_TRANSPORT_STATISTICS statistics;
+  ULONG64 eventCount = OPEN_COUNT * (READS_PER_OPEN + 3);
+  HANDLE completer = NULL;
+
+  instance = CreateTestFileSystem(Options, &options, &operations);
+  if (!instance) {
+    return;
+  }
+  if (Options & DOKAN_OPTION_ASYNC_DISPATCH) {
+    g_HostTimersStopped = TRUE;
+    completer = CreateThread(NULL, 0, CompletePendingReads, NULL, 0, NULL);
+    CHECK(completer != NULL);
+  }
+  SubmitOpens(instance, 0, OPEN_COUNT);
+  CHECK(DokanWaitForMemoryTransportIdle(instance, 10000));
+  if (completer) {
+    WaitForSingleObject(completer, INFINITE);
+    CloseHandle(completer);
+    g_HostTimersStopped = FALSE;
+  }
+
+  CHECK(DokanGetMemoryTransportStatistics(instance, &statistics));
+  CHECK(statistics.SubmittedEvents == eventCount);
+  CHECK(statistics.PulledEvents == eventCount);
+  CHECK(statistics.CompletedEvents == eventCount);
+  // Closes are not replied to.
+  CHECK(statistics.Results == eventCount - OPEN_COUNT);
+  CHECK(statistics.Latency[IRP_MJ_READ].Count == OPEN_COUNT * READS_PER_OPEN);
+  CHECK(statistics.Latency[IRP_MJ_CREATE].Count == OPEN_COUNT);
+  CHECK(g_Creates == OPEN_COUNT);
+  CHECK(g_Reads == OPEN_COUNT * READS_PER_OPEN);
+  CHECK(g_Cleanups == OPEN_COUNT);
+
+  // A close is completed once pulled, its callback is only known to have run
+  // once the dispatch threads are stopped.
+  DokanCloseHandle(instance);
+  CHECK(g_Closes == OPEN_COUNT);
+  CHECK(g_WrongContexts == 0);
+}
+
+static VOID TestOverlappedPullWaves() {
+  const ULONG waveCount = 8;
+  const ULONG opensPerWave = OPEN_COUNT / waveCount;
+  DOKAN_OPTIONS options;
+  DOKAN_OPERATIONS operations;
+  DOKAN_HANDLE instance;
+  DOKAN_MEMORY_TRANSPORT_STATISTICS statistics;
+
+  instance = CreateTestFileSystem(DOKAN_OPTION_OVERLAPPED_PULL, &options,
+                                  &operations);
+  if (!instance) {
+    return;
+  }
+  g_HostTimersStopped = TRUE;
+  for (ULONG wave = 0; wave < waveCount; ++wave) {
+    SubmitOpens(instance, wave * opensPerWave, opensPerWave);
+    CHECK(DokanWaitForMemoryTransportIdle(instance, 10000));
+  }
+  g_HostTimersStopped = FALSE;
+
+  CHECK(DokanGetMemoryTransportStatistics(instance, &statistics));
+  CHECK(statistics.PulledEvents == OPEN_COUNT * (READS_PER_OPEN + 3));
+  CHECK(statistics.Results == OPEN_COUNT * (READS_PER_OPEN + 2));
+  // Every wave is pulled by pulls posted again after the previous one.
+  CHECK(statistics.Pulls > waveCount);
+  CHECK(g_Reads == OPEN_COUNT * READS_PER_OPEN);
+
+  // The posted pulls are cancelled.
+  DokanCloseHandle(instance);
+  CHECK(g_Closes == OPEN_COUNT);
+  CHECK(g_WrongContexts == 0);
+}
+
+int main() {
+  DokanInit();
+  TestOpenReadClose(0);
+  TestOpenReadClose(DOKAN_OPTION_ALLOW_IPC_BATCHING);
+  TestOpenReadClose(DOKAN_OPTION_ALLOW_IPC_BATCHING |
+                    DOKAN_OPTION_ASYNC_DISPATCH);
+  TestOpenReadClose(DOKAN_OPTION_OVERLAPPED_PULL);
+  TestOpenReadClose(DOKAN_OPTION_OVERLAPPED_PULL |
+                    DOKAN_OPTION_ASYNC_DISPATCH);
+  TestOverlappedPullWaves();
+  DokanShutdown();
+  return TEST_RESULT();
+}
@@ -0,0 +1,91 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Times the name matcher and the recursive matcher it replaced on the
+// patterns of a directory listing and on a pattern the recursion is
+// exponential for. Not run by ctest, pass a repetition factor to scale it.
+
+#include "../dokani.h"
+#include "name_matcher_reference.h"
+
+typedef BOOL (*PMATCH_ROUTINE)(LPCWSTR Expression, LPCWSTR Name,
+                               BOOL IgnoreCase);
+
+typedef struct _BENCHMARK_CASE {
+  LPCWSTR Description;
+  LPCWSTR Expression;
+  LPCWSTR Name;
+  ULONG Iterations;
+} BENCHMARK_CASE;
+
+static const BENCHMARK_CASE g_Cases[] = {
+    {L"extension", L"*.txt", L"a_rather_long_file_name.txt", 1000000},
+    {L"dos wildcards", L"<.\"tx>", L"a_rather_long_file_name.txt", 1000000},
+    {L"literal", L"a_rather_long_file_name.txt",
+     L"A_RATHER_LONG_FILE_NAME.TXT", 1000000},
+    {L"many stars", L"*a*a*a*a*a*a*b", L"aaaaaaaaaaaaaaaaaaaaaaaaa", 20},
+};
+
+static double NowSeconds() {
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static double TimeMatches(PMATCH_ROUTINE Match, const BENCHMARK_CASE *Case,
+                          ULONG Iterations, PULONG Matches) {
+  double start = NowSeconds();
+  *Matches = 0;
+  for (ULONG i = 0; i < Iterations; ++i) {
+    *Matches += Match(Case->Expression, Case->Name, TRUE) ? 1 : 0;
+  }
+  return NowSeconds() - start;
+}
+
+static BOOL MatchWithMatcher(LPCWSTR Expression, LPCWSTR Name,
+                             BOOL IgnoreCase) {
+  return IsNameInExpression(Expression, Name, IgnoreCase);
+}
+
+int main(int argc, char **argv) {
+  ULONG factor = argc > 1 ? (ULONG)strtoul(argv[1], NULL, 10) : 1;
+  if (factor == 0) {
+    factor = 1;
+  }
+  printf("%-16s %14s %14s\n", "case", "matcher ns", "recursive ns");
+  for (ULONG i = 0; i < _countof(g_Cases); ++i) {
+    const BENCHMARK_CASE *benchmarkCase = &g_Cases[i];
+    ULONG iterations = benchmarkCase->Iterations * factor;
+    ULONG matches;
+    ULONG referenceMatches;
+    double matcherTime =
+        TimeMatches(MatchWithMatcher, benchmarkCase, iterations, &matches);
+    double referenceTime =
+        TimeMatches(ReferenceIsNameInExpression, benchmarkCase, iterations,
+                    &referenceMatches);
+    printf("%-16ls %14.1f %14.1f%s\n", benchmarkCase->Description,
+           matcherTime * 1e9 / iterations, referenceTime * 1e9 / iterations,
+           matches == referenceMatches ? "" : " MISMATCH");
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "name_matcher_reference.h"
+
+#define DOS_STAR (L'<')
+#define DOS_QM (L'>')
+#define DOS_DOT (L'"')
+
+BOOL ReferenceIsNameInExpression(LPCWSTR Expression, LPCWSTR Name,
+                                 BOOL IgnoreCase) {
+  ULONG ei = 0;
+  ULONG ni = 0;
+
+  while (Expression[ei] != '\0') {
+
+    if (Expression[ei] == L'*') {
+      ei++;
+      if (Expression[ei] == '\0')
+        return TRUE;
+
+      while (Name[ni] != '\0') {
+        if (ReferenceIsNameInExpression(&Expression[ei], &Name[ni],
+                                        IgnoreCase))
+          return TRUE;
+        ni++;
+      }
+
+    } else if (Expression[ei] == DOS_STAR) {
+
+      ULONG p = ni;
+      ULONG lastDot = 0;
+      ei++;
+
+      while (Name[p] != '\0') {
+        if (Name[p] == L'.')
+          lastDot = p;
+        p++;
+      }
+
+      BOOL endReached = FALSE;
+      while (!endReached) {
+
+        endReached = (Name[ni] == '\0' || ni == lastDot);
+
+        if (!endReached) {
+          if (ReferenceIsNameInExpression(&Expression[ei], &Name[ni],
+                                          IgnoreCase))
+            return TRUE;
+
+          ni++;
+        }
+      }
+
+    } else if (Expression[ei] == DOS_QM) {
+
+      ei++;
+      if (Name[ni] != L'.') {
+        ni++;
+      } else {
+
+        ULONG p = ni + 1;
+        while (Name[p] != '\0') {
+          if (Name[p] == L'.')
+            break;
+          p++;
+        }
+
+        if (Name[p] == L'.')
+          ni++;
+      }
+
+    } else if (Expression[ei] == DOS_DOT) {
+      ei++;
+
+      if (Name[ni] == L'.')
+        ni++;
+
+    } else {
+      if (Expression[ei] == L'?') {
+        ei++;
+        ni++;
+      } else if (IgnoreCase && towupper(Expression[ei]) == towupper(Name[ni])) {
+        ei++;
+        ni++;
+      } else if (!IgnoreCase && Expression[ei] == Name[ni]) {
+        ei++;
+        ni++;
+      } else {
+        return FALSE;
+      }
+    }
+  }
+
+  if (ei == wcslen(Expression) && ni == wcslen(Name))
+    return TRUE;
+
+  return FALSE;
+}
@@ -0,0 +1,33 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DOKAN_TESTS_NAME_MATCHER_REFERENCE_H_
+#define DOKAN_TESTS_NAME_MATCHER_REFERENCE_H_
+
+#include <windows.h>
+
+// The recursive DokanIsNameInExpression the name matcher replaced. Each '?'
+// or DOS_QM left when the end of Name is reached reads one more character
+// past it, so Name must be followed by as many NUL characters.
+BOOL ReferenceIsNameInExpression(LPCWSTR Expression, LPCWSTR Name,
+                                 BOOL IgnoreCase);
+
+#endif // DOKAN_TESTS_NAME_MATCHER_REFERENCE_H_
@@ -0,0 +1,192 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Compares the name matcher with the recursive matcher it replaced: every
+// expression and name up to a few characters over an alphabet of wildcards,
+// literals of both cases and dots, then long random expressions whose matcher
+// does not fit on the stack of IsNameInExpression.
+
+#include "../dokani.h"
+#include "name_matcher_reference.h"
+#include "test.h"
+
+ULONG g_TestFailures;
+
+#define MAX_EXPRESSION_LENGTH 4
+#define MAX_NAME_LENGTH 4
+#define LONG_EXPRESSION_COUNT 5000
+#define LONG_EXPRESSION_MAX_LENGTH 400
+// Room for the characters the reference matcher reads past the end.
+#define NAME_BUFFER_LENGTH (2 * LONG_EXPRESSION_MAX_LENGTH + 2)
+
+static const WCHAR g_ExpressionAlphabet[] = L"aB.*?<>\"";
+static const WCHAR g_NameAlphabet[] = L"abB.";
+
+static ULONG g_Seed = 1;
+
+static ULONG NextRandom(ULONG Bound) {
+  g_Seed = g_Seed * 1103515245 + 12345;
+  return (g_Seed >> 8) % Bound;
+}
+
+// Builds the Index-th word of Length characters over Alphabet.
+static VOID MakeWord(PWCHAR Word, LPCWSTR Alphabet, ULONG Length,
+                     ULONG Index) {
+  ULONG base = (ULONG)wcslen(Alphabet);
+  for (ULONG i = 0; i < Length; ++i) {
+    Word[i] = Alphabet[Index % base];
+    Index /= base;
+  }
+  Word[Length] = L'\0';
+}
+
+static ULONG Power(ULONG Base, ULONG Exponent) {
+  ULONG result = 1;
+  while (Exponent-- > 0) {
+    result *= Base;
+  }
+  return result;
+}
+
+static VOID CheckSameMatch(LPCWSTR Expression, LPCWSTR Name,
+                           BOOL IgnoreCase) {
+  BOOL expected = ReferenceIsNameInExpression(Expression, Name, IgnoreCase);
+  BOOL match = IsNameInExpression(Expression, Name, IgnoreCase);
+  PDOKAN_NAME_MATCHER matcher = CreateNameMatcher(Expression, IgnoreCase);
+
+  CHECK(matcher != NULL);
+  if (match != expected) {
+    fprintf(stderr, "\"%ls\" in \"%ls\" (IgnoreCase %d): %d, expected %d\n",
+            Name, Expression, IgnoreCase, match, expected);
+  }
+  CHECK(match == expected);
+  if (matcher) {
+    CHECK(MatchName(matcher, Name) == expected);
+    DeleteNameMatcher(matcher);
+  }
+}
+
+static VOID TestShortExpressions() {
+  WCHAR expression[MAX_EXPRESSION_LENGTH + 1];
+  WCHAR name[MAX_NAME_LENGTH + MAX_EXPRESSION_LENGTH + 1];
+  ULONG expressionBase = (ULONG)wcslen(g_ExpressionAlphabet);
+  ULONG nameBase = (ULONG)wcslen(g_NameAlphabet);
+
+  for (ULONG expressionLength = 0; expressionLength <= MAX_EXPRESSION_LENGTH;
+       ++expressionLength) {
+    ULONG expressionCount = Power(expressionBase, expressionLength);
+    for (ULONG e = 0; e < expressionCount; ++e) {
+      MakeWord(expression, g_ExpressionAlphabet, expressionLength, e);
+      for (ULONG nameLength = 0; nameLength <= MAX_NAME_LENGTH;
+           ++nameLength) {
+        ULONG nameCount = Power(nameBase, nameLength);
+        for (ULONG n = 0; n < nameCount; ++n) {
+          RtlZeroMemory(name, sizeof(name));
+          MakeWord(name, g_NameAlphabet, nameLength, n);
+          CheckSameMatch(expression, name, FALSE);
+          CheckSameMatch(expression, name, TRUE);
+        }
+      }
+    }
+  }
+}
+
+// Returns a random expression of Length characters, mostly literals since the
+// reference matcher is exponential in the number of stars.
+static VOID MakeLongExpression(PWCHAR Expression, ULONG Length) {
+  static const WCHAR literals[] = L"abcABC.";
+  static const WCHAR wildcards[] = L"*?<>\"";
+  ULONG stars = 0;
+  for (ULONG i = 0; i < Length; ++i) {
+    if (NextRandom(16) == 0) {
+      Expression[i] = wildcards[NextRandom(5)];
+      if (Expression[i] == L'*' || Expression[i] == L'<') {
+        if (stars == 2) {
+          Expression[i] = L'?';
+        } else {
+          ++stars;
+        }
+      }
+    } else {
+      Expression[i] = literals[NextRandom(7)];
+    }
+  }
+  Expression[Length] = L'\0';
+}
+
+// Returns a name the expression likely matches, with a character changed
+// from time to time so that it likely does not.
+static VOID MakeLongName(PWCHAR Name, LPCWSTR Expression) {
+  static const WCHAR literals[] = L"abcABC.";
+  ULONG length = 0;
+  for (ULONG i = 0; Expression[i] != L'\0'; ++i) {
+    switch (Expression[i]) {
+    case L'*':
+    case L'<':
+      for (ULONG count = NextRandom(4); count > 0; --count) {
+        Name[length++] = literals[NextRandom(6)];
+      }
+      break;
+    case L'?':
+    case L'>':
+      Name[length++] = literals[NextRandom(6)];
+      break;
+    case L'"':
+      Name[length++] = L'.';
+      break;
+    default:
+      Name[length++] =
+          NextRandom(2) ? Expression[i] : (WCHAR)towlower(Expression[i]);
+      break;
+    }
+  }
+  if (length > 0 && NextRandom(4) == 0) {
+    Name[NextRandom(length)] = L'x';
+  }
+  Name[length] = L'\0';
+}
+
+static VOID TestLongExpressions() {
+  WCHAR expression[LONG_EXPRESSION_MAX_LENGTH + 1];
+  WCHAR name[NAME_BUFFER_LENGTH];
+  ULONG longMatches = 0;
+
+  for (ULONG i = 0; i < LONG_EXPRESSION_COUNT; ++i) {
+    ULONG length = 1 + NextRandom(LONG_EXPRESSION_MAX_LENGTH);
+    BOOL ignoreCase = NextRandom(2);
+    MakeLongExpression(expression, length);
+    RtlZeroMemory(name, sizeof(name));
+    MakeLongName(name, expression);
+    CheckSameMatch(expression, name, ignoreCase);
+    // Make sure the heap matchers are not only tested on failures.
+    if (length * sizeof(WCHAR) > DOKAN_NAME_MATCHER_STACK_SIZE &&
+        ReferenceIsNameInExpression(expression, name, ignoreCase)) {
+      ++longMatches;
+    }
+  }
+  CHECK(longMatches > LONG_EXPRESSION_COUNT / 10);
+}
+
+int main() {
+  TestShortExpressions();
+  TestLongExpressions();
+  return TEST_RESULT();
+}
@@ -0,0 +1,183 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Times pops and pushes of the DOKAN_IO_EVENT pool of a mount from 1 to 64
+// threads, next to a pool behind one CRITICAL_SECTION like the one the
+// magazines replaced. Not run by ctest, pass a repetition factor to scale it.
+
+#include "../dokan_pool.h"
+
+#define MAX_THREAD_COUNT 64
+#define ITERATIONS_PER_THREAD 200000
+// Objects held at once by a thread, like the event and result of a request.
+#define HELD_OBJECT_COUNT 4
+#define LOCKED_POOL_SIZE 1024
+
+typedef struct _LOCKED_POOL {
+  CRITICAL_SECTION Lock;
+  PDOKAN_VECTOR Objects;
+} LOCKED_POOL, *PLOCKED_POOL;
+
+typedef struct _BENCHMARK_THREAD {
+  PDOKAN_INSTANCE Instance;
+  PLOCKED_POOL LockedPool;
+  ULONG Iterations;
+  volatile LONG *Start;
+} BENCHMARK_THREAD, *PBENCHMARK_THREAD;
+
+static double NowSeconds() {
+  LARGE_INTEGER counter;
+  LARGE_INTEGER frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+static PVOID PopLocked(PLOCKED_POOL Pool) {
+  PVOID object = NULL;
+  EnterCriticalSection(&Pool->Lock);
+  if (DokanVector_GetCount(Pool->Objects) > 0) {
+    object = *(PVOID *)DokanVector_GetLastItem(Pool->Objects);
+    DokanVector_PopBack(Pool->Objects);
+  }
+  LeaveCriticalSection(&Pool->Lock);
+  if (!object) {
+    object = malloc(sizeof(DOKAN_IO_EVENT));
+  }
+  return object;
+}
+
+static VOID PushLocked(PLOCKED_POOL Pool, PVOID Object) {
+  EnterCriticalSection(&Pool->Lock);
+  if (DokanVector_GetCount(Pool->Objects) < LOCKED_POOL_SIZE) {
+    DokanVector_PushBack(Pool->Objects, &Object);
+    Object = NULL;
+  }
+  LeaveCriticalSection(&Pool->Lock);
+  free(Object);
+}
+
+static VOID WaitForStart(PBENCHMARK_THREAD Thread) {
+  while (InterlockedCompareExchange(Thread->Start, 0, 0) == 0) {
+  }
+}
+
+static DWORD WINAPI PopPushMagazines(LPVOID Context) {
+  PBENCHMARK_THREAD thread = (PBENCHMARK_THREAD)Context;
+  PDOKAN_IO_EVENT held[HELD_OBJECT_COUNT];
+  WaitForStart(thread);
+  for (ULONG iteration = 0; iteration < thread->Iterations; ++iteration) {
+    for (ULONG i = 0; i < HELD_OBJECT_COUNT; ++i) {
+      held[i] = PopIoEventBuffer(thread->Instance);
+    }
+    for (ULONG i = 0; i < HELD_OBJECT_COUNT; ++i) {
+      PushIoEventBuffer(held[i]);
+    }
+  }
+  return 0;
+}
+
+static DWORD WINAPI PopPushLocked(LPVOID Context) {
+  PBENCHMARK_THREAD thread = (PBENCHMARK_THREAD)Context;
+  PVOID held[HELD_OBJECT_COUNT];
+  WaitForStart(thread);
+  for (ULONG iteration = 0; iteration < thread->Iterations; ++iteration) {
+    for (ULONG i = 0; i < HELD_OBJECT_COUNT; ++i) {
+      held[i] = PopLocked(thread->LockedPool);
+    }
+    for (ULONG i = 0; i < HELD_OBJECT_COUNT; ++i) {
+      PushLocked(thread->LockedPool, held[i]);
+    }
+  }
+  return 0;
+}
+
+// Returns the pop and push pairs per second of ThreadCount threads.
+static double TimeThreads(LPTHREAD_START_ROUTINE Routine,
+                          PDOKAN_INSTANCE Instance, PLOCKED_POOL LockedPool,
+                          ULONG ThreadCount, ULONG Iterations) {
+  BENCHMARK_THREAD threads[MAX_THREAD_COUNT];
+  HANDLE handles[MAX_THREAD_COUNT];
+  volatile LONG start = 0;
+  double startTime;
+  double elapsed;
+
+  for (ULONG i = 0; i < ThreadCount; ++i) {
+    threads[i].Instance = Instance;
+    threads[i].LockedPool = LockedPool;
+    threads[i].Iterations = Iterations;
+    threads[i].Start = &start;
+    handles[i] = CreateThread(NULL, 0, Routine, &threads[i], 0, NULL);
+    if (!handles[i]) {
+      fprintf(stderr, "CreateThread failed\n");
+      exit(1);
+    }
+  }
+  startTime = NowSeconds();
+  InterlockedExchange(&start, 1);
+  for (ULONG i = 0; i < ThreadCount; ++i) {
+    WaitForSingleObject(handles[i], INFINITE);
+    CloseHandle(handles[i]);
+  }
+  elapsed = NowSeconds() - startTime;
+  return (double)ThreadCount * Iterations * HELD_OBJECT_COUNT / elapsed;
+}
+
+int main(int argc, char **argv) {
+  ULONG factor = argc > 1 ? (ULONG)strtoul(argv[1], NULL, 10) : 1;
+  ULONG iterations;
+  DOKAN_OPTIONS options;
+  DOKAN_INSTANCE instance;
+  LOCKED_POOL lockedPool;
+
+  if (factor == 0) {
+    factor = 1;
+  }
+  iterations = ITERATIONS_PER_THREAD * factor;
+  RtlZeroMemory(&options, sizeof(DOKAN_OPTIONS));
+  RtlZeroMemory(&instance, sizeof(DOKAN_INSTANCE));
+  instance.DokanOptions = &options;
+  if (!CreateInstancePools(&instance, FALSE)) {
+    fprintf(stderr, "CreateInstancePools failed\n");
+    return 1;
+  }
+  InitializeCriticalSection(&lockedPool.Lock);
+  lockedPool.Objects = DokanVector_Alloc(sizeof(PVOID));
+
+  printf("%-8s %16s %16s\n", "threads", "magazine Mop/s", "locked Mop/s");
+  for (ULONG threadCount = 1; threadCount <= MAX_THREAD_COUNT;
+       threadCount *= 2) {
+    double magazines = TimeThreads(PopPushMagazines, &instance, NULL,
+                                   threadCount, iterations);
+    double locked = TimeThreads(PopPushLocked, NULL, &lockedPool,
+                                threadCount, iterations);
+    printf("%-8lu %16.1f %16.1f\n", threadCount, magazines / 1e6,
+           locked / 1e6);
+  }
+
+  for (size_t i = 0; i < DokanVector_GetCount(lockedPool.Objects); ++i) {
+    free(*(PVOID *)DokanVector_GetItem(lockedPool.Objects, i));
+  }
+  DokanVector_Free(lockedPool.Objects);
+  DeleteCriticalSection(&lockedPool.Lock);
+  DeleteInstancePools(&instance);
+  return 0;
+}
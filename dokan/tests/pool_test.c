@@ -0,0 +1,433 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Checks the invariants of the object pools through the DOKAN_IO_EVENT pool
+// of a mount: an object is never handed out twice, the objects pushed back
+// are the ones popped next, whole magazines move between threads through the
+// depot, and every pushed object is either reused or freed.
+
+#include "../dokan_pool.h"
+#include "test.h"
+
+ULONG g_TestFailures;
+
+#define CONCURRENT_THREAD_COUNT 4
+#define CONCURRENT_ITERATIONS 20000
+#define CONCURRENT_MAX_HELD 40
+
+typedef struct _TEST_MOUNT {
+  DOKAN_OPTIONS Options;
+  DOKAN_INSTANCE Instance;
+} TEST_MOUNT, *PTEST_MOUNT;
+
+// Every test uses its own mount, so that the calling thread starts without
+// magazines.
+static VOID CreateTestMount(PTEST_MOUNT Mount) {
+  RtlZeroMemory(Mount, sizeof(TEST_MOUNT));
+  Mount->Instance.DokanOptions = &Mount->Options;
+  CHECK(CreateInstancePools(&Mount->Instance, FALSE));
+}
+
+static VOID DeleteTestMount(PTEST_MOUNT Mount) {
+  DeleteInstancePools(&Mount->Instance);
+}
+
+static DOKAN_POOL_STATISTICS GetIoEventStatistics(PTEST_MOUNT Mount) {
+  DOKAN_POOL_STATISTICS statistics[32];
+  ULONG count = DokanGetInstancePoolStatistics(&Mount->Instance, statistics,
+                                               _countof(statistics));
+  CHECK(count > 0 && count <= _countof(statistics));
+  for (ULONG i = 0; i < count; ++i) {
+    if (wcscmp(statistics[i].Name, L"IoEvent") == 0) {
+      return statistics[i];
+    }
+  }
+  CHECK(!"IoEvent pool not found");
+  RtlZeroMemory(&statistics[0], sizeof(DOKAN_POOL_STATISTICS));
+  return statistics[0];
+}
+
+static BOOL IsInArray(PVOID *Objects, ULONG Count, PVOID Object) {
+  for (ULONG i = 0; i < Count; ++i) {
+    if (Objects[i] == Object) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static VOID PopEvents(PTEST_MOUNT Mount, PVOID *Objects, ULONG Count) {
+  for (ULONG i = 0; i < Count; ++i) {
+    Objects[i] = PopIoEventBuffer(&Mount->Instance);
+    CHECK(Objects[i] != NULL);
+    CHECK(!IsInArray(Objects, i, Objects[i]));
+  }
+}
+
+static VOID PushEvents(PVOID *Objects, ULONG Count) {
+  for (ULONG i = 0; i < Count; ++i) {
+    PushIoEventBuffer((PDOKAN_IO_EVENT)Objects[i]);
+  }
+}
+
+// The last object pushed is the next one popped.
+static VOID TestLastPushedIsPopped() {
+  TEST_MOUNT mount;
+  PDOKAN_IO_EVENT ioEvent;
+  CreateTestMount(&mount);
+
+  ioEvent = PopIoEventBuffer(&mount.Instance);
+  CHECK(ioEvent && ioEvent->DokanInstance == &mount.Instance);
+  PushIoEventBuffer(ioEvent);
+  CHECK(PopIoEventBuffer(&mount.Instance) == ioEvent);
+  PushIoEventBuffer(ioEvent);
+
+  DeleteTestMount(&mount);
+}
+
+// Objects pushed over several magazines are all popped back without
+// allocating, and none of them twice.
+static VOID TestReuseAcrossMagazines() {
+  TEST_MOUNT mount;
+  PVOID first[100];
+  PVOID second[100];
+  DOKAN_POOL_STATISTICS statistics;
+  CreateTestMount(&mount);
+
+  PopEvents(&mount, first, _countof(first));
+  statistics = GetIoEventStatistics(&mount);
+  CHECK(statistics.Misses == _countof(first));
+  CHECK(statistics.Hits == 0);
+  CHECK(statistics.ObjectsOutstanding == _countof(first));
+  PushEvents(first, _countof(first));
+  CHECK(GetIoEventStatistics(&mount).ObjectsOutstanding == 0);
+
+  PopEvents(&mount, second, _countof(second));
+  for (ULONG i = 0; i < _countof(second); ++i) {
+    CHECK(IsInArray(first, _countof(first), second[i]));
+  }
+  statistics = GetIoEventStatistics(&mount);
+  CHECK(statistics.Hits == _countof(second));
+  CHECK(statistics.Misses == _countof(first));
+  CHECK(statistics.HighWaterObjects == _countof(first));
+  PushEvents(second, _countof(second));
+
+  DeleteTestMount(&mount);
+}
+
+typedef struct _THREAD_EXIT_CONTEXT {
+  PTEST_MOUNT Mount;
+  PVOID Objects[70];
+} THREAD_EXIT_CONTEXT, *PTHREAD_EXIT_CONTEXT;
+
+static DWORD WINAPI PopPushAndExit(LPVOID Context) {
+  PTHREAD_EXIT_CONTEXT context = (PTHREAD_EXIT_CONTEXT)Context;
+  PopEvents(context->Mount, context->Objects, _countof(context->Objects));
+  PushEvents(context->Objects, _countof(context->Objects));
+  return 0;
+}
+
+// The magazines of an exiting thread go to the depot, where another thread
+// finds them.
+static VOID TestThreadExitFlushesMagazines() {
+  TEST_MOUNT mount;
+  THREAD_EXIT_CONTEXT context;
+  PVOID objects[_countof(context.Objects)];
+  HANDLE thread;
+  DOKAN_POOL_STATISTICS statistics;
+  CreateTestMount(&mount);
+
+  context.Mount = &mount;
+  thread = CreateThread(NULL, 0, PopPushAndExit, &context, 0, NULL);
+  CHECK(thread != NULL);
+  if (!thread) {
+    DeleteTestMount(&mount);
+    return;
+  }
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+
+  PopEvents(&mount, objects, _countof(objects));
+  for (ULONG i = 0; i < _countof(objects); ++i) {
+    CHECK(IsInArray(context.Objects, _countof(context.Objects), objects[i]));
+  }
+  statistics = GetIoEventStatistics(&mount);
+  CHECK(statistics.Hits == _countof(objects));
+  CHECK(statistics.Misses == _countof(context.Objects));
+  PushEvents(objects, _countof(objects));
+
+  DeleteTestMount(&mount);
+}
+
+// Pushing more objects than the pool keeps frees the extra ones, the others
+// are reused.
+static VOID TestPushesBeyondLimitAreFreed() {
+  TEST_MOUNT mount;
+  const ULONG count = 3000;
+  PVOID *objects = (PVOID *)calloc(count, sizeof(PVOID));
+  DOKAN_POOL_STATISTICS statistics;
+  ULONG64 dropped;
+  CHECK(objects != NULL);
+  if (!objects) {
+    return;
+  }
+  CreateTestMount(&mount);
+
+  for (ULONG i = 0; i < count; ++i) {
+    objects[i] = PopIoEventBuffer(&mount.Instance);
+    CHECK(objects[i] != NULL);
+  }
+  PushEvents(objects, count);
+  statistics = GetIoEventStatistics(&mount);
+  dropped = statistics.DroppedPushes;
+  CHECK(dropped > 0 && dropped < count);
+  CHECK(statistics.ObjectsOutstanding == 0);
+
+  for (ULONG i = 0; i < count; ++i) {
+    objects[i] = PopIoEventBuffer(&mount.Instance);
+    CHECK(objects[i] != NULL);
+  }
+  statistics = GetIoEventStatistics(&mount);
+  CHECK(statistics.Hits == count - dropped);
+  CHECK(statistics.Misses == count + dropped);
+  CHECK(statistics.HighWaterObjects == count);
+  PushEvents(objects, count);
+
+  DeleteTestMount(&mount);
+  free(objects);
+}
+
+typedef struct _CONCURRENT_CONTEXT {
+  PTEST_MOUNT Mount;
+  ULONG Seed;
+  // Objects seen in the hands of two threads at once.
+  ULONG Collisions;
+} CONCURRENT_CONTEXT, *PCONCURRENT_CONTEXT;
+
+static DWORD WINAPI PopPushConcurrently(LPVOID Context) {
+  PCONCURRENT_CONTEXT context = (PCONCURRENT_CONTEXT)Context;
+  PDOKAN_IO_EVENT held[CONCURRENT_MAX_HELD];
+  for (ULONG iteration = 0; iteration < CONCURRENT_ITERATIONS; ++iteration) {
+    ULONG count;
+    context->Seed = context->Seed * 1103515245 + 12345;
+    count = 1 + (context->Seed >> 8) % CONCURRENT_MAX_HELD;
+    // Each held object carries the token of its holder, that a second holder
+    // would overwrite.
+    for (ULONG i = 0; i < count; ++i) {
+      held[i] = PopIoEventBuffer(&context->Mount->Instance);
+      if (!held[i]) {
+        count = i;
+        break;
+      }
+      held[i]->DokanFileInfo.Context = (ULONG64)(ULONG_PTR)&held[i];
+    }
+    for (ULONG i = 0; i < count; ++i) {
+      if (held[i]->DokanFileInfo.Context != (ULONG64)(ULONG_PTR)&held[i]) {
+        ++context->Collisions;
+      }
+      PushIoEventBuffer(held[i]);
+    }
+  }
+  return 0;
+}
+
+// Threads popping and pushing at the same time never share an object, and
+// every object popped is pushed back.
+static VOID TestConcurrentPopPush() {
+  TEST_MOUNT mount;
+  CONCURRENT_CONTEXT contexts[CONCURRENT_THREAD_COUNT];
+  HANDLE threads[CONCURRENT_THREAD_COUNT];
+  DOKAN_POOL_STATISTICS statistics;
+  CreateTestMount(&mount);
+
+  for (ULONG i = 0; i < CONCURRENT_THREAD_COUNT; ++i) {
+    contexts[i].Mount = &mount;
+    contexts[i].Seed = i + 1;
+    contexts[i].Collisions = 0;
+    threads[i] =
+        CreateThread(NULL, 0, PopPushConcurrently, &contexts[i], 0, NULL);
+    CHECK(threads[i] != NULL);
+  }
+  for (ULONG i = 0; i < CONCURRENT_THREAD_COUNT; ++i) {
+    if (threads[i]) {
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+    }
+    CHECK(contexts[i].Collisions == 0);
+  }
+  statistics = GetIoEventStatistics(&mount);
+  CHECK(statistics.ObjectsOutstanding == 0);
+  CHECK(statistics.Hits > statistics.Misses);
+
+  DeleteTestMount(&mount);
+}
+
+static DOKAN_POOL_STATISTICS GetProcessIoEventStatistics() {
+  DOKAN_POOL_STATISTICS statistics[32];
+  ULONG count = DokanGetPoolStatistics(statistics, _countof(statistics));
+  CHECK(count > 0 && count <= _countof(statistics));
+  for (ULONG i = 0; i < count && i < _countof(statistics); ++i) {
+    if (statistics[i].Name && wcscmp(statistics[i].Name, L"IoEvent") == 0) {
+      return statistics[i];
+    }
+  }
+  CHECK(!"IoEvent pool not found");
+  RtlZeroMemory(&statistics[0], sizeof(DOKAN_POOL_STATISTICS));
+  return statistics[0];
+}
+
+#ifdef HOST_NUMA_EMULATION
+// Objects pushed from another NUMA node go back to the pool set of the node
+// they were popped on.
+static VOID TestPushesReturnToTheirNode() {
+  TEST_MOUNT mount;
+  PDOKAN_IO_EVENT ioEvent;
+  PEVENT_INFORMATION eventResult;
+  ULONG eventResultSize;
+  PDOKAN_OPEN_INFO openInfo;
+  PDOKAN_DIRECTORY_LIST dirList;
+  PDOKAN_IO_EVENT otherIoEvent;
+  PEVENT_INFORMATION otherEventResult;
+  ULONG otherEventResultSize;
+
+  g_HostHighestNumaNode = 1;
+  g_HostNumaNode = 0;
+  RtlZeroMemory(&mount, sizeof(TEST_MOUNT));
+  mount.Instance.DokanOptions = &mount.Options;
+  CHECK(CreateInstancePools(&mount.Instance, TRUE));
+  CHECK(mount.Instance.PoolSetCount == 2);
+
+  ioEvent = PopIoEventBuffer(&mount.Instance);
+  eventResult = PopEventResult(&mount.Instance, 100, &eventResultSize);
+  openInfo = PopFileOpenInfo(&mount.Instance);
+  dirList = PopDirectoryList(&mount.Instance);
+  CHECK(ioEvent && eventResult && openInfo && dirList);
+  CHECK(ioEvent->PoolSet == mount.Instance.PoolSets[0]);
+
+  g_HostNumaNode = 1;
+  PushIoEventBuffer(ioEvent);
+  PushEventResult(&mount.Instance, eventResult, eventResultSize);
+  PushFileOpenInfo(openInfo);
+  PushDirectoryList(&mount.Instance, dirList);
+  otherIoEvent = PopIoEventBuffer(&mount.Instance);
+  otherEventResult =
+      PopEventResult(&mount.Instance, 100, &otherEventResultSize);
+  CHECK(otherIoEvent != ioEvent);
+  CHECK(otherEventResult != eventResult);
+  CHECK(otherIoEvent->PoolSet == mount.Instance.PoolSets[1]);
+
+  g_HostNumaNode = 0;
+  CHECK(PopIoEventBuffer(&mount.Instance) == ioEvent);
+  CHECK(PopEventResult(&mount.Instance, 100, &eventResultSize) ==
+        eventResult);
+  CHECK(PopFileOpenInfo(&mount.Instance) == openInfo);
+  CHECK(PopDirectoryList(&mount.Instance) == dirList);
+  CHECK(GetIoEventStatistics(&mount).ObjectsOutstanding == 2);
+  PushIoEventBuffer(ioEvent);
+  PushEventResult(&mount.Instance, eventResult, eventResultSize);
+  PushFileOpenInfo(openInfo);
+  PushDirectoryList(&mount.Instance, dirList);
+  PushIoEventBuffer(otherIoEvent);
+  PushEventResult(&mount.Instance, otherEventResult, otherEventResultSize);
+  CHECK(GetIoEventStatistics(&mount).ObjectsOutstanding == 0);
+
+  DeleteTestMount(&mount);
+  g_HostHighestNumaNode = 0;
+}
+#endif
+
+// The process counters keep the pops of the unmounted mounts.
+static VOID TestUnmountedCountersAreKept() {
+  TEST_MOUNT mount;
+  PVOID objects[10];
+  DOKAN_POOL_STATISTICS before;
+  DOKAN_POOL_STATISTICS after;
+  CreateTestMount(&mount);
+
+  before = GetProcessIoEventStatistics();
+  PopEvents(&mount, objects, _countof(objects));
+  PushEvents(objects, _countof(objects));
+  DeleteTestMount(&mount);
+  after = GetProcessIoEventStatistics();
+  CHECK(after.Misses == before.Misses + _countof(objects));
+  CHECK(after.ObjectSize == sizeof(DOKAN_IO_EVENT));
+  CHECK(after.ObjectsOutstanding == 0);
+}
+
+// The large buffer pool is committed when the mount is created, its buffers
+// are usable as soon as they are carved.
+static VOID TestLargeBufferPoolIsCommittedAtMount() {
+  const SIZE_T poolSize = 1024 * 1024;
+  const SIZE_T bufferSize = 384 * 1024;
+  TEST_MOUNT mount;
+  DOKAN_LARGE_BUFFER_POOL_STATISTICS statistics;
+  PCHAR first;
+  PCHAR second;
+  RtlZeroMemory(&mount, sizeof(TEST_MOUNT));
+  mount.Instance.DokanOptions = &mount.Options;
+  mount.Options.Options = DOKAN_OPTION_LARGE_BUFFER_POOL;
+  mount.Options.LargeBufferPoolSize = poolSize;
+  CHECK(CreateInstancePools(&mount.Instance, FALSE));
+
+  CHECK(DokanGetLargeBufferPoolStatistics(&mount.Instance, &statistics));
+  CHECK(statistics.PoolSize == poolSize);
+  CHECK(statistics.CommittedBytes == poolSize);
+  CHECK(!statistics.LargePages);
+
+  first = (PCHAR)PopLargeBuffer(&mount.Instance, bufferSize);
+  second = (PCHAR)PopLargeBuffer(&mount.Instance, bufferSize);
+  CHECK(first != NULL && second != NULL);
+  if (first && second) {
+    CHECK(first + bufferSize <= second || second + bufferSize <= first);
+    memset(first, 0xa5, bufferSize);
+    memset(second, 0x5a, bufferSize);
+    CHECK(IsLargeBuffer(&mount.Instance, first));
+  }
+  // No room left for a third one.
+  CHECK(PopLargeBuffer(&mount.Instance, bufferSize) == NULL);
+
+  CHECK(DokanGetLargeBufferPoolStatistics(&mount.Instance, &statistics));
+  CHECK(statistics.Allocations == 2);
+  CHECK(statistics.Fallbacks == 1);
+  CHECK(statistics.BytesInUse == 2 * bufferSize);
+  if (first && second) {
+    PushLargeBuffer(&mount.Instance, first, bufferSize);
+    PushLargeBuffer(&mount.Instance, second, bufferSize);
+  }
+  CHECK(DokanGetLargeBufferPoolStatistics(&mount.Instance, &statistics));
+  CHECK(statistics.BytesInUse == 0);
+  CHECK(statistics.HighWaterBytes == 2 * bufferSize);
+  DeleteTestMount(&mount);
+}
+
+int main() {
+  TestLastPushedIsPopped();
+  TestReuseAcrossMagazines();
+  TestThreadExitFlushesMagazines();
+  TestPushesBeyondLimitAreFreed();
+  TestConcurrentPopPush();
+  TestUnmountedCountersAreKept();
+  TestLargeBufferPoolIsCommittedAtMount();
+#ifdef HOST_NUMA_EMULATION
+  TestPushesReturnToTheirNode();
+#endif
+  return TEST_RESULT();
+}
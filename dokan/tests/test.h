@@ -0,0 +1,44 @@
+/*
+  Dokan : user-mode file system library for Windows
+
+  Copyright (C) 2025 Google, Inc.
+
+  http://dokan-dev.github.io
+
+This program is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the Free
+Software Foundation; either version 3 of the License, or (at your option) any
+later version.
+
+This program is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Minimal checks for the host tests of the library, which has no test
+// framework dependency.
+
+#ifndef DOKAN_TESTS_TEST_H_
+#define DOKAN_TESTS_TEST_H_
+
+#include <windows.h>
+
+#include <stdio.h>
+
+extern ULONG g_TestFailures;
+
+// Reports a failure and continues, the test fails when main returns
+// TEST_RESULT().
+#define CHECK(Condition)                                                       \
+  ((Condition) ? (void)0                                                       \
+               : (fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__,     \
+                          __LINE__, #Condition),                               \
+                  (void)++g_TestFailures))
+
+#define TEST_RESULT() (g_TestFailures == 0 ? 0 : 1)
+
+#endif // DOKAN_TESTS_TEST_H_
@@ -19,7 +19,6 @@ FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
 You should have received a copy of the GNU Lesser General Public License along
 with this program. If not, see <http://www.gnu.org/licenses/>.
 */
-
 #include "dokani.h"
 #include "fileinfo.h"
 
@@ -54,80 +53,31 @@ NTSTATUS DOKAN_CALLBACK DokanGetDefaultVolumeInformation(
   return STATUS_SUCCESS;
 }
 
-NTSTATUS DokanGetVolumeInformation(
-    PDOKAN_OPERATIONS DokanOperations, LPWSTR VolumeNameBuffer,
-    DWORD VolumeNameSize, LPDWORD VolumeSerialNumber,
-    LPDWORD MaximumComponentLength, LPDWORD FileSystemFlags,
-    LPWSTR FileSystemNameBuffer, DWORD FileSystemNameSize,
-    PDOKAN_FILE_INFO DokanFileInfo) {
-  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
-
-  RtlZeroMemory(VolumeNameBuffer, VolumeNameSize * sizeof(WCHAR));
-  RtlZeroMemory(FileSystemNameBuffer, FileSystemNameSize * sizeof(WCHAR));
-
-  if (DokanOperations->GetVolumeInformation) {
-    status = DokanOperations->GetVolumeInformation(
-        VolumeNameBuffer, VolumeNameSize, VolumeSerialNumber,
-        MaximumComponentLength, FileSystemFlags, FileSystemNameBuffer,
-        FileSystemNameSize, DokanFileInfo);
-  }
-
-  if (status == STATUS_NOT_IMPLEMENTED) {
-    status = DokanGetDefaultVolumeInformation(
-        VolumeNameBuffer, VolumeNameSize, VolumeSerialNumber,
-        MaximumComponentLength, FileSystemFlags, FileSystemNameBuffer,
-        FileSystemNameSize, DokanFileInfo);
-  }
-
-  return status;
-}
-
 NTSTATUS
 DokanFsVolumeInformation(PEVENT_INFORMATION EventInfo,
-                         PEVENT_CONTEXT EventContext, PDOKAN_FILE_INFO FileInfo,
-                         PDOKAN_OPERATIONS DokanOperations) {
-  WCHAR volumeName[MAX_PATH];
-  DWORD volumeSerial = 0;
-  DWORD maxComLength = 0;
-  DWORD fsFlags = 0;
-  WCHAR fsName[MAX_PATH];
+                         PEVENT_CONTEXT EventContext, LPCWSTR VolumeName,
+                         DWORD VolumeSerialNumber) {
   ULONG remainingLength;
   ULONG bytesToCopy;
-  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
 
   PFILE_FS_VOLUME_INFORMATION volumeInfo =
       (PFILE_FS_VOLUME_INFORMATION)EventInfo->Buffer;
 
   remainingLength = EventContext->Operation.Volume.BufferLength;
 
-  if (remainingLength < sizeof(FILE_FS_VOLUME_INFORMATION)) {
-    return STATUS_BUFFER_OVERFLOW;
-  }
-
-  status = DokanGetVolumeInformation(
-      DokanOperations,
-      volumeName,                         // VolumeNameBuffer
-      sizeof(volumeName) / sizeof(WCHAR), // VolumeNameSize
-      &volumeSerial,                      // VolumeSerialNumber
-      &maxComLength,                      // MaximumComponentLength
-      &fsFlags,                           // FileSystemFlags
-      fsName,                             // FileSystemNameBuffer
-      sizeof(fsName) / sizeof(WCHAR),     // FileSystemNameSize
-      FileInfo);
-
   volumeInfo->VolumeCreationTime.QuadPart = 0;
-  volumeInfo->VolumeSerialNumber = volumeSerial;
+  volumeInfo->VolumeSerialNumber = VolumeSerialNumber;
   volumeInfo->SupportsObjects = FALSE;
 
   remainingLength -= FIELD_OFFSET(FILE_FS_VOLUME_INFORMATION, VolumeLabel[0]);
 
-  bytesToCopy = (ULONG)wcslen(volumeName) * sizeof(WCHAR);
+  bytesToCopy = (ULONG)wcslen(VolumeName) * sizeof(WCHAR);
   if (remainingLength < bytesToCopy) {
     bytesToCopy = remainingLength;
   }
 
   volumeInfo->VolumeLabelLength = bytesToCopy;
-  RtlCopyMemory(volumeInfo->VolumeLabel, volumeName, bytesToCopy);
+  RtlCopyMemory(volumeInfo->VolumeLabel, VolumeName, bytesToCopy);
   remainingLength -= bytesToCopy;
 
   EventInfo->BufferLength =
@@ -138,47 +88,18 @@ DokanFsVolumeInformation(PEVENT_INFORMATION EventInfo,
 
 NTSTATUS
 DokanFsSizeInformation(PEVENT_INFORMATION EventInfo,
-                       PEVENT_CONTEXT EventContext, PDOKAN_FILE_INFO FileInfo,
-                       PDOKAN_OPERATIONS DokanOperations) {
-  ULONGLONG freeBytesAvailable = 0;
-  ULONGLONG totalBytes = 0;
-  ULONGLONG freeBytes = 0;
-  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
-
+                       PDOKAN_FILE_INFO FileInfo,
+                       ULONGLONG FreeBytesAvailable, ULONGLONG TotalBytes) {
   ULONG allocationUnitSize = FileInfo->DokanOptions->AllocationUnitSize;
   ULONG sectorSize = FileInfo->DokanOptions->SectorSize;
 
   PFILE_FS_SIZE_INFORMATION sizeInfo =
       (PFILE_FS_SIZE_INFORMATION)EventInfo->Buffer;
 
-  if (EventContext->Operation.Volume.BufferLength <
-      sizeof(FILE_FS_SIZE_INFORMATION)) {
-    return STATUS_BUFFER_OVERFLOW;
-  }
-
-  if (DokanOperations->GetDiskFreeSpace) {
-    status = DokanOperations->GetDiskFreeSpace(
-        &freeBytesAvailable, // FreeBytesAvailable
-        &totalBytes,         // TotalNumberOfBytes
-        &freeBytes,          // TotalNumberOfFreeBytes
-        FileInfo);
-  }
-
-  if (status == STATUS_NOT_IMPLEMENTED) {
-    status = DokanGetDiskFreeSpace(&freeBytesAvailable, // FreeBytesAvailable
-                                   &totalBytes,         // TotalNumberOfBytes
-                                   &freeBytes, // TotalNumberOfFreeBytes
-                                   FileInfo);
-  }
-
-  if (status != STATUS_SUCCESS) {
-    return status;
-  }
-
   sizeInfo->TotalAllocationUnits.QuadPart =
-      totalBytes / allocationUnitSize;
+      TotalBytes / allocationUnitSize;
   sizeInfo->AvailableAllocationUnits.QuadPart =
-      freeBytesAvailable / allocationUnitSize;
+      FreeBytesAvailable / allocationUnitSize;
   sizeInfo->SectorsPerAllocationUnit =
 	  allocationUnitSize / sectorSize;
   sizeInfo->BytesPerSector = sectorSize;
@@ -191,55 +112,31 @@ DokanFsSizeInformation(PEVENT_INFORMATION EventInfo,
 NTSTATUS
 DokanFsAttributeInformation(PEVENT_INFORMATION EventInfo,
                             PEVENT_CONTEXT EventContext,
-                            PDOKAN_FILE_INFO FileInfo,
-                            PDOKAN_OPERATIONS DokanOperations) {
-  WCHAR volumeName[MAX_PATH];
-  DWORD volumeSerial;
-  DWORD maxComLength = 0;
-  DWORD fsFlags = 0;
-  WCHAR fsName[MAX_PATH];
+                            DWORD MaximumComponentLength,
+                            DWORD FileSystemFlags, LPCWSTR FileSystemName) {
   ULONG remainingLength;
   ULONG bytesToCopy;
-  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
+  NTSTATUS status = STATUS_SUCCESS;
 
   PFILE_FS_ATTRIBUTE_INFORMATION attrInfo =
       (PFILE_FS_ATTRIBUTE_INFORMATION)EventInfo->Buffer;
 
   remainingLength = EventContext->Operation.Volume.BufferLength;
 
-  if (remainingLength < sizeof(FILE_FS_ATTRIBUTE_INFORMATION)) {
-    return STATUS_BUFFER_OVERFLOW;
-  }
-
-  status = DokanGetVolumeInformation(
-      DokanOperations,
-      volumeName,                         // VolumeNameBuffer
-      sizeof(volumeName) / sizeof(WCHAR), // VolumeNameSize
-      &volumeSerial,                      // VolumeSerialNumber
-      &maxComLength,                      // MaximumComponentLength
-      &fsFlags,                           // FileSystemFlags
-      fsName,                             // FileSystemNameBuffer
-      sizeof(fsName) / sizeof(WCHAR),     // FileSystemNameSize
-      FileInfo);
-
-  if (status != STATUS_SUCCESS) {
-    return status;
-  }
-
-  attrInfo->FileSystemAttributes = fsFlags;
-  attrInfo->MaximumComponentNameLength = maxComLength;
+  attrInfo->FileSystemAttributes = FileSystemFlags;
+  attrInfo->MaximumComponentNameLength = MaximumComponentLength;
 
   remainingLength -=
       FIELD_OFFSET(FILE_FS_ATTRIBUTE_INFORMATION, FileSystemName[0]);
 
-  bytesToCopy = (ULONG)wcslen(fsName) * sizeof(WCHAR);
+  bytesToCopy = (ULONG)wcslen(FileSystemName) * sizeof(WCHAR);
   if (remainingLength < bytesToCopy) {
     bytesToCopy = remainingLength;
     status = STATUS_BUFFER_OVERFLOW;
   }
 
   attrInfo->FileSystemNameLength = bytesToCopy;
-  RtlCopyMemory(attrInfo->FileSystemName, fsName, bytesToCopy);
+  RtlCopyMemory(attrInfo->FileSystemName, FileSystemName, bytesToCopy);
   remainingLength -= bytesToCopy;
 
   EventInfo->BufferLength =
@@ -250,50 +147,21 @@ DokanFsAttributeInformation(PEVENT_INFORMATION EventInfo,
 
 NTSTATUS
 DokanFsFullSizeInformation(PEVENT_INFORMATION EventInfo,
-                           PEVENT_CONTEXT EventContext,
                            PDOKAN_FILE_INFO FileInfo,
-                           PDOKAN_OPERATIONS DokanOperations) {
-  ULONGLONG freeBytesAvailable = 0;
-  ULONGLONG totalBytes = 0;
-  ULONGLONG freeBytes = 0;
-  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
-
+                           ULONGLONG FreeBytesAvailable, ULONGLONG TotalBytes,
+                           ULONGLONG FreeBytes) {
   ULONG allocationUnitSize = FileInfo->DokanOptions->AllocationUnitSize;
   ULONG sectorSize = FileInfo->DokanOptions->SectorSize;
 
   PFILE_FS_FULL_SIZE_INFORMATION sizeInfo =
       (PFILE_FS_FULL_SIZE_INFORMATION)EventInfo->Buffer;
 
-  if (EventContext->Operation.Volume.BufferLength <
-      sizeof(FILE_FS_FULL_SIZE_INFORMATION)) {
-    return STATUS_BUFFER_OVERFLOW;
-  }
-
-  if (DokanOperations->GetDiskFreeSpace) {
-    status = DokanOperations->GetDiskFreeSpace(
-        &freeBytesAvailable, // FreeBytesAvailable
-        &totalBytes,         // TotalNumberOfBytes
-        &freeBytes,          // TotalNumberOfFreeBytes
-        FileInfo);
-  }
-
-  if (status == STATUS_NOT_IMPLEMENTED) {
-    status = DokanGetDiskFreeSpace(&freeBytesAvailable, // FreeBytesAvailable
-                                   &totalBytes,         // TotalNumberOfBytes
-                                   &freeBytes, // TotalNumberOfFreeBytes
-                                   FileInfo);
-  }
-
-  if (status != STATUS_SUCCESS) {
-    return status;
-  }
-
   sizeInfo->TotalAllocationUnits.QuadPart =
-      totalBytes / allocationUnitSize;
+      TotalBytes / allocationUnitSize;
   sizeInfo->ActualAvailableAllocationUnits.QuadPart =
-      freeBytes / allocationUnitSize;
+      FreeBytes / allocationUnitSize;
   sizeInfo->CallerAvailableAllocationUnits.QuadPart =
-      freeBytesAvailable / allocationUnitSize;
+      FreeBytesAvailable / allocationUnitSize;
   sizeInfo->SectorsPerAllocationUnit =
 	  allocationUnitSize / sectorSize;
   sizeInfo->BytesPerSector = sectorSize;
@@ -303,11 +171,148 @@ DokanFsFullSizeInformation(PEVENT_INFORMATION EventInfo,
   return STATUS_SUCCESS;
 }
 
+VOID DOKANAPI DokanEndDispatchGetVolumeInformation(
+    PDOKAN_FILE_INFO DokanFileInfo, LPCWSTR VolumeName,
+    DWORD VolumeSerialNumber, DWORD MaximumComponentLength,
+    DWORD FileSystemFlags, LPCWSTR FileSystemName, NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  WCHAR volumeName[MAX_PATH];
+  WCHAR fsName[MAX_PATH];
+
+  if (Status == STATUS_NOT_IMPLEMENTED) {
+    Status = DokanGetDefaultVolumeInformation(
+        volumeName,                         // VolumeNameBuffer
+        sizeof(volumeName) / sizeof(WCHAR), // VolumeNameSize
+        &VolumeSerialNumber,                // VolumeSerialNumber
+        &MaximumComponentLength,            // MaximumComponentLength
+        &FileSystemFlags,                   // FileSystemFlags
+        fsName,                             // FileSystemNameBuffer
+        sizeof(fsName) / sizeof(WCHAR),     // FileSystemNameSize
+        DokanFileInfo);
+    VolumeName = volumeName;
+    FileSystemName = fsName;
+  }
+
+  switch (ioEvent->EventContext->Operation.Volume.FsInformationClass) {
+  case FileFsVolumeInformation:
+    ioEvent->EventResult->Status = DokanFsVolumeInformation(
+        ioEvent->EventResult, ioEvent->EventContext, VolumeName,
+        VolumeSerialNumber);
+    break;
+  case FileFsAttributeInformation:
+    ioEvent->EventResult->Status =
+        Status != STATUS_SUCCESS
+            ? Status
+            : DokanFsAttributeInformation(
+                  ioEvent->EventResult, ioEvent->EventContext,
+                  MaximumComponentLength, FileSystemFlags, FileSystemName);
+    break;
+  default:
+    ioEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
+    break;
+  }
+
+  EventCompletion(ioEvent);
+}
+
+VOID DOKANAPI DokanEndDispatchGetDiskFreeSpace(
+    PDOKAN_FILE_INFO DokanFileInfo, ULONGLONG FreeBytesAvailable,
+    ULONGLONG TotalNumberOfBytes, ULONGLONG TotalNumberOfFreeBytes,
+    NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+
+  if (Status == STATUS_NOT_IMPLEMENTED) {
+    Status = DokanGetDiskFreeSpace(&FreeBytesAvailable, &TotalNumberOfBytes,
+                                   &TotalNumberOfFreeBytes, DokanFileInfo);
+  }
+
+  if (Status != STATUS_SUCCESS) {
+    ioEvent->EventResult->Status = Status;
+    EventCompletion(ioEvent);
+    return;
+  }
+
+  switch (ioEvent->EventContext->Operation.Volume.FsInformationClass) {
+  case FileFsSizeInformation:
+    ioEvent->EventResult->Status =
+        DokanFsSizeInformation(ioEvent->EventResult, DokanFileInfo,
+                               FreeBytesAvailable, TotalNumberOfBytes);
+    break;
+  case FileFsFullSizeInformation:
+    ioEvent->EventResult->Status = DokanFsFullSizeInformation(
+        ioEvent->EventResult, DokanFileInfo, FreeBytesAvailable,
+        TotalNumberOfBytes, TotalNumberOfFreeBytes);
+    break;
+  default:
+    ioEvent->EventResult->Status = STATUS_INVALID_PARAMETER;
+    break;
+  }
+
+  EventCompletion(ioEvent);
+}
+
+VOID DokanQueryVolumeInformation(PDOKAN_IO_EVENT IoEvent) {
+  WCHAR volumeName[MAX_PATH];
+  DWORD volumeSerial = 0;
+  DWORD maxComLength = 0;
+  DWORD fsFlags = 0;
+  WCHAR fsName[MAX_PATH];
+  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
+
+  RtlZeroMemory(volumeName, sizeof(volumeName));
+  RtlZeroMemory(fsName, sizeof(fsName));
+
+  if (IoEvent->DokanInstance->DokanOperations->GetVolumeInformation) {
+    status = IoEvent->DokanInstance->DokanOperations->GetVolumeInformation(
+        volumeName,                         // VolumeNameBuffer
+        sizeof(volumeName) / sizeof(WCHAR), // VolumeNameSize
+        &volumeSerial,                      // VolumeSerialNumber
+        &maxComLength,                      // MaximumComponentLength
+        &fsFlags,                           // FileSystemFlags
+        fsName,                             // FileSystemNameBuffer
+        sizeof(fsName) / sizeof(WCHAR),     // FileSystemNameSize
+        &IoEvent->DokanFileInfo);
+  }
+
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
+  }
+  DokanEndDispatchGetVolumeInformation(&IoEvent->DokanFileInfo, volumeName,
+                                       volumeSerial, maxComLength, fsFlags,
+                                       fsName, status);
+}
+
+VOID DokanQueryDiskFreeSpace(PDOKAN_IO_EVENT IoEvent) {
+  ULONGLONG freeBytesAvailable = 0;
+  ULONGLONG totalBytes = 0;
+  ULONGLONG freeBytes = 0;
+  NTSTATUS status = STATUS_NOT_IMPLEMENTED;
+
+  if (IoEvent->DokanInstance->DokanOperations->GetDiskFreeSpace) {
+    status = IoEvent->DokanInstance->DokanOperations->GetDiskFreeSpace(
+        &freeBytesAvailable, // FreeBytesAvailable
+        &totalBytes,         // TotalNumberOfBytes
+        &freeBytes,          // TotalNumberOfFreeBytes
+        &IoEvent->DokanFileInfo);
+  }
+
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
+  }
+  DokanEndDispatchGetDiskFreeSpace(&IoEvent->DokanFileInfo,
+                                   freeBytesAvailable, totalBytes, freeBytes,
+                                   status);
+}
+
 VOID DispatchQueryVolumeInformation(PDOKAN_IO_EVENT IoEvent) {
+  ULONG minimumLength = 0;
+
   CreateDispatchCommon(IoEvent,
                        IoEvent->EventContext->Operation.Volume.BufferLength,
                        /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   DbgPrint("###QueryVolumeInfo file handle = 0x%p, eventID = %04d, event Info "
            "= 0x%p\n",
@@ -320,29 +325,36 @@ VOID DispatchQueryVolumeInformation(PDOKAN_IO_EVENT IoEvent) {
 
   switch (IoEvent->EventContext->Operation.Volume.FsInformationClass) {
   case FileFsVolumeInformation:
-    IoEvent->EventResult->Status = DokanFsVolumeInformation(
-        IoEvent->EventResult, IoEvent->EventContext, &IoEvent->DokanFileInfo,
-                                 IoEvent->DokanInstance->DokanOperations);
+    minimumLength = sizeof(FILE_FS_VOLUME_INFORMATION);
     break;
   case FileFsSizeInformation:
-    IoEvent->EventResult->Status = DokanFsSizeInformation(
-        IoEvent->EventResult, IoEvent->EventContext, &IoEvent->DokanFileInfo,
-                               IoEvent->DokanInstance->DokanOperations);
+    minimumLength = sizeof(FILE_FS_SIZE_INFORMATION);
     break;
   case FileFsAttributeInformation:
-    IoEvent->EventResult->Status = DokanFsAttributeInformation(
-        IoEvent->EventResult, IoEvent->EventContext, &IoEvent->DokanFileInfo,
-        IoEvent->DokanInstance->DokanOperations);
+    minimumLength = sizeof(FILE_FS_ATTRIBUTE_INFORMATION);
     break;
   case FileFsFullSizeInformation:
-    IoEvent->EventResult->Status = DokanFsFullSizeInformation(
-        IoEvent->EventResult, IoEvent->EventContext, &IoEvent->DokanFileInfo,
-        IoEvent->DokanInstance->DokanOperations);
+    minimumLength = sizeof(FILE_FS_FULL_SIZE_INFORMATION);
     break;
   default:
     DbgPrint("error unknown volume info %d\n",
              IoEvent->EventContext->Operation.Volume.FsInformationClass);
+    EventCompletion(IoEvent);
+    return;
   }
 
-  EventCompletion(IoEvent);
+  if (IoEvent->EventContext->Operation.Volume.BufferLength < minimumLength) {
+    IoEvent->EventResult->Status = STATUS_BUFFER_OVERFLOW;
+    EventCompletion(IoEvent);
+    return;
+  }
+
+  if (IoEvent->EventContext->Operation.Volume.FsInformationClass ==
+          FileFsVolumeInformation ||
+      IoEvent->EventContext->Operation.Volume.FsInformationClass ==
+          FileFsAttributeInformation) {
+    DokanQueryVolumeInformation(IoEvent);
+  } else {
+    DokanQueryDiskFreeSpace(IoEvent);
+  }
 }
@@ -30,32 +30,65 @@ DWORD SendWriteRequest(PDOKAN_IO_EVENT IoEvent, ULONG WriteEventContextLength,
                        PDOKAN_IO_BATCH *WriteIoBatch) {
   DWORD WrittenLength = 0;
   if (WriteEventContextLength <= BATCH_EVENT_CONTEXT_SIZE) {
-    *WriteIoBatch = PopIoBatchBuffer();
+    *WriteIoBatch = PopIoBatchBuffer(IoEvent->DokanInstance);
   } else {
+    SIZE_T bufferSize = (SIZE_T)FIELD_OFFSET(DOKAN_IO_BATCH, EventContext) +
+                        WriteEventContextLength;
     PDOKAN_IO_BATCH buffer =
-        malloc((SIZE_T)FIELD_OFFSET(DOKAN_IO_BATCH, EventContext) +
-               WriteEventContextLength);
-    if (!buffer) {
-      DokanDbgPrintW(L"Dokan Error: Failed to allocate IO event buffer.\n");
-      return ERROR_NO_SYSTEM_RESOURCES;
+        PopLargeBuffer(IoEvent->DokanInstance, bufferSize);
+    if (buffer) {
+      RtlZeroMemory(buffer, FIELD_OFFSET(DOKAN_IO_BATCH, EventContext));
+      buffer->DokanInstance = IoEvent->DokanInstance;
+      buffer->LargeBufferSize = bufferSize;
+    } else {
+      buffer = malloc(bufferSize);
+      if (!buffer) {
+        DokanDbgPrintW(L"Dokan Error: Failed to allocate IO event buffer.\n");
+        return ERROR_NO_SYSTEM_RESOURCES;
+      }
+      buffer->LargeBufferSize = 0;
     }
     *WriteIoBatch = buffer;
     (*WriteIoBatch)->PoolAllocated = FALSE;
   }
 
-  if (!DeviceIoControl(
-          IoEvent->DokanInstance->Device,    // Handle to device
-          FSCTL_EVENT_WRITE,                 // IO Control code
-          IoEvent->EventResult,              // Input Buffer to driver.
-          IoEvent->EventResultSize,          // Length of input buffer in bytes.
-          &(*WriteIoBatch)->EventContext[0], // Output Buffer from driver.
-          WriteEventContextLength, // Length of output buffer in bytes.
-          &WrittenLength,          // Bytes placed in buffer.
-          NULL                     // asynchronous call
-          )) {
-    return GetLastError();
+  return IoEvent->DokanInstance->Transport->FetchWrite(
+      IoEvent->DokanInstance, IoEvent->EventResult, IoEvent->EventResultSize,
+      &(*WriteIoBatch)->EventContext[0], WriteEventContextLength,
+      &WrittenLength);
+}
+
+VOID DOKANAPI DokanEndDispatchWrite(PDOKAN_FILE_INFO DokanFileInfo,
+                                    DWORD NumberOfBytesWritten,
+                                    NTSTATUS Status) {
+  PDOKAN_IO_EVENT ioEvent =
+      (PDOKAN_IO_EVENT)(UINT_PTR)DokanFileInfo->DokanContext;
+  // Set by DispatchWrite when the driver sent the write in its own batch.
+  PDOKAN_IO_BATCH writeIoBatch =
+      DokanFileInfo->ProcessingContext
+          ? (PDOKAN_IO_BATCH)DokanFileInfo->ProcessingContext
+          : ioEvent->IoBatch;
+
+  ioEvent->EventResult->Status = Status;
+  ioEvent->EventResult->BufferLength = 0;
+
+  if (Status == STATUS_SUCCESS) {
+    ioEvent->EventResult->BufferLength = NumberOfBytesWritten;
+    ioEvent->EventResult->Operation.Write.CurrentByteOffset.QuadPart =
+        writeIoBatch->EventContext->Operation.Write.ByteOffset.QuadPart +
+        NumberOfBytesWritten;
   }
-  return 0;
+
+  if (writeIoBatch != ioEvent->IoBatch) {
+    DokanFileInfo->ProcessingContext = NULL;
+    if (writeIoBatch->PoolAllocated) {
+      PushIoBatchBuffer(writeIoBatch);
+    } else {
+      FreeIoBatchBuffer(writeIoBatch);
+    }
+  }
+
+  EventCompletion(ioEvent);
 }
 
 VOID DispatchWrite(PDOKAN_IO_EVENT IoEvent) {
@@ -64,7 +97,7 @@ VOID DispatchWrite(PDOKAN_IO_EVENT IoEvent) {
   NTSTATUS status;
 
   CreateDispatchCommon(IoEvent, 0, /*UseExtraMemoryPool=*/FALSE,
-                       /*ClearNonPoolBuffer=*/TRUE);
+                       /*ClearBuffer=*/TRUE);
 
   CheckFileName(IoEvent->EventContext->Operation.Write.FileName);
   DbgPrint(
@@ -96,7 +129,7 @@ VOID DispatchWrite(PDOKAN_IO_EVENT IoEvent) {
         if (writeIoBatch->PoolAllocated) {
           PushIoBatchBuffer(writeIoBatch);
         } else {
-          free(writeIoBatch);
+          FreeIoBatchBuffer(writeIoBatch);
         }
       }
       EventCompletion(IoEvent);
@@ -104,6 +137,10 @@ VOID DispatchWrite(PDOKAN_IO_EVENT IoEvent) {
     }
   }
 
+  if (writeIoBatch != IoEvent->IoBatch) {
+    IoEvent->DokanFileInfo.ProcessingContext = writeIoBatch;
+  }
+
   // for the case SendWriteRequest success
   if (IoEvent->DokanInstance->DokanOperations->WriteFile) {
     status = IoEvent->DokanInstance->DokanOperations->WriteFile(
@@ -118,23 +155,8 @@ VOID DispatchWrite(PDOKAN_IO_EVENT IoEvent) {
     status = STATUS_NOT_IMPLEMENTED;
   }
 
-  IoEvent->EventResult->Status = status;
-  IoEvent->EventResult->BufferLength = 0;
-
-  if (status == STATUS_SUCCESS) {
-    IoEvent->EventResult->BufferLength = writtenLength;
-    IoEvent->EventResult->Operation.Write.CurrentByteOffset.QuadPart =
-        writeIoBatch->EventContext->Operation.Write.ByteOffset.QuadPart +
-        writtenLength;
-  }
-
-  if (writeIoBatch != IoEvent->IoBatch) {
-    if (writeIoBatch->PoolAllocated) {
-      PushIoBatchBuffer(writeIoBatch);
-    } else {
-      free(writeIoBatch);
-    }
+  if (IsDispatchPending(IoEvent, status)) {
+    return;
   }
-
-  EventCompletion(IoEvent);
+  DokanEndDispatchWrite(&IoEvent->DokanFileInfo, writtenLength, status);
 }
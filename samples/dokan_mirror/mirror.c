@@ -82,6 +82,9 @@ static WCHAR gRootDirectory[DOKAN_MAX_PATH] = L"C:";
 static WCHAR gMountPoint[DOKAN_MAX_PATH] = L"M:\\";
 static WCHAR gUNCName[DOKAN_MAX_PATH] = L"";
 static WCHAR gVolumeName[MAX_PATH + 1] = L"DOKAN";
+static WCHAR gTraceFile[MAX_PATH] = L"";
+static WCHAR gReplayFile[MAX_PATH] = L"";
+static BOOL g_ReplayOriginalSpeed = FALSE;
 
 static void GetFilePath(PWCHAR filePath, ULONG numberOfElements,
                         LPCWSTR FileName) {
@@ -1526,7 +1529,10 @@ void ShowUsage() {
           "  /i Timeout in Milliseconds (ex. /i 30000)\t Timeout until a running operation is aborted and the device is unmounted.\n"
           "  /x Network unmount\t\t\t\t Allows unmounting network drive from file explorer.\n"
           "  /e Enable Driver Logs\t\t\t\t Forward Driver logs to userland.\n"
-          "  /v Volume name\t\t\t\t Personalize the volume name.\n\n"
+          "  /v Volume name\t\t\t\t Personalize the volume name.\n"
+          "  /y Trace file (ex. /y C:\\mirror.trace)\t Record the events received by the mount in a trace file.\n"
+          "  /z Trace file (ex. /z C:\\mirror.trace)\t Replay a recorded trace on RootDirectory without mounting and show the time taken.\n"
+          "  /q Replay at recorded speed\t\t\t Replay the trace at the pace it was recorded instead of as fast as possible.\n\n"
           "Examples:\n"
           "\tmirror.exe /r C:\\Users /l M:\t\t\t# Mirror C:\\Users as RootDirectory into a drive of letter M:\\.\n"
           "\tmirror.exe /r C:\\Users /l C:\\mount\\dokan\t# Mirror C:\\Users as RootDirectory into NTFS folder C:\\mount\\dokan.\n"
@@ -1535,6 +1541,60 @@ void ShowUsage() {
   // clang-format on
 }
 
+static const char *MajorFunctionName(ULONG MajorFunction) {
+  static const char *names[DOKAN_MAJOR_FUNCTION_COUNT] = {
+      "Create", "CreateNamedPipe", "Close", "Read", "Write",
+      "QueryInformation", "SetInformation", "QueryEa", "SetEa",
+      "FlushBuffers", "QueryVolumeInformation", "SetVolumeInformation",
+      "DirectoryControl", "FileSystemControl", "DeviceControl",
+      "InternalDeviceControl", "Shutdown", "LockControl", "Cleanup",
+      "CreateMailslot", "QuerySecurity", "SetSecurity", "Power",
+      "SystemControl", "DeviceChange", "QueryQuota", "SetQuota", "Pnp"};
+  return names[MajorFunction];
+}
+
+// Replays gReplayFile on the mirror operations in memory and shows the
+// throughput and the time taken by each kind of event.
+static int ReplayTrace(PDOKAN_OPTIONS DokanOptions,
+                       PDOKAN_OPERATIONS DokanOperations) {
+  DOKAN_HANDLE instance;
+  DOKAN_REPLAY_STATISTICS replay;
+  DOKAN_MEMORY_TRANSPORT_STATISTICS statistics;
+  int status;
+
+  status =
+      DokanCreateMemoryFileSystem(DokanOptions, DokanOperations, &instance);
+  if (status != DOKAN_SUCCESS) {
+    fwprintf(stderr, L"Failed to create the file system: %d\n", status);
+    return EXIT_FAILURE;
+  }
+  if (!DokanReplayEventTrace(instance, gReplayFile, g_ReplayOriginalSpeed,
+                             &replay)) {
+    fwprintf(stderr, L"Failed to replay %ls\n", gReplayFile);
+    DokanCloseHandle(instance);
+    return EXIT_FAILURE;
+  }
+  DokanGetMemoryTransportStatistics(instance, &statistics);
+  DokanCloseHandle(instance);
+
+  fprintf(stderr,
+          "%llu events in %llu ms, %llu events/s, %llu events skipped\n",
+          replay.Events, replay.ElapsedUs / 1000, replay.EventsPerSecond,
+          replay.SkippedEvents);
+  fprintf(stderr, "%-24s %10s %12s %12s\n", "Major function", "Count",
+          "Average us", "Max us");
+  for (ULONG i = 0; i < DOKAN_MAJOR_FUNCTION_COUNT; ++i) {
+    PDOKAN_LATENCY_STATISTICS latency = &statistics.Latency[i];
+    if (!latency->Count) {
+      continue;
+    }
+    fprintf(stderr, "%-24s %10llu %12llu %12llu\n", MajorFunctionName(i),
+            latency->Count, latency->TotalUs / latency->Count,
+            latency->MaxUs);
+  }
+  return EXIT_SUCCESS;
+}
+
 #define CHECK_CMD_ARG(commad, argc)                                            \
   {                                                                            \
     if (++command == argc) {                                                   \
@@ -1644,6 +1704,17 @@ int __cdecl wmain(ULONG argc, PWCHAR argv[]) {
       CHECK_CMD_ARG(command, argc)
       dokanOptions.SectorSize = (ULONG)_wtol(argv[command]);
       break;
+    case L'y':
+      CHECK_CMD_ARG(command, argc)
+      wcscpy_s(gTraceFile, sizeof(gTraceFile) / sizeof(WCHAR), argv[command]);
+      break;
+    case L'z':
+      CHECK_CMD_ARG(command, argc)
+      wcscpy_s(gReplayFile, sizeof(gReplayFile) / sizeof(WCHAR), argv[command]);
+      break;
+    case L'q':
+      g_ReplayOriginalSpeed = TRUE;
+      break;
     default:
       fwprintf(stderr, L"unknown command: %ls\n", argv[command]);
       return EXIT_FAILURE;
@@ -1735,7 +1806,24 @@ int __cdecl wmain(ULONG argc, PWCHAR argv[]) {
   dokanOperations.Mounted = MirrorMounted;
 
   DokanInit();
-  status = DokanMain(&dokanOptions, &dokanOperations);
+  if (wcscmp(gReplayFile, L"") != 0) {
+    status = ReplayTrace(&dokanOptions, &dokanOperations);
+    DokanShutdown();
+    return status;
+  }
+  if (wcscmp(gTraceFile, L"") != 0) {
+    DOKAN_HANDLE instance;
+    status = DokanCreateFileSystem(&dokanOptions, &dokanOperations, &instance);
+    if (status == DOKAN_SUCCESS) {
+      if (!DokanStartEventTrace(instance, gTraceFile)) {
+        fwprintf(stderr, L"Failed to record the trace in %ls\n", gTraceFile);
+      }
+      DokanWaitForFileSystemClosed(instance, INFINITE);
+      DokanCloseHandle(instance);
+    }
+  } else {
+    status = DokanMain(&dokanOptions, &dokanOperations);
+  }
   DokanShutdown();
   switch (status) {
   case DOKAN_SUCCESS:
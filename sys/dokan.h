@@ -122,6 +122,7 @@ extern ULONG DokanMdlSafePriority;
 
 #define DRIVER_CONTEXT_EVENT 2
 #define DRIVER_CONTEXT_IRP_ENTRY 3
+#define DRIVER_CONTEXT_PULL_DCB 0
 
 #define DOKAN_IRP_PENDING_TIMEOUT (1000 * 15)               // in millisecond
 #define DOKAN_IRP_PENDING_TIMEOUT_RESET_MAX (1000 * 60 * 5) // in millisecond
@@ -290,6 +291,12 @@ typedef struct _DokanDiskControlBlock {
   // strictly one for each DeviceIoControl that the DLL issues to fetch a
   // request.
   BOOLEAN AllowIpcBatching;
+  // Whether pull requests that find no event are left pending instead of
+  // blocking the calling thread. Such IRPs wait in PendingPulls, linked through
+  // Tail.Overlay.ListEntry, until DokanEventNotification can fill them.
+  BOOLEAN OverlappedPull;
+  LIST_ENTRY PendingPulls;
+  KSPIN_LOCK PendingPullsLock;
 
   // How often to garbage-collect FCBs. If this is 0, we use the historical
   // default behavior of freeing them on the spot and in the current context
@@ -1018,6 +1025,19 @@ VOID DokanEventNotification(__in PREQUEST_CONTEXT RequestContext,
                             __in PIRP_LIST NotifyEvent,
                             __in PEVENT_CONTEXT EventContext);
 
+NTSTATUS PullEvents(__in PDokanDCB Dcb, __in PIRP Irp,
+                    __in PIRP_LIST NotifyEvent);
+
+// Marks the pull IRP pending and parks it until an event is notified. Returns
+// FALSE if the IRP was already canceled, in which case the caller completes it.
+BOOLEAN DokanQueuePendingPull(__in PDokanDCB Dcb, __in PIRP Irp);
+
+// Fills and completes the parked pull IRPs while events are available.
+VOID DokanServicePendingPulls(__in PDokanDCB Dcb);
+
+// Completes all the parked pull IRPs with STATUS_NO_SUCH_DEVICE.
+VOID DokanReleasePendingPulls(__in PDokanDCB Dcb);
+
 VOID DokanCompleteDirectoryControl(__in PREQUEST_CONTEXT RequestContext,
                                    __in PEVENT_INFORMATION EventInfo);
 
@@ -506,6 +506,23 @@ DokanCompleteIrp(__in PREQUEST_CONTEXT RequestContext) {
       break;
     }
     lastSerialNumber = eventInfo->SerialNumber;
+    if (irpEntry->SerialNumber > eventInfo->SerialNumber &&
+        (eventInfo->Flags & DOKAN_EVENT_INFO_BATCHED)) {
+      // The pending list is sorted too, so the IRP of this reply was canceled
+      // or timed out. Skip the reply and match this entry with the next one.
+      ULONGLONG skippedSize =
+          (eventInfo->Flags & DOKAN_EVENT_INFO_FIXED_SIZE)
+              ? sizeof(EVENT_INFORMATION)
+              : max((ULONGLONG)sizeof(EVENT_INFORMATION),
+                    (ULONGLONG)FIELD_OFFSET(EVENT_INFORMATION, Buffer[0]) +
+                        eventInfo->BufferLength);
+      if (offset + skippedSize + sizeof(EVENT_INFORMATION) > bufferLength) {
+        break;
+      }
+      offset += (ULONG)skippedSize;
+      nextEntry = thisEntry;
+      continue;
+    }
     if (irpEntry->SerialNumber != eventInfo->SerialNumber) {
       continue;
     }
@@ -996,6 +1013,8 @@ DokanEventStart(__in PREQUEST_CONTEXT RequestContext) {
       (eventStart->Flags & DOKAN_EVENT_DISPATCH_DRIVER_LOGS) != 0;
   dcb->AllowIpcBatching =
       (eventStart->Flags & DOKAN_EVENT_ALLOW_IPC_BATCHING) != 0;
+  dcb->OverlappedPull =
+      (eventStart->Flags & DOKAN_EVENT_OVERLAPPED_PULL) != 0;
   isMountPointDriveLetter = IsMountPointDriveLetter(dcb->MountPoint);
 
   if (dcb->DispatchDriverLogs) {
@@ -452,7 +452,7 @@ DokanGlobalUserFsRequest(__in PREQUEST_CONTEXT RequestContext) {
   return STATUS_INVALID_DEVICE_REQUEST;
 }
 
-NTSTATUS PullEvents(__in PREQUEST_CONTEXT RequestContext,
+NTSTATUS PullEvents(__in PDokanDCB Dcb, __in PIRP Irp,
                     __in PIRP_LIST NotifyEvent) {
   PDRIVER_EVENT_CONTEXT workItem = NULL;
   PDRIVER_EVENT_CONTEXT alreadySeenWorkItem = NULL;
@@ -460,9 +460,9 @@ NTSTATUS PullEvents(__in PREQUEST_CONTEXT RequestContext,
   KIRQL workQueueIrql;
   ULONG workItemBytes = 0;
   ULONG currentIoctlBufferBytesRemaining =
-      RequestContext->IrpSp->Parameters.DeviceIoControl.OutputBufferLength;
-  PCHAR currentIoctlBuffer =
-      (PCHAR)RequestContext->Irp->AssociatedIrp.SystemBuffer;
+      IoGetCurrentIrpStackLocation(Irp)
+          ->Parameters.DeviceIoControl.OutputBufferLength;
+  PCHAR currentIoctlBuffer = (PCHAR)Irp->AssociatedIrp.SystemBuffer;
 
   ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
   KeAcquireSpinLock(&NotifyEvent->ListLock, &workQueueIrql);
@@ -489,21 +489,20 @@ NTSTATUS PullEvents(__in PREQUEST_CONTEXT RequestContext,
     RtlCopyMemory(currentIoctlBuffer, &workItem->EventContext, workItemBytes);
     currentIoctlBufferBytesRemaining -= workItemBytes;
     currentIoctlBuffer += workItemBytes;
-    RequestContext->Irp->IoStatus.Information += workItemBytes;
+    Irp->IoStatus.Information += workItemBytes;
     ExFreePool(workItem);
-    if (!RequestContext->Dcb->AllowIpcBatching) {
+    if (!Dcb->AllowIpcBatching) {
       break;
     }
   }
   // If there is still pending items we need to reflag the queue for when we come back
   if (!IsListEmpty(&NotifyEvent->ListHead) &&
-       !KeReadStateQueue(&RequestContext->Dcb->NotifyIrpEventQueue)) {
-     KeInsertQueue(&RequestContext->Dcb->NotifyIrpEventQueue,
-                   &RequestContext->Dcb->NotifyIrpEventQueueList);
+       !KeReadStateQueue(&Dcb->NotifyIrpEventQueue)) {
+     KeInsertQueue(&Dcb->NotifyIrpEventQueue, &Dcb->NotifyIrpEventQueueList);
   }
   KeReleaseSpinLock(&NotifyEvent->ListLock, workQueueIrql);
-  RequestContext->Irp->IoStatus.Status = STATUS_SUCCESS;
-  return RequestContext->Irp->IoStatus.Status;
+  Irp->IoStatus.Status = STATUS_SUCCESS;
+  return Irp->IoStatus.Status;
 }
 
 
@@ -532,6 +531,26 @@ NTSTATUS DokanProcessAndPullEvents(__in PREQUEST_CONTEXT RequestContext) {
   // 3 - Flag the device as having workers starting to pull events.
   RequestContext->Vcb->HasEventWait = TRUE;
 
+  // 4 - With overlapped pulls the IRP never blocks the calling thread: it is
+  // either filled right away or left pending until an event is notified.
+  if (RequestContext->Dcb->OverlappedPull) {
+    PullEvents(RequestContext->Dcb, RequestContext->Irp,
+               &RequestContext->Dcb->NotifyEvent);
+    if (RequestContext->Irp->IoStatus.Information > 0) {
+      return STATUS_SUCCESS;
+    }
+    if (!DokanQueuePendingPull(RequestContext->Dcb, RequestContext->Irp)) {
+      return STATUS_CANCELLED;
+    }
+    // An event may have been notified between the pull and the queuing, and
+    // the unmount may have drained the queue before we got in it.
+    DokanServicePendingPulls(RequestContext->Dcb);
+    if (IsUnmountPendingVcb(RequestContext->Vcb)) {
+      DokanReleasePendingPulls(RequestContext->Dcb);
+    }
+    return STATUS_PENDING;
+  }
+
   PEVENT_INFORMATION eventInfo =
       (PEVENT_INFORMATION)(RequestContext->Irp->AssociatedIrp.SystemBuffer);
   ULONG waitTimeoutMs =
@@ -542,7 +561,7 @@ NTSTATUS DokanProcessAndPullEvents(__in PREQUEST_CONTEXT RequestContext) {
     timeout.QuadPart += (LONGLONG)waitTimeoutMs * 10000; // Ms to 100 nano
   }
 
-  // 4 - Wait for new event indefinitely if we are the main pull thread
+  // 5 - Wait for new event indefinitely if we are the main pull thread
   // or wait for the requested time.
   PLIST_ENTRY listEntry;
   KeRemoveQueueEx(&RequestContext->Dcb->NotifyIrpEventQueue, KernelMode, TRUE,
@@ -558,8 +577,9 @@ NTSTATUS DokanProcessAndPullEvents(__in PREQUEST_CONTEXT RequestContext) {
     return STATUS_SUCCESS;
   }
 
-  // 5 - Fill the provided buffer as much as we can with events.
-  return PullEvents(RequestContext, &RequestContext->Dcb->NotifyEvent);
+  // 6 - Fill the provided buffer as much as we can with events.
+  return PullEvents(RequestContext->Dcb, RequestContext->Irp,
+                    &RequestContext->Dcb->NotifyEvent);
 }
 
 NTSTATUS
@@ -1082,6 +1082,8 @@ DokanCreateDiskDevice(__in PDRIVER_OBJECT DriverObject, __in ULONG MountId,
     RtlZeroMemory(&dcb->NotifyIrpEventQueueList, sizeof(LIST_ENTRY));
     InitializeListHead(&dcb->NotifyIrpEventQueueList);
     KeInitializeQueue(&dcb->NotifyIrpEventQueue, 0);
+    InitializeListHead(&dcb->PendingPulls);
+    KeInitializeSpinLock(&dcb->PendingPullsLock);
 
     KeInitializeEvent(&dcb->ReleaseEvent, NotificationEvent, FALSE);
     ExInitializeResourceLite(&dcb->Resource);
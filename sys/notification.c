@@ -123,6 +123,97 @@ VOID DokanEventNotification(__in PREQUEST_CONTEXT RequestContext,
                   &RequestContext->Dcb->NotifyIrpEventQueueList);
   }
   KeReleaseSpinLock(&NotifyEvent->ListLock, oldIrql);
+
+  if (RequestContext->Dcb->OverlappedPull) {
+    DokanServicePendingPulls(RequestContext->Dcb);
+  }
+}
+
+VOID DokanCancelPendingPull(__in PDEVICE_OBJECT DeviceObject,
+                            __in PIRP Irp) {
+  PDokanDCB dcb = Irp->Tail.Overlay.DriverContext[DRIVER_CONTEXT_PULL_DCB];
+  KIRQL oldIrql;
+
+  UNREFERENCED_PARAMETER(DeviceObject);
+  IoReleaseCancelSpinLock(Irp->CancelIrql);
+
+  KeAcquireSpinLock(&dcb->PendingPullsLock, &oldIrql);
+  RemoveEntryList(&Irp->Tail.Overlay.ListEntry);
+  KeReleaseSpinLock(&dcb->PendingPullsLock, oldIrql);
+
+  Irp->IoStatus.Information = 0;
+  DokanCompleteIrpRequest(Irp, STATUS_CANCELLED);
+}
+
+BOOLEAN DokanQueuePendingPull(__in PDokanDCB Dcb, __in PIRP Irp) {
+  KIRQL oldIrql;
+
+  Irp->Tail.Overlay.DriverContext[DRIVER_CONTEXT_PULL_DCB] = Dcb;
+  ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+  KeAcquireSpinLock(&Dcb->PendingPullsLock, &oldIrql);
+  IoSetCancelRoutine(Irp, DokanCancelPendingPull);
+  // If the cancel routine was already taken by the I/O manager, it is about to
+  // run and will remove the IRP from the list, so it has to be in there.
+  if (Irp->Cancel && IoSetCancelRoutine(Irp, NULL) != NULL) {
+    KeReleaseSpinLock(&Dcb->PendingPullsLock, oldIrql);
+    return FALSE;
+  }
+  IoMarkIrpPending(Irp);
+  InsertTailList(&Dcb->PendingPulls, &Irp->Tail.Overlay.ListEntry);
+  KeReleaseSpinLock(&Dcb->PendingPullsLock, oldIrql);
+  return TRUE;
+}
+
+// Takes the first parked pull IRP that is not being canceled.
+PIRP DokanDequeuePendingPull(__in PDokanDCB Dcb) {
+  PLIST_ENTRY listEntry;
+  PIRP irp = NULL;
+  KIRQL oldIrql;
+
+  ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+  KeAcquireSpinLock(&Dcb->PendingPullsLock, &oldIrql);
+  while (!IsListEmpty(&Dcb->PendingPulls)) {
+    listEntry = RemoveHeadList(&Dcb->PendingPulls);
+    irp = CONTAINING_RECORD(listEntry, IRP, Tail.Overlay.ListEntry);
+    if (IoSetCancelRoutine(irp, NULL) != NULL) {
+      break;
+    }
+    // The cancel routine is running and will unlink the entry itself.
+    InitializeListHead(&irp->Tail.Overlay.ListEntry);
+    irp = NULL;
+  }
+  KeReleaseSpinLock(&Dcb->PendingPullsLock, oldIrql);
+  return irp;
+}
+
+VOID DokanServicePendingPulls(__in PDokanDCB Dcb) {
+  PIRP irp;
+
+  while (!IsListEmpty(&Dcb->NotifyEvent.ListHead)) {
+    irp = DokanDequeuePendingPull(Dcb);
+    if (irp == NULL) {
+      return;
+    }
+    irp->IoStatus.Information = 0;
+    PullEvents(Dcb, irp, &Dcb->NotifyEvent);
+    if (irp->IoStatus.Information == 0) {
+      // Another pull got the events first, or none of them fits this buffer.
+      if (!DokanQueuePendingPull(Dcb, irp)) {
+        DokanCompleteIrpRequest(irp, STATUS_CANCELLED);
+      }
+      return;
+    }
+    DokanCompleteIrpRequest(irp, STATUS_SUCCESS);
+  }
+}
+
+VOID DokanReleasePendingPulls(__in PDokanDCB Dcb) {
+  PIRP irp;
+
+  while ((irp = DokanDequeuePendingPull(Dcb)) != NULL) {
+    irp->IoStatus.Information = 0;
+    DokanCompleteIrpRequest(irp, STATUS_NO_SUCH_DEVICE);
+  }
 }
 
 // Moves the contents of the given Source list to Dest, discarding IRPs that
@@ -372,6 +463,7 @@ NTSTATUS DokanEventRelease(__in_opt PREQUEST_CONTEXT RequestContext,
   ReleasePendingIrp(&dcb->PendingIrp);
   ReleasePendingIrp(&dcb->PendingRetryIrp);
   ReleaseNotifyEvent(&dcb->NotifyEvent);
+  DokanReleasePendingPulls(dcb);
   DokanStopCheckThread(dcb);
   DokanStopEventNotificationThread(dcb);
   KeRundownQueue(&dcb->NotifyIrpEventQueue);
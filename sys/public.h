@@ -28,7 +28,9 @@ with this program. If not, see <http://www.gnu.org/licenses/>.
 #include <minwindef.h>
 #endif
 
-#define DOKAN_DRIVER_VERSION 0x0000190
+// Must match between the driver and the library. 0x191 adds the batched
+// replies of DOKAN_EVENT_INFO_BATCHED, 0x192 DOKAN_EVENT_OVERLAPPED_PULL.
+#define DOKAN_DRIVER_VERSION 0x0000192
 
 #define EVENT_CONTEXT_MAX_SIZE (1024 * 32)
 // This is arbitrary. There isn't really an absolute max, but we marshal it in
@@ -392,6 +394,15 @@ typedef struct _EVENT_INFORMATION {
   UCHAR Buffer[DOKAN_EVENT_INFO_MIN_BUFFER_SIZE];
 } EVENT_INFORMATION, *PEVENT_INFORMATION;
 
+// Bits of EVENT_INFORMATION.Flags.
+
+// The reply is sent with other replies in one buffer. The driver skips it when
+// its IRP is not pending anymore and goes on with the next reply.
+#define DOKAN_EVENT_INFO_BATCHED 1
+// The reply is sizeof(EVENT_INFORMATION) long whatever its BufferLength is,
+// like write replies. Only used with DOKAN_EVENT_INFO_BATCHED.
+#define DOKAN_EVENT_INFO_FIXED_SIZE (1 << 1)
+
 // By default we pool EVENT_INFORMATION objects with a 4k buffer (1 page) as most read/writes are this size
 // or smaller
 #define DOKAN_EVENT_INFO_DEFAULT_SIZE                                          \
@@ -421,6 +432,9 @@ typedef struct _EVENT_INFORMATION {
 #define DOKAN_EVENT_DISPATCH_DRIVER_LOGS                            (1 << 8)
 #define DOKAN_EVENT_ALLOW_IPC_BATCHING                              (1 << 9)
 #define DOKAN_EVENT_DRIVE_LETTER_IN_USE                             (1 << 10)
+// FSCTL_EVENT_PROCESS_N_PULL returns STATUS_PENDING instead of waiting when no
+// event is available, so the DLL can keep overlapped pulls posted.
+#define DOKAN_EVENT_OVERLAPPED_PULL                                 (1 << 11)
 
 // Non-exclusive bits that can be set in EVENT_DRIVER_INFO.Flags for the driver
 // to send back extra info about what happened during a mount attempt, whether